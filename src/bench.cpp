@@ -0,0 +1,1559 @@
+// Micro-benchmarks of the geometry kernels and model scripts. Built only with `WITH_BENCHMARKS`;
+// run the Release configuration, the numbers are meaningless otherwise.
+
+#include <ctype.h>                      // isalnum, isdigit
+#include <math.h>                       // cosf, fabsf, floorf, NAN, sinf, sqrtf
+#include <stdint.h>                     // *int*_t
+#include <stdio.h>                      // printf
+#include <stdlib.h>                     // atoi, strtof, strtoul
+#include <string.h>                     // strchr, strlen, strncmp
+
+#include <algorithm>                    // sort
+#include <filesystem>                   // directory_iterator, remove_all, temp_directory_path
+#include <string>                       // string, to_string
+#include <vector>                       // vector
+
+#include <bx/timer.h>                   // getHPCounter, getHPFrequency
+
+#include <glm/glm.hpp>                  // glm::*
+#include <glm/gtc/matrix_transform.hpp> // rotate, scale, translate
+
+#include "bvh.h"                        // Bvh, Ray
+#include "csg.h"                        // CsgOperation, CsgStats, mesh_boolean
+#include "culling.h"                    // Frustum, ObjectBounds, cull_*
+#include "mesh.h"                       // Aabb, Mesh
+#include "mesh_kernels.h"               // compute_*, set_simd_level, transform_*
+#include "occlusion.h"                  // OcclusionBuffer
+#include "script.h"                     // evaluate_script, ScriptCache, ScriptOptions, ScriptResult
+#include "sdf.h"                        // contour_sdf, generate_sdf_shader, mesh_brick_map, mesh_sdf, SdfBrickMap, SdfGridSnap, SdfMeshCache, SdfShader, SdfTape, SdfTree
+#include "subdivision.h"                // SubdivisionScheme, SubdivisionSurface
+#include "tasks.h"                      // parallel_for, task_pool_*
+
+
+// -----------------------------------------------------------------------------
+// BENCHMARK HELPERS
+// -----------------------------------------------------------------------------
+
+// Returns the best (minimum) time of the given number of runs in milliseconds.
+template <typename Func>
+static double measure_ms(uint32_t runs, Func&& func)
+{
+    double best = 1e30;
+
+    for (uint32_t i = 0; i < runs; i++)
+    {
+        const int64_t start = bx::getHPCounter();
+        func();
+        const int64_t end   = bx::getHPCounter();
+
+        const double ms = double(end - start) * 1000.0 / double(bx::getHPFrequency());
+        best = ms < best ? ms : best;
+    }
+
+    return best;
+}
+
+static void print_result(const char* name, double ms, double items)
+{
+    printf("  %-32s %9.3f ms %10.1f M/s\n", name, ms, items / (ms * 1000.0));
+}
+
+// Keeps the optimizer from discarding benchmarked results.
+static volatile float g_sink = 0.0f;
+
+// Deterministic pseudo-random numbers in [0, 1).
+static float random_float(uint32_t& state)
+{
+    state = state * 1664525u + 1013904223u;
+
+    return float(state >> 8) * (1.0f / 16777216.0f);
+}
+
+// Sphere-like grid of `segments * segments` vertices.
+static Mesh make_test_mesh(uint32_t segments)
+{
+    Mesh mesh;
+
+    for (uint32_t i = 0; i < segments; i++)
+    {
+        const float theta = 3.14159265f * float(i) / float(segments - 1);
+
+        for (uint32_t j = 0; j < segments; j++)
+        {
+            const float phi = 6.28318531f * float(j) / float(segments);
+
+            mesh.add_vertex({ sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi) });
+        }
+    }
+
+    for (uint32_t i = 0; i + 1 < segments; i++)
+    {
+        for (uint32_t j = 0; j < segments; j++)
+        {
+            const uint32_t a = i * segments + j;
+            const uint32_t b = i * segments + (j + 1) % segments;
+            const uint32_t c = a + segments;
+            const uint32_t d = b + segments;
+
+            mesh.add_triangle(a, b, c);
+            mesh.add_triangle(b, d, c);
+        }
+    }
+
+    return mesh;
+}
+
+
+// -----------------------------------------------------------------------------
+// MESH KERNELS
+// -----------------------------------------------------------------------------
+
+static void bench_mesh_kernels()
+{
+    const uint32_t runs = 20;
+    const Mesh     mesh = make_test_mesh(1024);
+    const uint32_t n    = mesh.vertex_count();
+    const uint32_t t    = mesh.triangle_count();
+
+    const glm::mat4 matrix = glm::rotate(
+        glm::translate(glm::mat4(1.0f), { 1.0f, 2.0f, 3.0f }), 0.5f, { 0.0f, 1.0f, 0.0f }
+    );
+
+    printf("Mesh kernels (%u vertices, %u triangles)\n", n, t);
+
+    // GLM baselines, operating on the array-of-structures layout they expect.
+    std::vector<glm::vec3> aos_in (n);
+    std::vector<glm::vec3> aos_out(n);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        aos_in[i] = mesh.position(i);
+    }
+
+    print_result("transform_points (glm)", measure_ms(runs, [&]()
+    {
+        for (uint32_t i = 0; i < n; i++)
+        {
+            aos_out[i] = glm::vec3(matrix * glm::vec4(aos_in[i], 1.0f));
+        }
+        g_sink = aos_out[n / 2].x;
+    }), n);
+
+    print_result("compute_aabb (glm)", measure_ms(runs, [&]()
+    {
+        Aabb aabb;
+        for (uint32_t i = 0; i < n; i++)
+        {
+            aabb.extend(aos_in[i]);
+        }
+        g_sink = aabb.max.x;
+    }), n);
+
+    print_result("compute_vertex_normals (glm)", measure_ms(runs, [&]()
+    {
+        for (uint32_t i = 0; i < n; i++)
+        {
+            aos_out[i] = glm::vec3(0.0f);
+        }
+
+        for (uint32_t i = 0; i < t; i++)
+        {
+            const uint32_t  idx[] = { mesh.indices[i * 3], mesh.indices[i * 3 + 1], mesh.indices[i * 3 + 2] };
+            const glm::vec3 p[]   = { aos_in[idx[0]], aos_in[idx[1]], aos_in[idx[2]] };
+            const glm::vec3 face  = glm::normalize(glm::cross(p[1] - p[0], p[2] - p[0]));
+
+            for (uint32_t j = 0; j < 3; j++)
+            {
+                const glm::vec3 e0 = glm::normalize(p[(j + 1) % 3] - p[j]);
+                const glm::vec3 e1 = glm::normalize(p[(j + 2) % 3] - p[j]);
+
+                aos_out[idx[j]] += face * acosf(glm::clamp(glm::dot(e0, e1), -1.0f, 1.0f));
+            }
+        }
+
+        for (uint32_t i = 0; i < n; i++)
+        {
+            aos_out[i] = glm::normalize(aos_out[i]);
+        }
+        g_sink = aos_out[n / 2].x;
+    }), t);
+
+    // Dispatched kernels at every supported level.
+    std::vector<float> out_x(n), out_y(n), out_z(n);
+    const Float3Span   out = { out_x.data(), out_y.data(), out_z.data() };
+
+    std::vector<float> face_x(t), face_y(t), face_z(t);
+    const Float3Span   face = { face_x.data(), face_y.data(), face_z.data() };
+
+    const SimdLevel max_level = get_max_simd_level();
+
+    for (int level = 0; level <= int(max_level); level++)
+    {
+        set_simd_level(SimdLevel(level));
+
+        char name[64];
+        const char* level_name = get_simd_level_name(SimdLevel(level));
+
+        snprintf(name, sizeof(name), "transform_points (%s)", level_name);
+        print_result(name, measure_ms(runs, [&]()
+        {
+            transform_points(matrix, mesh.positions(), out, n);
+            g_sink = out_x[n / 2];
+        }), n);
+
+        snprintf(name, sizeof(name), "compute_aabb (%s)", level_name);
+        print_result(name, measure_ms(runs, [&]()
+        {
+            g_sink = compute_aabb(mesh.positions(), n).max.x;
+        }), n);
+
+        snprintf(name, sizeof(name), "compute_face_normals (%s)", level_name);
+        print_result(name, measure_ms(runs, [&]()
+        {
+            compute_face_normals(mesh.positions(), mesh.indices.data(), t, face);
+            g_sink = face_x[t / 2];
+        }), t);
+
+        snprintf(name, sizeof(name), "compute_vertex_normals (%s)", level_name);
+        print_result(name, measure_ms(runs, [&]()
+        {
+            compute_vertex_normals(mesh.positions(), n, mesh.indices.data(), t, out);
+            g_sink = out_x[n / 2];
+        }), t);
+    }
+
+    set_simd_level(max_level);
+}
+
+
+// -----------------------------------------------------------------------------
+// BVH
+// -----------------------------------------------------------------------------
+
+static void bench_bvh()
+{
+    const uint32_t runs = 3;
+    const Mesh     mesh = make_test_mesh(1024);
+    const uint32_t t    = mesh.triangle_count();
+
+    printf("BVH (%u triangles)\n", t);
+
+    Bvh bvh;
+
+    for (uint32_t threads : { 1u, 0u })
+    {
+        task_pool_init(threads);
+
+        char name[64];
+        snprintf(name, sizeof(name), "build (%u threads)", task_pool_thread_count());
+
+        print_result(name, measure_ms(runs, [&]()
+        {
+            bvh.build(mesh);
+        }), t);
+    }
+
+    std::vector<Aabb> triangle_bounds;
+    compute_triangle_bounds(mesh, triangle_bounds);
+
+    print_result("refit", measure_ms(runs, [&]()
+    {
+        bvh.refit(triangle_bounds.data());
+    }), t);
+
+    // Rays from a surrounding sphere towards random points near the origin.
+    const uint32_t   ray_count = 1u << 18;
+    std::vector<Ray> rays(ray_count);
+    uint32_t         state = 1;
+
+    for (Ray& ray : rays)
+    {
+        const glm::vec3 from = glm::normalize(glm::vec3(
+            random_float(state) - 0.5f, random_float(state) - 0.5f, random_float(state) - 0.5f
+        )) * 3.0f;
+        const glm::vec3 to = glm::vec3(
+            random_float(state) - 0.5f, random_float(state) - 0.5f, random_float(state) - 0.5f
+        );
+
+        ray.origin    = from;
+        ray.direction = glm::normalize(to - from);
+    }
+
+    print_result("ray_cast", measure_ms(runs, [&]()
+    {
+        std::vector<uint32_t> hits(task_pool_thread_count() * 64, 0);
+
+        parallel_for(0, ray_count, 4096, [&](uint32_t begin, uint32_t end)
+        {
+            uint32_t count = 0;
+            for (uint32_t i = begin; i < end; i++)
+            {
+                count += bvh.ray_cast(mesh, rays[i]).hit();
+            }
+            hits[(begin / 4096) % hits.size()] += count;
+        });
+
+        g_sink = float(hits[0]);
+    }), ray_count);
+
+    print_result("closest_point", measure_ms(runs, [&]()
+    {
+        parallel_for(0, ray_count, 4096, [&](uint32_t begin, uint32_t end)
+        {
+            float sum = 0.0f;
+            for (uint32_t i = begin; i < end; i++)
+            {
+                sum += bvh.closest_point(mesh, rays[i].origin * 0.5f).distance;
+            }
+            g_sink = sum;
+        });
+    }), ray_count);
+
+    task_pool_shutdown();
+}
+
+
+// -----------------------------------------------------------------------------
+// FRUSTUM CULLING
+// -----------------------------------------------------------------------------
+
+static void bench_culling()
+{
+    const uint32_t runs  = 10;
+    const uint32_t count = 1u << 18;
+
+    printf("Frustum culling (%u objects)\n", count);
+
+    // Small boxes scattered in a 200 units wide cube around the camera.
+    ObjectBounds      bounds;
+    std::vector<Aabb> boxes(count);
+    uint32_t          state = 7;
+
+    for (Aabb& box : boxes)
+    {
+        const glm::vec3 center = glm::vec3(
+            random_float(state) - 0.5f, random_float(state) - 0.5f, random_float(state) - 0.5f
+        ) * 200.0f;
+        const glm::vec3 half = glm::vec3(0.1f + random_float(state));
+
+        box = { center - half, center + half };
+        bounds.add(box);
+    }
+
+    Bvh hierarchy;
+    hierarchy.build(boxes.data(), count);
+
+    const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(1.0f, 0.2f, 0.3f), glm::vec3(0.0f, 1.0f, 0.0f));
+    const glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+
+    const Frustum frustum = Frustum::from_matrix(proj * view);
+
+    std::vector<uint32_t> spheres;
+    std::vector<uint32_t> aabbs;
+    std::vector<uint32_t> hierarchical;
+
+    const CullStats stats = cull_aabbs(frustum, bounds, aabbs);
+
+    print_result("spheres", measure_ms(runs, [&]()
+    {
+        spheres.clear();
+        cull_spheres(frustum, bounds, spheres);
+    }), count);
+
+    print_result("aabbs", measure_ms(runs, [&]()
+    {
+        aabbs.clear();
+        cull_aabbs(frustum, bounds, aabbs);
+    }), count);
+
+    print_result("hierarchical", measure_ms(runs, [&]()
+    {
+        hierarchical.clear();
+        cull_hierarchical(frustum, bounds, hierarchy, hierarchical);
+    }), count);
+
+    // Both box tests must agree; spheres are more conservative.
+    std::sort(hierarchical.begin(), hierarchical.end());
+
+    printf("  drawn %u, culled %u, spheres %zu, hierarchy %s\n",
+        stats.drawn, stats.culled, spheres.size(), hierarchical == aabbs ? "matches" : "MISMATCH");
+}
+
+
+// -----------------------------------------------------------------------------
+// OCCLUSION CULLING
+// -----------------------------------------------------------------------------
+
+// Returns whether the segment from `eye` to `point` passes through the sphere.
+static bool segment_hits_sphere(const glm::vec3& eye, const glm::vec3& point, float radius)
+{
+    const glm::vec3 d = point - eye;
+    const float     t = glm::clamp(-glm::dot(eye, d) / glm::dot(d, d), 0.0f, 1.0f);
+
+    return glm::length(eye + d * t) < radius;
+}
+
+static void bench_occlusion()
+{
+    const uint32_t runs  = 10;
+    const uint32_t count = 1u << 16;
+
+    printf("Occlusion culling (%u objects)\n", count);
+
+    // One big sphere in front of the camera hiding boxes scattered around it.
+    Mesh occluder = make_test_mesh(64);
+
+    for (uint32_t i = 0; i < occluder.vertex_count(); i++)
+    {
+        occluder.position_x[i] *= 20.0f;
+        occluder.position_y[i] *= 20.0f;
+        occluder.position_z[i] *= 20.0f;
+    }
+
+    ObjectBounds bounds;
+    uint32_t     state = 11;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const glm::vec3 center = glm::vec3(
+            random_float(state) - 0.5f, random_float(state) - 0.5f, random_float(state) - 0.5f
+        ) * 80.0f;
+        const glm::vec3 half = glm::vec3(0.25f + 0.5f * random_float(state));
+
+        bounds.add({ center - half, center + half });
+    }
+
+    const glm::vec3 eye  = { 0.0f, 0.0f, 60.0f };
+    const glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    const glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 200.0f);
+
+    std::vector<uint32_t> all;
+    cull_aabbs(Frustum::from_matrix(proj * view), bounds, all);
+
+    OcclusionBuffer buffer;
+    buffer.resize(320, 180);
+
+    const Mesh* occluders[] = { &occluder };
+
+    for (uint32_t threads : { 1u, 0u })
+    {
+        task_pool_init(threads);
+
+        char name[64];
+        snprintf(name, sizeof(name), "rasterize (%u threads)", task_pool_thread_count());
+
+        print_result(name, measure_ms(runs, [&]()
+        {
+            buffer.rasterize(proj * view, occluders, 1);
+        }), occluder.triangle_count());
+    }
+
+    task_pool_shutdown();
+
+    std::vector<uint32_t> visible;
+    uint32_t              occluded = 0;
+
+    print_result("test", measure_ms(runs, [&]()
+    {
+        visible  = all;
+        occluded = buffer.cull(bounds, visible);
+    }), double(all.size()));
+
+    // Every corner of a rejected box must be hidden by the sphere, give or
+    // take a pixel at its silhouette.
+    uint32_t wrong = 0;
+    size_t   j     = 0;
+
+    for (const uint32_t i : all)
+    {
+        if (j < visible.size() && visible[j] == i)
+        {
+            j++;
+            continue;
+        }
+
+        const Aabb box = bounds.get(i);
+
+        for (uint32_t k = 0; k < 8; k++)
+        {
+            const glm::vec3 corner = {
+                (k & 1) ? box.max.x : box.min.x,
+                (k & 2) ? box.max.y : box.min.y,
+                (k & 4) ? box.max.z : box.min.z,
+            };
+
+            if (!segment_hits_sphere(eye, corner, 20.0f + 0.5f))
+            {
+                wrong++;
+                break;
+            }
+        }
+    }
+
+    printf("  in frustum %zu, occluded %u, wrongly occluded %u\n", all.size(), occluded, wrong);
+}
+
+
+// -----------------------------------------------------------------------------
+// SDF MESHING
+// -----------------------------------------------------------------------------
+
+// Rounded body with a ring around it and a lattice of holes through it.
+static uint32_t make_test_sdf(SdfTree& tree)
+{
+    const uint32_t body  = tree.unite(tree.sphere(0.8f), tree.box(glm::vec3(0.6f), 0.1f), 0.2f);
+    const uint32_t ring  = tree.transform(tree.torus(0.9f, 0.08f), glm::rotate(glm::mat4(1.0f), 1.5707963f, glm::vec3(1.0f, 0.0f, 0.0f)));
+    const uint32_t holes = tree.repeat(tree.cylinder(0.08f, 2.0f), { 0.3f, 0.0f, 0.3f });
+
+    return tree.subtract(tree.unite(body, ring, 0.05f), holes, 0.02f);
+}
+
+static void bench_sdf()
+{
+    const uint32_t runs = 3;
+
+    SdfTree        tree;
+    const uint32_t root = make_test_sdf(tree);
+
+    Aabb bounds = tree.bounds(root);
+    bounds.min -= glm::vec3(0.05f);
+    bounds.max += glm::vec3(0.05f);
+
+    const float cell_size = bounds.extent().x / 256.0f;
+
+    // Point by point: walking the tree, then running its tape at every
+    // supported level.
+    const uint32_t n = 1 << 18;
+
+    std::vector<float> x(n), y(n), z(n), distances(n), registers;
+    std::vector<float> gradient_x(n), gradient_y(n), gradient_z(n);
+    uint32_t           state = 1;
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        x[i] = bounds.min.x + bounds.extent().x * random_float(state);
+        y[i] = bounds.min.y + bounds.extent().y * random_float(state);
+        z[i] = bounds.min.z + bounds.extent().z * random_float(state);
+    }
+
+    SdfTape tape;
+    tape.compile(tree, root);
+
+    printf("SDF evaluation (%u nodes, %zu instructions)\n", uint32_t(tree.nodes.size()), tape.code.size());
+
+    print_result("tree walk", measure_ms(runs, [&]()
+    {
+        for (uint32_t i = 0; i < n; i++)
+        {
+            distances[i] = tree.evaluate(root, { x[i], y[i], z[i] });
+        }
+
+        g_sink = distances[n / 2];
+    }), n);
+
+    const SimdLevel max_level = get_max_simd_level();
+
+    for (int level = 0; level <= int(max_level); level++)
+    {
+        set_simd_level(SimdLevel(level));
+
+        char name[64];
+        snprintf(name, sizeof(name), "tape (%s)", get_simd_level_name(SimdLevel(level)));
+
+        print_result(name, measure_ms(runs, [&]()
+        {
+            tape.evaluate({ x.data(), y.data(), z.data() }, n, distances.data(), registers);
+            g_sink = distances[n / 2];
+        }), n);
+
+        // What the normals cost: one pass on dual numbers, against the six
+        // plain evaluations of central differences.
+        snprintf(name, sizeof(name), "tape gradient (%s)", get_simd_level_name(SimdLevel(level)));
+
+        print_result(name, measure_ms(runs, [&]()
+        {
+            tape.evaluate_gradient({ x.data(), y.data(), z.data() }, n, distances.data(), { gradient_x.data(), gradient_y.data(), gradient_z.data() }, registers);
+            g_sink = gradient_x[n / 2];
+        }), n);
+    }
+
+    set_simd_level(max_level);
+
+    task_pool_init(0);
+    const uint32_t max_threads = task_pool_thread_count();
+    task_pool_shutdown();
+
+    Mesh         mesh;
+    SdfMeshStats stats;
+
+    printf("SDF meshing\n");
+
+    for (uint32_t threads = 1; ; threads = std::min(threads * 2, max_threads))
+    {
+        task_pool_init(threads);
+
+        char name[64];
+        snprintf(name, sizeof(name), "surface nets (%u threads)", task_pool_thread_count());
+
+        const double ms = measure_ms(runs, [&]()
+        {
+            stats = mesh_sdf(tree, root, bounds, cell_size, mesh);
+        });
+
+        print_result(name, ms, double(stats.cells));
+
+        task_pool_shutdown();
+
+        if (threads == max_threads)
+        {
+            break;
+        }
+    }
+
+    printf("  %llu voxels in %u blocks, %u triangles; rates are voxels per second\n",
+        (unsigned long long)stats.cells, stats.blocks, mesh.triangle_count());
+    printf("  %llu samples evaluated (%.1f%% of the voxels), the rest skipped by intervals\n",
+        (unsigned long long)stats.samples, 100.0 * double(stats.samples) / double(stats.cells));
+
+    // A small sphere dragged along the surface, a step per run, remeshing only
+    // the blocks it reaches.
+    {
+        task_pool_init(max_threads);
+
+        SdfTree      edited;
+        SdfMeshCache cache;
+        uint32_t     step = 0;
+
+        const auto edit = [&]()
+        {
+            edited = tree;
+
+            const glm::vec3 position = { 0.3f + 0.01f * float(step++), 0.75f, 0.0f };
+
+            return edited.unite(root, edited.transform(edited.sphere(0.08f), glm::translate(glm::mat4(1.0f), position)), 0.03f);
+        };
+
+        mesh_sdf(edited, edit(), bounds, cell_size, mesh, &cache);
+
+        char name[64];
+        snprintf(name, sizeof(name), "surface nets edit (%u threads)", task_pool_thread_count());
+
+        const double ms = measure_ms(runs, [&]()
+        {
+            const uint32_t edited_root = edit();
+
+            cache.begin();
+            stats = mesh_sdf(edited, edited_root, bounds, cell_size, mesh, &cache);
+            cache.evict_unused();
+        });
+
+        print_result(name, ms, double(stats.cells));
+
+        printf("  %u of %u blocks remeshed per edit\n", stats.remeshed, stats.blocks);
+
+        // The same sphere pulled out past the field, so that the grid of its
+        // own bounds grows with every step, snapped to the block lattice.
+        step = 0;
+
+        const auto grow = [&]()
+        {
+            edited = tree;
+
+            const glm::vec3 position = { 1.0f + 0.01f * float(step++), 0.0f, 0.0f };
+
+            return edited.unite(root, edited.transform(edited.sphere(0.08f), glm::translate(glm::mat4(1.0f), position)), 0.03f);
+        };
+
+        const auto grown_bounds = [&](uint32_t grown_root)
+        {
+            Aabb grown = edited.bounds(grown_root);
+            grown.min -= glm::vec3(cell_size * 1.5f);
+            grown.max += glm::vec3(cell_size * 1.5f);
+
+            return grown;
+        };
+
+        cache.clear();
+
+        uint32_t grown_root = grow();
+        mesh_sdf(edited, grown_root, grown_bounds(grown_root), cell_size, mesh, &cache, SdfGridSnap::BLOCKS);
+
+        snprintf(name, sizeof(name), "surface nets growing (%u threads)", task_pool_thread_count());
+
+        const double grow_ms = measure_ms(runs, [&]()
+        {
+            grown_root = grow();
+
+            cache.begin();
+            stats = mesh_sdf(edited, grown_root, grown_bounds(grown_root), cell_size, mesh, &cache, SdfGridSnap::BLOCKS);
+            cache.evict_unused();
+        });
+
+        print_result(name, grow_ms, double(stats.cells));
+
+        printf("  %u of %u blocks remeshed per edit\n", stats.remeshed, stats.blocks);
+
+        task_pool_shutdown();
+    }
+
+    // Over the same grid, merging cells while within a twentieth of a cell of
+    // the surface.
+    const float tolerance = cell_size * 0.05f;
+
+    for (uint32_t threads = 1; ; threads = std::min(threads * 2, max_threads))
+    {
+        task_pool_init(threads);
+
+        char name[64];
+        snprintf(name, sizeof(name), "dual contouring (%u threads)", task_pool_thread_count());
+
+        const double ms = measure_ms(runs, [&]()
+        {
+            stats = contour_sdf(tree, root, bounds, cell_size, tolerance, mesh);
+        });
+
+        print_result(name, ms, double(stats.cells));
+
+        task_pool_shutdown();
+
+        if (threads == max_threads)
+        {
+            break;
+        }
+    }
+
+    printf("  %llu voxels in %u blocks, %u triangles\n",
+        (unsigned long long)stats.cells, stats.blocks, mesh.triangle_count());
+
+    // Sampled once into bricks over the same grid, then meshed and queried
+    // from them, against the dense grid of floats they replace.
+    {
+        task_pool_init(max_threads);
+
+        SdfBrickMap map;
+
+        char name[64];
+        snprintf(name, sizeof(name), "brick map build (%u threads)", task_pool_thread_count());
+
+        const double build_ms = measure_ms(runs, [&]()
+        {
+            map.build(tree, root, bounds, cell_size, 0.0f);
+        });
+
+        const double points = double(map.bricks.x * SdfBrickMap::BRICK_CELLS + 1)
+                            * double(map.bricks.y * SdfBrickMap::BRICK_CELLS + 1)
+                            * double(map.bricks.z * SdfBrickMap::BRICK_CELLS + 1);
+
+        print_result(name, build_ms, points);
+
+        snprintf(name, sizeof(name), "brick map meshing (%u threads)", task_pool_thread_count());
+
+        print_result(name, measure_ms(runs, [&]()
+        {
+            stats = mesh_brick_map(map, mesh);
+        }), double(stats.cells));
+
+        print_result("brick map distance", measure_ms(runs, [&]()
+        {
+            for (uint32_t i = 0; i < n; i++)
+            {
+                distances[i] = map.distance({ x[i], y[i], z[i] });
+            }
+
+            g_sink = distances[n / 2];
+        }), n);
+
+        printf("  %u bricks, %.1f MiB against %.1f MiB dense, %u triangles\n",
+            map.brick_count(), double(map.memory_usage()) / 1048576.0, points * sizeof(float) / 1048576.0, mesh.triangle_count());
+
+        task_pool_shutdown();
+    }
+}
+
+
+// -----------------------------------------------------------------------------
+// SDF SHADERS
+// -----------------------------------------------------------------------------
+
+// Runs the source of `generate_sdf_shader` on the CPU, to check it against
+// `SdfTree::evaluate` without a GPU. Covers exactly the GLSL the generator
+// writes: one declaration of a `vN` variable per line, arithmetic with scalar
+// broadcasting, swizzles, `u_sdf_params` reads and the built-ins it calls.
+struct GlslShim
+{
+    struct Value
+    {
+        float    v[4] = {};
+        uint32_t size = 1;
+    };
+
+    const std::vector<glm::vec4>& params;
+    std::vector<Value>            variables;
+    const char*                   cursor = nullptr;
+    bool                          failed = false;
+
+    // Returns NaN if the source has anything the shim doesn't know.
+    float run(const std::string& source, const glm::vec3& point)
+    {
+        const size_t body = source.find("float sdf_field(vec3 v0)");
+
+        failed = body == std::string::npos;
+        cursor = failed ? "" : source.c_str() + source.find('{', body) + 1;
+
+        variables.assign(1, { { point.x, point.y, point.z, 0.0f }, 3 });
+
+        while (!failed)
+        {
+            skip_space();
+
+            if (accept("return"))
+            {
+                const Value result = expression();
+
+                return failed || result.size != 1 ? NAN : result.v[0];
+            }
+
+            // Type, then `vN = ...;`.
+            identifier();
+            skip_space();
+
+            if (!accept("v"))
+            {
+                break;
+            }
+
+            const uint32_t index = uint32_t(strtoul(cursor, const_cast<char**>(&cursor), 10));
+
+            expect('=');
+
+            const Value value = expression();
+
+            expect(';');
+
+            if (index >= variables.size())
+            {
+                variables.resize(index + 1);
+            }
+
+            variables[index] = value;
+        }
+
+        return NAN;
+    }
+
+    void skip_space()
+    {
+        while (*cursor == ' ' || *cursor == '\n')
+        {
+            cursor++;
+        }
+    }
+
+    bool accept(const char* token)
+    {
+        const size_t length = strlen(token);
+
+        if (strncmp(cursor, token, length) != 0)
+        {
+            return false;
+        }
+
+        cursor += length;
+
+        return true;
+    }
+
+    void expect(char c)
+    {
+        skip_space();
+
+        failed |= *cursor != c;
+        cursor += !failed;
+    }
+
+    std::string identifier()
+    {
+        const char* begin = cursor;
+
+        while (isalnum(uint8_t(*cursor)) || *cursor == '_')
+        {
+            cursor++;
+        }
+
+        return std::string(begin, cursor);
+    }
+
+    template <typename Func>
+    Value map(const Value& a, const Value& b, Func&& func)
+    {
+        failed |= a.size != b.size && a.size != 1 && b.size != 1;
+
+        Value result;
+        result.size = std::max(a.size, b.size);
+
+        for (uint32_t i = 0; i < result.size; i++)
+        {
+            result.v[i] = func(a.v[a.size == 1 ? 0 : i], b.v[b.size == 1 ? 0 : i]);
+        }
+
+        return result;
+    }
+
+    template <typename Func>
+    static Value map(Value a, Func&& func)
+    {
+        for (uint32_t i = 0; i < a.size; i++)
+        {
+            a.v[i] = func(a.v[i]);
+        }
+
+        return a;
+    }
+
+    Value expression()
+    {
+        Value value = term();
+
+        for (skip_space(); *cursor == '+' || *cursor == '-'; skip_space())
+        {
+            const char  op    = *cursor++;
+            const Value right = term();
+
+            value = op == '+'
+                ? map(value, right, [](float a, float b) { return a + b; })
+                : map(value, right, [](float a, float b) { return a - b; });
+        }
+
+        return value;
+    }
+
+    Value term()
+    {
+        Value value = unary();
+
+        for (skip_space(); *cursor == '*' || *cursor == '/'; skip_space())
+        {
+            const char  op    = *cursor++;
+            const Value right = unary();
+
+            value = op == '*'
+                ? map(value, right, [](float a, float b) { return a * b; })
+                : map(value, right, [](float a, float b) { return a / b; });
+        }
+
+        return value;
+    }
+
+    Value unary()
+    {
+        static const char* const AXES = "xyzw";
+
+        skip_space();
+
+        if (accept("-"))
+        {
+            return map(unary(), [](float a) { return -a; });
+        }
+
+        Value value = primary();
+
+        while (!failed && *cursor == '.')
+        {
+            cursor++;
+
+            const std::string swizzle = identifier();
+            Value             result;
+
+            result.size = uint32_t(swizzle.size());
+            failed     |= result.size == 0 || result.size > 4;
+
+            for (uint32_t i = 0; i < result.size && !failed; i++)
+            {
+                const char*    found     = strchr(AXES, swizzle[i]);
+                const uint32_t component = found ? uint32_t(found - AXES) : 4;
+
+                failed |= component >= value.size;
+                result.v[i] = value.v[component & 3];
+            }
+
+            value = result;
+        }
+
+        return value;
+    }
+
+    Value primary()
+    {
+        skip_space();
+
+        if (accept("("))
+        {
+            const Value value = expression();
+
+            expect(')');
+
+            return value;
+        }
+
+        if (isdigit(uint8_t(*cursor)))
+        {
+            return { { strtof(cursor, const_cast<char**>(&cursor)) }, 1 };
+        }
+
+        const std::string name = identifier();
+
+        if (name.size() > 1 && name[0] == 'v' && isdigit(uint8_t(name[1])))
+        {
+            const size_t index = size_t(atoi(name.c_str() + 1));
+
+            failed |= index >= variables.size();
+
+            return failed ? Value() : variables[index];
+        }
+
+        if (name == "u_sdf_params")
+        {
+            expect('[');
+
+            const uint32_t index = uint32_t(strtoul(cursor, const_cast<char**>(&cursor), 10));
+
+            expect(']');
+
+            failed |= index >= params.size();
+
+            const glm::vec4 param = failed ? glm::vec4(0.0f) : params[index];
+
+            return { { param.x, param.y, param.z, param.w }, 4 };
+        }
+
+        std::vector<Value> args;
+
+        expect('(');
+
+        while (!failed)
+        {
+            args.push_back(expression());
+            skip_space();
+
+            if (!accept(","))
+            {
+                break;
+            }
+        }
+
+        expect(')');
+
+        return call(name, args);
+    }
+
+    Value call(const std::string& name, const std::vector<Value>& args)
+    {
+        const size_t count = args.size();
+
+        if (name == "vec2" || name == "vec3" || name == "vec4")
+        {
+            Value result;
+            result.size = uint32_t(name[3] - '0');
+
+            uint32_t filled = 0;
+
+            for (const Value& arg : args)
+            {
+                for (uint32_t i = 0; i < arg.size && filled < 4; i++)
+                {
+                    result.v[filled++] = arg.v[i];
+                }
+            }
+
+            if (filled == 1)
+            {
+                return map(result, [&](float) { return result.v[0]; });
+            }
+
+            failed |= filled != result.size;
+
+            return result;
+        }
+
+        if (count == 1)
+        {
+            const Value& a = args[0];
+
+            if (name == "abs"  ) return map(a, [](float x) { return fabsf(x); });
+            if (name == "floor") return map(a, [](float x) { return floorf(x); });
+            if (name == "cos"  ) return map(a, [](float x) { return cosf(x); });
+            if (name == "sin"  ) return map(a, [](float x) { return sinf(x); });
+
+            if (name == "length")
+            {
+                float sum = 0.0f;
+
+                for (uint32_t i = 0; i < a.size; i++)
+                {
+                    sum += a.v[i] * a.v[i];
+                }
+
+                return { { sqrtf(sum) }, 1 };
+            }
+        }
+
+        if (count == 2)
+        {
+            const Value& a = args[0];
+            const Value& b = args[1];
+
+            if (name == "min") return map(a, b, [](float x, float y) { return std::min(x, y); });
+            if (name == "max") return map(a, b, [](float x, float y) { return std::max(x, y); });
+
+            if (name == "dot")
+            {
+                const Value product = map(a, b, [](float x, float y) { return x * y; });
+
+                float sum = 0.0f;
+
+                for (uint32_t i = 0; i < product.size; i++)
+                {
+                    sum += product.v[i];
+                }
+
+                return { { sum }, 1 };
+            }
+        }
+
+        if (count == 3)
+        {
+            const Value& a = args[0];
+            const Value& b = args[1];
+            const Value& c = args[2];
+
+            if (name == "clamp")
+            {
+                return map(map(a, b, [](float x, float lo) { return std::max(x, lo); }), c, [](float x, float hi) { return std::min(x, hi); });
+            }
+
+            if (name == "mix")
+            {
+                const Value rest = map(c, [](float t) { return 1.0f - t; });
+
+                return map(
+                    map(a, rest, [](float x, float t) { return x * t; }),
+                    map(b, c   , [](float y, float t) { return y * t; }),
+                    [](float x, float y) { return x + y; }
+                );
+            }
+
+            // The prelude's polynomial smooth minimum, as in `sdf.cpp`.
+            if (name == "sdf_smooth_min")
+            {
+                const float k = c.v[0];
+                const float h = std::max(k - fabsf(a.v[0] - b.v[0]), 0.0f) / k;
+
+                return { { std::min(a.v[0], b.v[0]) - h * h * k * 0.25f }, 1 };
+            }
+        }
+
+        failed = true;
+
+        return Value();
+    }
+};
+
+// Every operation, with smooth blends, a rotated and scaled transform and a
+// repetition along two axes.
+static uint32_t make_shader_test_sdf(SdfTree& tree)
+{
+    const uint32_t shapes = tree.unite(
+        tree.unite(tree.sphere(0.7f), tree.box(glm::vec3(0.5f, 0.4f, 0.6f), 0.1f), 0.15f),
+        tree.intersect(tree.cylinder(0.3f, 1.2f), tree.plane(glm::vec3(0.2f, 1.0f, 0.1f), 0.4f))
+    );
+
+    const glm::mat4 matrix = glm::scale(glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(0.2f, -0.1f, 0.3f)), 0.7f, glm::vec3(1.0f, 1.0f, 0.0f)), glm::vec3(1.3f));
+
+    const uint32_t ring  = tree.twist(tree.transform(tree.torus(0.9f, 0.1f), matrix), 0.8f);
+    const uint32_t rods  = tree.repeat(tree.capsule(0.05f, 0.4f), { 0.5f, 0.0f, 0.5f });
+    const uint32_t cut   = tree.subtract(tree.intersect(shapes, tree.mirror(ring, true, false, true), 0.1f), rods);
+    const uint32_t blend = tree.subtract(tree.unite(cut, tree.sphere(0.3f)), tree.box(glm::vec3(0.2f)), 0.05f);
+
+    return tree.shell(tree.round(blend, 0.02f), 0.03f);
+}
+
+static void bench_sdf_shader()
+{
+    printf("SDF shaders\n");
+
+    const uint32_t runs = 10;
+
+    SdfTree        tree;
+    const uint32_t root = make_shader_test_sdf(tree);
+
+    SdfShader shader;
+
+    print_result("shader generation", measure_ms(runs, [&]()
+    {
+        generate_sdf_shader(tree, root, shader);
+    }), double(tree.nodes.size()));
+
+    // The GPU rounds differently, so only agreement up to float precision is
+    // expected; mistakes in the generator are far off.
+    GlslShim shim = { shader.params, {} };
+
+    const uint32_t count      = 4096;
+    uint32_t       state      = 1;
+    uint32_t       mismatches = 0;
+    float          max_error  = 0.0f;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const glm::vec3 point =
+        {
+            random_float(state) * 4.0f - 2.0f,
+            random_float(state) * 4.0f - 2.0f,
+            random_float(state) * 4.0f - 2.0f,
+        };
+
+        const float expected = tree.evaluate(root, point);
+        const float actual   = shim.run(shader.source, point);
+        const float error    = fabsf(actual - expected);
+
+        mismatches += !(error <= 1e-4f * (1.0f + fabsf(expected)));
+        max_error   = std::max(max_error, error);
+    }
+
+    printf("  %zu nodes, %zu parameters, %u points, largest difference %g, shader %s\n",
+        tree.nodes.size(), shader.params.size(), count, double(max_error), mismatches == 0 ? "matches" : "MISMATCH");
+}
+
+
+// -----------------------------------------------------------------------------
+// MESH BOOLEANS
+// -----------------------------------------------------------------------------
+
+// Closed sphere of `segments * (rings - 1) + 2` vertices, counter-clockwise
+// from the outside.
+static Mesh make_closed_sphere(uint32_t segments, uint32_t rings, const glm::vec3& center)
+{
+    Mesh mesh;
+
+    mesh.add_vertex(center + glm::vec3(0.0f, 1.0f, 0.0f));
+
+    for (uint32_t i = 1; i < rings; i++)
+    {
+        const float theta = 3.14159265f * float(i) / float(rings);
+
+        for (uint32_t j = 0; j < segments; j++)
+        {
+            const float phi = 6.28318531f * float(j) / float(segments);
+
+            mesh.add_vertex(center + glm::vec3(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi)));
+        }
+    }
+
+    mesh.add_vertex(center - glm::vec3(0.0f, 1.0f, 0.0f));
+
+    const uint32_t south = mesh.vertex_count() - 1;
+
+    for (uint32_t j = 0; j < segments; j++)
+    {
+        const uint32_t next = (j + 1) % segments;
+
+        mesh.add_triangle(0, 1 + next, 1 + j);
+        mesh.add_triangle(south, south - segments + j, south - segments + next);
+    }
+
+    for (uint32_t i = 0; i + 2 < rings; i++)
+    {
+        for (uint32_t j = 0; j < segments; j++)
+        {
+            const uint32_t a = 1 + i * segments + j;
+            const uint32_t b = 1 + i * segments + (j + 1) % segments;
+            const uint32_t c = a + segments;
+            const uint32_t d = b + segments;
+
+            mesh.add_triangle(a, b, c);
+            mesh.add_triangle(b, d, c);
+        }
+    }
+
+    return mesh;
+}
+
+static void bench_csg()
+{
+    const uint32_t runs = 3;
+
+    task_pool_init(0);
+    const uint32_t max_threads = task_pool_thread_count();
+    task_pool_shutdown();
+
+    // Two overlapping spheres of about 100k, 300k and 1M triangles in total.
+    for (const uint32_t segments : { 224u, 388u, 708u })
+    {
+        const Mesh a = make_closed_sphere(segments, segments / 2, glm::vec3(0.0f));
+        const Mesh b = make_closed_sphere(segments, segments / 2, glm::vec3(0.7f, 0.3f, 0.1f));
+
+        const double triangles = double(a.triangle_count() + b.triangle_count());
+
+        printf("Mesh booleans (%u + %u triangles)\n", a.triangle_count(), b.triangle_count());
+
+        Mesh     mesh;
+        CsgStats stats;
+
+        for (uint32_t threads = 1; ; threads = std::min(threads * 2, max_threads))
+        {
+            task_pool_init(threads);
+
+            char name[64];
+            snprintf(name, sizeof(name), "union (%u threads)", task_pool_thread_count());
+
+            print_result(name, measure_ms(runs, [&]()
+            {
+                stats = mesh_boolean(a, b, CsgOperation::UNION, mesh);
+            }), triangles);
+
+            snprintf(name, sizeof(name), "difference (%u threads)", task_pool_thread_count());
+
+            print_result(name, measure_ms(runs, [&]()
+            {
+                stats = mesh_boolean(a, b, CsgOperation::DIFFERENCE, mesh);
+            }), triangles);
+
+            task_pool_shutdown();
+
+            if (threads == max_threads)
+            {
+                break;
+            }
+        }
+
+        printf("  %llu candidate pairs, %u crossing, %u split triangles, %u exact predicates, %u triangles out\n",
+            (unsigned long long)stats.candidate_pairs, stats.intersecting_pairs, stats.split_triangles, stats.exact_predicates, mesh.triangle_count());
+    }
+}
+
+
+// -----------------------------------------------------------------------------
+// SUBDIVISION SURFACES
+// -----------------------------------------------------------------------------
+
+static void bench_subdivision()
+{
+    const uint32_t runs = 3;
+
+    task_pool_init(0);
+    const uint32_t max_threads = task_pool_thread_count();
+    task_pool_shutdown();
+
+    const Mesh cage = make_closed_sphere(128, 64, glm::vec3(0.0f));
+
+    for (const SubdivisionScheme scheme : { SubdivisionScheme::CATMULL_CLARK, SubdivisionScheme::LOOP })
+    {
+        const char* scheme_name = scheme == SubdivisionScheme::LOOP ? "Loop" : "Catmull-Clark";
+
+        SubdivisionSurface surface;
+        Mesh               mesh;
+
+        // Topology and stencils once, then only positions, as when dragging
+        // cage vertices.
+        task_pool_init(max_threads);
+
+        const double build_ms = measure_ms(runs, [&]()
+        {
+            surface.build(cage, scheme, 3, true);
+        });
+
+        task_pool_shutdown();
+
+        printf("%s subdivision (%u triangles, 3 levels, %u triangles)\n", scheme_name, cage.triangle_count(), uint32_t(surface.indices.size() / 3));
+
+        char name[64];
+        snprintf(name, sizeof(name), "build (%u threads)", max_threads);
+
+        print_result(name, build_ms, double(surface.vertex_count()));
+
+        for (uint32_t threads = 1; ; threads = std::min(threads * 2, max_threads))
+        {
+            task_pool_init(threads);
+
+            snprintf(name, sizeof(name), "evaluate (%u threads)", task_pool_thread_count());
+
+            print_result(name, measure_ms(runs, [&]()
+            {
+                surface.evaluate(cage.positions(), mesh);
+                g_sink = mesh.position_x[0];
+            }), double(surface.vertex_count()));
+
+            task_pool_shutdown();
+
+            if (threads == max_threads)
+            {
+                break;
+            }
+        }
+
+        printf("  %u vertices, %.1f MiB of stencils and indices\n", surface.vertex_count(), double(surface.memory_usage()) / 1048576.0);
+    }
+}
+
+
+// -----------------------------------------------------------------------------
+// MODEL SCRIPTS
+// -----------------------------------------------------------------------------
+
+#ifdef WITH_LUAU
+
+// Typical procedural-geometry loops. The `--!native` directive only has effect
+// with native code enabled, so each script runs both ways unchanged.
+static const char* BENCH_SCRIPTS[][2] =
+{
+    {
+        "terrain heights",
+        "--!native\n"
+        "local function height(x, z)\n"
+        "    local h = 0\n"
+        "    local f = 1\n"
+        "    for octave = 1, 6 do\n"
+        "        h = h + math.sin(x * f) * math.cos(z * f * 1.3) / f\n"
+        "        f = f * 2\n"
+        "    end\n"
+        "    return h\n"
+        "end\n"
+        "local sum = 0\n"
+        "for i = 0, 511 do\n"
+        "    for j = 0, 511 do\n"
+        "        sum = sum + height(i * 0.01, j * 0.01)\n"
+        "    end\n"
+        "end\n"
+        "emit(box(1 + math.abs(sum) * 1e-9))\n"
+    },
+    {
+        "spiral placement",
+        "--!native\n"
+        "local parts = {}\n"
+        "for i = 1, 2000 do\n"
+        "    local t = i * 0.05\n"
+        "    local r = 1 + t * 0.1\n"
+        "    parts[#parts + 1] = translate(box(0.05), r * math.cos(t), t * 0.01, r * math.sin(t))\n"
+        "end\n"
+        "emit(merge(table.unpack(parts, 1, 200)))\n"
+    },
+    {
+        "vertex arithmetic",
+        "--!native\n"
+        "local xs, ys, zs = {}, {}, {}\n"
+        "for i = 1, 200000 do\n"
+        "    local a = i * 0.001\n"
+        "    xs[i] = math.cos(a) * (2 + math.cos(3 * a))\n"
+        "    ys[i] = math.sin(3 * a)\n"
+        "    zs[i] = math.sin(a) * (2 + math.cos(3 * a))\n"
+        "end\n"
+        "local lo, hi = math.huge, -math.huge\n"
+        "for i = 1, #xs do\n"
+        "    local d = math.sqrt(xs[i] * xs[i] + ys[i] * ys[i] + zs[i] * zs[i])\n"
+        "    lo = math.min(lo, d)\n"
+        "    hi = math.max(hi, d)\n"
+        "end\n"
+        "emit(box(hi - lo))\n"
+    },
+};
+
+static void bench_scripts()
+{
+    const uint32_t runs = 5;
+
+    printf("Model scripts (native code %s)\n", script_native_code_supported() ? "supported" : "NOT supported");
+
+    for (const auto& script : BENCH_SCRIPTS)
+    {
+        double times[2] = {};
+
+        for (const bool native : { false, true })
+        {
+            ScriptOptions options;
+            options.native_code = native;
+
+            ScriptResult result;
+
+            times[native] = measure_ms(runs, [&]()
+            {
+                evaluate_script(script[1], result, options);
+            });
+
+            if (!result.error.empty())
+            {
+                printf("  %s: %s\n", script[0], result.error.c_str());
+            }
+        }
+
+        printf("  %-32s %9.3f ms interpreted %9.3f ms native (%.2fx)\n",
+            script[0], times[0], times[1], times[0] / times[1]);
+    }
+}
+
+// Edits compile a new source each, like keystrokes; the directory must stay
+// within its limit and keep the latest script's bytecode.
+static void bench_bytecode_cache()
+{
+    printf("Bytecode cache\n");
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "modeler_bench_bytecode";
+
+    std::error_code error;
+    std::filesystem::remove_all(directory, error);
+
+    ScriptCache cache;
+    cache.bytecode_directory = directory.string();
+    cache.bytecode_max_files = 8;
+
+    const uint32_t edits = 64;
+
+    ScriptResult result;
+    std::string  source;
+
+    print_result("compile and write", measure_ms(1, [&]()
+    {
+        for (uint32_t i = 0; i < edits; i++)
+        {
+            source = "emit(box(" + std::to_string(i + 1) + "))\n";
+            evaluate_script(source, result, {}, nullptr, &cache);
+        }
+    }) / edits, 1.0);
+
+    uint32_t files = 0;
+
+    for (std::filesystem::directory_iterator it(directory, error), end; !error && it != end; it.increment(error))
+    {
+        files += it->path().extension() == ".luauc";
+    }
+
+    evaluate_script(source, result, {}, nullptr, &cache);
+
+    printf("  %u files after %u edits, limit %u %s, latest %s\n", files, edits, cache.bytecode_max_files,
+        files <= cache.bytecode_max_files ? "holds" : "EXCEEDED", result.bytecode_cached ? "kept" : "MISSING");
+
+    std::filesystem::remove_all(directory, error);
+}
+
+#endif // WITH_LUAU
+
+
+// -----------------------------------------------------------------------------
+// MAIN ENTRY
+// -----------------------------------------------------------------------------
+
+int main(int, char**)
+{
+    bench_mesh_kernels();
+    bench_bvh();
+    bench_culling();
+    bench_occlusion();
+    bench_sdf();
+    bench_sdf_shader();
+    bench_csg();
+    bench_subdivision();
+
+#ifdef WITH_LUAU
+    bench_scripts();
+    bench_bytecode_cache();
+#endif
+
+    return 0;
+}
@@ -0,0 +1,1099 @@
+#include "bvh.h"
+
+#include <assert.h>       // assert
+#include <math.h>         // fabsf
+
+#include <algorithm>      // nth_element, partition
+#include <atomic>         // atomic
+
+#include <bx/platform.h>  // BX_CPU_X86
+
+#if BX_CPU_X86
+#   include <emmintrin.h> // _mm_*
+#endif
+
+#include "tasks.h"        // parallel_for, task_pool_thread_count, task_run, task_wait, TaskCounter
+
+
+// -----------------------------------------------------------------------------
+// BINARY SAH BUILDER
+// -----------------------------------------------------------------------------
+
+constexpr uint32_t BIN_COUNT             = 16;
+constexpr uint32_t MAX_LEAF_SIZE         = 8;
+constexpr uint32_t PARALLEL_BUILD_SIZE   = 4096;
+constexpr uint32_t PARALLEL_BINNING_SIZE = 65536;
+constexpr uint32_t MEDIAN_SPLIT_DEPTH    = 40;   // SAH splits above, object medians below.
+constexpr float    TRAVERSAL_COST        = 1.0f; // Relative to one primitive test.
+
+struct BuildNode
+{
+    Aabb     bounds;
+    uint32_t left  = Bvh::INVALID; // Right child is always `left + 1`.
+    uint32_t first = 0;
+    uint32_t count = 0;
+};
+
+struct RangeBounds
+{
+    Aabb bounds;
+    Aabb centroid_bounds;
+
+    void merge(const RangeBounds& other)
+    {
+        bounds         .extend(other.bounds);
+        centroid_bounds.extend(other.centroid_bounds);
+    }
+};
+
+// Bins also track centroid bounds, so that the children's ranges are known
+// without another pass over their primitives.
+struct Bins
+{
+    RangeBounds range[3][BIN_COUNT];
+    uint32_t    count[3][BIN_COUNT] = {};
+
+    void merge(const Bins& other)
+    {
+        for (uint32_t axis = 0; axis < 3; axis++)
+        {
+            for (uint32_t i = 0; i < BIN_COUNT; i++)
+            {
+                range[axis][i].merge(other.range[axis][i]);
+                count[axis][i] += other.count[axis][i];
+            }
+        }
+    }
+};
+
+struct BuildContext
+{
+    const Aabb*            primitive_bounds = nullptr;
+    std::vector<glm::vec3> centroids;
+    std::vector<uint32_t>  indices;
+    std::vector<BuildNode> nodes;
+    std::atomic<uint32_t>  node_count = 1;
+    TaskCounter            tasks;
+
+    // Maps a centroid coordinate to its bin along the given axis.
+    struct Binning
+    {
+        glm::vec3 origin;
+        glm::vec3 scale;
+
+        uint32_t bin(const glm::vec3& centroid, uint32_t axis) const
+        {
+            const int i = int((centroid[axis] - origin[axis]) * scale[axis]);
+
+            return uint32_t(i < 0 ? 0 : (i >= int(BIN_COUNT) ? int(BIN_COUNT) - 1 : i));
+        }
+    };
+
+    // Runs `func(begin, end, partial)` over the range, splitting it across the
+    // task pool when large enough, and merges the partial results.
+    template <typename Result, typename Func>
+    static Result reduce(uint32_t begin, uint32_t end, Func&& func)
+    {
+        if (end - begin < PARALLEL_BINNING_SIZE)
+        {
+            Result result;
+            func(begin, end, result);
+
+            return result;
+        }
+
+        const uint32_t      grain = PARALLEL_BINNING_SIZE / 4;
+        std::vector<Result> partials((end - begin + grain - 1) / grain);
+
+        parallel_for(begin, end, grain, [&](uint32_t chunk_begin, uint32_t chunk_end)
+        {
+            func(chunk_begin, chunk_end, partials[(chunk_begin - begin) / grain]);
+        });
+
+        for (size_t i = 1; i < partials.size(); i++)
+        {
+            partials[0].merge(partials[i]);
+        }
+
+        return partials[0];
+    }
+
+    RangeBounds compute_range(uint32_t begin, uint32_t end) const
+    {
+        return reduce<RangeBounds>(begin, end, [&](uint32_t b, uint32_t e, RangeBounds& out)
+        {
+            for (uint32_t i = b; i < e; i++)
+            {
+                out.bounds         .extend(primitive_bounds[indices[i]]);
+                out.centroid_bounds.extend(centroids       [indices[i]]);
+            }
+        });
+    }
+
+    void build_node(uint32_t node_index, uint32_t begin, uint32_t end, const RangeBounds& range, uint32_t depth)
+    {
+        BuildNode&     node  = nodes[node_index];
+        const uint32_t count = end - begin;
+
+        node.bounds = range.bounds;
+        node.first  = begin;
+        node.count  = count;
+
+        if (count <= 1)
+        {
+            return;
+        }
+
+        const glm::vec3 centroid_extent = range.centroid_bounds.extent();
+        uint32_t        mid             = begin + count / 2;
+        RangeBounds     left_range;
+        RangeBounds     right_range;
+        bool            ranges_known    = false;
+
+        if (depth >= MEDIAN_SPLIT_DEPTH)
+        {
+            // SAH splits can peel off a few primitives per level, so a deep
+            // chain of them would overflow the traversal stack; halve the range
+            // along the longest centroid axis instead, which bounds the depth.
+            if (count <= MAX_LEAF_SIZE)
+            {
+                return;
+            }
+
+            const uint32_t axis = centroid_extent.x >= centroid_extent.y
+                ? (centroid_extent.x >= centroid_extent.z ? 0 : 2)
+                : (centroid_extent.y >= centroid_extent.z ? 1 : 2);
+
+            std::nth_element(
+                indices.begin() + begin,
+                indices.begin() + mid,
+                indices.begin() + end,
+                [&](uint32_t a, uint32_t b)
+                {
+                    return centroids[a][axis] < centroids[b][axis];
+                }
+            );
+        }
+        else if (centroid_extent.x > 0.0f || centroid_extent.y > 0.0f || centroid_extent.z > 0.0f)
+        {
+            Binning binning;
+            binning.origin = range.centroid_bounds.min;
+
+            for (uint32_t axis = 0; axis < 3; axis++)
+            {
+                binning.scale[axis] = centroid_extent[axis] > 0.0f
+                    ? float(BIN_COUNT) * 0.9999f / centroid_extent[axis]
+                    : 0.0f;
+            }
+
+            const Bins bins = reduce<Bins>(begin, end, [&](uint32_t b, uint32_t e, Bins& out)
+            {
+                for (uint32_t i = b; i < e; i++)
+                {
+                    const uint32_t   primitive = indices[i];
+                    const glm::vec3& centroid  = centroids[primitive];
+
+                    for (uint32_t axis = 0; axis < 3; axis++)
+                    {
+                        const uint32_t k = binning.bin(centroid, axis);
+
+                        out.range[axis][k].bounds         .extend(primitive_bounds[primitive]);
+                        out.range[axis][k].centroid_bounds.extend(centroid);
+                        out.count[axis][k]++;
+                    }
+                }
+            });
+
+            // Sweep the bins from both sides to evaluate every split plane.
+            float    best_cost = 1e30f;
+            uint32_t best_axis = 0;
+            uint32_t best_bin  = 0;
+
+            for (uint32_t axis = 0; axis < 3; axis++)
+            {
+                if (binning.scale[axis] == 0.0f)
+                {
+                    continue;
+                }
+
+                float    right_area [BIN_COUNT];
+                uint32_t right_count[BIN_COUNT];
+
+                Aabb     accum;
+                uint32_t accum_count = 0;
+
+                for (uint32_t i = BIN_COUNT - 1; i > 0; i--)
+                {
+                    accum.extend(bins.range[axis][i].bounds);
+                    accum_count += bins.count[axis][i];
+
+                    right_area [i] = accum.surface_area();
+                    right_count[i] = accum_count;
+                }
+
+                accum       = {};
+                accum_count = 0;
+
+                for (uint32_t i = 0; i + 1 < BIN_COUNT; i++)
+                {
+                    accum.extend(bins.range[axis][i].bounds);
+                    accum_count += bins.count[axis][i];
+
+                    if (accum_count == 0 || right_count[i + 1] == 0)
+                    {
+                        continue;
+                    }
+
+                    const float cost =
+                        accum.surface_area() * float(accum_count) +
+                        right_area[i + 1]    * float(right_count[i + 1]);
+
+                    if (cost < best_cost)
+                    {
+                        best_cost = cost;
+                        best_axis = axis;
+                        best_bin  = i;
+                    }
+                }
+            }
+
+            const float node_area  = node.bounds.surface_area();
+            const float split_cost = TRAVERSAL_COST + (node_area > 0.0f ? best_cost / node_area : 0.0f);
+
+            if (split_cost >= float(count) && count <= MAX_LEAF_SIZE)
+            {
+                return;
+            }
+
+            if (best_cost < 1e30f)
+            {
+                for (uint32_t i = 0; i < BIN_COUNT; i++)
+                {
+                    (i <= best_bin ? left_range : right_range).merge(bins.range[best_axis][i]);
+                }
+                ranges_known = true;
+
+                mid = uint32_t(std::partition(
+                    indices.begin() + begin,
+                    indices.begin() + end,
+                    [&](uint32_t primitive)
+                    {
+                        return binning.bin(centroids[primitive], best_axis) <= best_bin;
+                    }
+                ) - indices.begin());
+            }
+        }
+        else if (count <= MAX_LEAF_SIZE)
+        {
+            return;
+        }
+
+        // Coincident centroids; fall back to the object median.
+        if (mid == begin || mid == end)
+        {
+            mid          = begin + count / 2;
+            ranges_known = false;
+        }
+
+        if (!ranges_known)
+        {
+            left_range  = compute_range(begin, mid);
+            right_range = compute_range(mid  , end);
+        }
+
+        const uint32_t left = node_count.fetch_add(2, std::memory_order_relaxed);
+
+        node.left  = left;
+        node.count = 0;
+
+        if (count >= PARALLEL_BUILD_SIZE)
+        {
+            task_run(tasks, [this, left, begin, mid, left_range, depth]()
+            {
+                build_node(left, begin, mid, left_range, depth + 1);
+            });
+        }
+        else
+        {
+            build_node(left, begin, mid, left_range, depth + 1);
+        }
+
+        build_node(left + 1, mid, end, right_range, depth + 1);
+    }
+};
+
+
+// -----------------------------------------------------------------------------
+// WIDE NODE COLLAPSE
+// -----------------------------------------------------------------------------
+
+static void set_slot_bounds(Bvh::Node& node, uint32_t slot, const Aabb& bounds)
+{
+    node.min_x[slot] = bounds.min.x;
+    node.min_y[slot] = bounds.min.y;
+    node.min_z[slot] = bounds.min.z;
+    node.max_x[slot] = bounds.max.x;
+    node.max_y[slot] = bounds.max.y;
+    node.max_z[slot] = bounds.max.z;
+}
+
+static Aabb get_node_bounds(const Bvh::Node& node)
+{
+    Aabb bounds;
+
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        bounds.extend(Aabb{
+            { node.min_x[i], node.min_y[i], node.min_z[i] },
+            { node.max_x[i], node.max_y[i], node.max_z[i] },
+        });
+    }
+
+    return bounds;
+}
+
+// Pulls up grandchildren (largest surface area first) until four slots are
+// filled, then recurses. Returns the index of the emitted wide node.
+static uint32_t collapse(const std::vector<BuildNode>& build_nodes, uint32_t build_index, Bvh& bvh)
+{
+    const BuildNode& root = build_nodes[build_index];
+
+    uint32_t children[4];
+    uint32_t child_count = 0;
+
+    if (root.left == Bvh::INVALID)
+    {
+        children[child_count++] = build_index;
+    }
+    else
+    {
+        children[child_count++] = root.left;
+        children[child_count++] = root.left + 1;
+    }
+
+    while (child_count < 4)
+    {
+        uint32_t best      = Bvh::INVALID;
+        float    best_area = -1.0f;
+
+        for (uint32_t i = 0; i < child_count; i++)
+        {
+            const BuildNode& child = build_nodes[children[i]];
+
+            if (child.left != Bvh::INVALID && child.bounds.surface_area() > best_area)
+            {
+                best      = i;
+                best_area = child.bounds.surface_area();
+            }
+        }
+
+        if (best == Bvh::INVALID)
+        {
+            break;
+        }
+
+        const uint32_t left = build_nodes[children[best]].left;
+
+        children[best]          = left;
+        children[child_count++] = left + 1;
+    }
+
+    const uint32_t node_index = uint32_t(bvh.nodes.size());
+    bvh.nodes.emplace_back();
+
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        Bvh::Node& node = bvh.nodes[node_index];
+
+        if (i >= child_count)
+        {
+            set_slot_bounds(node, i, Aabb{});
+            node.child[i] = Bvh::INVALID;
+            node.count[i] = 0;
+            continue;
+        }
+
+        const BuildNode& child = build_nodes[children[i]];
+        set_slot_bounds(node, i, child.bounds);
+
+        if (child.left == Bvh::INVALID)
+        {
+            node.child[i] = child.first;
+            node.count[i] = child.count;
+        }
+        else
+        {
+            // Recursion may reallocate `bvh.nodes`; don't hold the reference.
+            const uint32_t index = collapse(build_nodes, children[i], bvh);
+
+            bvh.nodes[node_index].child[i] = index;
+            bvh.nodes[node_index].count[i] = 0;
+        }
+    }
+
+    return node_index;
+}
+
+
+// -----------------------------------------------------------------------------
+// BUILD AND REFIT
+// -----------------------------------------------------------------------------
+
+void Bvh::build(const Aabb* primitive_bounds, uint32_t primitive_count)
+{
+    nodes     .clear();
+    primitives.clear();
+    bounds = {};
+
+    if (primitive_count == 0)
+    {
+        return;
+    }
+
+    BuildContext ctx;
+    ctx.primitive_bounds = primitive_bounds;
+    ctx.centroids.resize(primitive_count);
+    ctx.indices  .resize(primitive_count);
+    ctx.nodes    .resize(size_t(primitive_count) * 2 - 1);
+
+    parallel_for(0, primitive_count, 16384, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t i = begin; i < end; i++)
+        {
+            ctx.centroids[i] = primitive_bounds[i].center();
+            ctx.indices  [i] = i;
+        }
+    });
+
+    ctx.build_node(0, 0, primitive_count, ctx.compute_range(0, primitive_count), 0);
+    task_wait(ctx.tasks);
+
+    nodes.reserve(ctx.node_count.load() / 2 + 1);
+    collapse(ctx.nodes, 0, *this);
+
+    primitives = static_cast<std::vector<uint32_t>&&>(ctx.indices);
+    bounds     = ctx.nodes[0].bounds;
+}
+
+void Bvh::refit(const Aabb* primitive_bounds)
+{
+    // Leaf slots are independent of each other.
+    parallel_for(0, uint32_t(nodes.size()), 1024, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t i = begin; i < end; i++)
+        {
+            Node& node = nodes[i];
+
+            for (uint32_t slot = 0; slot < 4; slot++)
+            {
+                if (node.count[slot] == 0)
+                {
+                    continue;
+                }
+
+                Aabb leaf_bounds;
+                for (uint32_t j = 0; j < node.count[slot]; j++)
+                {
+                    leaf_bounds.extend(primitive_bounds[primitives[node.child[slot] + j]]);
+                }
+
+                set_slot_bounds(node, slot, leaf_bounds);
+            }
+        }
+    });
+
+    // Children follow their parent in the array, so walking it backwards
+    // visits every node after all of its descendants.
+    for (size_t i = nodes.size(); i-- > 0;)
+    {
+        Node& node = nodes[i];
+
+        for (uint32_t slot = 0; slot < 4; slot++)
+        {
+            if (node.count[slot] == 0 && node.child[slot] != INVALID)
+            {
+                set_slot_bounds(node, slot, get_node_bounds(nodes[node.child[slot]]));
+            }
+        }
+    }
+
+    bounds = nodes.empty() ? Aabb{} : get_node_bounds(nodes[0]);
+}
+
+void compute_triangle_bounds(const Mesh& mesh, std::vector<Aabb>& out_bounds)
+{
+    out_bounds.resize(mesh.triangle_count());
+
+    parallel_for(0, mesh.triangle_count(), 16384, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t i = begin; i < end; i++)
+        {
+            Aabb& aabb = out_bounds[i];
+            aabb = {};
+            aabb.extend(mesh.position(mesh.indices[i * 3 + 0]));
+            aabb.extend(mesh.position(mesh.indices[i * 3 + 1]));
+            aabb.extend(mesh.position(mesh.indices[i * 3 + 2]));
+        }
+    });
+}
+
+void Bvh::build(const Mesh& mesh)
+{
+    std::vector<Aabb> triangle_bounds;
+    compute_triangle_bounds(mesh, triangle_bounds);
+
+    build(triangle_bounds.data(), uint32_t(triangle_bounds.size()));
+}
+
+void Bvh::refit(const Mesh& mesh)
+{
+    std::vector<Aabb> triangle_bounds;
+    compute_triangle_bounds(mesh, triangle_bounds);
+
+    refit(triangle_bounds.data());
+}
+
+
+// -----------------------------------------------------------------------------
+// NODE TESTS
+// -----------------------------------------------------------------------------
+
+struct RayData
+{
+    float    origin[3];
+    float    inv_dir[3];
+    uint32_t negative[3]; // Whether the near plane is the box maximum.
+};
+
+static RayData make_ray_data(const Ray& ray)
+{
+    RayData data;
+
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        // Avoid infinities (and NaNs from `0 * inf`) for axis-parallel rays.
+        const float d = fabsf(ray.direction[i]) > 1e-20f
+            ? ray.direction[i]
+            : (ray.direction[i] < 0.0f ? -1e-20f : 1e-20f);
+
+        data.origin  [i] = ray.origin[i];
+        data.inv_dir [i] = 1.0f / d;
+        data.negative[i] = d < 0.0f;
+    }
+
+    return data;
+}
+
+// Writes the entry distance of each hit slot and returns the hit mask. Empty
+// slots never hit because their near plane lies beyond the far one.
+static uint32_t intersect_ray_node(const Bvh::Node& node, const RayData& ray, float t_min, float t_max, float* out_t)
+{
+    const float* near_x = ray.negative[0] ? node.max_x : node.min_x;
+    const float* far_x  = ray.negative[0] ? node.min_x : node.max_x;
+    const float* near_y = ray.negative[1] ? node.max_y : node.min_y;
+    const float* far_y  = ray.negative[1] ? node.min_y : node.max_y;
+    const float* near_z = ray.negative[2] ? node.max_z : node.min_z;
+    const float* far_z  = ray.negative[2] ? node.min_z : node.max_z;
+
+#if BX_CPU_X86
+    const __m128 ox = _mm_set1_ps(ray.origin [0]), oy = _mm_set1_ps(ray.origin [1]), oz = _mm_set1_ps(ray.origin [2]);
+    const __m128 ix = _mm_set1_ps(ray.inv_dir[0]), iy = _mm_set1_ps(ray.inv_dir[1]), iz = _mm_set1_ps(ray.inv_dir[2]);
+
+    const __m128 t0x = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(near_x), ox), ix);
+    const __m128 t0y = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(near_y), oy), iy);
+    const __m128 t0z = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(near_z), oz), iz);
+    const __m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(far_x ), ox), ix);
+    const __m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(far_y ), oy), iy);
+    const __m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(far_z ), oz), iz);
+
+    const __m128 t_near = _mm_max_ps(_mm_max_ps(t0x, t0y), _mm_max_ps(t0z, _mm_set1_ps(t_min)));
+    const __m128 t_far  = _mm_min_ps(_mm_min_ps(t1x, t1y), _mm_min_ps(t1z, _mm_set1_ps(t_max)));
+
+    _mm_storeu_ps(out_t, t_near);
+
+    return uint32_t(_mm_movemask_ps(_mm_cmple_ps(t_near, t_far)));
+#else
+    uint32_t mask = 0;
+
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        const float t0x = (near_x[i] - ray.origin[0]) * ray.inv_dir[0];
+        const float t0y = (near_y[i] - ray.origin[1]) * ray.inv_dir[1];
+        const float t0z = (near_z[i] - ray.origin[2]) * ray.inv_dir[2];
+        const float t1x = (far_x [i] - ray.origin[0]) * ray.inv_dir[0];
+        const float t1y = (far_y [i] - ray.origin[1]) * ray.inv_dir[1];
+        const float t1z = (far_z [i] - ray.origin[2]) * ray.inv_dir[2];
+
+        const float t_near = glm::max(glm::max(t0x, t0y), glm::max(t0z, t_min));
+        const float t_far  = glm::min(glm::min(t1x, t1y), glm::min(t1z, t_max));
+
+        out_t[i] = t_near;
+        mask    |= uint32_t(t_near <= t_far) << i;
+    }
+
+    return mask;
+#endif
+}
+
+// Squared distances from the point to each slot box (huge for empty slots).
+static void distance_point_node(const Bvh::Node& node, const glm::vec3& p, float* out_d2)
+{
+#if BX_CPU_X86
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 px   = _mm_set1_ps(p.x), py = _mm_set1_ps(p.y), pz = _mm_set1_ps(p.z);
+
+    const __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node.min_x), px), _mm_sub_ps(px, _mm_loadu_ps(node.max_x))), zero);
+    const __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node.min_y), py), _mm_sub_ps(py, _mm_loadu_ps(node.max_y))), zero);
+    const __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node.min_z), pz), _mm_sub_ps(pz, _mm_loadu_ps(node.max_z))), zero);
+
+    _mm_storeu_ps(out_d2, _mm_add_ps(_mm_mul_ps(dx, dx), _mm_add_ps(_mm_mul_ps(dy, dy), _mm_mul_ps(dz, dz))));
+#else
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        const float dx = glm::max(glm::max(node.min_x[i] - p.x, p.x - node.max_x[i]), 0.0f);
+        const float dy = glm::max(glm::max(node.min_y[i] - p.y, p.y - node.max_y[i]), 0.0f);
+        const float dz = glm::max(glm::max(node.min_z[i] - p.z, p.z - node.max_z[i]), 0.0f);
+
+        out_d2[i] = dx * dx + dy * dy + dz * dz;
+    }
+#endif
+}
+
+
+// -----------------------------------------------------------------------------
+// TRIANGLE TESTS
+// -----------------------------------------------------------------------------
+
+// Möller-Trumbore, double-sided.
+static bool intersect_ray_triangle
+(
+    const Ray&       ray,
+    const glm::vec3& a,
+    const glm::vec3& b,
+    const glm::vec3& c,
+    float            t_max,
+    float&           out_t,
+    float&           out_u,
+    float&           out_v
+)
+{
+    const glm::vec3 e1  = b - a;
+    const glm::vec3 e2  = c - a;
+    const glm::vec3 p   = glm::cross(ray.direction, e2);
+    const float     det = glm::dot(e1, p);
+
+    if (fabsf(det) < 1e-12f)
+    {
+        return false;
+    }
+
+    const float     inv_det = 1.0f / det;
+    const glm::vec3 s       = ray.origin - a;
+    const float     u       = glm::dot(s, p) * inv_det;
+
+    if (u < 0.0f || u > 1.0f)
+    {
+        return false;
+    }
+
+    const glm::vec3 q = glm::cross(s, e1);
+    const float     v = glm::dot(ray.direction, q) * inv_det;
+
+    if (v < 0.0f || u + v > 1.0f)
+    {
+        return false;
+    }
+
+    const float t = glm::dot(e2, q) * inv_det;
+
+    if (t < ray.t_min || t > t_max)
+    {
+        return false;
+    }
+
+    out_t = t;
+    out_u = u;
+    out_v = v;
+
+    return true;
+}
+
+// Ericson, Real-Time Collision Detection, 5.1.5.
+static glm::vec3 closest_point_on_triangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+    const glm::vec3 ab = b - a;
+    const glm::vec3 ac = c - a;
+    const glm::vec3 ap = p - a;
+
+    const float d1 = glm::dot(ab, ap);
+    const float d2 = glm::dot(ac, ap);
+    if (d1 <= 0.0f && d2 <= 0.0f) return a;
+
+    const glm::vec3 bp = p - b;
+    const float     d3 = glm::dot(ab, bp);
+    const float     d4 = glm::dot(ac, bp);
+    if (d3 >= 0.0f && d4 <= d3) return b;
+
+    const float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return a + ab * (d1 / (d1 - d3));
+
+    const glm::vec3 cp = p - c;
+    const float     d5 = glm::dot(ab, cp);
+    const float     d6 = glm::dot(ac, cp);
+    if (d6 >= 0.0f && d5 <= d6) return c;
+
+    const float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return a + ac * (d2 / (d2 - d6));
+
+    const float va = d3 * d6 - d5 * d4;
+    if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+    {
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+
+    const float denom = 1.0f / (va + vb + vc);
+
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+
+// -----------------------------------------------------------------------------
+// TRAVERSAL
+// -----------------------------------------------------------------------------
+
+struct StackEntry
+{
+    uint32_t child;
+    uint32_t count;
+    float    distance;
+};
+
+// Halving from below `MEDIAN_SPLIT_DEPTH` takes at most 32 more levels, and
+// each wide level descended replaces one entry with at most four.
+static_assert(3 * (MEDIAN_SPLIT_DEPTH + 33) + 1 <= Bvh::STACK_SIZE, "traversal stack too small for the build depth");
+
+// Pushes the hit slots so that the nearest one is popped first.
+static void push_sorted(StackEntry* stack, uint32_t& size, const Bvh::Node& node, uint32_t mask, const float* distance)
+{
+    StackEntry entries[4];
+    uint32_t   count = 0;
+
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        if (mask & (1u << i))
+        {
+            StackEntry entry = { node.child[i], node.count[i], distance[i] };
+
+            uint32_t j = count++;
+            for (; j > 0 && entries[j - 1].distance < entry.distance; j--)
+            {
+                entries[j] = entries[j - 1];
+            }
+            entries[j] = entry;
+        }
+    }
+
+    assert(size + count <= Bvh::STACK_SIZE);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        stack[size++] = entries[i];
+    }
+}
+
+RayHit Bvh::ray_cast(const Mesh& mesh, const Ray& ray) const
+{
+    RayHit hit;
+    hit.t = ray.t_max;
+
+    if (nodes.empty())
+    {
+        return hit;
+    }
+
+    const RayData data = make_ray_data(ray);
+
+    StackEntry stack[Bvh::STACK_SIZE];
+    uint32_t   size = 0;
+
+    stack[size++] = { 0, 0, ray.t_min };
+
+    while (size > 0)
+    {
+        const StackEntry entry = stack[--size];
+
+        if (entry.distance > hit.t)
+        {
+            continue;
+        }
+
+        if (entry.count == 0)
+        {
+            float          t[4];
+            const Node&    node = nodes[entry.child];
+            const uint32_t mask = intersect_ray_node(node, data, ray.t_min, hit.t, t);
+
+            push_sorted(stack, size, node, mask, t);
+            continue;
+        }
+
+        for (uint32_t i = 0; i < entry.count; i++)
+        {
+            const uint32_t  primitive = primitives[entry.child + i];
+            const uint32_t* tri       = &mesh.indices[primitive * 3];
+
+            float t, u, v;
+            if (intersect_ray_triangle(
+                ray, mesh.position(tri[0]), mesh.position(tri[1]), mesh.position(tri[2]), hit.t, t, u, v))
+            {
+                hit.t         = t;
+                hit.u         = u;
+                hit.v         = v;
+                hit.primitive = primitive;
+            }
+        }
+    }
+
+    return hit;
+}
+
+ClosestPoint Bvh::closest_point(const Mesh& mesh, const glm::vec3& point, float max_distance) const
+{
+    ClosestPoint result;
+
+    if (nodes.empty())
+    {
+        return result;
+    }
+
+    float best_d2 = max_distance < 1e15f ? max_distance * max_distance : 1e30f;
+
+    StackEntry stack[Bvh::STACK_SIZE];
+    uint32_t   size = 0;
+
+    stack[size++] = { 0, 0, 0.0f };
+
+    while (size > 0)
+    {
+        const StackEntry entry = stack[--size];
+
+        if (entry.distance > best_d2)
+        {
+            continue;
+        }
+
+        if (entry.count == 0)
+        {
+            float       d2[4];
+            const Node& node = nodes[entry.child];
+            distance_point_node(node, point, d2);
+
+            uint32_t mask = 0;
+            for (uint32_t i = 0; i < 4; i++)
+            {
+                mask |= uint32_t(d2[i] <= best_d2 && node.child[i] != INVALID) << i;
+            }
+
+            push_sorted(stack, size, node, mask, d2);
+            continue;
+        }
+
+        for (uint32_t i = 0; i < entry.count; i++)
+        {
+            const uint32_t  primitive = primitives[entry.child + i];
+            const uint32_t* tri       = &mesh.indices[primitive * 3];
+
+            const glm::vec3 q = closest_point_on_triangle(
+                point, mesh.position(tri[0]), mesh.position(tri[1]), mesh.position(tri[2])
+            );
+            const glm::vec3 d  = q - point;
+            const float     d2 = glm::dot(d, d);
+
+            if (d2 < best_d2)
+            {
+                best_d2          = d2;
+                result.point     = q;
+                result.primitive = primitive;
+            }
+        }
+    }
+
+    if (result.found())
+    {
+        result.distance = sqrtf(best_d2);
+    }
+
+    return result;
+}
+
+
+// -----------------------------------------------------------------------------
+// OVERLAPS
+// -----------------------------------------------------------------------------
+
+// Inner node (zero `count`) or leaf range, with its box from the parent slot.
+struct SlotRef
+{
+    uint32_t child;
+    uint32_t count;
+    Aabb     bounds;
+};
+
+struct SlotPair
+{
+    SlotRef a;
+    SlotRef b;
+};
+
+static bool boxes_overlap(const Aabb& a, const Aabb& b)
+{
+    return a.min.x <= b.max.x && b.min.x <= a.max.x
+        && a.min.y <= b.max.y && b.min.y <= a.max.y
+        && a.min.z <= b.max.z && b.min.z <= a.max.z;
+}
+
+// Leaves stand for themselves; inner nodes for their used slots.
+static uint32_t get_slots(const Bvh& bvh, const SlotRef& ref, SlotRef* out_slots)
+{
+    if (ref.count > 0)
+    {
+        out_slots[0] = ref;
+
+        return 1;
+    }
+
+    const Bvh::Node& node  = bvh.nodes[ref.child];
+    uint32_t         count = 0;
+
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        if (node.child[i] != Bvh::INVALID)
+        {
+            out_slots[count++] = {
+                node.child[i],
+                node.count[i],
+                { { node.min_x[i], node.min_y[i], node.min_z[i] }, { node.max_x[i], node.max_y[i], node.max_z[i] } },
+            };
+        }
+    }
+
+    return count;
+}
+
+// Tests the primitives of two leaves, or pushes the overlapping pairs of
+// their children, descending both sides at once.
+static void expand_pair
+(
+    const Bvh&               a,
+    const Bvh&               b,
+    const SlotPair&          pair,
+    const Aabb*              a_bounds,
+    const Aabb*              b_bounds,
+    std::vector<SlotPair>&   out_pairs,
+    std::vector<glm::uvec2>& out_primitives
+)
+{
+    if (pair.a.count > 0 && pair.b.count > 0)
+    {
+        for (uint32_t i = 0; i < pair.a.count; i++)
+        {
+            const uint32_t primitive_a = a.primitives[pair.a.child + i];
+
+            if (!boxes_overlap(a_bounds[primitive_a], pair.b.bounds))
+            {
+                continue;
+            }
+
+            for (uint32_t j = 0; j < pair.b.count; j++)
+            {
+                const uint32_t primitive_b = b.primitives[pair.b.child + j];
+
+                if (boxes_overlap(a_bounds[primitive_a], b_bounds[primitive_b]))
+                {
+                    out_primitives.push_back({ primitive_a, primitive_b });
+                }
+            }
+        }
+
+        return;
+    }
+
+    SlotRef        slots_a[4];
+    SlotRef        slots_b[4];
+    const uint32_t count_a = get_slots(a, pair.a, slots_a);
+    const uint32_t count_b = get_slots(b, pair.b, slots_b);
+
+    for (uint32_t i = 0; i < count_a; i++)
+    {
+        for (uint32_t j = 0; j < count_b; j++)
+        {
+            if (boxes_overlap(slots_a[i].bounds, slots_b[j].bounds))
+            {
+                out_pairs.push_back({ slots_a[i], slots_b[j] });
+            }
+        }
+    }
+}
+
+void Bvh::find_overlaps(const Bvh& other, const Aabb* primitive_bounds, const Aabb* other_primitive_bounds, std::vector<glm::uvec2>& out_pairs) const
+{
+    out_pairs.clear();
+
+    if (nodes.empty() || other.nodes.empty() || !boxes_overlap(bounds, other.bounds))
+    {
+        return;
+    }
+
+    // Breadth-first until there are enough pairs to keep every thread busy;
+    // leaf pairs found on the way are tested right away.
+    const size_t min_frontier = size_t(task_pool_thread_count()) * 64;
+
+    std::vector<SlotPair> frontier = { { { 0, 0, bounds }, { 0, 0, other.bounds } } };
+    std::vector<SlotPair> next;
+
+    while (!frontier.empty() && frontier.size() < min_frontier)
+    {
+        next.clear();
+
+        for (const SlotPair& pair : frontier)
+        {
+            expand_pair(*this, other, pair, primitive_bounds, other_primitive_bounds, next, out_pairs);
+        }
+
+        frontier.swap(next);
+    }
+
+    std::vector<std::vector<glm::uvec2>> found(frontier.size());
+
+    parallel_for(0, uint32_t(frontier.size()), 1, [&](uint32_t begin, uint32_t end)
+    {
+        std::vector<SlotPair> stack;
+
+        for (uint32_t i = begin; i < end; i++)
+        {
+            stack.push_back(frontier[i]);
+
+            while (!stack.empty())
+            {
+                const SlotPair pair = stack.back();
+                stack.pop_back();
+
+                expand_pair(*this, other, pair, primitive_bounds, other_primitive_bounds, stack, found[i]);
+            }
+        }
+    });
+
+    size_t total = out_pairs.size();
+
+    for (const std::vector<glm::uvec2>& pairs : found)
+    {
+        total += pairs.size();
+    }
+
+    out_pairs.reserve(total);
+
+    for (const std::vector<glm::uvec2>& pairs : found)
+    {
+        out_pairs.insert(out_pairs.end(), pairs.begin(), pairs.end());
+    }
+}
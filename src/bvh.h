@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stdint.h>    // uint32_t
+
+#include <vector>      // vector
+
+#include <glm/glm.hpp> // uvec2, vec3
+
+#include "mesh.h"      // Aabb, Mesh
+
+
+// -----------------------------------------------------------------------------
+// QUERIES
+// -----------------------------------------------------------------------------
+
+struct Ray
+{
+    glm::vec3 origin    = glm::vec3(0.0f);
+    glm::vec3 direction = { 0.0f, 0.0f, -1.0f };
+    float     t_min     = 0.0f;
+    float     t_max     = 1e30f;
+};
+
+struct RayHit
+{
+    float    t         = 1e30f;
+    float    u         = 0.0f; // Barycentric coordinates of the hit point, the
+    float    v         = 0.0f; // weights of the triangle's second and third vertex.
+    uint32_t primitive = UINT32_MAX;
+
+    bool hit() const
+    {
+        return primitive != UINT32_MAX;
+    }
+};
+
+struct ClosestPoint
+{
+    glm::vec3 point     = glm::vec3(0.0f);
+    float     distance  = 1e30f;
+    uint32_t  primitive = UINT32_MAX;
+
+    bool found() const
+    {
+        return primitive != UINT32_MAX;
+    }
+};
+
+
+// -----------------------------------------------------------------------------
+// BOUNDING VOLUME HIERARCHY
+// -----------------------------------------------------------------------------
+
+// Four-wide bounding volume hierarchy. Built top-down as a binary tree using
+// binned surface area heuristic (subtrees built in parallel via `tasks.h`),
+// switching to object median splits deep down so that the depth stays within
+// the fixed traversal stack, then collapsed so that each node tests four child
+// boxes at once with SIMD.
+//
+// The generic functions work on arbitrary primitive bounds; the mesh overloads
+// treat primitive `i` as the mesh's `i`-th triangle.
+struct Bvh
+{
+    static constexpr uint32_t INVALID = UINT32_MAX;
+
+    // Entries enough for a depth-first traversal that pushes the inner
+    // children of each node it pops, given the build's depth bound.
+    static constexpr uint32_t STACK_SIZE = 256;
+
+    // Child boxes are stored as structure of arrays. A child with zero `count`
+    // is an inner node index; otherwise `child` is the first of `count` entries
+    // in `primitives`. Unused slots have inverted (empty) bounds.
+    struct Node
+    {
+        float    min_x[4];
+        float    min_y[4];
+        float    min_z[4];
+        float    max_x[4];
+        float    max_y[4];
+        float    max_z[4];
+        uint32_t child[4];
+        uint32_t count[4];
+    };
+
+    // Nodes are in depth-first pre-order, so each node precedes its children.
+    std::vector<Node>     nodes;
+    std::vector<uint32_t> primitives;
+    Aabb                  bounds;
+
+    bool is_empty() const
+    {
+        return nodes.empty();
+    }
+
+    void build(const Aabb* primitive_bounds, uint32_t primitive_count);
+
+    void build(const Mesh& mesh);
+
+    // Updates the node bounds in place after the primitives moved, keeping the
+    // topology. Quality degrades with large deformations; rebuild then.
+    void refit(const Aabb* primitive_bounds);
+
+    void refit(const Mesh& mesh);
+
+    RayHit ray_cast(const Mesh& mesh, const Ray& ray) const;
+
+    // Ignores triangles farther than `max_distance`.
+    ClosestPoint closest_point(const Mesh& mesh, const glm::vec3& point, float max_distance = 1e30f) const;
+
+    // Pairs of primitives, one of this hierarchy and one of `other`, whose
+    // bounds overlap, in no particular order. Both trees are descended at once,
+    // in parallel from a frontier of node pairs.
+    void find_overlaps(const Bvh& other, const Aabb* primitive_bounds, const Aabb* other_primitive_bounds, std::vector<glm::uvec2>& out_pairs) const;
+};
+
+void compute_triangle_bounds(const Mesh& mesh, std::vector<Aabb>& out_bounds);
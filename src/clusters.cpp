@@ -0,0 +1,255 @@
+#include "clusters.h"
+
+#include <string.h>         // memcpy
+
+#include <bx/platform.h>    // BX_CPU_X86
+
+#if BX_CPU_X86
+#   include <emmintrin.h>   // _mm_*
+#endif
+
+#include <meshoptimizer.h>  // meshopt_*
+
+#include "tasks.h"          // parallel_for
+
+
+// -----------------------------------------------------------------------------
+// CLUSTER BUILDING
+// -----------------------------------------------------------------------------
+
+void MeshClusters::build(const Mesh& mesh, uint32_t max_vertices, uint32_t max_triangles)
+{
+    clear();
+
+    if (mesh.indices.empty())
+    {
+        return;
+    }
+
+    // meshoptimizer wants interleaved positions.
+    std::vector<float> positions(size_t(mesh.vertex_count()) * 3);
+
+    for (uint32_t i = 0; i < mesh.vertex_count(); i++)
+    {
+        positions[i * 3 + 0] = mesh.position_x[i];
+        positions[i * 3 + 1] = mesh.position_y[i];
+        positions[i * 3 + 2] = mesh.position_z[i];
+    }
+
+    const size_t max_meshlets = meshopt_buildMeshletsBound(mesh.indices.size(), max_vertices, max_triangles);
+
+    std::vector<meshopt_Meshlet> meshlets         (max_meshlets);
+    std::vector<uint32_t>        meshlet_vertices (max_meshlets * max_vertices);
+    std::vector<uint8_t>         meshlet_triangles(max_meshlets * max_triangles * 3);
+
+    // Some weight on cone tightness makes backface culling more effective.
+    const float cone_weight = 0.25f;
+
+    const size_t count = meshopt_buildMeshlets(
+        meshlets.data(),
+        meshlet_vertices.data(),
+        meshlet_triangles.data(),
+        mesh.indices.data(),
+        mesh.indices.size(),
+        positions.data(),
+        mesh.vertex_count(),
+        sizeof(float) * 3,
+        max_vertices,
+        max_triangles,
+        cone_weight
+    );
+
+    indices.reserve(mesh.indices.size());
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const meshopt_Meshlet& meshlet = meshlets[i];
+
+        const meshopt_Bounds bounds = meshopt_computeMeshletBounds(
+            &meshlet_vertices [meshlet.vertex_offset  ],
+            &meshlet_triangles[meshlet.triangle_offset],
+            meshlet.triangle_count,
+            positions.data(),
+            mesh.vertex_count(),
+            sizeof(float) * 3
+        );
+
+        center_x    .push_back(bounds.center[0]);
+        center_y    .push_back(bounds.center[1]);
+        center_z    .push_back(bounds.center[2]);
+        radius      .push_back(bounds.radius);
+        cone_axis_x .push_back(bounds.cone_axis[0]);
+        cone_axis_y .push_back(bounds.cone_axis[1]);
+        cone_axis_z .push_back(bounds.cone_axis[2]);
+        cone_cutoff .push_back(bounds.cone_cutoff);
+
+        index_offset.push_back(uint32_t(indices.size()));
+        index_count .push_back(meshlet.triangle_count * 3);
+
+        for (uint32_t j = 0; j < meshlet.triangle_count * 3; j++)
+        {
+            const uint8_t local = meshlet_triangles[meshlet.triangle_offset + j];
+
+            indices.push_back(meshlet_vertices[meshlet.vertex_offset + local]);
+        }
+    }
+}
+
+void MeshClusters::clear()
+{
+    center_x    .clear();
+    center_y    .clear();
+    center_z    .clear();
+    radius      .clear();
+    cone_axis_x .clear();
+    cone_axis_y .clear();
+    cone_axis_z .clear();
+    cone_cutoff .clear();
+    index_offset.clear();
+    index_count .clear();
+    indices     .clear();
+}
+
+
+// -----------------------------------------------------------------------------
+// CLUSTER CULLING
+// -----------------------------------------------------------------------------
+
+// Frustum test of the bounding sphere, then the cone test from meshoptimizer's
+// documentation: the cluster faces away if the direction from the eye falls
+// within the cone of its (negated) normals.
+static bool cluster_visible(const MeshClusters& clusters, const Frustum& frustum, const glm::vec3& eye, uint32_t i)
+{
+    const glm::vec3 center = { clusters.center_x[i], clusters.center_y[i], clusters.center_z[i] };
+
+    for (const glm::vec4& p : frustum.planes)
+    {
+        if (glm::dot(glm::vec3(p), center) + p.w < -clusters.radius[i])
+        {
+            return false;
+        }
+    }
+
+    const glm::vec3 axis = { clusters.cone_axis_x[i], clusters.cone_axis_y[i], clusters.cone_axis_z[i] };
+    const glm::vec3 view = center - eye;
+
+    return glm::dot(view, axis) < clusters.cone_cutoff[i] * glm::length(view) + clusters.radius[i];
+}
+
+CullStats cull_clusters
+(
+    const MeshClusters&    clusters,
+    const Frustum&         frustum,
+    const glm::vec3&       eye,
+    std::vector<uint32_t>& out_visible
+)
+{
+    const uint32_t count = clusters.size();
+    const size_t   first = out_visible.size();
+
+    // Three extra entries absorb the speculative writes of the compaction.
+    out_visible.resize(first + count + 3);
+
+    uint32_t* out     = out_visible.data() + first;
+    uint32_t  visible = 0;
+    uint32_t  i       = 0;
+
+#if BX_CPU_X86
+    const __m128 eye_x = _mm_set1_ps(eye.x);
+    const __m128 eye_y = _mm_set1_ps(eye.y);
+    const __m128 eye_z = _mm_set1_ps(eye.z);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 cx = _mm_loadu_ps(&clusters.center_x[i]);
+        const __m128 cy = _mm_loadu_ps(&clusters.center_y[i]);
+        const __m128 cz = _mm_loadu_ps(&clusters.center_z[i]);
+        const __m128 r  = _mm_loadu_ps(&clusters.radius  [i]);
+
+        const __m128 neg_r = _mm_sub_ps(_mm_setzero_ps(), r);
+
+        __m128 pass = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+        for (const glm::vec4& p : frustum.planes)
+        {
+            const __m128 d = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.x), cx), _mm_mul_ps(_mm_set1_ps(p.y), cy)),
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.z), cz), _mm_set1_ps(p.w))
+            );
+
+            pass = _mm_and_ps(pass, _mm_cmpge_ps(d, neg_r));
+        }
+
+        const __m128 vx = _mm_sub_ps(cx, eye_x);
+        const __m128 vy = _mm_sub_ps(cy, eye_y);
+        const __m128 vz = _mm_sub_ps(cz, eye_z);
+
+        const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz)));
+
+        const __m128 dot = _mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(vx, _mm_loadu_ps(&clusters.cone_axis_x[i])),
+            _mm_mul_ps(vy, _mm_loadu_ps(&clusters.cone_axis_y[i]))),
+            _mm_mul_ps(vz, _mm_loadu_ps(&clusters.cone_axis_z[i]))
+        );
+
+        const __m128 limit = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&clusters.cone_cutoff[i]), length), r);
+
+        pass = _mm_and_ps(pass, _mm_cmplt_ps(dot, limit));
+
+        const uint32_t mask = uint32_t(_mm_movemask_ps(pass));
+
+        for (uint32_t j = 0; j < 4; j++)
+        {
+            out[visible] = i + j;
+            visible     += (mask >> j) & 1;
+        }
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        out[visible] = i;
+        visible     += cluster_visible(clusters, frustum, eye, i);
+    }
+
+    out_visible.resize(first + visible);
+
+    return { visible, count - visible };
+}
+
+uint32_t count_cluster_indices(const MeshClusters& clusters, const uint32_t* visible, uint32_t count)
+{
+    uint32_t total = 0;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        total += clusters.index_count[visible[i]];
+    }
+
+    return total;
+}
+
+void copy_cluster_indices(const MeshClusters& clusters, const uint32_t* visible, uint32_t count, uint32_t* out_indices)
+{
+    std::vector<uint32_t> offsets(count);
+
+    for (uint32_t i = 0, offset = 0; i < count; i++)
+    {
+        offsets[i] = offset;
+        offset    += clusters.index_count[visible[i]];
+    }
+
+    parallel_for(0, count, 256, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t i = begin; i < end; i++)
+        {
+            const uint32_t cluster = visible[i];
+
+            memcpy(
+                out_indices + offsets[i],
+                clusters.indices.data() + clusters.index_offset[cluster],
+                clusters.index_count[cluster] * sizeof(uint32_t)
+            );
+        }
+    });
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>    // uint32_t
+
+#include <vector>      // vector
+
+#include <glm/glm.hpp> // vec3
+
+#include "culling.h"   // CullStats, Frustum
+#include "mesh.h"      // Mesh
+
+
+// -----------------------------------------------------------------------------
+// MESH CLUSTERS
+// -----------------------------------------------------------------------------
+
+// Partition of a mesh into small clusters of triangles (meshlets), each with
+// a bounding sphere and a normal cone for backface culling. The triangles of
+// all clusters are stored as plain mesh indices, cluster after cluster, so a
+// cluster's index range can be copied straight to an index buffer.
+struct MeshClusters
+{
+    std::vector<float>    center_x;
+    std::vector<float>    center_y;
+    std::vector<float>    center_z;
+    std::vector<float>    radius;
+
+    std::vector<float>    cone_axis_x;
+    std::vector<float>    cone_axis_y;
+    std::vector<float>    cone_axis_z;
+    std::vector<float>    cone_cutoff;
+
+    std::vector<uint32_t> index_offset;
+    std::vector<uint32_t> index_count;
+
+    std::vector<uint32_t> indices;
+
+    uint32_t size() const
+    {
+        return uint32_t(center_x.size());
+    }
+
+    bool is_empty() const
+    {
+        return center_x.empty();
+    }
+
+    // Limits as recommended by meshoptimizer for mesh shading hardware; they
+    // work equally well for CPU culling.
+    void build(const Mesh& mesh, uint32_t max_vertices = 64, uint32_t max_triangles = 124);
+
+    void clear();
+};
+
+// Appends the indices of clusters that are inside the frustum and not facing
+// away from `eye` to `out_visible`. Counts are in clusters.
+CullStats cull_clusters
+(
+    const MeshClusters&    clusters,
+    const Frustum&         frustum,
+    const glm::vec3&       eye,
+    std::vector<uint32_t>& out_visible
+);
+
+// Returns the total index count of the given clusters.
+uint32_t count_cluster_indices(const MeshClusters& clusters, const uint32_t* visible, uint32_t count);
+
+// Copies the index ranges of the given clusters to `out_indices`, which must
+// have room for `count_cluster_indices` entries. Parallel on the task pool.
+void copy_cluster_indices(const MeshClusters& clusters, const uint32_t* visible, uint32_t count, uint32_t* out_indices);
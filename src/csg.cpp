@@ -0,0 +1,1607 @@
+#include "csg.h"
+
+#include <math.h>          // fabs, fma
+#include <string.h>        // memcpy
+
+#include <algorithm>       // max, min, swap
+#include <unordered_map>   // unordered_map
+#include <vector>          // vector
+
+#include <glm/glm.hpp>     // dvec2, dvec3, uvec2, uvec3, vec3
+
+#include "bvh.h"           // Bvh, compute_triangle_bounds, Ray
+#include "tasks.h"         // parallel_for, task_cancelled, TaskCancel
+
+
+// -----------------------------------------------------------------------------
+// EXACT ARITHMETIC
+// -----------------------------------------------------------------------------
+
+// Sum of doubles that don't overlap bitwise, by increasing magnitude and
+// without zeros, so that its sign is that of its last component (Shewchuk,
+// Adaptive Precision Floating-Point Arithmetic and Fast Robust Geometric
+// Predicates). Large enough for the orientation determinants of doubles.
+struct Expansion
+{
+    static constexpr uint32_t CAPACITY = 192;
+
+    double   terms[CAPACITY];
+    uint32_t count = 0;
+
+    void push(double term)
+    {
+        if (term != 0.0)
+        {
+            terms[count++] = term;
+        }
+    }
+
+    int sign() const
+    {
+        return count == 0 ? 0 : (terms[count - 1] > 0.0 ? 1 : -1);
+    }
+};
+
+static void two_sum(double a, double b, double& out_sum, double& out_error)
+{
+    out_sum = a + b;
+
+    const double b_virtual = out_sum - a;
+    const double a_virtual = out_sum - b_virtual;
+
+    out_error = (a - a_virtual) + (b - b_virtual);
+}
+
+// Requires |a| >= |b|.
+static void fast_two_sum(double a, double b, double& out_sum, double& out_error)
+{
+    out_sum   = a + b;
+    out_error = b - (out_sum - a);
+}
+
+static void two_product(double a, double b, double& out_product, double& out_error)
+{
+    out_product = a * b;
+    out_error   = fma(a, b, -out_product);
+}
+
+static Expansion exact_difference(double a, double b)
+{
+    Expansion result;
+    double    difference, error;
+
+    two_sum(a, -b, difference, error);
+
+    result.push(error);
+    result.push(difference);
+
+    return result;
+}
+
+static Expansion grow(const Expansion& e, double b)
+{
+    Expansion result;
+    double    q = b;
+
+    for (uint32_t i = 0; i < e.count; i++)
+    {
+        double error;
+        two_sum(q, e.terms[i], q, error);
+        result.push(error);
+    }
+
+    result.push(q);
+
+    return result;
+}
+
+static Expansion add(const Expansion& e, const Expansion& f)
+{
+    Expansion result = e;
+
+    for (uint32_t i = 0; i < f.count; i++)
+    {
+        result = grow(result, f.terms[i]);
+    }
+
+    return result;
+}
+
+static Expansion negate(Expansion e)
+{
+    for (uint32_t i = 0; i < e.count; i++)
+    {
+        e.terms[i] = -e.terms[i];
+    }
+
+    return e;
+}
+
+static Expansion scale(const Expansion& e, double b)
+{
+    Expansion result;
+
+    if (e.count == 0)
+    {
+        return result;
+    }
+
+    double q, error;
+    two_product(e.terms[0], b, q, error);
+    result.push(error);
+
+    for (uint32_t i = 1; i < e.count; i++)
+    {
+        double product, product_error, sum;
+
+        two_product(e.terms[i], b, product, product_error);
+        two_sum(q, product_error, sum, error);
+        result.push(error);
+        fast_two_sum(product, sum, q, error);
+        result.push(error);
+    }
+
+    result.push(q);
+
+    return result;
+}
+
+static Expansion multiply(const Expansion& e, const Expansion& f)
+{
+    Expansion result;
+
+    for (uint32_t i = 0; i < f.count; i++)
+    {
+        result = add(result, scale(e, f.terms[i]));
+    }
+
+    return result;
+}
+
+
+// -----------------------------------------------------------------------------
+// PREDICATES
+// -----------------------------------------------------------------------------
+
+// Shewchuk's first-stage error bounds, relative to the permanent.
+static const double ORIENT2D_ERROR_BOUND = 3.3306690738754716e-16;
+static const double ORIENT3D_ERROR_BOUND = 7.7715611723761027e-16;
+
+// Orientation tests, filtered: the determinant is computed in doubles, and
+// again exactly only when it's smaller than its rounding error bound. Counts
+// the exact evaluations.
+struct CsgPredicates
+{
+    uint32_t exact = 0;
+
+    // Positive if `c` is to the left of the line from `a` to `b`.
+    int orient2d(const glm::dvec2& a, const glm::dvec2& b, const glm::dvec2& c)
+    {
+        const double left  = (b.x - a.x) * (c.y - a.y);
+        const double right = (b.y - a.y) * (c.x - a.x);
+        const double det   = left - right;
+        const double bound = ORIENT2D_ERROR_BOUND * (fabs(left) + fabs(right));
+
+        if (det > bound || -det > bound)
+        {
+            return det > 0.0 ? 1 : -1;
+        }
+
+        exact++;
+
+        const Expansion ba_x = exact_difference(b.x, a.x);
+        const Expansion ba_y = exact_difference(b.y, a.y);
+        const Expansion ca_x = exact_difference(c.x, a.x);
+        const Expansion ca_y = exact_difference(c.y, a.y);
+
+        return add(multiply(ba_x, ca_y), negate(multiply(ba_y, ca_x))).sign();
+    }
+
+    // Positive if `d` is on the side of the plane through `a`, `b` and `c`
+    // that they're counter-clockwise from.
+    int orient3d(const glm::dvec3& a, const glm::dvec3& b, const glm::dvec3& c, const glm::dvec3& d)
+    {
+        const glm::dvec3 ba = b - a;
+        const glm::dvec3 ca = c - a;
+        const glm::dvec3 da = d - a;
+
+        const double yz = ca.y * da.z, zy = ca.z * da.y;
+        const double zx = ca.z * da.x, xz = ca.x * da.z;
+        const double xy = ca.x * da.y, yx = ca.y * da.x;
+
+        const double det   = ba.x * (yz - zy) + ba.y * (zx - xz) + ba.z * (xy - yx);
+        const double bound = ORIENT3D_ERROR_BOUND * (
+            fabs(ba.x) * (fabs(yz) + fabs(zy)) +
+            fabs(ba.y) * (fabs(zx) + fabs(xz)) +
+            fabs(ba.z) * (fabs(xy) + fabs(yx))
+        );
+
+        if (det > bound || -det > bound)
+        {
+            return det > 0.0 ? 1 : -1;
+        }
+
+        exact++;
+
+        Expansion e_ba[3], e_ca[3], e_da[3];
+
+        for (int i = 0; i < 3; i++)
+        {
+            e_ba[i] = exact_difference(b[i], a[i]);
+            e_ca[i] = exact_difference(c[i], a[i]);
+            e_da[i] = exact_difference(d[i], a[i]);
+        }
+
+        const Expansion minor_x = add(multiply(e_ca[1], e_da[2]), negate(multiply(e_ca[2], e_da[1])));
+        const Expansion minor_y = add(multiply(e_ca[2], e_da[0]), negate(multiply(e_ca[0], e_da[2])));
+        const Expansion minor_z = add(multiply(e_ca[0], e_da[1]), negate(multiply(e_ca[1], e_da[0])));
+
+        return add(add(multiply(e_ba[0], minor_x), multiply(e_ba[1], minor_y)), multiply(e_ba[2], minor_z)).sign();
+    }
+};
+
+
+// -----------------------------------------------------------------------------
+// TRIANGLE PAIRS
+// -----------------------------------------------------------------------------
+
+static const uint32_t CSG_NONE = UINT32_MAX;
+
+// Where the edge of a triangle of one mesh crosses a triangle of the other.
+struct CsgPoint
+{
+    glm::dvec3 position;
+    uint32_t   mesh = 0; // Of the crossing edge.
+    uint32_t   edge = 0; // From vertex `edge` to the next.
+};
+
+// Crossing of two triangles, one of each mesh.
+struct CsgSegment
+{
+    uint32_t triangles[2] = {};
+    CsgPoint points[2];
+};
+
+struct CsgTriangle
+{
+    glm::dvec3 p[3];
+};
+
+static CsgTriangle get_triangle(const Mesh& mesh, uint32_t triangle)
+{
+    const uint32_t* tri = &mesh.indices[triangle * 3];
+
+    return { {
+        glm::dvec3(mesh.position(tri[0])),
+        glm::dvec3(mesh.position(tri[1])),
+        glm::dvec3(mesh.position(tri[2])),
+    } };
+}
+
+static bool less_lexicographic(const glm::dvec3& a, const glm::dvec3& b)
+{
+    return a.x != b.x ? a.x < b.x : (a.y != b.y ? a.y < b.y : a.z < b.z);
+}
+
+// Crossing of the edge from `p` to `q` with the plane of `triangle`. Every
+// triangle sharing the edge gets the same bits, as the endpoints go in a
+// canonical order.
+static glm::dvec3 intersect_edge_plane(glm::dvec3 p, glm::dvec3 q, const CsgTriangle& triangle)
+{
+    if (less_lexicographic(q, p))
+    {
+        std::swap(p, q);
+    }
+
+    const glm::dvec3 normal = glm::cross(triangle.p[1] - triangle.p[0], triangle.p[2] - triangle.p[0]);
+    const double     denom  = glm::dot(normal, q - p);
+    const double     t      = denom != 0.0 ? glm::dot(normal, triangle.p[0] - p) / denom : 0.5;
+
+    return p + (q - p) * std::min(std::max(t, 0.0), 1.0);
+}
+
+// Exact side of a point, with points on the plane counted as in front of it,
+// as if the plane were pushed back a little. Being the same for every query
+// of a given pair, it keeps degenerate contacts consistent.
+static int side_of_plane(CsgPredicates& predicates, const CsgTriangle& triangle, const glm::dvec3& point)
+{
+    return predicates.orient3d(triangle.p[0], triangle.p[1], triangle.p[2], point) >= 0 ? 1 : -1;
+}
+
+// Adds the crossings of the edges of `edges` (of mesh `mesh`), whose vertices
+// are on `sides` of it, with the triangle `other`.
+static void intersect_edges
+(
+    CsgPredicates&     predicates,
+    const CsgTriangle& edges,
+    const int*         sides,
+    const CsgTriangle& other,
+    uint32_t           mesh,
+    CsgPoint*          out_points,
+    uint32_t&          inout_count
+)
+{
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        const uint32_t j = (i + 1) % 3;
+
+        if (sides[i] == sides[j])
+        {
+            continue;
+        }
+
+        // Within the triangle when all three of its edges turn the same way
+        // around the crossing edge; on one of them counts as within.
+        const glm::dvec3& p = edges.p[i];
+        const glm::dvec3& q = edges.p[j];
+
+        const int s0 = predicates.orient3d(p, q, other.p[0], other.p[1]);
+        const int s1 = predicates.orient3d(p, q, other.p[1], other.p[2]);
+        const int s2 = predicates.orient3d(p, q, other.p[2], other.p[0]);
+
+        if ((s0 >= 0 && s1 >= 0 && s2 >= 0) || (s0 <= 0 && s1 <= 0 && s2 <= 0))
+        {
+            out_points[inout_count++] = { intersect_edge_plane(edges.p[i], edges.p[j], other), mesh, i };
+        }
+    }
+}
+
+enum struct CsgPairResult
+{
+    DISJOINT,
+    COPLANAR,
+    CROSSING,
+};
+
+static CsgPairResult intersect_triangles(CsgPredicates& predicates, const CsgTriangle& a, const CsgTriangle& b, CsgSegment& out_segment)
+{
+    int sides_a[3], sides_b[3];
+
+    int on_plane = 0;
+
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        const int side = predicates.orient3d(b.p[0], b.p[1], b.p[2], a.p[i]);
+
+        on_plane  += side == 0;
+        sides_a[i] = side >= 0 ? 1 : -1;
+    }
+
+    if (on_plane == 3)
+    {
+        return CsgPairResult::COPLANAR;
+    }
+
+    if (sides_a[0] == sides_a[1] && sides_a[1] == sides_a[2])
+    {
+        return CsgPairResult::DISJOINT;
+    }
+
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        sides_b[i] = side_of_plane(predicates, a, b.p[i]);
+    }
+
+    if (sides_b[0] == sides_b[1] && sides_b[1] == sides_b[2])
+    {
+        return CsgPairResult::DISJOINT;
+    }
+
+    // Generally two crossings; more when they meet the other triangle's
+    // edges or vertices exactly, then some coincide.
+    CsgPoint points[6];
+    uint32_t count = 0;
+
+    intersect_edges(predicates, a, sides_a, b, 0, points, count);
+    intersect_edges(predicates, b, sides_b, a, 1, points, count);
+
+    if (count < 2)
+    {
+        return CsgPairResult::DISJOINT;
+    }
+
+    // The crossings are on the line common to both planes; the segment spans
+    // the farthest two.
+    const glm::dvec3 direction = glm::cross(
+        glm::cross(a.p[1] - a.p[0], a.p[2] - a.p[0]),
+        glm::cross(b.p[1] - b.p[0], b.p[2] - b.p[0])
+    );
+
+    uint32_t first = 0, last = 0;
+
+    for (uint32_t i = 1; i < count; i++)
+    {
+        const double t = glm::dot(points[i].position, direction);
+
+        first = t < glm::dot(points[first].position, direction) ? i : first;
+        last  = t > glm::dot(points[last ].position, direction) ? i : last;
+    }
+
+    if (points[first].position == points[last].position)
+    {
+        return CsgPairResult::DISJOINT;
+    }
+
+    out_segment.points[0] = points[first];
+    out_segment.points[1] = points[last ];
+
+    return CsgPairResult::CROSSING;
+}
+
+
+// -----------------------------------------------------------------------------
+// TRIANGLE SPLITTING
+// -----------------------------------------------------------------------------
+
+static uint32_t find_root(std::vector<uint32_t>& parents, uint32_t i)
+{
+    while (parents[i] != i)
+    {
+        parents[i] = parents[parents[i]];
+        i          = parents[i];
+    }
+
+    return i;
+}
+
+static void unite(std::vector<uint32_t>& parents, uint32_t a, uint32_t b)
+{
+    a = find_root(parents, a);
+    b = find_root(parents, b);
+
+    if (a != b)
+    {
+        parents[std::max(a, b)] = std::min(a, b);
+    }
+}
+
+// Vertex of a piece: one of the triangle's own, or a new one on a crossing.
+struct CsgPieceVertex
+{
+    glm::dvec3 position;
+    glm::vec3  normal   = glm::vec3(0.0f); // Interpolated, if the mesh has them.
+    uint32_t   original = CSG_NONE;        // Index in the mesh.
+};
+
+// Pieces of a triangle between the same crossings form a region, on one side
+// of the other mesh. Regions with some of the triangle's own vertices take
+// their side; the others, enclosed by crossings or partly on the other mesh,
+// take that of their largest piece's centroid.
+struct CsgPiece
+{
+    CsgPieceVertex vertices[3];
+    uint32_t       triangle = 0;        // That it's a piece of.
+    uint32_t       anchor   = CSG_NONE; // Own vertex of the region, if any.
+    int32_t        leader   = 0;        // Offset to the largest piece of the region, without one.
+};
+
+// Limits the splits of a segment through vertices that are on it.
+static const uint32_t MAX_SEGMENT_DEPTH = 16;
+
+// Triangulates one triangle with the crossing segments as edges, in the plane
+// of the triangle, projected along its dominant axis. Locations are decided
+// with exact predicates on the projected points, so the triangulation stays
+// valid even though the points themselves are rounded.
+struct CsgSplitter
+{
+    struct Vertex
+    {
+        glm::dvec2 uv;
+        glm::dvec3 position;
+        uint32_t   corner = CSG_NONE; // Of the triangle.
+        uint32_t   edges  = 0;        // Bit mask of the triangle's edges it's on.
+    };
+
+    CsgPredicates&          predicates;
+    CsgTriangle             triangle;
+    uint32_t                u_axis = 0;
+    uint32_t                v_axis = 1;
+    std::vector<Vertex>     vertices;
+    std::vector<glm::uvec3> triangles;
+    std::vector<glm::uvec2> constraints; // Edges along crossings.
+
+    CsgSplitter(CsgPredicates& predicates, const CsgTriangle& triangle)
+        : predicates(predicates)
+        , triangle(triangle)
+    {
+    }
+
+    // False for degenerate triangles, which are kept whole.
+    bool init()
+    {
+        const glm::dvec3 normal = glm::cross(triangle.p[1] - triangle.p[0], triangle.p[2] - triangle.p[0]);
+        const glm::dvec3 size   = glm::abs(normal);
+        const uint32_t   axis   = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+
+        if (normal[axis] == 0.0)
+        {
+            return false;
+        }
+
+        // Cyclic, so the triangle projects counter-clockwise.
+        u_axis = (axis + 1) % 3;
+        v_axis = (axis + 2) % 3;
+
+        if (normal[axis] < 0.0)
+        {
+            std::swap(u_axis, v_axis);
+        }
+
+        for (uint32_t i = 0; i < 3; i++)
+        {
+            vertices.push_back({ project(triangle.p[i]), triangle.p[i], i, (1u << i) | (1u << ((i + 2) % 3)) });
+        }
+
+        triangles.push_back({ 0, 1, 2 });
+
+        return true;
+    }
+
+    glm::dvec2 project(const glm::dvec3& position) const
+    {
+        return { position[u_axis], position[v_axis] };
+    }
+
+    int orient(uint32_t a, uint32_t b, uint32_t c)
+    {
+        return predicates.orient2d(vertices[a].uv, vertices[b].uv, vertices[c].uv);
+    }
+
+    uint32_t add_vertex(const glm::dvec2& uv, const glm::dvec3& position, uint32_t edges)
+    {
+        vertices.push_back({ uv, position, CSG_NONE, edges });
+
+        return uint32_t(vertices.size() - 1);
+    }
+
+    // Splits the edge from `a` to `b`, in both of its triangles.
+    void split_edge(uint32_t a, uint32_t b, uint32_t vertex)
+    {
+        const size_t count = triangles.size();
+
+        for (size_t i = 0; i < count; i++)
+        {
+            for (uint32_t k = 0; k < 3; k++)
+            {
+                const uint32_t u = triangles[i][k];
+                const uint32_t w = triangles[i][(k + 1) % 3];
+                const uint32_t x = triangles[i][(k + 2) % 3];
+
+                if ((u == a && w == b) || (u == b && w == a))
+                {
+                    triangles[i] = { u, vertex, x };
+                    triangles.push_back({ vertex, w, x });
+                    break;
+                }
+            }
+        }
+    }
+
+    // Index of the vertex at `position`, inserting it if it's new. `edge` is
+    // the edge of the triangle it's known to be on, if any.
+    uint32_t insert_point(const glm::dvec3& position, uint32_t edge)
+    {
+        for (uint32_t i = 0; i < vertices.size(); i++)
+        {
+            if (vertices[i].position == position)
+            {
+                return i;
+            }
+        }
+
+        const glm::dvec2 uv = project(position);
+
+        if (edge != CSG_NONE)
+        {
+            return insert_on_edge(uv, position, edge);
+        }
+
+        const uint32_t vertex = add_vertex(uv, position, 0);
+
+        for (size_t i = 0; i < triangles.size(); i++)
+        {
+            const glm::uvec3 t = triangles[i];
+
+            const int o0 = orient(t[0], t[1], vertex);
+            const int o1 = orient(t[1], t[2], vertex);
+            const int o2 = orient(t[2], t[0], vertex);
+
+            if (o0 < 0 || o1 < 0 || o2 < 0)
+            {
+                continue;
+            }
+
+            if (o0 > 0 && o1 > 0 && o2 > 0)
+            {
+                triangles[i] = { t[0], t[1], vertex };
+                triangles.push_back({ t[1], t[2], vertex });
+                triangles.push_back({ t[2], t[0], vertex });
+
+                return vertex;
+            }
+
+            // On an edge, or projected onto a vertex, which can only happen
+            // to points rounded off the triangle's plane.
+            if (o0 + o1 + o2 == 1)
+            {
+                vertices.pop_back();
+
+                return o0 > 0 ? t[2] : (o1 > 0 ? t[0] : t[1]);
+            }
+
+            const uint32_t k = o0 == 0 ? 0 : (o1 == 0 ? 1 : 2);
+
+            vertices[vertex].edges = vertices[t[k]].edges & vertices[t[(k + 1) % 3]].edges;
+            split_edge(t[k], t[(k + 1) % 3], vertex);
+
+            return vertex;
+        }
+
+        // Rounded outside of the triangle: onto its nearest boundary edge.
+        uint32_t nearest      = 0;
+        double   nearest_dist = 1e300;
+
+        for (uint32_t i = 0; i < 3; i++)
+        {
+            const glm::dvec2 a = vertices[i].uv;
+            const glm::dvec2 d = vertices[(i + 1) % 3].uv - a;
+            const glm::dvec2 p = uv - a;
+
+            const double cross = d.x * p.y - d.y * p.x;
+            const double dist  = cross * cross / std::max(d.x * d.x + d.y * d.y, 1e-300);
+
+            if (dist < nearest_dist)
+            {
+                nearest      = i;
+                nearest_dist = dist;
+            }
+        }
+
+        vertices.pop_back();
+
+        return insert_on_edge(uv, position, nearest);
+    }
+
+    // Splits the piece of the boundary edge `edge` that `position` is on.
+    uint32_t insert_on_edge(const glm::dvec2& uv, const glm::dvec3& position, uint32_t edge)
+    {
+        const glm::dvec3 origin    = triangle.p[edge];
+        const glm::dvec3 direction = triangle.p[(edge + 1) % 3] - origin;
+        const double     t         = glm::dot(position - origin, direction);
+        const uint32_t   mask      = 1u << edge;
+
+        for (const glm::uvec3& tri : triangles)
+        {
+            for (uint32_t k = 0; k < 3; k++)
+            {
+                const uint32_t a = tri[k];
+                const uint32_t b = tri[(k + 1) % 3];
+
+                if (!(vertices[a].edges & vertices[b].edges & mask))
+                {
+                    continue;
+                }
+
+                const double ta = glm::dot(vertices[a].position - origin, direction);
+                const double tb = glm::dot(vertices[b].position - origin, direction);
+
+                if (t > std::min(ta, tb) && t < std::max(ta, tb))
+                {
+                    const uint32_t vertex = add_vertex(uv, position, mask);
+                    split_edge(a, b, vertex);
+
+                    return vertex;
+                }
+            }
+        }
+
+        // Past the corners, rounded: the nearest one.
+        const glm::dvec3 d0 = position - triangle.p[edge];
+        const glm::dvec3 d1 = position - triangle.p[(edge + 1) % 3];
+
+        return glm::dot(d0, d0) < glm::dot(d1, d1) ? edge : (edge + 1) % 3;
+    }
+
+    bool has_edge(uint32_t a, uint32_t b) const
+    {
+        for (const glm::uvec3& tri : triangles)
+        {
+            for (uint32_t k = 0; k < 3; k++)
+            {
+                if ((tri[k] == a && tri[(k + 1) % 3] == b) || (tri[k] == b && tri[(k + 1) % 3] == a))
+                {
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    // Makes the segment from `a` to `b` a chain of edges: through the vertices
+    // on it, and flipping the edges it crosses (Sloan, A Fast Algorithm for
+    // Generating Constrained Delaunay Triangulations), which adds no vertices,
+    // so the other mesh's pieces along the crossing line up with these.
+    void insert_segment(uint32_t a, uint32_t b, uint32_t depth = 0)
+    {
+        if (a == b || depth > MAX_SEGMENT_DEPTH)
+        {
+            return;
+        }
+
+        if (has_edge(a, b))
+        {
+            constraints.push_back({ a, b });
+
+            return;
+        }
+
+        const glm::dvec2 ab = vertices[b].uv - vertices[a].uv;
+
+        for (uint32_t i = 0; i < vertices.size(); i++)
+        {
+            if (i == a || i == b || orient(a, b, i) != 0)
+            {
+                continue;
+            }
+
+            const glm::dvec2 ai = vertices[i].uv - vertices[a].uv;
+            const glm::dvec2 bi = vertices[i].uv - vertices[b].uv;
+
+            if (ai.x * ab.x + ai.y * ab.y > 0.0 && bi.x * ab.x + bi.y * ab.y < 0.0)
+            {
+                insert_segment(a, i, depth + 1);
+                insert_segment(i, b, depth + 1);
+
+                return;
+            }
+        }
+
+        // Some crossed edge always has a convex quad around it, and every flip
+        // takes a crossing away.
+        const size_t max_flips = triangles.size() * triangles.size() + 16;
+
+        for (size_t flip = 0; flip < max_flips; flip++)
+        {
+            if (has_edge(a, b))
+            {
+                constraints.push_back({ a, b });
+
+                return;
+            }
+
+            if (!flip_crossed_edge(a, b))
+            {
+                return;
+            }
+        }
+    }
+
+    bool is_constrained(uint32_t a, uint32_t b) const
+    {
+        for (const glm::uvec2& edge : constraints)
+        {
+            if ((edge.x == a && edge.y == b) || (edge.x == b && edge.y == a))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Flips one edge crossed by the segment from `a` to `b` whose two
+    // triangles form a convex quad. False if there's none.
+    bool flip_crossed_edge(uint32_t a, uint32_t b)
+    {
+        for (size_t i = 0; i < triangles.size(); i++)
+        {
+            for (uint32_t k = 0; k < 3; k++)
+            {
+                const uint32_t u = triangles[i][k];
+                const uint32_t w = triangles[i][(k + 1) % 3];
+                const uint32_t x = triangles[i][(k + 2) % 3];
+
+                if (u == a || u == b || w == a || w == b)
+                {
+                    continue;
+                }
+
+                if (orient(a, b, u) * orient(a, b, w) >= 0 || orient(u, w, a) * orient(u, w, b) >= 0)
+                {
+                    continue;
+                }
+
+                for (size_t j = 0; j < triangles.size(); j++)
+                {
+                    for (uint32_t l = 0; l < 3; l++)
+                    {
+                        if (triangles[j][l] != w || triangles[j][(l + 1) % 3] != u)
+                        {
+                            continue;
+                        }
+
+                        const uint32_t y = triangles[j][(l + 2) % 3];
+
+                        if (orient(x, y, u) * orient(x, y, w) >= 0)
+                        {
+                            continue;
+                        }
+
+                        triangles[i] = { u, y, x };
+                        triangles[j] = { y, w, x };
+
+                        return true;
+                    }
+                }
+            }
+        }
+
+        return false;
+    }
+};
+
+// Crossings of one triangle, as segments between its points.
+struct CsgTriangleCuts
+{
+    uint32_t triangle = 0;
+    uint32_t first    = 0; // In the segment list of its mesh.
+    uint32_t count    = 0;
+};
+
+static void split_triangle
+(
+    CsgPredicates&                 predicates,
+    const Mesh&                    mesh,
+    uint32_t                       side,
+    const CsgTriangleCuts&         cuts,
+    const std::vector<CsgSegment>& segments,
+    const std::vector<uint32_t>&   segment_indices,
+    bool                           coplanar,
+    bool                           with_normals,
+    std::vector<CsgPiece>&         out_pieces
+)
+{
+    const CsgTriangle triangle = get_triangle(mesh, cuts.triangle);
+    const uint32_t*   tri      = &mesh.indices[cuts.triangle * 3];
+
+    CsgSplitter splitter(predicates, triangle);
+
+    if (splitter.init())
+    {
+        for (uint32_t i = 0; i < cuts.count; i++)
+        {
+            const CsgSegment& segment = segments[segment_indices[cuts.first + i]];
+            uint32_t          ends[2];
+
+            for (uint32_t k = 0; k < 2; k++)
+            {
+                const CsgPoint& point = segment.points[k];
+
+                ends[k] = splitter.insert_point(point.position, point.mesh == side ? point.edge : CSG_NONE);
+            }
+
+            splitter.insert_segment(ends[0], ends[1]);
+        }
+    }
+    else
+    {
+        splitter.triangles.push_back({ 0, 1, 2 });
+
+        for (uint32_t i = 0; i < 3; i++)
+        {
+            splitter.vertices.push_back({ {}, triangle.p[i], i, 0 });
+        }
+    }
+
+    // Barycentric weights, for the normals of the new vertices.
+    const glm::dvec2 e1    = splitter.project(triangle.p[1] - triangle.p[0]);
+    const glm::dvec2 e2    = splitter.project(triangle.p[2] - triangle.p[0]);
+    const double     denom = e1.x * e2.y - e1.y * e2.x;
+
+    std::vector<CsgPieceVertex> vertices(splitter.vertices.size());
+
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        const CsgSplitter::Vertex& vertex = splitter.vertices[i];
+        CsgPieceVertex&            out    = vertices[i];
+
+        out.position = vertex.position;
+        out.original = vertex.corner != CSG_NONE ? tri[vertex.corner] : CSG_NONE;
+
+        if (!with_normals)
+        {
+            continue;
+        }
+
+        if (out.original != CSG_NONE)
+        {
+            out.normal = { mesh.normal_x[out.original], mesh.normal_y[out.original], mesh.normal_z[out.original] };
+            continue;
+        }
+
+        const glm::dvec2 p  = splitter.project(vertex.position - triangle.p[0]);
+        const double     w1 = denom != 0.0 ? (p.x * e2.y - p.y * e2.x) / denom : 0.0;
+        const double     w2 = denom != 0.0 ? (e1.x * p.y - e1.y * p.x) / denom : 0.0;
+        const double     w0 = 1.0 - w1 - w2;
+
+        glm::vec3 normal(0.0f);
+
+        for (uint32_t k = 0; k < 3; k++)
+        {
+            const float weight = float(k == 0 ? w0 : (k == 1 ? w1 : w2));
+
+            normal += glm::vec3(mesh.normal_x[tri[k]], mesh.normal_y[tri[k]], mesh.normal_z[tri[k]]) * weight;
+        }
+
+        const float length = sqrtf(glm::dot(normal, normal));
+
+        out.normal = length > 0.0f ? normal / length : normal;
+    }
+
+    // Regions: pieces joined through their edges off the crossings.
+    const std::vector<glm::uvec3>& pieces = splitter.triangles;
+    const uint32_t                 count  = uint32_t(pieces.size());
+
+    std::vector<uint32_t> regions(count);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        regions[i] = i;
+
+        for (uint32_t j = 0; j < i; j++)
+        {
+            for (uint32_t k = 0; k < 3; k++)
+            {
+                const uint32_t u = pieces[i][k];
+                const uint32_t w = pieces[i][(k + 1) % 3];
+
+                const bool shared = (pieces[j][0] == w && pieces[j][1] == u)
+                                 || (pieces[j][1] == w && pieces[j][2] == u)
+                                 || (pieces[j][2] == w && pieces[j][0] == u);
+
+                if (shared && !splitter.is_constrained(u, w))
+                {
+                    unite(regions, i, j);
+                }
+            }
+        }
+    }
+
+    std::vector<uint32_t> anchors(count, CSG_NONE);
+    std::vector<uint32_t> leaders(count, CSG_NONE);
+    std::vector<double>   areas  (count, 0.0);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const uint32_t region = find_root(regions, i);
+
+        for (uint32_t k = 0; k < 3; k++)
+        {
+            if (vertices[pieces[i][k]].original != CSG_NONE)
+            {
+                anchors[region] = vertices[pieces[i][k]].original;
+            }
+        }
+
+        const glm::dvec2 e1 = splitter.vertices[pieces[i][1]].uv - splitter.vertices[pieces[i][0]].uv;
+        const glm::dvec2 e2 = splitter.vertices[pieces[i][2]].uv - splitter.vertices[pieces[i][0]].uv;
+
+        areas[i] = e1.x * e2.y - e1.y * e2.x;
+
+        if (leaders[region] == CSG_NONE || areas[i] > areas[leaders[region]])
+        {
+            leaders[region] = i;
+        }
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const uint32_t region = find_root(regions, i);
+
+        CsgPiece piece;
+        piece.triangle = cuts.triangle;
+        piece.anchor   = coplanar ? CSG_NONE : anchors[region];
+        piece.leader   = int32_t(leaders[region]) - int32_t(i);
+
+        for (uint32_t k = 0; k < 3; k++)
+        {
+            piece.vertices[k] = vertices[pieces[i][k]];
+        }
+
+        out_pieces.push_back(piece);
+    }
+}
+
+
+// -----------------------------------------------------------------------------
+// CLASSIFICATION
+// -----------------------------------------------------------------------------
+
+enum struct CsgClass : uint8_t
+{
+    OUTSIDE,
+    INSIDE,
+    SAME,     // On the other mesh, facing the same way.
+    OPPOSITE, // On the other mesh, facing the other way.
+};
+
+static glm::vec3 to_vec3(const glm::dvec3& v)
+{
+    return { float(v.x), float(v.y), float(v.z) };
+}
+
+static glm::vec3 face_normal(const Mesh& mesh, uint32_t triangle)
+{
+    const uint32_t* tri = &mesh.indices[triangle * 3];
+    const glm::vec3 p0  = mesh.position(tri[0]);
+
+    return glm::cross(mesh.position(tri[1]) - p0, mesh.position(tri[2]) - p0);
+}
+
+// Inside when the nearest surface along a ray is seen from behind. Skewed so
+// that rays rarely graze edges of axis-aligned models. Points within
+// `tolerance` of the other mesh are on it instead, when it's `normal` that
+// tells.
+static CsgClass classify_point(const Mesh& mesh, const Bvh& bvh, const glm::vec3& point, const glm::vec3* normal, float tolerance)
+{
+    if (normal)
+    {
+        const ClosestPoint closest = bvh.closest_point(mesh, point, tolerance);
+
+        if (closest.found())
+        {
+            return glm::dot(face_normal(mesh, closest.primitive), *normal) > 0.0f ? CsgClass::SAME : CsgClass::OPPOSITE;
+        }
+    }
+
+    const Ray    ray = { point, glm::vec3(0.5469f, 0.6543f, 0.5222f) };
+    const RayHit hit = bvh.ray_cast(mesh, ray);
+
+    return hit.hit() && glm::dot(face_normal(mesh, hit.primitive), ray.direction) > 0.0f ? CsgClass::INSIDE : CsgClass::OUTSIDE;
+}
+
+// Pieces of one mesh and where they are relative to the other. Its own
+// vertices are joined through the triangles and regions off the crossings, and
+// each group is classified by a ray cast from the centroid of one of its
+// triangles; vertices themselves can be on the other mesh. Triangles that
+// overlap some of the other mesh in a common plane, and regions without own
+// vertices, are classified one by one.
+struct CsgSide
+{
+    const Mesh*                  mesh = nullptr;
+    std::vector<CsgTriangleCuts> cuts;
+    std::vector<uint32_t>        segment_indices;
+    std::vector<uint8_t>         is_split;
+    std::vector<uint8_t>         is_coplanar;
+    std::vector<CsgPiece>        pieces;
+    std::vector<CsgClass>        vertex_classes;   // Of the groups' vertices.
+    std::vector<CsgClass>        triangle_classes; // Of the coplanar triangles.
+    std::vector<CsgClass>        piece_classes;
+};
+
+static uint32_t classify(CsgSide& side, const Mesh& other, const Bvh& other_bvh, float tolerance, const TaskCancel* cancel)
+{
+    const Mesh&    mesh           = *side.mesh;
+    const uint32_t vertex_count   = mesh.vertex_count();
+    const uint32_t triangle_count = mesh.triangle_count();
+
+    std::vector<uint32_t> parents(vertex_count);
+
+    for (uint32_t i = 0; i < vertex_count; i++)
+    {
+        parents[i] = i;
+    }
+
+    std::vector<uint32_t> lone_triangles;
+    std::vector<uint32_t> lone_pieces;
+
+    for (uint32_t i = 0; i < triangle_count; i++)
+    {
+        if (side.is_split[i])
+        {
+            continue;
+        }
+
+        if (side.is_coplanar[i])
+        {
+            lone_triangles.push_back(i);
+            continue;
+        }
+
+        const uint32_t* tri = &mesh.indices[i * 3];
+
+        unite(parents, tri[0], tri[1]);
+        unite(parents, tri[0], tri[2]);
+    }
+
+    for (uint32_t i = 0; i < side.pieces.size(); i++)
+    {
+        const CsgPiece& piece = side.pieces[i];
+
+        if (piece.anchor == CSG_NONE)
+        {
+            if (piece.leader == 0)
+            {
+                lone_pieces.push_back(i);
+            }
+
+            continue;
+        }
+
+        for (const CsgPieceVertex& vertex : piece.vertices)
+        {
+            if (vertex.original != CSG_NONE)
+            {
+                unite(parents, piece.anchor, vertex.original);
+            }
+        }
+    }
+
+    // A centroid per group, preferably of a whole triangle, as pieces can be
+    // slivers along the crossings.
+    std::vector<uint32_t>  roots;
+    std::vector<uint32_t>  root_groups(vertex_count, CSG_NONE);
+    std::vector<glm::vec3> samples;
+    std::vector<float>     sample_areas;
+
+    const auto sample = [&](uint32_t vertex, const glm::vec3& centroid, float area)
+    {
+        const uint32_t root = find_root(parents, vertex);
+
+        if (root_groups[root] == CSG_NONE)
+        {
+            root_groups[root] = uint32_t(roots.size());
+            roots       .push_back(root);
+            samples     .push_back(centroid);
+            sample_areas.push_back(area);
+        }
+        else if (area > sample_areas[root_groups[root]])
+        {
+            samples     [root_groups[root]] = centroid;
+            sample_areas[root_groups[root]] = area;
+        }
+    };
+
+    for (uint32_t i = 0; i < triangle_count; i++)
+    {
+        if (side.is_split[i] || side.is_coplanar[i])
+        {
+            continue;
+        }
+
+        const uint32_t* tri = &mesh.indices[i * 3];
+
+        if (root_groups[find_root(parents, tri[0])] == CSG_NONE)
+        {
+            sample(tri[0], (mesh.position(tri[0]) + mesh.position(tri[1]) + mesh.position(tri[2])) / 3.0f, 1e30f);
+        }
+    }
+
+    for (const CsgPiece& piece : side.pieces)
+    {
+        if (piece.anchor != CSG_NONE)
+        {
+            const glm::dvec3 centroid = (piece.vertices[0].position + piece.vertices[1].position + piece.vertices[2].position) / 3.0;
+            const glm::dvec3 cross    = glm::cross(piece.vertices[1].position - piece.vertices[0].position, piece.vertices[2].position - piece.vertices[0].position);
+
+            sample(piece.anchor, to_vec3(centroid), float(glm::dot(cross, cross)));
+        }
+    }
+
+    std::vector<CsgClass> group_classes(roots.size());
+
+    side.vertex_classes  .assign(vertex_count, CsgClass::OUTSIDE);
+    side.triangle_classes.assign(triangle_count, CsgClass::OUTSIDE);
+    side.piece_classes   .assign(side.pieces.size(), CsgClass::OUTSIDE);
+
+    parallel_for(0, uint32_t(roots.size()), 64, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t i = begin; i < end && !task_cancelled(cancel); i++)
+        {
+            group_classes[i] = classify_point(other, other_bvh, samples[i], nullptr, tolerance);
+        }
+    });
+
+    parallel_for(0, uint32_t(lone_triangles.size()), 64, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t i = begin; i < end && !task_cancelled(cancel); i++)
+        {
+            const uint32_t* tri    = &mesh.indices[lone_triangles[i] * 3];
+            const glm::vec3 normal = face_normal(mesh, lone_triangles[i]);
+
+            side.triangle_classes[lone_triangles[i]] = classify_point(other, other_bvh,
+                (mesh.position(tri[0]) + mesh.position(tri[1]) + mesh.position(tri[2])) / 3.0f, &normal, tolerance);
+        }
+    });
+
+    parallel_for(0, uint32_t(lone_pieces.size()), 64, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t i = begin; i < end && !task_cancelled(cancel); i++)
+        {
+            const CsgPiece&  piece    = side.pieces[lone_pieces[i]];
+            const glm::dvec3 centroid = (piece.vertices[0].position + piece.vertices[1].position + piece.vertices[2].position) / 3.0;
+            const glm::vec3  normal   = face_normal(mesh, piece.triangle);
+
+            side.piece_classes[lone_pieces[i]] = classify_point(other, other_bvh, to_vec3(centroid), &normal, tolerance);
+        }
+    });
+
+    for (uint32_t i = 0; i < vertex_count; i++)
+    {
+        const uint32_t group = root_groups[find_root(parents, i)];
+
+        if (group != CSG_NONE)
+        {
+            side.vertex_classes[i] = group_classes[group];
+        }
+    }
+
+    for (uint32_t i = 0; i < side.pieces.size(); i++)
+    {
+        const CsgPiece& piece = side.pieces[i];
+
+        side.piece_classes[i] = piece.anchor != CSG_NONE
+            ? side.vertex_classes[piece.anchor]
+            : side.piece_classes[i + piece.leader];
+    }
+
+    return uint32_t(roots.size() + lone_triangles.size() + lone_pieces.size());
+}
+
+
+// -----------------------------------------------------------------------------
+// BOOLEANS
+// -----------------------------------------------------------------------------
+
+// Whether a part of side `side` (0 for the first mesh) that is `where` relative
+// to the other mesh is in the result. Of surfaces on both meshes, the first
+// mesh's copy stands for both.
+static bool keep(CsgOperation operation, uint32_t side, CsgClass where)
+{
+    switch (where)
+    {
+    case CsgClass::OUTSIDE:
+        return operation == CsgOperation::UNION || (operation == CsgOperation::DIFFERENCE && side == 0);
+
+    case CsgClass::INSIDE:
+        return operation == CsgOperation::INTERSECTION || (operation == CsgOperation::DIFFERENCE && side == 1);
+
+    case CsgClass::SAME:
+        return side == 0 && operation != CsgOperation::DIFFERENCE;
+
+    case CsgClass::OPPOSITE:
+        return side == 0 && operation == CsgOperation::DIFFERENCE;
+    }
+
+    return false;
+}
+
+// New vertices are merged by position and normal, so pieces of one triangle,
+// and of neighbors across an edge, share them.
+struct CsgVertexKey
+{
+    double x, y, z;
+    float  nx, ny, nz;
+
+    // Bitwise, like the hash, member by member: the struct's trailing padding
+    // is indeterminate.
+    bool operator==(const CsgVertexKey& other) const
+    {
+        return memcmp(&x , &other.x , sizeof(double) * 3) == 0
+            && memcmp(&nx, &other.nx, sizeof(float ) * 3) == 0;
+    }
+};
+
+struct CsgVertexKeyHash
+{
+    size_t operator()(const CsgVertexKey& key) const
+    {
+        uint64_t words[3];
+        memcpy(words, &key.x, sizeof(words));
+
+        uint64_t hash = words[0] * 0x9e3779b97f4a7c15ull;
+        hash = (hash ^ words[1]) * 0x9e3779b97f4a7c15ull;
+        hash = (hash ^ words[2]) * 0x9e3779b97f4a7c15ull;
+
+        return size_t(hash ^ (hash >> 32));
+    }
+};
+
+static const uint32_t CSG_PAIR_GRAIN  = 4096;
+static const uint32_t CSG_PIECE_GRAIN = 256;
+
+// Groups the segments by the triangle of side `index` they cross.
+static void gather_cuts(CsgSide& side, uint32_t index, const std::vector<CsgSegment>& segments)
+{
+    const uint32_t triangle_count = side.mesh->triangle_count();
+
+    std::vector<uint32_t> counts(triangle_count + 1, 0);
+
+    for (const CsgSegment& segment : segments)
+    {
+        counts[segment.triangles[index] + 1]++;
+    }
+
+    for (uint32_t i = 0; i < triangle_count; i++)
+    {
+        counts[i + 1] += counts[i];
+    }
+
+    side.segment_indices.resize(segments.size());
+    side.is_split.assign(triangle_count, 0);
+
+    std::vector<uint32_t> offsets(counts.begin(), counts.end() - 1);
+
+    for (uint32_t i = 0; i < segments.size(); i++)
+    {
+        side.segment_indices[offsets[segments[i].triangles[index]]++] = i;
+    }
+
+    for (uint32_t i = 0; i < triangle_count; i++)
+    {
+        if (counts[i + 1] > counts[i])
+        {
+            side.cuts.push_back({ i, counts[i], counts[i + 1] - counts[i] });
+            side.is_split[i] = 1;
+        }
+    }
+}
+
+// Splits the crossed triangles of one side, in parallel.
+static void split_side(CsgSide& side, uint32_t index, const std::vector<CsgSegment>& segments, bool with_normals, uint32_t& inout_exact, const TaskCancel* cancel)
+{
+    const uint32_t                     chunk_count = (uint32_t(side.cuts.size()) + CSG_PIECE_GRAIN - 1) / CSG_PIECE_GRAIN;
+    std::vector<std::vector<CsgPiece>> chunk_pieces(chunk_count);
+    std::vector<uint32_t>              chunk_exact (chunk_count, 0);
+
+    parallel_for(0, uint32_t(side.cuts.size()), CSG_PIECE_GRAIN, [&](uint32_t begin, uint32_t end)
+    {
+        if (task_cancelled(cancel))
+        {
+            return;
+        }
+
+        CsgPredicates predicates;
+
+        for (uint32_t i = begin; i < end; i++)
+        {
+            const CsgTriangleCuts& cuts = side.cuts[i];
+
+            split_triangle(predicates, *side.mesh, index, cuts, segments, side.segment_indices,
+                side.is_coplanar[cuts.triangle], with_normals, chunk_pieces[begin / CSG_PIECE_GRAIN]);
+        }
+
+        chunk_exact[begin / CSG_PIECE_GRAIN] = predicates.exact;
+    });
+
+    for (uint32_t i = 0; i < chunk_count; i++)
+    {
+        side.pieces.insert(side.pieces.end(), chunk_pieces[i].begin(), chunk_pieces[i].end());
+        inout_exact += chunk_exact[i];
+    }
+}
+
+// Appends the kept triangles and pieces of one side to the output, flipped
+// for the second mesh's inside in differences.
+static void emit_side(const CsgSide& side, uint32_t index, CsgOperation operation, bool with_normals, Mesh& out_mesh)
+{
+    const Mesh& mesh = *side.mesh;
+    const bool  flip = operation == CsgOperation::DIFFERENCE && index == 1;
+    const float sign = flip ? -1.0f : 1.0f;
+
+    std::vector<uint32_t>                                        remap(mesh.vertex_count(), CSG_NONE);
+    std::unordered_map<CsgVertexKey, uint32_t, CsgVertexKeyHash> new_vertices;
+
+    const auto add_vertex = [&](const glm::vec3& position, const glm::vec3& normal)
+    {
+        const uint32_t vertex = out_mesh.add_vertex(position);
+
+        if (with_normals)
+        {
+            out_mesh.normal_x.push_back(normal.x * sign);
+            out_mesh.normal_y.push_back(normal.y * sign);
+            out_mesh.normal_z.push_back(normal.z * sign);
+        }
+
+        return vertex;
+    };
+
+    const auto original_vertex = [&](uint32_t vertex)
+    {
+        if (remap[vertex] == CSG_NONE)
+        {
+            remap[vertex] = add_vertex(
+                mesh.position(vertex),
+                with_normals ? glm::vec3(mesh.normal_x[vertex], mesh.normal_y[vertex], mesh.normal_z[vertex]) : glm::vec3(0.0f)
+            );
+        }
+
+        return remap[vertex];
+    };
+
+    const auto add_triangle = [&](uint32_t a, uint32_t b, uint32_t c)
+    {
+        if (flip)
+        {
+            std::swap(b, c);
+        }
+
+        out_mesh.add_triangle(a, b, c);
+    };
+
+    for (uint32_t i = 0; i < mesh.triangle_count(); i++)
+    {
+        const uint32_t* tri   = &mesh.indices[i * 3];
+        const CsgClass  where = side.is_coplanar[i] ? side.triangle_classes[i] : side.vertex_classes[tri[0]];
+
+        if (!side.is_split[i] && keep(operation, index, where))
+        {
+            add_triangle(original_vertex(tri[0]), original_vertex(tri[1]), original_vertex(tri[2]));
+        }
+    }
+
+    for (size_t i = 0; i < side.pieces.size(); i++)
+    {
+        if (!keep(operation, index, side.piece_classes[i]))
+        {
+            continue;
+        }
+
+        uint32_t vertices[3];
+
+        for (uint32_t k = 0; k < 3; k++)
+        {
+            const CsgPieceVertex& vertex = side.pieces[i].vertices[k];
+
+            if (vertex.original != CSG_NONE)
+            {
+                vertices[k] = original_vertex(vertex.original);
+                continue;
+            }
+
+            const CsgVertexKey key = { vertex.position.x, vertex.position.y, vertex.position.z, vertex.normal.x, vertex.normal.y, vertex.normal.z };
+            const auto         it  = new_vertices.find(key);
+
+            if (it != new_vertices.end())
+            {
+                vertices[k] = it->second;
+                continue;
+            }
+
+            vertices[k] = add_vertex(to_vec3(vertex.position), vertex.normal);
+            new_vertices.emplace(key, vertices[k]);
+        }
+
+        // Rounding to floats can collapse slivers along the crossings.
+        if (vertices[0] != vertices[1] && vertices[1] != vertices[2] && vertices[2] != vertices[0])
+        {
+            add_triangle(vertices[0], vertices[1], vertices[2]);
+        }
+    }
+}
+
+CsgStats mesh_boolean(const Mesh& a, const Mesh& b, CsgOperation operation, Mesh& out_mesh, const TaskCancel* cancel)
+{
+    CsgStats stats;
+
+    out_mesh.clear();
+
+    std::vector<Aabb> bounds_a, bounds_b;
+    compute_triangle_bounds(a, bounds_a);
+    compute_triangle_bounds(b, bounds_b);
+
+    Bvh bvh_a, bvh_b;
+    bvh_a.build(bounds_a.data(), uint32_t(bounds_a.size()));
+    bvh_b.build(bounds_b.data(), uint32_t(bounds_b.size()));
+
+    std::vector<glm::uvec2> pairs;
+    bvh_a.find_overlaps(bvh_b, bounds_a.data(), bounds_b.data(), pairs);
+
+    stats.candidate_pairs = pairs.size();
+
+    // Crossings of the candidate pairs, in parallel, compacted by chunk.
+    const uint32_t chunk_count = (uint32_t(pairs.size()) + CSG_PAIR_GRAIN - 1) / CSG_PAIR_GRAIN;
+
+    std::vector<std::vector<CsgSegment>> chunk_segments(chunk_count);
+    std::vector<std::vector<glm::uvec2>> chunk_coplanar(chunk_count);
+    std::vector<uint32_t>                chunk_exact   (chunk_count, 0);
+
+    parallel_for(0, uint32_t(pairs.size()), CSG_PAIR_GRAIN, [&](uint32_t begin, uint32_t end)
+    {
+        const uint32_t chunk = begin / CSG_PAIR_GRAIN;
+
+        if (task_cancelled(cancel))
+        {
+            return;
+        }
+
+        CsgPredicates predicates;
+
+        for (uint32_t i = begin; i < end; i++)
+        {
+            CsgSegment segment;
+            segment.triangles[0] = pairs[i].x;
+            segment.triangles[1] = pairs[i].y;
+
+            const CsgPairResult result = intersect_triangles(predicates, get_triangle(a, pairs[i].x), get_triangle(b, pairs[i].y), segment);
+
+            if (result == CsgPairResult::CROSSING)
+            {
+                chunk_segments[chunk].push_back(segment);
+            }
+            else if (result == CsgPairResult::COPLANAR)
+            {
+                chunk_coplanar[chunk].push_back(pairs[i]);
+            }
+        }
+
+        chunk_exact[chunk] = predicates.exact;
+    });
+
+    // Some chunks may be missing.
+    if (task_cancelled(cancel))
+    {
+        return CsgStats();
+    }
+
+    CsgSide sides[2];
+    sides[0].mesh = &a;
+    sides[1].mesh = &b;
+    sides[0].is_coplanar.assign(a.triangle_count(), 0);
+    sides[1].is_coplanar.assign(b.triangle_count(), 0);
+
+    std::vector<CsgSegment> segments;
+
+    for (uint32_t i = 0; i < chunk_count; i++)
+    {
+        segments.insert(segments.end(), chunk_segments[i].begin(), chunk_segments[i].end());
+
+        for (const glm::uvec2& pair : chunk_coplanar[i])
+        {
+            sides[0].is_coplanar[pair.x] = 1;
+            sides[1].is_coplanar[pair.y] = 1;
+        }
+
+        stats.coplanar_pairs   += uint32_t(chunk_coplanar[i].size());
+        stats.exact_predicates += chunk_exact[i];
+    }
+
+    stats.intersecting_pairs = uint32_t(segments.size());
+
+    // Split and classify both sides. Centroids closer to the other mesh than
+    // the rounding of the coordinates are on it.
+    const bool with_normals = a.has_normals() && b.has_normals();
+
+    Aabb bounds = bvh_a.bounds;
+    bounds.extend(bvh_b.bounds);
+
+    const glm::vec3 extent    = bounds.extent();
+    const float     tolerance = std::max(extent.x, std::max(extent.y, extent.z)) * 1e-6f;
+
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        gather_cuts(sides[i], i, segments);
+        split_side (sides[i], i, segments, with_normals, stats.exact_predicates, cancel);
+
+        stats.split_triangles += uint32_t(sides[i].cuts.size());
+    }
+
+    if (task_cancelled(cancel))
+    {
+        return CsgStats();
+    }
+
+    stats.classified += classify(sides[0], b, bvh_b, tolerance, cancel);
+    stats.classified += classify(sides[1], a, bvh_a, tolerance, cancel);
+
+    if (task_cancelled(cancel))
+    {
+        return CsgStats();
+    }
+
+    emit_side(sides[0], 0, operation, with_normals, out_mesh);
+    emit_side(sides[1], 1, operation, with_normals, out_mesh);
+
+    return stats;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h> // uint*_t
+
+#include "mesh.h"   // Mesh
+
+struct TaskCancel;
+
+
+// -----------------------------------------------------------------------------
+// MESH BOOLEANS
+// -----------------------------------------------------------------------------
+
+enum struct CsgOperation
+{
+    UNION,
+    DIFFERENCE,   // The first mesh minus the second.
+    INTERSECTION,
+};
+
+struct CsgStats
+{
+    uint64_t candidate_pairs    = 0; // Triangle pairs with overlapping bounds.
+    uint32_t intersecting_pairs = 0; // Crossing each other.
+    uint32_t coplanar_pairs     = 0; // Overlapping in a common plane, not split.
+    uint32_t split_triangles    = 0; // Of both meshes.
+    uint32_t exact_predicates   = 0; // That the floating-point filter couldn't decide.
+    uint32_t classified         = 0; // Regions and triangles located by a query.
+};
+
+// Boolean of two closed, consistently oriented (counter-clockwise from the
+// outside) meshes without self-intersections, in `out_mesh`.
+//
+// Candidate triangle pairs come from the bounding volume hierarchies of both
+// meshes. Whether and where two triangles cross is decided by orientation
+// predicates, evaluated in floating point and only redone exactly when the
+// rounding error could flip their sign, so the decisions are always
+// consistent; the crossing points themselves are rounded. Crossed triangles
+// are split along the crossings in parallel, then the pieces are classified
+// as inside or outside of the other mesh by region, a ray cast per region.
+// Triangles lying on the other mesh are classified one by one, and kept from
+// the first mesh only, when facing the right way for the operation.
+//
+// Normals are interpolated if both meshes have them; vertex colors are
+// dropped. Faces that partly overlap in a common plane aren't split against
+// each other, which leaves cracks along the overlap; move one of the meshes
+// slightly off it instead.
+//
+// Stops between chunks of pairs, pieces and queries once `cancel` is
+// requested, leaving the mesh empty.
+CsgStats mesh_boolean(const Mesh& a, const Mesh& b, CsgOperation operation, Mesh& out_mesh, const TaskCancel* cancel = nullptr);
@@ -0,0 +1,361 @@
+#include "culling.h"
+
+#include <assert.h>       // assert
+
+#include <bx/platform.h>  // BX_CPU_X86
+
+#if BX_CPU_X86
+#   include <emmintrin.h> // _mm_*
+#endif
+
+#include "bvh.h"          // Bvh
+
+
+// -----------------------------------------------------------------------------
+// VIEW FRUSTUM
+// -----------------------------------------------------------------------------
+
+Frustum Frustum::from_matrix(const glm::mat4& m)
+{
+    // Rows of the (column-major) matrix.
+    const glm::vec4 r0 = { m[0][0], m[1][0], m[2][0], m[3][0] };
+    const glm::vec4 r1 = { m[0][1], m[1][1], m[2][1], m[3][1] };
+    const glm::vec4 r2 = { m[0][2], m[1][2], m[2][2], m[3][2] };
+    const glm::vec4 r3 = { m[0][3], m[1][3], m[2][3], m[3][3] };
+
+    Frustum frustum;
+    frustum.planes[0] = r3 + r0;
+    frustum.planes[1] = r3 - r0;
+    frustum.planes[2] = r3 + r1;
+    frustum.planes[3] = r3 - r1;
+    frustum.planes[4] = r3 + r2;
+    frustum.planes[5] = r3 - r2;
+
+    for (glm::vec4& plane : frustum.planes)
+    {
+        plane = plane / glm::length(glm::vec3(plane));
+    }
+
+    return frustum;
+}
+
+
+// -----------------------------------------------------------------------------
+// OBJECT BOUNDS
+// -----------------------------------------------------------------------------
+
+void ObjectBounds::add(const Aabb& aabb)
+{
+    const glm::vec3 center = aabb.center();
+
+    min_x   .push_back(aabb.min.x);
+    min_y   .push_back(aabb.min.y);
+    min_z   .push_back(aabb.min.z);
+    max_x   .push_back(aabb.max.x);
+    max_y   .push_back(aabb.max.y);
+    max_z   .push_back(aabb.max.z);
+    center_x.push_back(center.x);
+    center_y.push_back(center.y);
+    center_z.push_back(center.z);
+    radius  .push_back(glm::length(aabb.extent()) * 0.5f);
+}
+
+void ObjectBounds::clear()
+{
+    min_x   .clear();
+    min_y   .clear();
+    min_z   .clear();
+    max_x   .clear();
+    max_y   .clear();
+    max_z   .clear();
+    center_x.clear();
+    center_y.clear();
+    center_z.clear();
+    radius  .clear();
+}
+
+
+// -----------------------------------------------------------------------------
+// FLAT CULLING
+// -----------------------------------------------------------------------------
+
+// Branchless compaction of the set bits of a four-lane mask.
+static uint32_t append_mask(uint32_t mask, uint32_t base, uint32_t* out, uint32_t count)
+{
+    for (uint32_t j = 0; j < 4; j++)
+    {
+        out[count] = base + j;
+        count     += (mask >> j) & 1;
+    }
+
+    return count;
+}
+
+// Reserves room for every object, so the kernels can write unconditionally.
+// Three extra entries absorb the compaction's speculative writes.
+static uint32_t* reserve_output(std::vector<uint32_t>& out_visible, uint32_t count, size_t& first)
+{
+    first = out_visible.size();
+    out_visible.resize(first + count + 3);
+
+    return out_visible.data() + first;
+}
+
+static CullStats finish_output(std::vector<uint32_t>& out_visible, size_t first, uint32_t count, uint32_t visible)
+{
+    out_visible.resize(first + visible);
+
+    return { visible, count - visible };
+}
+
+static bool sphere_visible(const Frustum& frustum, const ObjectBounds& bounds, uint32_t i)
+{
+    for (const glm::vec4& p : frustum.planes)
+    {
+        if (p.x * bounds.center_x[i] + p.y * bounds.center_y[i] + p.z * bounds.center_z[i] + p.w < -bounds.radius[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Tests the box corner farthest along each plane normal (the "positive vertex").
+static bool aabb_visible(const Frustum& frustum, const Aabb& aabb)
+{
+    for (const glm::vec4& p : frustum.planes)
+    {
+        const float x = p.x >= 0.0f ? aabb.max.x : aabb.min.x;
+        const float y = p.y >= 0.0f ? aabb.max.y : aabb.min.y;
+        const float z = p.z >= 0.0f ? aabb.max.z : aabb.min.z;
+
+        if (p.x * x + p.y * y + p.z * z + p.w < 0.0f)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+CullStats cull_spheres(const Frustum& frustum, const ObjectBounds& bounds, std::vector<uint32_t>& out_visible)
+{
+    const uint32_t count = bounds.size();
+    size_t         first;
+    uint32_t*      out     = reserve_output(out_visible, count, first);
+    uint32_t       visible = 0;
+    uint32_t       i       = 0;
+
+#if BX_CPU_X86
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 cx    = _mm_loadu_ps(&bounds.center_x[i]);
+        const __m128 cy    = _mm_loadu_ps(&bounds.center_y[i]);
+        const __m128 cz    = _mm_loadu_ps(&bounds.center_z[i]);
+        const __m128 neg_r = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&bounds.radius[i]));
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+        for (const glm::vec4& p : frustum.planes)
+        {
+            const __m128 d = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.x), cx), _mm_mul_ps(_mm_set1_ps(p.y), cy)),
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.z), cz), _mm_set1_ps(p.w))
+            );
+
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, neg_r));
+        }
+
+        visible = append_mask(uint32_t(_mm_movemask_ps(inside)), i, out, visible);
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        out[visible] = i;
+        visible     += sphere_visible(frustum, bounds, i);
+    }
+
+    return finish_output(out_visible, first, count, visible);
+}
+
+CullStats cull_aabbs(const Frustum& frustum, const ObjectBounds& bounds, std::vector<uint32_t>& out_visible)
+{
+    const uint32_t count = bounds.size();
+    size_t         first;
+    uint32_t*      out     = reserve_output(out_visible, count, first);
+    uint32_t       visible = 0;
+    uint32_t       i       = 0;
+
+#if BX_CPU_X86
+    // The positive vertex selection depends only on the plane, so it picks
+    // whole arrays.
+    const float* px[6];
+    const float* py[6];
+    const float* pz[6];
+
+    for (uint32_t j = 0; j < 6; j++)
+    {
+        const glm::vec4& p = frustum.planes[j];
+
+        px[j] = p.x >= 0.0f ? bounds.max_x.data() : bounds.min_x.data();
+        py[j] = p.y >= 0.0f ? bounds.max_y.data() : bounds.min_y.data();
+        pz[j] = p.z >= 0.0f ? bounds.max_z.data() : bounds.min_z.data();
+    }
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+        for (uint32_t j = 0; j < 6; j++)
+        {
+            const glm::vec4& p = frustum.planes[j];
+
+            const __m128 d = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.x), _mm_loadu_ps(px[j] + i)), _mm_mul_ps(_mm_set1_ps(p.y), _mm_loadu_ps(py[j] + i))),
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.z), _mm_loadu_ps(pz[j] + i)), _mm_set1_ps(p.w))
+            );
+
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, _mm_setzero_ps()));
+        }
+
+        visible = append_mask(uint32_t(_mm_movemask_ps(inside)), i, out, visible);
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        out[visible] = i;
+        visible     += aabb_visible(frustum, bounds.get(i));
+    }
+
+    return finish_output(out_visible, first, count, visible);
+}
+
+
+// -----------------------------------------------------------------------------
+// HIERARCHICAL CULLING
+// -----------------------------------------------------------------------------
+
+// Classifies the four child boxes of a node. Returns the mask of children at
+// least partially inside; `out_inside` gets those entirely inside.
+static uint32_t classify_node(const Frustum& frustum, const Bvh::Node& node, uint32_t& out_inside)
+{
+    uint32_t visible = 0xf;
+    uint32_t inside  = 0xf;
+
+    for (const glm::vec4& p : frustum.planes)
+    {
+        // Positive vertex decides "outside", negative vertex "entirely inside".
+        const float* pos_x = p.x >= 0.0f ? node.max_x : node.min_x;
+        const float* pos_y = p.y >= 0.0f ? node.max_y : node.min_y;
+        const float* pos_z = p.z >= 0.0f ? node.max_z : node.min_z;
+        const float* neg_x = p.x >= 0.0f ? node.min_x : node.max_x;
+        const float* neg_y = p.y >= 0.0f ? node.min_y : node.max_y;
+        const float* neg_z = p.z >= 0.0f ? node.min_z : node.max_z;
+
+#if BX_CPU_X86
+        const __m128 nx = _mm_set1_ps(p.x), ny = _mm_set1_ps(p.y), nz = _mm_set1_ps(p.z), nw = _mm_set1_ps(p.w);
+
+        const __m128 d_pos = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(nx, _mm_loadu_ps(pos_x)), _mm_mul_ps(ny, _mm_loadu_ps(pos_y))),
+            _mm_add_ps(_mm_mul_ps(nz, _mm_loadu_ps(pos_z)), nw)
+        );
+        const __m128 d_neg = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(nx, _mm_loadu_ps(neg_x)), _mm_mul_ps(ny, _mm_loadu_ps(neg_y))),
+            _mm_add_ps(_mm_mul_ps(nz, _mm_loadu_ps(neg_z)), nw)
+        );
+
+        visible &= uint32_t(_mm_movemask_ps(_mm_cmpge_ps(d_pos, _mm_setzero_ps())));
+        inside  &= uint32_t(_mm_movemask_ps(_mm_cmpge_ps(d_neg, _mm_setzero_ps())));
+#else
+        for (uint32_t i = 0; i < 4; i++)
+        {
+            const float d_pos = p.x * pos_x[i] + p.y * pos_y[i] + p.z * pos_z[i] + p.w;
+            const float d_neg = p.x * neg_x[i] + p.y * neg_y[i] + p.z * neg_z[i] + p.w;
+
+            visible &= ~(uint32_t(d_pos < 0.0f) << i);
+            inside  &= ~(uint32_t(d_neg < 0.0f) << i);
+        }
+#endif
+    }
+
+    out_inside = inside & visible;
+
+    return visible;
+}
+
+CullStats cull_hierarchical
+(
+    const Frustum&         frustum,
+    const ObjectBounds&    bounds,
+    const Bvh&             hierarchy,
+    std::vector<uint32_t>& out_visible
+)
+{
+    const uint32_t count = bounds.size();
+    const size_t   first = out_visible.size();
+
+    if (hierarchy.is_empty())
+    {
+        return { 0, count };
+    }
+
+    struct Entry
+    {
+        uint32_t node;
+        bool     inside;
+    };
+
+    // The hierarchy's depth bound keeps this within its traversal stack size.
+    Entry    stack[Bvh::STACK_SIZE];
+    uint32_t size = 0;
+
+    stack[size++] = { 0, false };
+
+    while (size > 0)
+    {
+        const Entry      entry = stack[--size];
+        const Bvh::Node& node  = hierarchy.nodes[entry.node];
+
+        uint32_t inside  = 0xf;
+        uint32_t visible = 0xf;
+
+        if (!entry.inside)
+        {
+            visible = classify_node(frustum, node, inside);
+        }
+
+        for (uint32_t i = 0; i < 4; i++)
+        {
+            if (!(visible & (1u << i)) || (node.count[i] == 0 && node.child[i] == Bvh::INVALID))
+            {
+                continue;
+            }
+
+            const bool child_inside = (inside & (1u << i)) != 0;
+
+            if (node.count[i] == 0)
+            {
+                assert(size < Bvh::STACK_SIZE);
+                stack[size++] = { node.child[i], child_inside };
+                continue;
+            }
+
+            for (uint32_t j = 0; j < node.count[i]; j++)
+            {
+                const uint32_t object = hierarchy.primitives[node.child[i] + j];
+
+                if (child_inside || aabb_visible(frustum, bounds.get(object)))
+                {
+                    out_visible.push_back(object);
+                }
+            }
+        }
+    }
+
+    const uint32_t drawn = uint32_t(out_visible.size() - first);
+
+    return { drawn, count - drawn };
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdint.h>    // uint32_t
+
+#include <vector>      // vector
+
+#include <glm/glm.hpp> // mat4, vec4
+
+#include "mesh.h"      // Aabb
+
+struct Bvh;
+
+
+// -----------------------------------------------------------------------------
+// VIEW FRUSTUM
+// -----------------------------------------------------------------------------
+
+struct Frustum
+{
+    // Left, right, bottom, top, near, far. Normals point inwards and are unit
+    // length, so `dot(xyz, p) + w` is the signed distance of point `p`.
+    glm::vec4 planes[6];
+
+    // Gribb-Hartmann extraction from a view-projection matrix, with -1..1 clip
+    // space depth (GLM's default, used in `setViewTransform`).
+    static Frustum from_matrix(const glm::mat4& view_proj);
+};
+
+
+// -----------------------------------------------------------------------------
+// OBJECT BOUNDS
+// -----------------------------------------------------------------------------
+
+// Flat structure-of-arrays list of world-space object bounds, keeping both the
+// box and the enclosing sphere.
+struct ObjectBounds
+{
+    std::vector<float> min_x;
+    std::vector<float> min_y;
+    std::vector<float> min_z;
+    std::vector<float> max_x;
+    std::vector<float> max_y;
+    std::vector<float> max_z;
+
+    std::vector<float> center_x;
+    std::vector<float> center_y;
+    std::vector<float> center_z;
+    std::vector<float> radius;
+
+    uint32_t size() const
+    {
+        return uint32_t(min_x.size());
+    }
+
+    Aabb get(uint32_t i) const
+    {
+        return { { min_x[i], min_y[i], min_z[i] }, { max_x[i], max_y[i], max_z[i] } };
+    }
+
+    void add(const Aabb& aabb);
+
+    void clear();
+};
+
+
+// -----------------------------------------------------------------------------
+// CULLING
+// -----------------------------------------------------------------------------
+
+struct CullStats
+{
+    uint32_t drawn  = 0;
+    uint32_t culled = 0;
+};
+
+// Each function appends the indices of potentially visible objects to
+// `out_visible` in ascending order (the hierarchical one in traversal order).
+
+CullStats cull_spheres(const Frustum& frustum, const ObjectBounds& bounds, std::vector<uint32_t>& out_visible);
+
+CullStats cull_aabbs(const Frustum& frustum, const ObjectBounds& bounds, std::vector<uint32_t>& out_visible);
+
+// Tests the nodes of a BVH built over `bounds` first; subtrees entirely inside
+// the frustum are accepted without testing their objects.
+CullStats cull_hierarchical
+(
+    const Frustum&         frustum,
+    const ObjectBounds&    bounds,
+    const Bvh&             hierarchy,
+    std::vector<uint32_t>& out_visible
+);
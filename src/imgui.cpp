@@ -189,4 +189,29 @@ void PushMonospacedFont()
     );
 }
 
+bool InputTextMultiline(const char* label, std::string* str, const ImVec2& size, ImGuiInputTextFlags flags)
+{
+    const ImGuiInputTextCallback resize = [](ImGuiInputTextCallbackData* data)
+    {
+        if (data->EventFlag == ImGuiInputTextFlags_CallbackResize)
+        {
+            std::string* string = static_cast<std::string*>(data->UserData);
+            string->resize(size_t(data->BufTextLen));
+            data->Buf = string->data();
+        }
+
+        return 0;
+    };
+
+    return ImGui::InputTextMultiline(
+        label,
+        str->data(),
+        str->capacity() + 1,
+        size,
+        flags | ImGuiInputTextFlags_CallbackResize,
+        resize,
+        str
+    );
+}
+
 } // namespace ImGui
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <string>           // string
+
 #include <imgui.h>          // ImGui::*
 #include <imgui_internal.h> // ...
 #include <ImGuizmo.h>       // ImGuizmo::*
@@ -15,6 +17,9 @@ float GetGlobalFontSize();
 
 void PushMonospacedFont();
 
+// Like `imgui_stdlib`'s version, growing the string as needed.
+bool InputTextMultiline(const char* label, std::string* str, const ImVec2& size = {}, ImGuiInputTextFlags flags = 0);
+
 } // namespace ImGui
 
 void imgui_init(GLFWwindow* window, unsigned short view_id, float font_size = 8.0f);
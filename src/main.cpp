@@ -1,12 +1,21 @@
 #include <stdint.h>                    // *int*_t
+#include <stdlib.h>                    // getenv
+
+#include <algorithm>                   // sort
+
+#include <string>                      // string
+#include <unordered_map>               // unordered_map
+#include <utility>                     // move, pair, swap
+#include <vector>                      // vector
 
 #include <bgfx/bgfx.h>                 // bgfx::*
 #include <bgfx/embedded_shader.h>      // BGFX_EMBEDDED_SHADER
 
-#include <bx/bx.h>                     // BX_CONCATENATE
+#include <bx/bx.h>                     // BX_CONCATENATE, memCopy, min
 #include <bx/math.h>                   // mtxOrtho, mtxRotateZ, round
 #include <bx/platform.h>               // BX_PLATFORM_*
 #include <bx/string.h>                 // snprintf
+#include <bx/timer.h>                  // getHPCounter, getHPFrequency
 
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>                // glfw*
@@ -30,7 +39,16 @@
 #define ARCBALL_CAMERA_IMPLEMENTATION
 #include <arcball_camera.h>               // arcball_camera_update
 
+#include "bvh.h"                          // Ray, RayHit
+#include "clusters.h"                     // copy_cluster_indices, cull_clusters
+#include "culling.h"                      // CullStats, Frustum, cull_*
 #include "imgui.h"                        // imgui_*, ImGui::*, ImGuizmo::*
+#include "mesh.h"                         // Mesh
+#include "occlusion.h"                    // OcclusionBuffer, select_occluders
+#include "scene.h"                        // Scene
+#include "script.h"                       // ScriptEvaluator, ScriptResult
+#include "sdf.h"                          // generate_sdf_shader, SdfShader
+#include "tasks.h"                        // task_*
 
 #if BX_PLATFORM_OSX
 #   import <Cocoa/Cocoa.h>                // NSWindow
@@ -38,7 +56,7 @@
 #endif
 
 #ifdef WITH_SHADERC_LIBRARY
-#   include <shaderclib.h>                // compile_from_memory
+#   include <shaderclib.h>                // compile_from_memory, compile_to_memory
 #else
 #   include <shaders/position_color_fs.h> // position_color_fs_*
 #   include <shaders/position_color_vs.h> // position_color_vs_
@@ -193,13 +211,799 @@ struct ArcballControls
     }
 };
 
+// Returns the world-space ray through the given screen position, or `false` if
+// the position lies outside of the viewport.
+static bool make_picking_ray
+(
+    const ImVec4&    viewport,
+    const ImVec2&    position,
+    const glm::mat4& view_proj,
+    Ray&             out_ray
+)
+{
+    if (position.x < viewport.x || position.x >= viewport.x + viewport.z ||
+        position.y < viewport.y || position.y >= viewport.y + viewport.w)
+    {
+        return false;
+    }
+
+    const float     x       = 2.0f * (position.x - viewport.x) / viewport.z - 1.0f;
+    const float     y       = 1.0f - 2.0f * (position.y - viewport.y) / viewport.w;
+    const glm::mat4 inverse = glm::inverse(view_proj);
+
+    const glm::vec4 near_point = inverse * glm::vec4(x, y, -1.0f, 1.0f);
+    const glm::vec4 far_point  = inverse * glm::vec4(x, y,  1.0f, 1.0f);
+
+    out_ray.origin    = glm::vec3(near_point) / near_point.w;
+    out_ray.direction = glm::normalize(glm::vec3(far_point) / far_point.w - out_ray.origin);
+
+    return true;
+}
+
+
+// -----------------------------------------------------------------------------
+// SCENE VISIBILITY
+// -----------------------------------------------------------------------------
+
+struct VisibilityStats
+{
+    uint32_t drawn              = 0;
+    uint32_t frustum_culled     = 0;
+    uint32_t occluded           = 0;
+    uint32_t occluder_triangles = 0;
+    uint32_t clusters_drawn     = 0;
+    uint32_t clusters_culled    = 0;
+};
+
+// Visible clusters of one clustered object.
+struct ClusterDraw
+{
+    uint32_t first       = 0; // Into `SceneVisibility::visible_clusters`.
+    uint32_t count       = 0;
+    uint32_t index_count = 0;
+};
+
+// Frustum culling followed by software occlusion culling against the largest
+// visible objects, and frustum/backface culling of the clusters of the visible
+// clustered objects. Only reads the scene, so it can run on the task pool while
+// the main thread keeps working on the frame.
+struct SceneVisibility
+{
+    OcclusionBuffer          occlusion_buffer;
+    std::vector<uint32_t>    occluders;
+    std::vector<const Mesh*> occluder_meshes;
+    std::vector<uint32_t>    visible;
+    std::vector<uint32_t>    visible_clusters;
+    std::vector<ClusterDraw> cluster_draws; // One per clustered visible object.
+    VisibilityStats          stats;
+
+    uint32_t                 max_occluders          = 8;
+    uint32_t                 max_occluder_triangles = 1u << 16;
+    float                    min_occluder_size      = 0.1f;
+    bool                     occlusion_culling      = true;
+
+    void update(const Scene& scene, const glm::mat4& view_proj, const glm::vec3& eye, float aspect)
+    {
+        const Frustum frustum = Frustum::from_matrix(view_proj);
+
+        visible.clear();
+        stats = {};
+
+        cull_objects(scene, frustum, view_proj, eye, aspect);
+        cull_object_clusters(scene, frustum, eye);
+    }
+
+    void cull_objects(const Scene& scene, const Frustum& frustum, const glm::mat4& view_proj, const glm::vec3& eye, float aspect)
+    {
+        // The hierarchy only pays off once there's enough objects to skip.
+        const CullStats cull_stats = scene.objects.size() > 64
+            ? cull_hierarchical(frustum, scene.bounds, scene.hierarchy, visible)
+            : cull_aabbs       (frustum, scene.bounds,                  visible);
+
+        stats.drawn          = cull_stats.drawn;
+        stats.frustum_culled = cull_stats.culled;
+
+        if (!occlusion_culling || visible.size() < 2 || !(aspect > 0.0f))
+        {
+            return;
+        }
+
+        select_occluders(scene.bounds, visible, eye, max_occluders, min_occluder_size, occluders);
+
+        occluder_meshes.clear();
+
+        uint32_t triangles = 0;
+        for (const uint32_t i : occluders)
+        {
+            const Mesh& mesh = scene.objects[i].mesh;
+
+            if (triangles + mesh.triangle_count() <= max_occluder_triangles)
+            {
+                triangles += mesh.triangle_count();
+                occluder_meshes.push_back(&mesh);
+            }
+        }
+
+        if (occluder_meshes.empty())
+        {
+            return;
+        }
+
+        const uint32_t width = 256;
+        occlusion_buffer.resize(width, uint32_t(float(width) / aspect));
+
+        stats.occluder_triangles = occlusion_buffer.rasterize(view_proj, occluder_meshes.data(), uint32_t(occluder_meshes.size()));
+        stats.occluded           = occlusion_buffer.cull(scene.bounds, visible);
+        stats.drawn             -= stats.occluded;
+    }
+
+    void cull_object_clusters(const Scene& scene, const Frustum& frustum, const glm::vec3& eye)
+    {
+        visible_clusters.clear();
+        cluster_draws   .clear();
+
+        for (const uint32_t i : visible)
+        {
+            const MeshClusters& clusters = scene.objects[i].clusters;
+
+            if (clusters.is_empty())
+            {
+                continue;
+            }
+
+            ClusterDraw draw;
+            draw.first = uint32_t(visible_clusters.size());
+
+            const CullStats cull_stats = cull_clusters(clusters, frustum, eye, visible_clusters);
+
+            draw.count       = cull_stats.drawn;
+            draw.index_count = count_cluster_indices(clusters, visible_clusters.data() + draw.first, draw.count);
+
+            cluster_draws.push_back(draw);
+
+            stats.clusters_drawn  += cull_stats.drawn;
+            stats.clusters_culled += cull_stats.culled;
+        }
+    }
+};
+
+
+// -----------------------------------------------------------------------------
+// MODEL EVALUATION
+// -----------------------------------------------------------------------------
+
+static const char* DEFAULT_MODEL_SOURCE =
+    "-- Model script: emit(mesh, 0xRRGGBB) adds a part to the scene.\n"
+    "\n"
+    "local base = box(2.0, 0.2, 1.2)\n"
+    "emit(base, 0x8090a0)\n"
+    "\n"
+    "for i = 0, 3 do\n"
+    "    local x = -0.75 + i * 0.5\n"
+    "    emit(translate(cylinder(0.08, 0.6, 24), x, 0.4, 0.0), 0xd08040)\n"
+    "end\n"
+    "\n"
+    "local top = translate(box(2.0, 0.1, 0.6), 0.0, 0.75, 0.0)\n"
+    "emit(rotate(top, 5, 1, 0, 0), 0x8090a0)\n"
+    "\n"
+    "local knob = sdf.union(sdf.sphere(0.2), sdf.translate(sdf.torus(0.2, 0.05), vector(0, -0.12, 0)), 0.08)\n"
+    "emit(translate(sdf.mesh(knob, 0.02), 0.0, 1.05, 0.0), 0x40a0d0)\n";
+
+// Per-user directory for compiled model scripts, or empty when there's no
+// sensible location.
+static std::string bytecode_cache_directory()
+{
+#if BX_PLATFORM_WINDOWS
+    const char* local = getenv("LOCALAPPDATA");
+
+    return local ? std::string(local) + "/Modeler/bytecode" : std::string();
+#else
+    const char* xdg  = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+
+    if (xdg && *xdg)
+    {
+        return std::string(xdg) + "/modeler/bytecode";
+    }
+
+#   if BX_PLATFORM_OSX
+    return home ? std::string(home) + "/Library/Caches/Modeler/bytecode" : std::string();
+#   else
+    return home ? std::string(home) + "/.cache/modeler/bytecode" : std::string();
+#   endif
+#endif
+}
+
+// Turns script results into scenes. The front scene is the last complete model.
+// Parts streamed by the running evaluation go into the stream scene, which is
+// drawn instead while it has any, so big models show up part by part. Once the
+// result is in, the parts that didn't fit the queue are prepared into the back
+// scene on the background task queue, and appended by the UI thread (which only
+// uploads GPU buffers) before the stream scene is swapped to the front.
+struct SceneDoubleBuffer
+{
+    // Per frame, for preparing and uploading streamed parts.
+    static constexpr double STREAM_BUDGET_MS = 4.0;
+
+    Scene                   front;
+    Scene                   back;
+    Scene                   stream;
+    uint32_t                stream_generation = 0;
+    std::vector<ScriptPart> incoming; // Received but not added yet.
+    size_t                  incoming_first    = 0;
+    ScriptResult            result;
+    TaskCounter             build_task;
+    bool                    building          = false;
+
+    std::vector<ScriptSdfPlacement> placements; // Of the front scene.
+
+    const Scene& visible() const
+    {
+        return stream.objects.empty() ? front : stream;
+    }
+
+    // Must not be called while the visible scene is in use by other tasks.
+    // Returns `true` when a new front scene was swapped in.
+    bool update(ScriptEvaluator& evaluator)
+    {
+        if (building)
+        {
+            if (build_task.pending.load(std::memory_order_acquire) != 0)
+            {
+                return false;
+            }
+
+            stream.take(back);
+            finish_stream();
+
+            building = false;
+
+            return true;
+        }
+
+        // All the parts of a polled result are queued already.
+        if (evaluator.poll(result))
+        {
+            receive(evaluator);
+            return finish();
+        }
+
+        receive(evaluator);
+
+        const int64_t start = bx::getHPCounter();
+        const int64_t end   = start + int64_t(STREAM_BUDGET_MS * 0.001 * double(bx::getHPFrequency()));
+        bool          added = false;
+
+        for (; incoming_first < incoming.size() && bx::getHPCounter() < end; incoming_first++)
+        {
+            ScriptPart& part = incoming[incoming_first];
+
+            if (part.generation != stream_generation)
+            {
+                // The previous evaluation may have finished in the meantime;
+                // its result was published before this part was queued.
+                if (stream_generation != 0 && evaluator.poll(result))
+                {
+                    return finish();
+                }
+
+                stream.clear();
+                stream_generation = part.generation;
+            }
+
+            stream.add(std::move(part.mesh), part.color);
+            added = true;
+        }
+
+        if (added)
+        {
+            stream.update_hierarchy();
+            stream.upload();
+        }
+
+        return false;
+    }
+
+    void clear()
+    {
+        task_wait(build_task);
+
+        front .clear();
+        back  .clear();
+        stream.clear();
+    }
+
+    void receive(ScriptEvaluator& evaluator)
+    {
+        if (incoming_first == incoming.size())
+        {
+            incoming.clear();
+            incoming_first = 0;
+        }
+
+        ScriptPart part;
+
+        while (evaluator.poll_part(part))
+        {
+            incoming.push_back(std::move(part));
+        }
+    }
+
+    // Completes the stream scene with the parts of `result` that weren't added
+    // yet. Failed evaluations keep the last good scene.
+    bool finish()
+    {
+        std::vector<Mesh>     meshes;
+        std::vector<uint32_t> colors;
+
+        if (stream_generation != result.generation)
+        {
+            stream.clear();
+        }
+
+        stream_generation = 0;
+
+        // Older parts are leftovers of cancelled evaluations; newer ones stay.
+        for (; incoming_first < incoming.size() && incoming[incoming_first].generation <= result.generation; incoming_first++)
+        {
+            ScriptPart& part = incoming[incoming_first];
+
+            if (part.generation == result.generation)
+            {
+                meshes.push_back(std::move(part.mesh));
+                colors.push_back(part.color);
+            }
+        }
+
+        if (!result.error.empty())
+        {
+            stream.clear();
+            return false;
+        }
+
+        if (meshes.empty() && result.meshes.empty())
+        {
+            finish_stream();
+            return true;
+        }
+
+        for (size_t i = 0; i < result.meshes.size(); i++)
+        {
+            meshes.push_back(std::move(result.meshes[i]));
+            colors.push_back(i < result.colors.size() ? result.colors[i] : Scene::DEFAULT_COLOR);
+        }
+
+        result.meshes = std::move(meshes);
+        result.colors = std::move(colors);
+        building      = true;
+
+        // Preparing meshes takes long, so it mustn't hold up frame tasks.
+        task_run(build_task, TaskQueue::BACKGROUND, [this]()
+        {
+            back.add(std::move(result.meshes), result.colors);
+        });
+
+        return false;
+    }
+
+    void finish_stream()
+    {
+        stream.update_hierarchy();
+        stream.upload();
+
+        std::swap(front, stream);
+        stream.clear();
+
+        placements = result.sdf_placements;
+    }
+};
+
+struct ModelEditor
+{
+    std::string source;
+    char        status[512] = {};
+    bool        has_error   = false;
+    bool        changed     = false;
+};
+
+struct ProfilePanel
+{
+    char path  [256] = "model.folded";
+    char status[320] = {};
+};
+
+static const char* EDITOR_WINDOW_NAME  = "Modeler";
+static const char* PROFILE_WINDOW_NAME = "Profile";
+
+
+// -----------------------------------------------------------------------------
+// SDF PREVIEW
+// -----------------------------------------------------------------------------
+
+#ifdef WITH_SHADERC_LIBRARY
+
+static const char* SDF_PREVIEW_VARYING =
+    "vec2 v_texcoord0 : TEXCOORD0 = vec2(0.0, 0.0);\n"
+    "vec3 a_position  : POSITION;";
+
+// Fullscreen triangle, passing the normalized device coordinates on.
+static const char* SDF_PREVIEW_VS =
+    "$input  a_position\n"
+    "$output v_texcoord0\n"
+    "#include <bgfx_shader.sh>\n"
+    "void main()\n"
+    "{\n"
+    "    gl_Position = vec4(a_position.xy, 0.0, 1.0);\n"
+    "    v_texcoord0 = a_position.xy;\n"
+    "}";
+
+// Sphere tracing of the generated `sdf_field` in the field's own space, within
+// the grid bounds, shaded like `Scene` shades meshes. The depth is that of the
+// hit point, so it composes with the scene.
+static const char* SDF_PREVIEW_FS_HEADER =
+    "$input v_texcoord0\n"
+    "#include <bgfx_shader.sh>\n"
+    "uniform vec4 u_sdf_params[%u];\n"
+    "uniform mat4 u_sdf_inverse;\n"   // From the world to the field's space.
+    "uniform vec4 u_sdf_bounds[2];\n"
+    "uniform vec4 u_sdf_color;\n"
+    "uniform vec4 u_sdf_info;\n";     // Homogeneous depth.
+
+static const char* SDF_PREVIEW_FS_MAIN =
+    "void main()\n"
+    "{\n"
+    "    vec4  near_point = mul(u_invViewProj, vec4(v_texcoord0, -1.0, 1.0));\n"
+    "    vec4  far_point  = mul(u_invViewProj, vec4(v_texcoord0,  1.0, 1.0));\n"
+    "    near_point /= near_point.w;\n"
+    "    far_point  /= far_point.w;\n"
+    "    vec3  origin     = mul(u_sdf_inverse, near_point).xyz;\n"
+    "    vec3  end        = mul(u_sdf_inverse, far_point ).xyz;\n"
+    "    float ray_length = length(end - origin);\n"
+    "    vec3  direction  = (end - origin) / ray_length;\n"
+    "    vec3  t0         = (u_sdf_bounds[0].xyz - origin) / direction;\n"
+    "    vec3  t1         = (u_sdf_bounds[1].xyz - origin) / direction;\n"
+    "    vec3  t_min      = min(t0, t1);\n"
+    "    vec3  t_max      = max(t0, t1);\n"
+    "    float t          = max(max(t_min.x, max(t_min.y, t_min.z)), 0.0);\n"
+    "    float t_end      = min(min(t_max.x, min(t_max.y, t_max.z)), ray_length);\n"
+    "    bool  hit        = false;\n"
+    "    for (int i = 0; i < 160 && t <= t_end; i++)\n"
+    "    {\n"
+    "        float d = sdf_field(origin + direction * t);\n"
+    "        if (d < 2e-4 * (1.0 + t)) { hit = true; break; }\n"
+    "        t += d;\n"
+    "    }\n"
+    "    if (!hit) { discard; }\n"
+    "    vec3  p          = origin + direction * t;\n"
+    "    float e          = 5e-4 * (1.0 + t);\n"
+    "    vec2  k          = vec2(1.0, -1.0);\n"
+    "    vec3  n          = k.xyy * sdf_field(p + k.xyy * e) + k.yyx * sdf_field(p + k.yyx * e)\n"
+    "                       + k.yxy * sdf_field(p + k.yxy * e) + k.xxx * sdf_field(p + k.xxx * e);\n"
+    "    vec3  normal     = normalize(mul(vec4(n, 0.0), u_sdf_inverse).xyz);\n"
+    "    float intensity  = 0.35 + 0.65 * max(dot(normal, normalize(vec3(0.3, 0.8, 0.5))), 0.0);\n"
+    "    vec4  clip_point = mul(u_viewProj, vec4(mix(near_point.xyz, far_point.xyz, t / ray_length), 1.0));\n"
+    "    float depth      = clip_point.z / clip_point.w;\n"
+    "    gl_FragColor = vec4(u_sdf_color.rgb * intensity, u_sdf_color.a);\n"
+    "    gl_FragDepth = u_sdf_info.x > 0.0 ? depth * 0.5 + 0.5 : depth;\n"
+    "}";
+
+// Draws the fields being meshed by the running evaluation, by raymarching them
+// in a fullscreen pass at the placements of the same calls in the front scene,
+// whose outdated parts it hides meanwhile. Each field is translated to a shader
+// compiled at runtime, cached by the hash of the tree's structure; parameters
+// go in uniforms, so edits that only change values reuse the program.
+//
+// Compiling takes tens of milliseconds, so it runs on the background task
+// queue, one shader at a time; fields whose program isn't ready yet keep their
+// outdated meshes drawn. Programs of fields that are gone are kept for later
+// edits of the same structure, up to `MAX_IDLE_PROGRAMS` of the most recently
+// used ones.
+struct SdfPreview
+{
+    static constexpr uint32_t MAX_IDLE_PROGRAMS = 16;
+
+    struct Field
+    {
+        ScriptSdfPreview preview;
+        SdfShader        shader;
+    };
+
+    struct Program
+    {
+        bgfx::ProgramHandle handle    = BGFX_INVALID_HANDLE; // Invalid when the compilation failed.
+        uint32_t            last_used = 0;                   // Generation.
+    };
+
+    // The background compilation in flight, if `running`.
+    struct Compilation
+    {
+        uint64_t             hash    = 0;
+        std::string          source;
+        std::vector<uint8_t> binary;           // Empty when it failed.
+        TaskCounter          task;
+        bool                 running = false;
+    };
+
+    bgfx::ShaderHandle                                vertex_shader = BGFX_INVALID_HANDLE;
+    bgfx::VertexLayout                                layout;
+    bgfx::UniformHandle                               u_params      = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle                               u_inverse     = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle                               u_bounds      = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle                               u_color       = BGFX_INVALID_HANDLE;
+    bgfx::UniformHandle                               u_info        = BGFX_INVALID_HANDLE;
+
+    std::unordered_map<uint64_t, Program>             programs;
+    Compilation                                       compilation;
+    std::vector<Field>                                fields;   // Of the latest evaluation sending any.
+    uint32_t                                          generation = 0;
+    std::vector<bool>                                 hidden;   // Front scene objects drawn as fields.
+
+    void init()
+    {
+        vertex_shader = shaderc::compile_from_memory(shaderc::ShaderType::VERTEX, SDF_PREVIEW_VS, SDF_PREVIEW_VARYING);
+
+        layout
+            .begin()
+            .add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float)
+            .end();
+
+        u_params  = bgfx::createUniform("u_sdf_params" , bgfx::UniformType::Vec4, SDF_SHADER_MAX_PARAMS);
+        u_inverse = bgfx::createUniform("u_sdf_inverse", bgfx::UniformType::Mat4);
+        u_bounds  = bgfx::createUniform("u_sdf_bounds" , bgfx::UniformType::Vec4, 2);
+        u_color   = bgfx::createUniform("u_sdf_color"  , bgfx::UniformType::Vec4);
+        u_info    = bgfx::createUniform("u_sdf_info"   , bgfx::UniformType::Vec4);
+    }
+
+    void shutdown()
+    {
+        task_wait(compilation.task);
+
+        for (const auto& [hash, program] : programs)
+        {
+            if (bgfx::isValid(program.handle))
+            {
+                bgfx::destroy(program.handle);
+            }
+        }
+
+        programs.clear();
+
+        if (bgfx::isValid(vertex_shader))
+        {
+            bgfx::destroy(vertex_shader);
+        }
+
+        bgfx::destroy(u_params );
+        bgfx::destroy(u_inverse);
+        bgfx::destroy(u_bounds );
+        bgfx::destroy(u_color  );
+        bgfx::destroy(u_info   );
+    }
+
+    // Takes in the fields sent since the last frame, and drops them once the
+    // evaluation that sent them has a result, i.e. their meshes are in or
+    // never will be.
+    void update(ScriptEvaluator& evaluator, const SceneDoubleBuffer& scenes)
+    {
+        Field field;
+
+        while (evaluator.poll_sdf_preview(field.preview))
+        {
+            if (field.preview.generation < generation)
+            {
+                continue;
+            }
+
+            if (field.preview.generation > generation)
+            {
+                fields.clear();
+                generation = field.preview.generation;
+            }
+
+            if (generate_sdf_shader(field.preview.tree, field.preview.root, field.shader))
+            {
+                fields.push_back(std::move(field));
+            }
+        }
+
+        if (!scenes.building && scenes.result.generation >= generation)
+        {
+            fields.clear();
+        }
+
+        if (bgfx::isValid(vertex_shader))
+        {
+            update_programs();
+        }
+
+        // Only the front scene's objects match the placements.
+        hidden.assign(scenes.visible().objects.size(), false);
+
+        if (&scenes.visible() == &scenes.front)
+        {
+            for (const ScriptSdfPlacement& placement : scenes.placements)
+            {
+                if (placement.part < hidden.size() && find_program(placement.call))
+                {
+                    hidden[placement.part] = true;
+                }
+            }
+        }
+    }
+
+    const Field* find(uint32_t call) const
+    {
+        for (const Field& field : fields)
+        {
+            if (field.preview.call == call)
+            {
+                return &field;
+            }
+        }
+
+        return nullptr;
+    }
+
+    // The valid program of the call's field, if it's ready.
+    const Program* find_program(uint32_t call) const
+    {
+        const Field* field = find(call);
+
+        if (!field)
+        {
+            return nullptr;
+        }
+
+        const auto found = programs.find(field->shader.hash);
+
+        return found != programs.end() && bgfx::isValid(found->second.handle) ? &found->second : nullptr;
+    }
+
+    // Takes in a finished compilation, starts the next one for a field without
+    // a program, and evicts idle programs beyond the limit.
+    void update_programs()
+    {
+        if (compilation.running && compilation.task.pending.load(std::memory_order_acquire) == 0)
+        {
+            programs[compilation.hash] = { create_program(compilation.binary), generation };
+
+            compilation.running = false;
+        }
+
+        for (const Field& field : fields)
+        {
+            const auto found = programs.find(field.shader.hash);
+
+            if (found != programs.end())
+            {
+                found->second.last_used = generation;
+            }
+            else if (!compilation.running)
+            {
+                char header[512];
+                bx::snprintf(header, sizeof(header), SDF_PREVIEW_FS_HEADER, SDF_SHADER_MAX_PARAMS);
+
+                compilation.hash    = field.shader.hash;
+                compilation.source  = header + field.shader.source + SDF_PREVIEW_FS_MAIN;
+                compilation.running = true;
+
+                task_run(compilation.task, TaskQueue::BACKGROUND, [this]()
+                {
+                    compilation.binary = shaderc::compile_to_memory(shaderc::ShaderType::FRAGMENT, compilation.source.c_str(), SDF_PREVIEW_VARYING);
+                });
+            }
+        }
+
+        // Programs of the current fields are in use.
+        std::vector<std::pair<uint32_t, uint64_t>> idle;
+
+        for (const auto& [hash, program] : programs)
+        {
+            if (fields.empty() || program.last_used != generation)
+            {
+                idle.emplace_back(program.last_used, hash);
+            }
+        }
+
+        if (idle.size() <= MAX_IDLE_PROGRAMS)
+        {
+            return;
+        }
+
+        std::sort(idle.begin(), idle.end());
+
+        for (size_t i = 0; i + MAX_IDLE_PROGRAMS < idle.size(); i++)
+        {
+            const auto found = programs.find(idle[i].second);
+
+            if (bgfx::isValid(found->second.handle))
+            {
+                bgfx::destroy(found->second.handle);
+            }
+
+            programs.erase(found);
+        }
+    }
+
+    void submit(bgfx::ViewId view, const std::vector<ScriptSdfPlacement>& placements)
+    {
+        if (!bgfx::isValid(vertex_shader))
+        {
+            return;
+        }
+
+        float info[4] = { bgfx::getCaps()->homogeneousDepth ? 1.0f : 0.0f };
+
+        for (const ScriptSdfPlacement& placement : placements)
+        {
+            const Field*   field   = find(placement.call);
+            const Program* program = find_program(placement.call);
+
+            if (!program || bgfx::getAvailTransientVertexBuffer(3, layout) < 3)
+            {
+                continue;
+            }
+
+            bgfx::TransientVertexBuffer vertex_buffer;
+            bgfx::allocTransientVertexBuffer(&vertex_buffer, 3, layout);
+
+            const float triangle[] = { -1.0f, -1.0f, 0.0f, 3.0f, -1.0f, 0.0f, -1.0f, 3.0f, 0.0f };
+            bx::memCopy(vertex_buffer.data, triangle, sizeof(triangle));
+
+            const glm::mat4 inverse  = glm::inverse(placement.matrix);
+            const glm::vec4 bounds[] = { glm::vec4(field->preview.bounds.min, 0.0f), glm::vec4(field->preview.bounds.max, 0.0f) };
+            const glm::vec4 color    =
+            {
+                float((placement.color      ) & 0xff) / 255.0f,
+                float((placement.color >>  8) & 0xff) / 255.0f,
+                float((placement.color >> 16) & 0xff) / 255.0f,
+                float((placement.color >> 24) & 0xff) / 255.0f,
+            };
+
+            bgfx::setUniform(u_params , field->shader.params.data(), uint16_t(field->shader.params.size()));
+            bgfx::setUniform(u_inverse, glm::value_ptr(inverse));
+            bgfx::setUniform(u_bounds , bounds, 2);
+            bgfx::setUniform(u_color  , glm::value_ptr(color));
+            bgfx::setUniform(u_info   , info);
+
+            bgfx::setVertexBuffer(0, &vertex_buffer);
+            bgfx::setState(BGFX_STATE_WRITE_RGB | BGFX_STATE_WRITE_A | BGFX_STATE_WRITE_Z | BGFX_STATE_DEPTH_TEST_LESS);
+
+            bgfx::submit(view, program->handle);
+        }
+    }
+
+    bgfx::ProgramHandle create_program(const std::vector<uint8_t>& binary) const
+    {
+        if (binary.empty())
+        {
+            return BGFX_INVALID_HANDLE;
+        }
+
+        const bgfx::ShaderHandle fragment_shader = bgfx::createShader(bgfx::copy(binary.data(), uint32_t(binary.size())));
+
+        if (!bgfx::isValid(fragment_shader))
+        {
+            return BGFX_INVALID_HANDLE;
+        }
+
+        // The program keeps its own reference.
+        const bgfx::ProgramHandle program = bgfx::createProgram(vertex_shader, fragment_shader, false);
+        bgfx::destroy(fragment_shader);
+
+        return program;
+    }
+};
+
+#endif // WITH_SHADERC_LIBRARY
+
 
 // -----------------------------------------------------------------------------
 // EDITOR GUI
 // -----------------------------------------------------------------------------
 
 // Returns remaining available viewport area.
-static ImVec4 update_editor_gui()
+static ImVec4 update_editor_gui(ModelEditor& editor)
 {
     ImGuiViewport* viewport = ImGui::GetMainViewport();
 
@@ -246,7 +1050,7 @@ static ImVec4 update_editor_gui()
 
     ImGui::PopStyleColor();
 
-    const char* window_name = "Modeler";
+    const char* window_name = EDITOR_WINDOW_NAME;
 
     if (!dockspace_init)
     {
@@ -254,11 +1058,16 @@ static ImVec4 update_editor_gui()
         ImGui::DockBuilderAddNode    (dockspace_id, ImGuiDockNodeFlags_DockSpace);
         ImGui::DockBuilderSetNodeSize(dockspace_id, viewport->Size);
 
-        const ImGuiID dock_editor_id = ImGui::DockBuilderSplitNode(
+        ImGuiID dock_editor_id = ImGui::DockBuilderSplitNode(
             dockspace_id, ImGuiDir_Right, 0.35f, nullptr, nullptr
         );
 
-        ImGui::DockBuilderDockWindow(window_name, dock_editor_id);
+        const ImGuiID dock_profile_id = ImGui::DockBuilderSplitNode(
+            dock_editor_id, ImGuiDir_Down, 0.3f, nullptr, &dock_editor_id
+        );
+
+        ImGui::DockBuilderDockWindow(window_name        , dock_editor_id );
+        ImGui::DockBuilderDockWindow(PROFILE_WINDOW_NAME, dock_profile_id);
 
         ImGui::DockBuilderFinish(dockspace_id);
     }
@@ -271,9 +1080,27 @@ static ImVec4 update_editor_gui()
     {
         ImGui::PushMonospacedFont();
 
-        // TODO: Render soruce code editor.
-        ImGui::TextUnformatted("TODO...");
-        
+        const float status_height = ImGui::GetTextLineHeightWithSpacing() * 4.0f;
+
+        editor.changed = ImGui::InputTextMultiline(
+            "##Source",
+            &editor.source,
+            { -FLT_MIN, -status_height },
+            ImGuiInputTextFlags_AllowTabInput
+        );
+
+        if (editor.has_error)
+        {
+            ImGui::PushStyleColor(ImGuiCol_Text, IM_COL32(255, 96, 96, 255));
+        }
+
+        ImGui::TextWrapped("%s", editor.status);
+
+        if (editor.has_error)
+        {
+            ImGui::PopStyleColor();
+        }
+
         ImGui::PopFont();
     }
     ImGui::End();
@@ -292,6 +1119,221 @@ static ImVec4 update_editor_gui()
 }
 
 
+// -----------------------------------------------------------------------------
+// PROFILE GUI
+// -----------------------------------------------------------------------------
+
+static ImU32 flame_color(const std::string& name)
+{
+    uint32_t hash = 2166136261u;
+
+    for (char c : name)
+    {
+        hash = (hash ^ uint8_t(c)) * 16777619u;
+    }
+
+    return IM_COL32(205 + hash % 50, 90 + (hash >> 8) % 110, 40 + (hash >> 16) % 40, 255);
+}
+
+// Icicle layout: callers on top, callees below, widths proportional to the
+// samples. Returns the hovered node, if any.
+static uint32_t draw_flame_node
+(
+    ImDrawList*          draw_list,
+    const ScriptProfile& profile,
+    uint32_t             index,
+    const ImVec2&        origin,
+    float                x,
+    float                width_per_sample,
+    float                row_height,
+    uint32_t             depth
+)
+{
+    const ScriptProfileNode& node  = profile.nodes[index];
+    const float              width = float(node.samples) * width_per_sample;
+
+    if (width < 1.0f)
+    {
+        return UINT32_MAX;
+    }
+
+    const ImVec2 min = { origin.x + x        , origin.y + float(depth    ) * row_height };
+    const ImVec2 max = { origin.x + x + width, origin.y + float(depth + 1) * row_height - 1.0f };
+
+    draw_list->AddRectFilled(min, max, flame_color(node.name));
+
+    if (width > 24.0f)
+    {
+        draw_list->PushClipRect(min, max, true);
+        draw_list->AddText({ min.x + 2.0f, min.y }, IM_COL32(0, 0, 0, 255), node.name.c_str());
+        draw_list->PopClipRect();
+    }
+
+    uint32_t hovered = ImGui::IsMouseHoveringRect(min, max) ? index : UINT32_MAX;
+
+    for (uint32_t child = node.first_child; child; child = profile.nodes[child].next_sibling)
+    {
+        const uint32_t hovered_child = draw_flame_node(draw_list, profile, child, origin, x, width_per_sample, row_height, depth + 1);
+
+        if (hovered_child != UINT32_MAX)
+        {
+            hovered = hovered_child;
+        }
+
+        x += float(profile.nodes[child].samples) * width_per_sample;
+    }
+
+    return hovered;
+}
+
+static uint32_t profile_depth(const ScriptProfile& profile, uint32_t index)
+{
+    uint32_t depth = 0;
+
+    for (uint32_t child = profile.nodes[index].first_child; child; child = profile.nodes[child].next_sibling)
+    {
+        depth = std::max(depth, profile_depth(profile, child));
+    }
+
+    return depth + 1;
+}
+
+// Returns the given line of `source`, from 1, without leading whitespace.
+static std::string source_line(const std::string& source, uint32_t line)
+{
+    size_t begin = 0;
+
+    for (uint32_t i = 1; i < line && begin != std::string::npos; i++)
+    {
+        begin = source.find('\n', begin);
+        begin = begin == std::string::npos ? begin : begin + 1;
+    }
+
+    if (begin == std::string::npos)
+    {
+        return {};
+    }
+
+    begin = source.find_first_not_of(" \t", begin);
+
+    const size_t end = source.find('\n', begin);
+
+    return begin == std::string::npos ? std::string() : source.substr(begin, end - begin);
+}
+
+static void update_profile_gui(ProfilePanel& panel, const ScriptProfile& profile, const std::string& source)
+{
+    if (!ImGui::Begin(PROFILE_WINDOW_NAME))
+    {
+        ImGui::End();
+        return;
+    }
+
+    if (profile.nodes.empty())
+    {
+        ImGui::TextUnformatted("No samples yet.");
+        ImGui::End();
+        return;
+    }
+
+    ImGui::Text("%u samples, every %.1f ms", profile.samples, profile.interval_ms);
+
+    ImGui::SetNextItemWidth(ImGui::GetContentRegionAvail().x * 0.5f);
+    ImGui::InputText("##Path", panel.path, sizeof(panel.path));
+    ImGui::SameLine();
+
+    if (ImGui::Button("Export folded stacks"))
+    {
+        bx::snprintf(panel.status, sizeof(panel.status), profile.write_folded(panel.path)
+            ? "Wrote %s." : "Couldn't write %s.", panel.path);
+    }
+
+    if (panel.status[0])
+    {
+        ImGui::SameLine();
+        ImGui::TextUnformatted(panel.status);
+    }
+
+    // Flame graph.
+    {
+        const float  row_height = ImGui::GetTextLineHeight() + 2.0f;
+        const float  width      = ImGui::GetContentRegionAvail().x;
+        const ImVec2 origin     = ImGui::GetCursorScreenPos();
+        const float  height     = float(profile_depth(profile, 0)) * row_height;
+
+        const uint32_t hovered = draw_flame_node(
+            ImGui::GetWindowDrawList(), profile, 0, origin, 0.0f,
+            width / float(std::max(profile.nodes[0].samples, 1u)), row_height, 0
+        );
+
+        ImGui::Dummy({ width, height });
+
+        if (hovered != UINT32_MAX)
+        {
+            const ScriptProfileNode& node = profile.nodes[hovered];
+
+            ImGui::SetTooltip("%s\n%.1f%% total, %.1f%% self",
+                node.name.c_str(),
+                100.0 * double(node.samples     ) / double(std::max(profile.samples, 1u)),
+                100.0 * double(node.self_samples) / double(std::max(profile.samples, 1u))
+            );
+        }
+    }
+
+    // Hot lines, by self samples.
+    std::vector<uint32_t> lines;
+
+    for (uint32_t line = 1; line < profile.line_samples.size(); line++)
+    {
+        if (profile.line_samples[line])
+        {
+            lines.push_back(line);
+        }
+    }
+
+    std::sort(lines.begin(), lines.end(), [&](uint32_t a, uint32_t b)
+    {
+        return profile.line_samples[a] > profile.line_samples[b];
+    });
+
+    lines.resize(std::min<size_t>(lines.size(), 16));
+
+    constexpr ImGuiTableFlags table_flags =
+        ImGuiTableFlags_BordersInnerV |
+        ImGuiTableFlags_RowBg         |
+        ImGuiTableFlags_SizingFixedFit;
+
+    if (!lines.empty() && ImGui::BeginTable("##HotLines", 3, table_flags))
+    {
+        ImGui::TableSetupColumn("Line");
+        ImGui::TableSetupColumn("Self");
+        ImGui::TableSetupColumn("Source", ImGuiTableColumnFlags_WidthStretch);
+        ImGui::TableHeadersRow();
+
+        ImGui::PushMonospacedFont();
+
+        for (uint32_t line : lines)
+        {
+            ImGui::TableNextRow();
+
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", line);
+
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f%%", 100.0 * double(profile.line_samples[line]) / double(std::max(profile.samples, 1u)));
+
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(source_line(source, line).c_str());
+        }
+
+        ImGui::PopFont();
+        ImGui::EndTable();
+    }
+
+    ImGui::End();
+}
+
+
 // -----------------------------------------------------------------------------
 // MAIN APPLICATION RUNTIME
 // -----------------------------------------------------------------------------
@@ -306,6 +1348,9 @@ static int run(int, char**)
 
     defer(glfwTerminate());
 
+    task_pool_init();
+    defer(task_pool_shutdown());
+
     glfwDefaultWindowHints();
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     glfwWindowHint(GLFW_SCALE_TO_MONITOR, GLFW_TRUE); // NOTE : Ignored when `glfwSetWindowSize` called.
@@ -375,30 +1420,34 @@ static int run(int, char**)
     const bgfx::ProgramHandle program = bgfx::createProgram(vs, fs, true);
     defer(bgfx::destroy(program));
 
-    bgfx::VertexLayout vertex_layout;
-    vertex_layout
-        .begin()
-        .add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float)
-        .add(bgfx::Attrib::Color0,   4, bgfx::AttribType::Uint8, true)
-        .end();
+    SceneDoubleBuffer scenes;
+    defer(scenes.clear());
 
-    struct Vertex
-    {
-        glm::vec3 position;
-        uint32_t  color;
-    };
+#ifdef WITH_SHADERC_LIBRARY
+    SdfPreview sdf_preview;
+    sdf_preview.init();
+    defer(sdf_preview.shutdown());
+#endif
 
-    const Vertex vertices[] =
-    {
-        { {-0.6f, -0.4f, 0.0f}, 0xff0000ff },
-        { { 0.6f, -0.4f, 0.0f}, 0xff00ff00 },
-        { { 0.0f,  0.6f, 0.0f}, 0xffff0000 },
-    };
-    const bgfx::VertexBufferHandle vertex_buffer = bgfx::createVertexBuffer(
-        bgfx::makeRef(vertices, sizeof(vertices)),
-        vertex_layout
-    );
-    defer(bgfx::destroy(vertex_buffer));
+    ScriptOptions options = { .time_budget_ms = 10000.0, .native_code = true, .stream_parts = true, .profile_interval_ms = 1.0 };
+
+#ifdef WITH_SHADERC_LIBRARY
+    options.sdf_previews = true;
+#endif
+
+    ScriptEvaluator evaluator;
+    evaluator.init(bytecode_cache_directory());
+    evaluator.set_options(options);
+    defer(evaluator.shutdown());
+
+    ModelEditor editor;
+    editor.source = DEFAULT_MODEL_SOURCE;
+    evaluator.submit(editor.source);
+
+    ProfilePanel profile_panel;
+
+    SceneVisibility visibility;
+    VisibilityStats visibility_stats;
 
     bgfx::setViewClear(0 , BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, 0x303030ff, 1.0f, 0);
 
@@ -408,8 +1457,8 @@ static int run(int, char**)
 
     ArcballControls camera =
     {
-        .eye    = { 0.0f, 0.0f, 2.0f },
-        .target = { 0.0f, 0.0f, 0.0f },
+        .eye    = { 0.0f, 1.0f, 3.5f },
+        .target = { 0.0f, 0.5f, 0.0f },
     };
 
     // Program loop ------------------------------------------------------------
@@ -418,9 +1467,75 @@ static int run(int, char**)
         // Update inputs.
         glfwPollEvents();
 
+        // Take in streamed parts and swap in the latest finished scene. No
+        // other task uses them right now.
+        scenes.update(evaluator);
+
+#ifdef WITH_SHADERC_LIBRARY
+        sdf_preview.update(evaluator, scenes);
+#endif
+
+        const Scene& scene = scenes.visible();
+
+        // Update the evaluation status.
+        {
+            const ScriptResult& result = scenes.result;
+            const ScriptStats   stats  = evaluator.get_stats();
+
+            editor.has_error = !result.error.empty();
+
+            int32_t length = 0;
+
+            if (editor.has_error)
+            {
+                length = bx::snprintf(editor.status, sizeof(editor.status), "%s\n", result.error.c_str());
+            }
+            else
+            {
+                char bricks[64] = "";
+
+                if (result.sdf_brick_bytes)
+                {
+                    bx::snprintf(bricks, sizeof(bricks), ", SDF bricks %.0f KiB", double(result.sdf_brick_bytes) / 1024.0);
+                }
+
+                length = bx::snprintf(editor.status, sizeof(editor.status), "%u objects, evaluated in %.1f ms with %u tasks, %u of %u calls cached%s, VM peak %.0f KiB in %u allocations%s%s\n",
+                    uint32_t(scene.objects.size()),
+                    result.time_ms,
+                    result.tasks,
+                    result.cache_hits,
+                    result.cache_hits + result.cache_misses,
+                    result.bytecode_cached ? ", bytecode from disk" : "",
+                    double(result.memory_peak) / 1024.0,
+                    result.allocations,
+                    bricks,
+                    evaluator.is_busy() || scenes.building ? " (updating...)" : ""
+                );
+            }
+
+            length = bx::min<int32_t>(length, sizeof(editor.status) - 1);
+
+            bx::snprintf(editor.status + length, sizeof(editor.status) - length,
+                "Useful %.0f ms, wasted %.0f ms (%u cancelled, %u superseded), cancel latency %.2f ms (max %.2f ms)",
+                stats.useful_ms,
+                stats.wasted_ms,
+                stats.cancelled,
+                stats.superseded,
+                stats.last_cancel_latency_ms,
+                stats.max_cancel_latency_ms
+            );
+        }
+
         // Update ImGui.
         imgui_begin_frame();
-        const ImVec4 avail_viewport = update_editor_gui();
+        const ImVec4 avail_viewport = update_editor_gui(editor);
+        update_profile_gui(profile_panel, scenes.result.profile, editor.source);
+
+        // Restart the evaluation on edits.
+        if (editor.changed)
+        {
+            evaluator.submit(editor.source);
+        }
 
         // Update camera.
         {
@@ -463,6 +1578,59 @@ static int run(int, char**)
             }
         }
 
+        const float     aspect = avail_viewport.z / avail_viewport.w;
+        const glm::mat4 proj   = glm::perspective(glm::radians(60.0f), aspect, 0.1f, 100.0f);
+
+        // Cull the scene on the task pool while the main thread finishes the
+        // ImGui frame.
+        TaskCounter visibility_task;
+        task_run(visibility_task, [&, view_proj = proj * camera.view_matrix]()
+        {
+            // Same matrix as passed to `setViewTransform`.
+            visibility.update(scene, view_proj, camera.eye, aspect);
+        });
+
+        // Pick geometry under the mouse cursor.
+        {
+            Ray ray;
+            if (!ImGui::GetIO().WantCaptureMouse &&
+                make_picking_ray(avail_viewport, ImGui::GetMousePos(), proj * camera.view_matrix, ray))
+            {
+                uint32_t object;
+                RayHit   hit;
+
+                if (scene.pick(ray, object, hit))
+                {
+                    ImGui::SetTooltip("Object %u, triangle %u (distance %.3f)", object, hit.primitive, hit.t);
+                }
+            }
+        }
+
+        // Draw the culling counters in the viewport corner. They lag a frame
+        // behind, the current ones aren't ready yet.
+        {
+            char text[192];
+            bx::snprintf(text, sizeof(text),
+                "Drawn: %u, frustum culled: %u, occluded: %u (%u occluder triangles)\n"
+                "Clusters drawn: %u, culled: %u",
+                visibility_stats.drawn,
+                visibility_stats.frustum_culled,
+                visibility_stats.occluded,
+                visibility_stats.occluder_triangles,
+                visibility_stats.clusters_drawn,
+                visibility_stats.clusters_culled
+            );
+
+            ImGui::GetForegroundDrawList()->AddText(
+                { avail_viewport.x + 8.0f, avail_viewport.y + 8.0f },
+                IM_COL32(255, 255, 255, 160),
+                text
+            );
+        }
+
+        // Render and submit ImGui.
+        imgui_end_frame();
+
         // Set projection transform for the view.
         {
             const ImVec2 dpi = ImGui::GetIO().DisplayFramebufferScale;
@@ -474,28 +1642,82 @@ static int run(int, char**)
                 uint16_t(bx::round(dpi.y * avail_viewport.w))
             );
 
-            const float     aspect = avail_viewport.z / avail_viewport.w;
-            const glm::mat4 proj   = glm::perspective(glm::radians(60.0f), aspect, 0.1f, 100.0f);
-
             bgfx::setViewTransform(0, glm::value_ptr(camera.view_matrix), glm::value_ptr(proj));
 
             bgfx::touch(0);
         }
 
-        // Submit the triangle data.
+        // Submit the visible objects.
+        task_wait(visibility_task);
+
+        const ClusterDraw* cluster_draw = visibility.cluster_draws.data();
+
+        for (const uint32_t i : visibility.visible)
         {
-            // float transform[16];
-            // bx::mtxRotateZ(transform, float(glfwGetTime()));
+            const SceneObject& object = scene.objects[i];
+
+#ifdef WITH_SHADERC_LIBRARY
+            // Previewed instead, until its new mesh comes in.
+            if (sdf_preview.hidden[i])
+            {
+                cluster_draw += object.clusters.is_empty() ? 0 : 1;
+                continue;
+            }
+#endif
+
+            // Empty meshes have no buffers (nor clusters).
+            if (!bgfx::isValid(object.vertex_buffer))
+            {
+                continue;
+            }
 
-            // bgfx::setTransform(transform);
-            bgfx::setVertexBuffer(0, vertex_buffer); // NOTE : No index buffer.
+            // Clustered objects draw only their visible clusters, with indices
+            // compacted into a transient buffer. When that runs out of space
+            // for the frame, they are drawn whole.
+            if (!object.clusters.is_empty())
+            {
+                const ClusterDraw& draw = *cluster_draw++;
+
+                if (draw.index_count == 0)
+                {
+                    continue;
+                }
+
+                if (bgfx::getAvailTransientIndexBuffer(draw.index_count, true) == draw.index_count)
+                {
+                    bgfx::TransientIndexBuffer index_buffer;
+                    bgfx::allocTransientIndexBuffer(&index_buffer, draw.index_count, true);
+
+                    copy_cluster_indices(
+                        object.clusters,
+                        visibility.visible_clusters.data() + draw.first,
+                        draw.count,
+                        reinterpret_cast<uint32_t*>(index_buffer.data)
+                    );
+
+                    bgfx::setIndexBuffer(&index_buffer);
+                }
+                else
+                {
+                    bgfx::setIndexBuffer(object.index_buffer);
+                }
+            }
+            else
+            {
+                bgfx::setIndexBuffer(object.index_buffer);
+            }
+
+            bgfx::setVertexBuffer(0, object.vertex_buffer);
             bgfx::setState(BGFX_STATE_DEFAULT);
 
             bgfx::submit(0, program);
         }
 
-        // Render and submit ImGui.
-        imgui_end_frame();
+#ifdef WITH_SHADERC_LIBRARY
+        sdf_preview.submit(0, scenes.placements);
+#endif
+
+        visibility_stats = visibility.stats;
 
         // Submit recorded rendering operations.
         bgfx::frame();
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <stdint.h>    // uint32_t
+
+#include <vector>      // vector
+
+#include <glm/glm.hpp> // glm::*
+
+
+// -----------------------------------------------------------------------------
+// BOUNDING BOX
+// -----------------------------------------------------------------------------
+
+struct Aabb
+{
+    glm::vec3 min = glm::vec3( 1e30f);
+    glm::vec3 max = glm::vec3(-1e30f);
+
+    bool is_empty() const
+    {
+        return min.x > max.x || min.y > max.y || min.z > max.z;
+    }
+
+    glm::vec3 center() const
+    {
+        return (min + max) * 0.5f;
+    }
+
+    glm::vec3 extent() const
+    {
+        return max - min;
+    }
+
+    float surface_area() const
+    {
+        const glm::vec3 e = glm::max(extent(), glm::vec3(0.0f));
+
+        return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+
+    void extend(const glm::vec3& point)
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void extend(const Aabb& other)
+    {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+};
+
+
+// -----------------------------------------------------------------------------
+// STRUCTURE-OF-ARRAYS VIEWS
+// -----------------------------------------------------------------------------
+
+struct Float3Span
+{
+    float* x = nullptr;
+    float* y = nullptr;
+    float* z = nullptr;
+};
+
+struct ConstFloat3Span
+{
+    const float* x = nullptr;
+    const float* y = nullptr;
+    const float* z = nullptr;
+
+    ConstFloat3Span() = default;
+
+    ConstFloat3Span(const float* x, const float* y, const float* z)
+        : x(x)
+        , y(y)
+        , z(z)
+    {
+    }
+
+    ConstFloat3Span(const Float3Span& span)
+        : x(span.x)
+        , y(span.y)
+        , z(span.z)
+    {
+    }
+};
+
+
+// -----------------------------------------------------------------------------
+// TRIANGLE MESH
+// -----------------------------------------------------------------------------
+
+// Indexed triangle mesh with each vertex attribute component stored in its own
+// array, so that the batch kernels in `mesh_kernels.h` can process them in SIMD
+// lanes without shuffling. Normals are optional (empty when not computed).
+struct Mesh
+{
+    std::vector<float>    position_x;
+    std::vector<float>    position_y;
+    std::vector<float>    position_z;
+
+    std::vector<float>    normal_x;
+    std::vector<float>    normal_y;
+    std::vector<float>    normal_z;
+
+    std::vector<uint32_t> colors; // Optional ABGR per vertex.
+
+    std::vector<uint32_t> indices;
+
+    uint32_t vertex_count() const
+    {
+        return uint32_t(position_x.size());
+    }
+
+    uint32_t triangle_count() const
+    {
+        return uint32_t(indices.size() / 3);
+    }
+
+    bool has_normals() const
+    {
+        return !normal_x.empty();
+    }
+
+    bool has_colors() const
+    {
+        return !colors.empty();
+    }
+
+    Float3Span positions()
+    {
+        return { position_x.data(), position_y.data(), position_z.data() };
+    }
+
+    ConstFloat3Span positions() const
+    {
+        return { position_x.data(), position_y.data(), position_z.data() };
+    }
+
+    Float3Span normals()
+    {
+        return { normal_x.data(), normal_y.data(), normal_z.data() };
+    }
+
+    ConstFloat3Span normals() const
+    {
+        return { normal_x.data(), normal_y.data(), normal_z.data() };
+    }
+
+    glm::vec3 position(uint32_t i) const
+    {
+        return { position_x[i], position_y[i], position_z[i] };
+    }
+
+    uint32_t add_vertex(const glm::vec3& position)
+    {
+        position_x.push_back(position.x);
+        position_y.push_back(position.y);
+        position_z.push_back(position.z);
+
+        return vertex_count() - 1;
+    }
+
+    void add_triangle(uint32_t a, uint32_t b, uint32_t c)
+    {
+        indices.push_back(a);
+        indices.push_back(b);
+        indices.push_back(c);
+    }
+
+    void resize_normals()
+    {
+        normal_x.resize(position_x.size());
+        normal_y.resize(position_y.size());
+        normal_z.resize(position_z.size());
+    }
+
+    void clear()
+    {
+        position_x.clear();
+        position_y.clear();
+        position_z.clear();
+        normal_x  .clear();
+        normal_y  .clear();
+        normal_z  .clear();
+        colors    .clear();
+        indices   .clear();
+    }
+};
@@ -0,0 +1,256 @@
+#include "mesh_kernels.h"
+
+#include <bx/platform.h>            // BX_CPU_X86, BX_COMPILER_MSVC
+
+#include <glm/gtc/type_ptr.hpp>     // value_ptr
+
+#if BX_CPU_X86
+#   include <emmintrin.h>           // _mm_*
+#   if BX_COMPILER_MSVC
+#       include <intrin.h>          // __cpuid, _xgetbv
+#   else
+#       include <cpuid.h>           // __get_cpuid*
+#   endif
+#endif
+
+#include "mesh_kernels_impl.h"      // F1, MeshKernelTable, make_mesh_kernel_table
+
+
+// -----------------------------------------------------------------------------
+// SCALAR KERNELS
+// -----------------------------------------------------------------------------
+
+const MeshKernelTable g_mesh_kernels_scalar = make_mesh_kernel_table<F1>();
+
+
+// -----------------------------------------------------------------------------
+// SSE2 KERNELS
+// -----------------------------------------------------------------------------
+
+#if BX_CPU_X86
+
+namespace
+{
+
+struct F4
+{
+    static constexpr uint32_t width = 4;
+
+    __m128 v;
+
+    static F4 splat(float x)        { return { _mm_set1_ps(x) }; }
+    static F4 load (const float* p) { return { _mm_loadu_ps(p) }; }
+
+    static F4 gather(const float* p, const uint32_t* i)
+    {
+        return { _mm_setr_ps(p[i[0]], p[i[1]], p[i[2]], p[i[3]]) };
+    }
+
+    void store(float* p) const { _mm_storeu_ps(p, v); }
+
+    friend F4 operator+(F4 a, F4 b) { return { _mm_add_ps(a.v, b.v) }; }
+    friend F4 operator-(F4 a, F4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+    friend F4 operator*(F4 a, F4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+    friend F4 operator/(F4 a, F4 b) { return { _mm_div_ps(a.v, b.v) }; }
+
+    friend F4 min (F4 a, F4 b) { return { _mm_min_ps(a.v, b.v) }; }
+    friend F4 max (F4 a, F4 b) { return { _mm_max_ps(a.v, b.v) }; }
+    friend F4 sqrt(F4 a)       { return { _mm_sqrt_ps(a.v) }; }
+
+    friend F4 select_positive(F4 cond, F4 a, F4 b)
+    {
+        const __m128 mask = _mm_cmpgt_ps(cond.v, _mm_setzero_ps());
+
+        return { _mm_or_ps(_mm_and_ps(mask, a.v), _mm_andnot_ps(mask, b.v)) };
+    }
+};
+
+} // unnamed namespace
+
+const MeshKernelTable g_mesh_kernels_sse2 = make_mesh_kernel_table<F4>();
+
+#endif // BX_CPU_X86
+
+
+// -----------------------------------------------------------------------------
+// KERNEL DISPATCH
+// -----------------------------------------------------------------------------
+
+static bool cpu_supports_avx2()
+{
+#if BX_CPU_X86 && defined(WITH_AVX2)
+#   if BX_COMPILER_MSVC
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+        return false;
+    }
+
+    __cpuid(info, 1);
+    const bool fma     = (info[2] & (1 << 12)) != 0;
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+
+    __cpuidex(info, 7, 0);
+    const bool avx2 = (info[1] & (1 << 5)) != 0;
+
+    // The OS must preserve the YMM registers.
+    return fma && osxsave && avx2 && (_xgetbv(0) & 0x6) == 0x6;
+#   else
+    __builtin_cpu_init();
+
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#   endif
+#else
+    return false;
+#endif
+}
+
+static SimdLevel detect_simd_level()
+{
+    if (cpu_supports_avx2())
+    {
+        return SimdLevel::AVX2;
+    }
+
+    return BX_CPU_X86 ? SimdLevel::SSE2 : SimdLevel::SCALAR;
+}
+
+struct KernelDispatch
+{
+    SimdLevel              max_level = detect_simd_level();
+    SimdLevel              level     = max_level;
+    const MeshKernelTable* table     = nullptr;
+
+    KernelDispatch()
+    {
+        select(level);
+    }
+
+    void select(SimdLevel requested)
+    {
+        level = requested > max_level ? max_level : requested;
+
+        switch (level)
+        {
+#if BX_CPU_X86
+#   ifdef WITH_AVX2
+        case SimdLevel::AVX2:
+            table = &g_mesh_kernels_avx2;
+            break;
+#   endif
+        case SimdLevel::SSE2:
+            table = &g_mesh_kernels_sse2;
+            break;
+#endif
+        default:
+            table = &g_mesh_kernels_scalar;
+            break;
+        }
+    }
+};
+
+static KernelDispatch& get_dispatch()
+{
+    static KernelDispatch dispatch;
+
+    return dispatch;
+}
+
+SimdLevel get_simd_level()
+{
+    return get_dispatch().level;
+}
+
+SimdLevel get_max_simd_level()
+{
+    return get_dispatch().max_level;
+}
+
+void set_simd_level(SimdLevel level)
+{
+    get_dispatch().select(level);
+}
+
+const char* get_simd_level_name(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::SCALAR: return "Scalar";
+    case SimdLevel::SSE2  : return "SSE2";
+    case SimdLevel::AVX2  : return "AVX2";
+    }
+
+    return "Unknown";
+}
+
+
+// -----------------------------------------------------------------------------
+// PUBLIC API
+// -----------------------------------------------------------------------------
+
+static KernelIn3 to_kernel(ConstFloat3Span span)
+{
+    return { span.x, span.y, span.z };
+}
+
+static KernelOut3 to_kernel(Float3Span span)
+{
+    return { span.x, span.y, span.z };
+}
+
+void transform_points(const glm::mat4& matrix, ConstFloat3Span in, Float3Span out, uint32_t count)
+{
+    get_dispatch().table->transform_points(glm::value_ptr(matrix), to_kernel(in), to_kernel(out), count);
+}
+
+void transform_vectors(const glm::mat4& matrix, ConstFloat3Span in, Float3Span out, uint32_t count)
+{
+    get_dispatch().table->transform_vectors(glm::value_ptr(matrix), to_kernel(in), to_kernel(out), count);
+}
+
+void normalize_vectors(Float3Span vectors, uint32_t count)
+{
+    get_dispatch().table->normalize_vectors(to_kernel(vectors), count);
+}
+
+Aabb compute_aabb(ConstFloat3Span positions, uint32_t count)
+{
+    Aabb aabb;
+    get_dispatch().table->compute_aabb(to_kernel(positions), count, &aabb.min.x, &aabb.max.x);
+
+    return aabb;
+}
+
+void compute_face_normals(ConstFloat3Span positions, const uint32_t* indices, uint32_t triangle_count, Float3Span out_normals)
+{
+    get_dispatch().table->compute_face_normals(to_kernel(positions), indices, triangle_count, to_kernel(out_normals));
+}
+
+void compute_vertex_normals(ConstFloat3Span positions, uint32_t vertex_count, const uint32_t* indices, uint32_t triangle_count, Float3Span out_normals)
+{
+    get_dispatch().table->compute_vertex_normals(to_kernel(positions), vertex_count, indices, triangle_count, to_kernel(out_normals));
+}
+
+void compute_vertex_normals(Mesh& mesh)
+{
+    mesh.resize_normals();
+
+    compute_vertex_normals(
+        mesh.positions(),
+        mesh.vertex_count(),
+        mesh.indices.data(),
+        mesh.triangle_count(),
+        mesh.normals()
+    );
+}
+
+void evaluate_sdf_tape(const SdfInstruction* code, uint32_t code_size, const float* constants, uint32_t result, float* registers, ConstFloat3Span points, uint32_t count, float* out)
+{
+    get_dispatch().table->evaluate_sdf_tape(code, code_size, constants, result, registers, to_kernel(points), count, out);
+}
+
+void evaluate_sdf_tape_gradient(const SdfInstruction* code, uint32_t code_size, const float* constants, uint32_t result, float* registers, ConstFloat3Span points, uint32_t count, float* out, Float3Span out_gradients)
+{
+    get_dispatch().table->evaluate_sdf_tape_gradient(code, code_size, constants, result, registers, to_kernel(points), count, out, to_kernel(out_gradients));
+}
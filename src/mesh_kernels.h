@@ -0,0 +1,114 @@
+#pragma once
+
+#include <stdint.h>    // uint32_t
+
+#include <glm/glm.hpp> // mat4
+
+#include "mesh.h"      // Aabb, ConstFloat3Span, Float3Span
+#include "sdf_tape.h"  // SdfInstruction
+
+
+// -----------------------------------------------------------------------------
+// KERNEL DISPATCH
+// -----------------------------------------------------------------------------
+
+// Instruction set used by the batch kernels. The best supported level is picked
+// at the first kernel call; requesting an unsupported level falls back to the
+// best available one.
+enum struct SimdLevel
+{
+    SCALAR,
+    SSE2,
+    AVX2,
+};
+
+SimdLevel get_simd_level();
+
+SimdLevel get_max_simd_level();
+
+void set_simd_level(SimdLevel level);
+
+const char* get_simd_level_name(SimdLevel level);
+
+
+// -----------------------------------------------------------------------------
+// BATCH KERNELS
+// -----------------------------------------------------------------------------
+
+// All kernels operate on structure-of-arrays data. Input and output spans may
+// alias only if they are identical.
+
+// `out = matrix * vec4(in, 1)`. The bottom row of the matrix is ignored.
+void transform_points
+(
+    const glm::mat4& matrix,
+    ConstFloat3Span  in,
+    Float3Span       out,
+    uint32_t         count
+);
+
+// `out = mat3(matrix) * in`. Pass the inverse transpose to transform normals.
+void transform_vectors
+(
+    const glm::mat4& matrix,
+    ConstFloat3Span  in,
+    Float3Span       out,
+    uint32_t         count
+);
+
+// Zero-length vectors are left as zero.
+void normalize_vectors(Float3Span vectors, uint32_t count);
+
+Aabb compute_aabb(ConstFloat3Span positions, uint32_t count);
+
+// One unit normal per triangle (zero for degenerate triangles).
+void compute_face_normals
+(
+    ConstFloat3Span positions,
+    const uint32_t* indices,
+    uint32_t        triangle_count,
+    Float3Span      out_normals
+);
+
+// Angle-weighted pseudo-normals (Thürmer & Wüthrich); `out_normals` must hold
+// `vertex_count` entries and is overwritten.
+void compute_vertex_normals
+(
+    ConstFloat3Span positions,
+    uint32_t        vertex_count,
+    const uint32_t* indices,
+    uint32_t        triangle_count,
+    Float3Span      out_normals
+);
+
+// Convenience wrapper filling the mesh's own normal arrays.
+void compute_vertex_normals(Mesh& mesh);
+
+// Runs an SDF tape (see `SdfTape`) at `count` points, in batches of
+// `SDF_TAPE_BATCH`. `registers` must hold that many values per register.
+void evaluate_sdf_tape
+(
+    const SdfInstruction* code,
+    uint32_t              code_size,
+    const float*          constants,
+    uint32_t              result,
+    float*                registers,
+    ConstFloat3Span       points,
+    uint32_t              count,
+    float*                out
+);
+
+// Same, with the gradients by forward-mode differentiation, in the same pass.
+// `registers` must hold four times as many values.
+void evaluate_sdf_tape_gradient
+(
+    const SdfInstruction* code,
+    uint32_t              code_size,
+    const float*          constants,
+    uint32_t              result,
+    float*                registers,
+    ConstFloat3Span       points,
+    uint32_t              count,
+    float*                out,
+    Float3Span            out_gradients
+);
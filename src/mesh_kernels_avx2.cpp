@@ -0,0 +1,59 @@
+// Compiled with AVX2 and FMA code generation enabled (see `CMakeLists.txt`);
+// only ever called after the runtime check in `mesh_kernels.cpp`.
+
+#include <immintrin.h>         // _mm256_*
+
+#include "mesh_kernels_impl.h" // F1, MeshKernelTable, make_mesh_kernel_table
+
+
+// -----------------------------------------------------------------------------
+// AVX2 KERNELS
+// -----------------------------------------------------------------------------
+
+namespace
+{
+
+struct F8
+{
+    static constexpr uint32_t width = 8;
+
+    __m256 v;
+
+    static F8 splat(float x)        { return { _mm256_set1_ps(x) }; }
+    static F8 load (const float* p) { return { _mm256_loadu_ps(p) }; }
+
+    static F8 gather(const float* p, const uint32_t* i)
+    {
+        const __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(i));
+
+        return { _mm256_i32gather_ps(p, index, 4) };
+    }
+
+    void store(float* p) const { _mm256_storeu_ps(p, v); }
+
+    friend F8 operator+(F8 a, F8 b) { return { _mm256_add_ps(a.v, b.v) }; }
+    friend F8 operator-(F8 a, F8 b) { return { _mm256_sub_ps(a.v, b.v) }; }
+    friend F8 operator*(F8 a, F8 b) { return { _mm256_mul_ps(a.v, b.v) }; }
+    friend F8 operator/(F8 a, F8 b) { return { _mm256_div_ps(a.v, b.v) }; }
+
+    friend F8 min (F8 a, F8 b) { return { _mm256_min_ps(a.v, b.v) }; }
+    friend F8 max (F8 a, F8 b) { return { _mm256_max_ps(a.v, b.v) }; }
+    friend F8 sqrt(F8 a)       { return { _mm256_sqrt_ps(a.v) }; }
+
+    friend F8 select_positive(F8 cond, F8 a, F8 b)
+    {
+        const __m256 mask = _mm256_cmp_ps(cond.v, _mm256_setzero_ps(), _CMP_GT_OQ);
+
+        return { _mm256_blendv_ps(b.v, a.v, mask) };
+    }
+};
+
+template <>
+F8 mul_add<F8>(F8 a, F8 b, F8 c)
+{
+    return { _mm256_fmadd_ps(a.v, b.v, c.v) };
+}
+
+} // unnamed namespace
+
+const MeshKernelTable g_mesh_kernels_avx2 = make_mesh_kernel_table<F8>();
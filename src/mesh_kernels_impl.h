@@ -0,0 +1,875 @@
+#pragma once
+
+// Private header shared by the per-instruction-set kernel translation units.
+// Everything below the table declaration lives in an unnamed namespace on
+// purpose: the AVX2 unit is compiled with different code generation flags, so
+// no inline function may be shared (and ODR-merged) across the units. For the
+// same reason, only C headers are included here.
+
+#include <math.h>     // cosf, floorf, sinf, sqrtf
+#include <stdint.h>   // uint32_t
+#include <string.h>   // memcpy, memset
+
+#include "sdf_tape.h" // SDF_TAPE_BATCH, SdfCode, SdfInstruction
+
+
+// -----------------------------------------------------------------------------
+// DISPATCH TABLE
+// -----------------------------------------------------------------------------
+
+struct KernelIn3
+{
+    const float* x;
+    const float* y;
+    const float* z;
+};
+
+struct KernelOut3
+{
+    float* x;
+    float* y;
+    float* z;
+};
+
+struct MeshKernelTable
+{
+    void (*transform_points          )(const float* matrix, KernelIn3 in, KernelOut3 out, uint32_t count);
+    void (*transform_vectors         )(const float* matrix, KernelIn3 in, KernelOut3 out, uint32_t count);
+    void (*normalize_vectors         )(KernelOut3 vectors, uint32_t count);
+    void (*compute_aabb              )(KernelIn3 positions, uint32_t count, float* out_min, float* out_max);
+    void (*compute_face_normals      )(KernelIn3 positions, const uint32_t* indices, uint32_t triangle_count, KernelOut3 out);
+    void (*compute_vertex_normals    )(KernelIn3 positions, uint32_t vertex_count, const uint32_t* indices, uint32_t triangle_count, KernelOut3 out);
+    void (*evaluate_sdf_tape         )(const SdfInstruction* code, uint32_t code_size, const float* constants, uint32_t result, float* registers, KernelIn3 points, uint32_t count, float* out);
+    void (*evaluate_sdf_tape_gradient)(const SdfInstruction* code, uint32_t code_size, const float* constants, uint32_t result, float* registers, KernelIn3 points, uint32_t count, float* out, KernelOut3 out_gradients);
+};
+
+extern const MeshKernelTable g_mesh_kernels_scalar;
+
+extern const MeshKernelTable g_mesh_kernels_sse2;
+
+extern const MeshKernelTable g_mesh_kernels_avx2;
+
+namespace
+{
+
+// -----------------------------------------------------------------------------
+// SCALAR LANE
+// -----------------------------------------------------------------------------
+
+// Every lane type provides the same minimal interface, so that the kernels
+// below can be written once and instantiated per instruction set. `F1` is also
+// used to process the tails of the wider types.
+struct F1
+{
+    static constexpr uint32_t width = 1;
+
+    float v;
+
+    static F1 splat(float x)                          { return { x }; }
+    static F1 load (const float* p)                   { return { *p }; }
+    static F1 gather(const float* p, const uint32_t* i) { return { p[*i] }; }
+
+    void store(float* p) const { *p = v; }
+
+    friend F1 operator+(F1 a, F1 b) { return { a.v + b.v }; }
+    friend F1 operator-(F1 a, F1 b) { return { a.v - b.v }; }
+    friend F1 operator*(F1 a, F1 b) { return { a.v * b.v }; }
+    friend F1 operator/(F1 a, F1 b) { return { a.v / b.v }; }
+
+    friend F1 min (F1 a, F1 b) { return { a.v < b.v ? a.v : b.v }; }
+    friend F1 max (F1 a, F1 b) { return { a.v > b.v ? a.v : b.v }; }
+    friend F1 sqrt(F1 a)       { return { sqrtf(a.v) }; }
+
+    // `cond > 0 ? a : b`, false for NaN.
+    friend F1 select_positive(F1 cond, F1 a, F1 b) { return { cond.v > 0.0f ? a.v : b.v }; }
+};
+
+
+// -----------------------------------------------------------------------------
+// GENERIC HELPERS
+// -----------------------------------------------------------------------------
+
+// Fused, with a single rounding, where the lane type specializes it (AVX2), so
+// results may differ in the last bits between instruction sets.
+template <typename V>
+static V mul_add(V a, V b, V c)
+{
+    return a * b + c;
+}
+
+// Returns zero instead of infinity for non-positive inputs.
+template <typename V>
+static V safe_rsqrt(V x)
+{
+    return select_positive(x, V::splat(1.0f) / sqrt(x), V::splat(0.0f));
+}
+
+// Abramowitz & Stegun 4.4.45, absolute error below 7e-5 rad. Used by all lane
+// types rather than their own `acos`, so that the error bound is the same for
+// every instruction set; results still differ by rounding (see `mul_add`).
+template <typename V>
+static V acos_approx(V x)
+{
+    const V one = V::splat(1.0f);
+    const V ax  = min(max(x, V::splat(0.0f) - x), one);
+
+    V poly = V::splat(-0.0187293f);
+    poly   = mul_add(poly, ax, V::splat( 0.0742610f));
+    poly   = mul_add(poly, ax, V::splat(-0.2121144f));
+    poly   = mul_add(poly, ax, V::splat( 1.5707288f));
+
+    const V r = sqrt(one - ax) * poly;
+
+    return select_positive(V::splat(0.0f) - x, V::splat(3.14159265f) - r, r);
+}
+
+template <typename V>
+static void cross(V ax, V ay, V az, V bx, V by, V bz, V& cx, V& cy, V& cz)
+{
+    cx = ay * bz - az * by;
+    cy = az * bx - ax * bz;
+    cz = ax * by - ay * bx;
+}
+
+template <typename V>
+static V absolute(V x)
+{
+    return max(x, V::splat(0.0f) - x);
+}
+
+template <typename V>
+static V length(V x, V y)
+{
+    return sqrt(x * x + y * y);
+}
+
+template <typename V>
+static V length(V x, V y, V z)
+{
+    return sqrt(x * x + y * y + z * z);
+}
+
+// Applies a scalar function lane by lane, for what the lane types don't have.
+template <typename V, typename Function>
+static V per_lane(V x, const Function& function)
+{
+    float lanes[V::width];
+    x.store(lanes);
+
+    for (uint32_t i = 0; i < V::width; i++)
+    {
+        lanes[i] = function(lanes[i]);
+    }
+
+    return V::load(lanes);
+}
+
+
+// -----------------------------------------------------------------------------
+// KERNEL BODIES
+// -----------------------------------------------------------------------------
+
+// Each body processes the half-open range `[begin, end)`, which must be a
+// multiple of `V::width` in length.
+
+template <typename V>
+static void transform_points_range(const float* m, KernelIn3 in, KernelOut3 out, uint32_t begin, uint32_t end)
+{
+    const V m00 = V::splat(m[0]), m01 = V::splat(m[4]), m02 = V::splat(m[ 8]), m03 = V::splat(m[12]);
+    const V m10 = V::splat(m[1]), m11 = V::splat(m[5]), m12 = V::splat(m[ 9]), m13 = V::splat(m[13]);
+    const V m20 = V::splat(m[2]), m21 = V::splat(m[6]), m22 = V::splat(m[10]), m23 = V::splat(m[14]);
+
+    for (uint32_t i = begin; i < end; i += V::width)
+    {
+        const V x = V::load(in.x + i);
+        const V y = V::load(in.y + i);
+        const V z = V::load(in.z + i);
+
+        mul_add(m00, x, mul_add(m01, y, mul_add(m02, z, m03))).store(out.x + i);
+        mul_add(m10, x, mul_add(m11, y, mul_add(m12, z, m13))).store(out.y + i);
+        mul_add(m20, x, mul_add(m21, y, mul_add(m22, z, m23))).store(out.z + i);
+    }
+}
+
+template <typename V>
+static void transform_vectors_range(const float* m, KernelIn3 in, KernelOut3 out, uint32_t begin, uint32_t end)
+{
+    const V m00 = V::splat(m[0]), m01 = V::splat(m[4]), m02 = V::splat(m[ 8]);
+    const V m10 = V::splat(m[1]), m11 = V::splat(m[5]), m12 = V::splat(m[ 9]);
+    const V m20 = V::splat(m[2]), m21 = V::splat(m[6]), m22 = V::splat(m[10]);
+
+    for (uint32_t i = begin; i < end; i += V::width)
+    {
+        const V x = V::load(in.x + i);
+        const V y = V::load(in.y + i);
+        const V z = V::load(in.z + i);
+
+        mul_add(m00, x, mul_add(m01, y, m02 * z)).store(out.x + i);
+        mul_add(m10, x, mul_add(m11, y, m12 * z)).store(out.y + i);
+        mul_add(m20, x, mul_add(m21, y, m22 * z)).store(out.z + i);
+    }
+}
+
+template <typename V>
+static void normalize_vectors_range(KernelOut3 v, uint32_t begin, uint32_t end)
+{
+    for (uint32_t i = begin; i < end; i += V::width)
+    {
+        const V x = V::load(v.x + i);
+        const V y = V::load(v.y + i);
+        const V z = V::load(v.z + i);
+
+        const V s = safe_rsqrt(mul_add(x, x, mul_add(y, y, z * z)));
+
+        (x * s).store(v.x + i);
+        (y * s).store(v.y + i);
+        (z * s).store(v.z + i);
+    }
+}
+
+template <typename V>
+static void compute_aabb_range(KernelIn3 in, uint32_t begin, uint32_t end, float* out_min, float* out_max)
+{
+    V min_x = V::splat(out_min[0]), min_y = V::splat(out_min[1]), min_z = V::splat(out_min[2]);
+    V max_x = V::splat(out_max[0]), max_y = V::splat(out_max[1]), max_z = V::splat(out_max[2]);
+
+    for (uint32_t i = begin; i < end; i += V::width)
+    {
+        const V x = V::load(in.x + i);
+        const V y = V::load(in.y + i);
+        const V z = V::load(in.z + i);
+
+        min_x = min(min_x, x); max_x = max(max_x, x);
+        min_y = min(min_y, y); max_y = max(max_y, y);
+        min_z = min(min_z, z); max_z = max(max_z, z);
+    }
+
+    float lanes[6][V::width];
+    min_x.store(lanes[0]); min_y.store(lanes[1]); min_z.store(lanes[2]);
+    max_x.store(lanes[3]); max_y.store(lanes[4]); max_z.store(lanes[5]);
+
+    for (uint32_t i = 0; i < V::width; i++)
+    {
+        for (uint32_t j = 0; j < 3; j++)
+        {
+            out_min[j] = lanes[j    ][i] < out_min[j] ? lanes[j    ][i] : out_min[j];
+            out_max[j] = lanes[j + 3][i] > out_max[j] ? lanes[j + 3][i] : out_max[j];
+        }
+    }
+}
+
+// Loads the corners of `V::width` consecutive triangles starting at `t`.
+template <typename V>
+struct TriangleBatch
+{
+    V ax, ay, az;
+    V bx, by, bz;
+    V cx, cy, cz;
+
+    TriangleBatch(KernelIn3 p, const uint32_t* indices, uint32_t t)
+    {
+        uint32_t ia[V::width], ib[V::width], ic[V::width];
+
+        for (uint32_t i = 0; i < V::width; i++)
+        {
+            ia[i] = indices[(t + i) * 3 + 0];
+            ib[i] = indices[(t + i) * 3 + 1];
+            ic[i] = indices[(t + i) * 3 + 2];
+        }
+
+        ax = V::gather(p.x, ia); ay = V::gather(p.y, ia); az = V::gather(p.z, ia);
+        bx = V::gather(p.x, ib); by = V::gather(p.y, ib); bz = V::gather(p.z, ib);
+        cx = V::gather(p.x, ic); cy = V::gather(p.y, ic); cz = V::gather(p.z, ic);
+    }
+};
+
+template <typename V>
+static void compute_face_normals_range(KernelIn3 p, const uint32_t* indices, KernelOut3 out, uint32_t begin, uint32_t end)
+{
+    for (uint32_t t = begin; t < end; t += V::width)
+    {
+        const TriangleBatch<V> tri(p, indices, t);
+
+        V nx, ny, nz;
+        cross(
+            tri.bx - tri.ax, tri.by - tri.ay, tri.bz - tri.az,
+            tri.cx - tri.ax, tri.cy - tri.ay, tri.cz - tri.az,
+            nx, ny, nz
+        );
+
+        const V s = safe_rsqrt(mul_add(nx, nx, mul_add(ny, ny, nz * nz)));
+
+        (nx * s).store(out.x + t);
+        (ny * s).store(out.y + t);
+        (nz * s).store(out.z + t);
+    }
+}
+
+// Adds each triangle's unit normal, weighted by the corner angle, to its three
+// vertices. The arithmetic is vectorized; the scatter is not (indices within a
+// batch may collide).
+template <typename V>
+static void accumulate_vertex_normals_range(KernelIn3 p, const uint32_t* indices, KernelOut3 out, uint32_t begin, uint32_t end)
+{
+    for (uint32_t t = begin; t < end; t += V::width)
+    {
+        const TriangleBatch<V> tri(p, indices, t);
+
+        const V e0x = tri.bx - tri.ax, e0y = tri.by - tri.ay, e0z = tri.bz - tri.az; // a -> b
+        const V e1x = tri.cx - tri.bx, e1y = tri.cy - tri.by, e1z = tri.cz - tri.bz; // b -> c
+        const V e2x = tri.ax - tri.cx, e2y = tri.ay - tri.cy, e2z = tri.az - tri.cz; // c -> a
+
+        const V l0 = mul_add(e0x, e0x, mul_add(e0y, e0y, e0z * e0z));
+        const V l1 = mul_add(e1x, e1x, mul_add(e1y, e1y, e1z * e1z));
+        const V l2 = mul_add(e2x, e2x, mul_add(e2y, e2y, e2z * e2z));
+
+        const V zero = V::splat(0.0f);
+
+        // Corner angle cosines are dot products of the negated incoming and the
+        // outgoing edge.
+        const V cos_a = (zero - mul_add(e2x, e0x, mul_add(e2y, e0y, e2z * e0z))) * safe_rsqrt(l2 * l0);
+        const V cos_b = (zero - mul_add(e0x, e1x, mul_add(e0y, e1y, e0z * e1z))) * safe_rsqrt(l0 * l1);
+        const V cos_c = (zero - mul_add(e1x, e2x, mul_add(e1y, e2y, e1z * e2z))) * safe_rsqrt(l1 * l2);
+
+        V nx, ny, nz;
+        cross(e0x, e0y, e0z, zero - e2x, zero - e2y, zero - e2z, nx, ny, nz);
+
+        const V s = safe_rsqrt(mul_add(nx, nx, mul_add(ny, ny, nz * nz)));
+
+        float lanes[6][V::width];
+        (nx * s).store(lanes[0]);
+        (ny * s).store(lanes[1]);
+        (nz * s).store(lanes[2]);
+        acos_approx(cos_a).store(lanes[3]);
+        acos_approx(cos_b).store(lanes[4]);
+        acos_approx(cos_c).store(lanes[5]);
+
+        for (uint32_t i = 0; i < V::width; i++)
+        {
+            for (uint32_t j = 0; j < 3; j++)
+            {
+                const uint32_t v = indices[(t + i) * 3 + j];
+                const float    w = lanes[3 + j][i];
+
+                out.x[v] += w * lanes[0][i];
+                out.y[v] += w * lanes[1][i];
+                out.z[v] += w * lanes[2][i];
+            }
+        }
+    }
+}
+
+
+// -----------------------------------------------------------------------------
+// SDF TAPE
+// -----------------------------------------------------------------------------
+
+// Value and gradient, for forward-mode differentiation: every operation also
+// applies the chain rule to the partial derivatives. Spans four rows of a
+// register, `SDF_TAPE_BATCH` values apart.
+template <typename V>
+struct SdfDual
+{
+    static constexpr uint32_t width = V::width;
+
+    V v;
+    V dx;
+    V dy;
+    V dz;
+
+    static SdfDual splat(float x)
+    {
+        const V zero = V::splat(0.0f);
+
+        return { V::splat(x), zero, zero, zero };
+    }
+
+    static SdfDual load(const float* p)
+    {
+        return { V::load(p), V::load(p + SDF_TAPE_BATCH), V::load(p + 2 * SDF_TAPE_BATCH), V::load(p + 3 * SDF_TAPE_BATCH) };
+    }
+
+    void store(float* p) const
+    {
+        v .store(p);
+        dx.store(p +     SDF_TAPE_BATCH);
+        dy.store(p + 2 * SDF_TAPE_BATCH);
+        dz.store(p + 3 * SDF_TAPE_BATCH);
+    }
+
+    friend SdfDual operator+(SdfDual a, SdfDual b) { return { a.v + b.v, a.dx + b.dx, a.dy + b.dy, a.dz + b.dz }; }
+    friend SdfDual operator-(SdfDual a, SdfDual b) { return { a.v - b.v, a.dx - b.dx, a.dy - b.dy, a.dz - b.dz }; }
+
+    friend SdfDual operator*(SdfDual a, SdfDual b)
+    {
+        return { a.v * b.v, a.dx * b.v + a.v * b.dx, a.dy * b.v + a.v * b.dy, a.dz * b.v + a.v * b.dz };
+    }
+
+    friend SdfDual operator/(SdfDual a, SdfDual b)
+    {
+        const V q = a.v / b.v;
+
+        return { q, (a.dx - q * b.dx) / b.v, (a.dy - q * b.dy) / b.v, (a.dz - q * b.dz) / b.v };
+    }
+
+    // Zero gradient where the value is zero, like `safe_rsqrt`.
+    friend SdfDual sqrt(SdfDual a)
+    {
+        const V s = safe_rsqrt(a.v) * V::splat(0.5f);
+
+        return { sqrt(a.v), a.dx * s, a.dy * s, a.dz * s };
+    }
+
+    // The gradient follows the value chosen.
+    friend SdfDual select_positive(V cond, SdfDual a, SdfDual b)
+    {
+        return
+        {
+            select_positive(cond, a.v , b.v ),
+            select_positive(cond, a.dx, b.dx),
+            select_positive(cond, a.dy, b.dy),
+            select_positive(cond, a.dz, b.dz),
+        };
+    }
+
+    // Ties go to `a`, so that where a primitive's clamp against a constant is
+    // exactly met, as on the surface of a box, the gradient isn't lost.
+    friend SdfDual min(SdfDual a, SdfDual b) { return select_positive(a.v - b.v, b, a); }
+    friend SdfDual max(SdfDual a, SdfDual b) { return select_positive(b.v - a.v, b, a); }
+};
+
+// Rows per register.
+template <typename T>
+struct SdfRows
+{
+    static constexpr uint32_t value = 1;
+};
+
+template <typename V>
+struct SdfRows<SdfDual<V>>
+{
+    static constexpr uint32_t value = 4;
+};
+
+template <typename V>
+static V floor_lanes(V x)
+{
+    return per_lane(x, floorf);
+}
+
+template <typename V>
+static V cos_lanes(V x)
+{
+    return per_lane(x, cosf);
+}
+
+template <typename V>
+static V sin_lanes(V x)
+{
+    return per_lane(x, sinf);
+}
+
+// Flat almost everywhere.
+template <typename V>
+static SdfDual<V> floor_lanes(SdfDual<V> x)
+{
+    const V zero = V::splat(0.0f);
+
+    return { floor_lanes(x.v), zero, zero, zero };
+}
+
+template <typename V>
+static SdfDual<V> cos_lanes(SdfDual<V> x)
+{
+    const V d = V::splat(0.0f) - sin_lanes(x.v);
+
+    return { cos_lanes(x.v), x.dx * d, x.dy * d, x.dz * d };
+}
+
+template <typename V>
+static SdfDual<V> sin_lanes(SdfDual<V> x)
+{
+    const V d = cos_lanes(x.v);
+
+    return { sin_lanes(x.v), x.dx * d, x.dy * d, x.dz * d };
+}
+
+// Same formulas as `SdfTree::evaluate`, except for the plain products and sums
+// that code generation may fuse.
+template <typename T>
+static T smooth_min(T a, T b, T k)
+{
+    const T h = max(k - absolute(a - b), T::splat(0.0f)) / k;
+
+    return min(a, b) - h * h * k * T::splat(0.25f);
+}
+
+// Runs one instruction over a whole batch; the dispatch happens once per batch
+// rather than per point. `T` is a lane type, or `SdfDual` of one to carry the
+// gradient along.
+template <typename T>
+static void run_sdf_instruction(const SdfInstruction& instruction, const float* c, float* registers)
+{
+    const size_t stride = SdfRows<T>::value * SDF_TAPE_BATCH; // Between registers.
+
+    const float* a   = registers + instruction.a   * stride;
+    const float* b   = registers + instruction.b   * stride;
+    float*       out = registers + instruction.out * stride;
+
+    // The three coordinates of points are in consecutive registers.
+    const auto x = [&](const float* r, uint32_t i) { return T::load(r              + i); };
+    const auto y = [&](const float* r, uint32_t i) { return T::load(r +     stride + i); };
+    const auto z = [&](const float* r, uint32_t i) { return T::load(r + 2 * stride + i); };
+
+    const auto for_each_vector = [](const auto& function)
+    {
+        for (uint32_t i = 0; i < SDF_TAPE_BATCH; i += T::width)
+        {
+            function(i);
+        }
+    };
+
+    const T zero = T::splat(0.0f);
+
+    switch (instruction.code)
+    {
+    case SdfCode::AFFINE:
+        for_each_vector([&](uint32_t i)
+        {
+            const T px = x(a, i), py = y(a, i), pz = z(a, i);
+
+            (T::splat(c[0]) * px + T::splat(c[1]) * py + T::splat(c[ 2]) * pz + T::splat(c[ 3])).store(out              + i);
+            (T::splat(c[4]) * px + T::splat(c[5]) * py + T::splat(c[ 6]) * pz + T::splat(c[ 7])).store(out +     stride + i);
+            (T::splat(c[8]) * px + T::splat(c[9]) * py + T::splat(c[10]) * pz + T::splat(c[11])).store(out + 2 * stride + i);
+        });
+        break;
+
+    case SdfCode::REPEAT:
+        for (uint32_t axis = 0; axis < 3; axis++)
+        {
+            const float* in     = a   + axis * stride;
+            float*       result = out + axis * stride;
+            const float  period = c[axis];
+
+            if (period > 0.0f)
+            {
+                for_each_vector([&](uint32_t i)
+                {
+                    const T p = T::load(in + i);
+
+                    (p - T::splat(period) * floor_lanes(p / T::splat(period) + T::splat(0.5f))).store(result + i);
+                });
+            }
+            else
+            {
+                memcpy(result, in, stride * sizeof(float));
+            }
+        }
+        break;
+
+    case SdfCode::MIRROR:
+        for (uint32_t axis = 0; axis < 3; axis++)
+        {
+            const float* in     = a   + axis * stride;
+            float*       result = out + axis * stride;
+
+            if (c[axis] != 0.0f)
+            {
+                for_each_vector([&](uint32_t i)
+                {
+                    absolute(T::load(in + i)).store(result + i);
+                });
+            }
+            else
+            {
+                memcpy(result, in, stride * sizeof(float));
+            }
+        }
+        break;
+
+    case SdfCode::TWIST:
+        for_each_vector([&](uint32_t i)
+        {
+            const T px    = x(a, i), py = y(a, i), pz = z(a, i);
+            const T angle = T::splat(c[0]) * py;
+            const T cs    = cos_lanes(angle);
+            const T sn    = sin_lanes(angle);
+
+            (cs * px - sn * pz).store(out              + i);
+            py                 .store(out +     stride + i);
+            (sn * px + cs * pz).store(out + 2 * stride + i);
+        });
+        break;
+
+    case SdfCode::SPHERE:
+        for_each_vector([&](uint32_t i)
+        {
+            (length(x(a, i), y(a, i), z(a, i)) - T::splat(c[0])).store(out + i);
+        });
+        break;
+
+    case SdfCode::BOX:
+        for_each_vector([&](uint32_t i)
+        {
+            const T qx = absolute(x(a, i)) - T::splat(c[0]);
+            const T qy = absolute(y(a, i)) - T::splat(c[1]);
+            const T qz = absolute(z(a, i)) - T::splat(c[2]);
+
+            const T outside = length(max(qx, zero), max(qy, zero), max(qz, zero));
+            const T inside  = min(max(qx, max(qy, qz)), zero);
+
+            (outside + inside - T::splat(c[3])).store(out + i);
+        });
+        break;
+
+    case SdfCode::CYLINDER:
+        for_each_vector([&](uint32_t i)
+        {
+            const T dx = length(x(a, i), z(a, i)) - T::splat(c[0]);
+            const T dy = absolute(y(a, i)) - T::splat(c[1]);
+
+            (min(max(dx, dy), zero) + length(max(dx, zero), max(dy, zero))).store(out + i);
+        });
+        break;
+
+    case SdfCode::TORUS:
+        for_each_vector([&](uint32_t i)
+        {
+            (length(length(x(a, i), z(a, i)) - T::splat(c[0]), y(a, i)) - T::splat(c[1])).store(out + i);
+        });
+        break;
+
+    case SdfCode::CAPSULE:
+        for_each_vector([&](uint32_t i)
+        {
+            const T py = y(a, i);
+            const T h  = T::splat(c[1]);
+
+            (length(x(a, i), py - min(max(py, zero - h), h), z(a, i)) - T::splat(c[0])).store(out + i);
+        });
+        break;
+
+    case SdfCode::PLANE:
+        for_each_vector([&](uint32_t i)
+        {
+            (x(a, i) * T::splat(c[0]) + y(a, i) * T::splat(c[1]) + z(a, i) * T::splat(c[2]) - T::splat(c[3])).store(out + i);
+        });
+        break;
+
+    case SdfCode::MIN:
+        for_each_vector([&](uint32_t i)
+        {
+            min(T::load(a + i), T::load(b + i)).store(out + i);
+        });
+        break;
+
+    case SdfCode::MAX:
+        for_each_vector([&](uint32_t i)
+        {
+            max(T::load(a + i), T::load(b + i)).store(out + i);
+        });
+        break;
+
+    case SdfCode::SUBTRACT:
+        for_each_vector([&](uint32_t i)
+        {
+            max(T::load(a + i), zero - T::load(b + i)).store(out + i);
+        });
+        break;
+
+    case SdfCode::SMOOTH_UNION:
+        for_each_vector([&](uint32_t i)
+        {
+            smooth_min(T::load(a + i), T::load(b + i), T::splat(c[0])).store(out + i);
+        });
+        break;
+
+    case SdfCode::SMOOTH_INTERSECT:
+        for_each_vector([&](uint32_t i)
+        {
+            (zero - smooth_min(zero - T::load(a + i), zero - T::load(b + i), T::splat(c[0]))).store(out + i);
+        });
+        break;
+
+    case SdfCode::SMOOTH_SUBTRACT:
+        for_each_vector([&](uint32_t i)
+        {
+            (zero - smooth_min(zero - T::load(a + i), T::load(b + i), T::splat(c[0]))).store(out + i);
+        });
+        break;
+
+    case SdfCode::MUL:
+        for_each_vector([&](uint32_t i)
+        {
+            (T::load(a + i) * T::splat(c[0])).store(out + i);
+        });
+        break;
+
+    case SdfCode::ADD:
+        for_each_vector([&](uint32_t i)
+        {
+            (T::load(a + i) + T::splat(c[0])).store(out + i);
+        });
+        break;
+
+    case SdfCode::SHELL:
+        for_each_vector([&](uint32_t i)
+        {
+            (absolute(T::load(a + i)) + T::splat(c[0])).store(out + i);
+        });
+        break;
+    }
+}
+
+// The points of the last batch are padded with copies of the last point, so
+// that every point runs through `V`, and gets the same result wherever it is
+// in the input.
+template <typename V>
+static void evaluate_sdf_tape_kernel(const SdfInstruction* code, uint32_t code_size, const float* constants, uint32_t result, float* registers, KernelIn3 points, uint32_t count, float* out)
+{
+    static_assert(SDF_TAPE_BATCH % V::width == 0, "Batches must be whole vectors.");
+
+    for (uint32_t begin = 0; begin < count; begin += SDF_TAPE_BATCH)
+    {
+        const uint32_t size = count - begin < SDF_TAPE_BATCH ? count - begin : SDF_TAPE_BATCH;
+
+        for (uint32_t i = 0; i < SDF_TAPE_BATCH; i++)
+        {
+            const uint32_t point = begin + (i < size ? i : size - 1);
+
+            registers[                     i] = points.x[point];
+            registers[    SDF_TAPE_BATCH + i] = points.y[point];
+            registers[2 * SDF_TAPE_BATCH + i] = points.z[point];
+        }
+
+        for (uint32_t i = 0; i < code_size; i++)
+        {
+            run_sdf_instruction<V>(code[i], constants + code[i].constants, registers);
+        }
+
+        memcpy(out + begin, registers + size_t(result) * SDF_TAPE_BATCH, size * sizeof(float));
+    }
+}
+
+// Same as above, with the gradients as well; the point's coordinates start out
+// with unit partial derivatives along their own axes.
+template <typename V>
+static void evaluate_sdf_tape_gradient_kernel(const SdfInstruction* code, uint32_t code_size, const float* constants, uint32_t result, float* registers, KernelIn3 points, uint32_t count, float* out, KernelOut3 out_gradients)
+{
+    const size_t stride = 4 * SDF_TAPE_BATCH;
+
+    memset(registers, 0, 3 * stride * sizeof(float));
+
+    for (uint32_t axis = 0; axis < 3; axis++)
+    {
+        for (uint32_t i = 0; i < SDF_TAPE_BATCH; i++)
+        {
+            registers[axis * stride + (axis + 1) * SDF_TAPE_BATCH + i] = 1.0f;
+        }
+    }
+
+    for (uint32_t begin = 0; begin < count; begin += SDF_TAPE_BATCH)
+    {
+        const uint32_t size = count - begin < SDF_TAPE_BATCH ? count - begin : SDF_TAPE_BATCH;
+
+        for (uint32_t i = 0; i < SDF_TAPE_BATCH; i++)
+        {
+            const uint32_t point = begin + (i < size ? i : size - 1);
+
+            registers[             i] = points.x[point];
+            registers[    stride + i] = points.y[point];
+            registers[2 * stride + i] = points.z[point];
+        }
+
+        for (uint32_t i = 0; i < code_size; i++)
+        {
+            run_sdf_instruction<SdfDual<V>>(code[i], constants + code[i].constants, registers);
+        }
+
+        const float* value = registers + result * stride;
+
+        memcpy(out             + begin, value                     , size * sizeof(float));
+        memcpy(out_gradients.x + begin, value +     SDF_TAPE_BATCH, size * sizeof(float));
+        memcpy(out_gradients.y + begin, value + 2 * SDF_TAPE_BATCH, size * sizeof(float));
+        memcpy(out_gradients.z + begin, value + 3 * SDF_TAPE_BATCH, size * sizeof(float));
+    }
+}
+
+
+// -----------------------------------------------------------------------------
+// KERNEL ENTRY POINTS
+// -----------------------------------------------------------------------------
+
+// Runs the bulk with `V` and the remainder with `F1`.
+#define RUN_WITH_TAIL(V, count, body, ...)                              \
+    do                                                                  \
+    {                                                                   \
+        const uint32_t bulk_ = (count) - (count) % V::width;            \
+        body<V >(__VA_ARGS__, 0    , bulk_  );                          \
+        body<F1>(__VA_ARGS__, bulk_, (count));                          \
+    }                                                                   \
+    while (0)
+
+template <typename V>
+static void transform_points_kernel(const float* matrix, KernelIn3 in, KernelOut3 out, uint32_t count)
+{
+    RUN_WITH_TAIL(V, count, transform_points_range, matrix, in, out);
+}
+
+template <typename V>
+static void transform_vectors_kernel(const float* matrix, KernelIn3 in, KernelOut3 out, uint32_t count)
+{
+    RUN_WITH_TAIL(V, count, transform_vectors_range, matrix, in, out);
+}
+
+template <typename V>
+static void normalize_vectors_kernel(KernelOut3 vectors, uint32_t count)
+{
+    RUN_WITH_TAIL(V, count, normalize_vectors_range, vectors);
+}
+
+template <typename V>
+static void compute_aabb_kernel(KernelIn3 positions, uint32_t count, float* out_min, float* out_max)
+{
+    const uint32_t bulk = count - count % V::width;
+
+    compute_aabb_range<V >(positions, 0   , bulk , out_min, out_max);
+    compute_aabb_range<F1>(positions, bulk, count, out_min, out_max);
+}
+
+template <typename V>
+static void compute_face_normals_kernel(KernelIn3 positions, const uint32_t* indices, uint32_t triangle_count, KernelOut3 out)
+{
+    RUN_WITH_TAIL(V, triangle_count, compute_face_normals_range, positions, indices, out);
+}
+
+template <typename V>
+static void compute_vertex_normals_kernel(KernelIn3 positions, uint32_t vertex_count, const uint32_t* indices, uint32_t triangle_count, KernelOut3 out)
+{
+    memset(out.x, 0, vertex_count * sizeof(float));
+    memset(out.y, 0, vertex_count * sizeof(float));
+    memset(out.z, 0, vertex_count * sizeof(float));
+
+    RUN_WITH_TAIL(V, triangle_count, accumulate_vertex_normals_range, positions, indices, out);
+    RUN_WITH_TAIL(V, vertex_count  , normalize_vectors_range        , out);
+}
+
+#undef RUN_WITH_TAIL
+
+template <typename V>
+static constexpr MeshKernelTable make_mesh_kernel_table()
+{
+    return
+    {
+        transform_points_kernel          <V>,
+        transform_vectors_kernel         <V>,
+        normalize_vectors_kernel         <V>,
+        compute_aabb_kernel              <V>,
+        compute_face_normals_kernel      <V>,
+        compute_vertex_normals_kernel    <V>,
+        evaluate_sdf_tape_kernel         <V>,
+        evaluate_sdf_tape_gradient_kernel<V>,
+    };
+}
+
+} // unnamed namespace
@@ -0,0 +1,432 @@
+#include "occlusion.h"
+
+#include <math.h>         // ceilf, fabsf, floorf
+
+#include <algorithm>      // fill, max, min, partial_sort
+
+#include <bx/platform.h>  // BX_CPU_X86
+
+#if BX_CPU_X86
+#   include <emmintrin.h> // _mm_*
+#endif
+
+#include "culling.h"      // ObjectBounds
+#include "tasks.h"        // parallel_for
+
+
+// -----------------------------------------------------------------------------
+// RASTERIZATION
+// -----------------------------------------------------------------------------
+
+// Vertices closer than this (in clip space `w`) are treated as crossing the
+// near plane.
+static constexpr float MIN_CLIP_W = 1e-4f;
+
+void OcclusionBuffer::resize(uint32_t new_width, uint32_t new_height)
+{
+    tiles_x = (new_width  + TILE_SIZE - 1) / TILE_SIZE;
+    tiles_y = (new_height + TILE_SIZE - 1) / TILE_SIZE;
+    width   = tiles_x * TILE_SIZE;
+    height  = tiles_y * TILE_SIZE;
+
+    // Cleared to the far plane, so nothing is occluded before rasterizing.
+    depth   .assign(size_t(width) * height, 1.0f);
+    tile_max.assign(size_t(tiles_x) * tiles_y, 1.0f);
+}
+
+uint32_t OcclusionBuffer::rasterize(const glm::mat4& matrix, const Mesh* const* occluders, uint32_t count)
+{
+    view_proj = matrix;
+
+    triangles.clear();
+    clip_x   .clear();
+    clip_y   .clear();
+    clip_z   .clear();
+    clip_w   .clear();
+
+    const glm::mat4& m = view_proj;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const Mesh&    mesh  = *occluders[i];
+        const uint32_t first = uint32_t(clip_x.size());
+
+        for (uint32_t j = 0; j < mesh.vertex_count(); j++)
+        {
+            const float x = mesh.position_x[j];
+            const float y = mesh.position_y[j];
+            const float z = mesh.position_z[j];
+
+            clip_x.push_back(m[0][0] * x + m[1][0] * y + m[2][0] * z + m[3][0]);
+            clip_y.push_back(m[0][1] * x + m[1][1] * y + m[2][1] * z + m[3][1]);
+            clip_z.push_back(m[0][2] * x + m[1][2] * y + m[2][2] * z + m[3][2]);
+            clip_w.push_back(m[0][3] * x + m[1][3] * y + m[2][3] * z + m[3][3]);
+        }
+
+        // Triangle setup: edge functions and the depth plane, in pixels.
+        for (size_t j = 0; j + 2 < mesh.indices.size(); j += 3)
+        {
+            float sx[3], sy[3], sz[3];
+            bool  near_clipped = false;
+
+            for (uint32_t k = 0; k < 3; k++)
+            {
+                const uint32_t v = first + mesh.indices[j + k];
+                const float    w = clip_w[v];
+
+                near_clipped |= w < MIN_CLIP_W;
+
+                const float inv_w = 1.0f / std::max(w, MIN_CLIP_W);
+
+                sx[k] = (clip_x[v] * inv_w * 0.5f + 0.5f) * float(width );
+                sy[k] = (0.5f - clip_y[v] * inv_w * 0.5f) * float(height);
+                sz[k] =  clip_z[v] * inv_w * 0.5f + 0.5f;
+            }
+
+            // Dropping occluder triangles is always safe.
+            if (near_clipped)
+            {
+                continue;
+            }
+
+            Triangle tri;
+            tri.min_x = std::max(int32_t(floorf(std::min({ sx[0], sx[1], sx[2] }))), 0);
+            tri.min_y = std::max(int32_t(floorf(std::min({ sy[0], sy[1], sy[2] }))), 0);
+            tri.max_x = std::min(int32_t(ceilf (std::max({ sx[0], sx[1], sx[2] }))), int32_t(width ) - 1);
+            tri.max_y = std::min(int32_t(ceilf (std::max({ sy[0], sy[1], sy[2] }))), int32_t(height) - 1);
+
+            if (tri.min_x > tri.max_x || tri.min_y > tri.max_y)
+            {
+                continue;
+            }
+
+            // Edge `k` is opposite to vertex `k`, so it evaluates to the
+            // (scaled) barycentric weight of that vertex.
+            for (uint32_t k = 0; k < 3; k++)
+            {
+                const uint32_t a = (k + 1) % 3;
+                const uint32_t b = (k + 2) % 3;
+
+                tri.edge_a[k] = sy[a] - sy[b];
+                tri.edge_b[k] = sx[b] - sx[a];
+                tri.edge_c[k] = sx[a] * sy[b] - sy[a] * sx[b];
+            }
+
+            float area = tri.edge_a[0] * sx[0] + tri.edge_b[0] * sy[0] + tri.edge_c[0];
+
+            if (fabsf(area) < 1e-8f)
+            {
+                continue;
+            }
+
+            // Two-sided: flip back-facing triangles so the inside is positive.
+            if (area < 0.0f)
+            {
+                for (uint32_t k = 0; k < 3; k++)
+                {
+                    tri.edge_a[k] = -tri.edge_a[k];
+                    tri.edge_b[k] = -tri.edge_b[k];
+                    tri.edge_c[k] = -tri.edge_c[k];
+                }
+
+                area = -area;
+            }
+
+            const float inv_area = 1.0f / area;
+
+            tri.depth_a = (tri.edge_a[0] * sz[0] + tri.edge_a[1] * sz[1] + tri.edge_a[2] * sz[2]) * inv_area;
+            tri.depth_b = (tri.edge_b[0] * sz[0] + tri.edge_b[1] * sz[1] + tri.edge_b[2] * sz[2]) * inv_area;
+            tri.depth_c = (tri.edge_c[0] * sz[0] + tri.edge_c[1] * sz[1] + tri.edge_c[2] * sz[2]) * inv_area;
+
+            triangles.push_back(tri);
+        }
+    }
+
+    parallel_for(0, tiles_y, 1, [this](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t i = begin; i < end; i++)
+        {
+            rasterize_band(i);
+        }
+    });
+
+    return uint32_t(triangles.size());
+}
+
+// Rasterizes all triangles overlapping one row of tiles and updates the
+// tiles' farthest depth afterwards. Widths are multiples of the tile size, so
+// four-pixel blocks never straddle a row.
+void OcclusionBuffer::rasterize_band(uint32_t tile_row)
+{
+    const int32_t band_min_y = int32_t(tile_row * TILE_SIZE);
+    const int32_t band_max_y = band_min_y + int32_t(TILE_SIZE) - 1;
+
+    float* band = depth.data() + size_t(band_min_y) * width;
+
+    std::fill(band, band + size_t(TILE_SIZE) * width, 1.0f);
+
+    for (const Triangle& tri : triangles)
+    {
+        const int32_t min_y = std::max(tri.min_y, band_min_y);
+        const int32_t max_y = std::min(tri.max_y, band_max_y);
+        const int32_t min_x = tri.min_x & ~3;
+
+        for (int32_t y = min_y; y <= max_y; y++)
+        {
+            const float fy  = float(y) + 0.5f;
+            float*      row = depth.data() + size_t(y) * width;
+
+#if BX_CPU_X86
+            const __m128 e0_row = _mm_set1_ps(tri.edge_b[0] * fy + tri.edge_c[0]);
+            const __m128 e1_row = _mm_set1_ps(tri.edge_b[1] * fy + tri.edge_c[1]);
+            const __m128 e2_row = _mm_set1_ps(tri.edge_b[2] * fy + tri.edge_c[2]);
+            const __m128 z_row  = _mm_set1_ps(tri.depth_b   * fy + tri.depth_c  );
+
+            const __m128 e0_a = _mm_set1_ps(tri.edge_a[0]);
+            const __m128 e1_a = _mm_set1_ps(tri.edge_a[1]);
+            const __m128 e2_a = _mm_set1_ps(tri.edge_a[2]);
+            const __m128 z_a  = _mm_set1_ps(tri.depth_a  );
+
+            const __m128 zero = _mm_setzero_ps();
+
+            for (int32_t x = min_x; x <= tri.max_x; x += 4)
+            {
+                const __m128 fx = _mm_add_ps(_mm_set1_ps(float(x)), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+
+                const __m128 e0 = _mm_add_ps(_mm_mul_ps(e0_a, fx), e0_row);
+                const __m128 e1 = _mm_add_ps(_mm_mul_ps(e1_a, fx), e1_row);
+                const __m128 e2 = _mm_add_ps(_mm_mul_ps(e2_a, fx), e2_row);
+
+                // Pixels with any negative edge value are outside.
+                const __m128 outside = _mm_cmplt_ps(_mm_min_ps(_mm_min_ps(e0, e1), e2), zero);
+
+                if (_mm_movemask_ps(outside) == 0xf)
+                {
+                    continue;
+                }
+
+                const __m128 z   = _mm_add_ps(_mm_mul_ps(z_a, fx), z_row);
+                const __m128 old = _mm_loadu_ps(row + x);
+                const __m128 min = _mm_min_ps(old, z);
+
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(outside, old), _mm_andnot_ps(outside, min)));
+            }
+#else
+            for (int32_t x = min_x; x <= tri.max_x; x++)
+            {
+                const float fx = float(x) + 0.5f;
+                const float e0 = tri.edge_a[0] * fx + tri.edge_b[0] * fy + tri.edge_c[0];
+                const float e1 = tri.edge_a[1] * fx + tri.edge_b[1] * fy + tri.edge_c[1];
+                const float e2 = tri.edge_a[2] * fx + tri.edge_b[2] * fy + tri.edge_c[2];
+
+                if (e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f)
+                {
+                    row[x] = std::min(row[x], tri.depth_a * fx + tri.depth_b * fy + tri.depth_c);
+                }
+            }
+#endif
+        }
+    }
+
+    for (uint32_t tile_x = 0; tile_x < tiles_x; tile_x++)
+    {
+        const float* tile = band + tile_x * TILE_SIZE;
+
+#if BX_CPU_X86
+        __m128 max = _mm_setzero_ps();
+
+        for (uint32_t y = 0; y < TILE_SIZE; y++)
+        {
+            const float* row = tile + size_t(y) * width;
+
+            max = _mm_max_ps(max, _mm_max_ps(_mm_loadu_ps(row), _mm_loadu_ps(row + 4)));
+        }
+
+        max = _mm_max_ps(max, _mm_shuffle_ps(max, max, _MM_SHUFFLE(1, 0, 3, 2)));
+        max = _mm_max_ps(max, _mm_shuffle_ps(max, max, _MM_SHUFFLE(2, 3, 0, 1)));
+
+        tile_max[tile_row * tiles_x + tile_x] = _mm_cvtss_f32(max);
+#else
+        float max = 0.0f;
+
+        for (uint32_t y = 0; y < TILE_SIZE; y++)
+        {
+            for (uint32_t x = 0; x < TILE_SIZE; x++)
+            {
+                max = std::max(max, tile[size_t(y) * width + x]);
+            }
+        }
+
+        tile_max[tile_row * tiles_x + tile_x] = max;
+#endif
+    }
+}
+
+
+// -----------------------------------------------------------------------------
+// QUERIES
+// -----------------------------------------------------------------------------
+
+bool OcclusionBuffer::test(const Aabb& box) const
+{
+    if (width == 0)
+    {
+        return true;
+    }
+
+    const glm::mat4& m = view_proj;
+
+    float min_x = 1e30f, max_x = -1e30f;
+    float min_y = 1e30f, max_y = -1e30f;
+    float min_z = 1e30f;
+
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        const float x = (i & 1) ? box.max.x : box.min.x;
+        const float y = (i & 2) ? box.max.y : box.min.y;
+        const float z = (i & 4) ? box.max.z : box.min.z;
+        const float w = m[0][3] * x + m[1][3] * y + m[2][3] * z + m[3][3];
+
+        // Crossing the near plane, the projected bounds are meaningless.
+        if (w < MIN_CLIP_W)
+        {
+            return true;
+        }
+
+        const float inv_w = 1.0f / w;
+        const float sx    = ((m[0][0] * x + m[1][0] * y + m[2][0] * z + m[3][0]) * inv_w * 0.5f + 0.5f) * float(width );
+        const float sy    = (0.5f - (m[0][1] * x + m[1][1] * y + m[2][1] * z + m[3][1]) * inv_w * 0.5f) * float(height);
+        const float sz    =  (m[0][2] * x + m[1][2] * y + m[2][2] * z + m[3][2]) * inv_w * 0.5f + 0.5f;
+
+        min_x = std::min(min_x, sx);
+        max_x = std::max(max_x, sx);
+        min_y = std::min(min_y, sy);
+        max_y = std::max(max_y, sy);
+        min_z = std::min(min_z, sz);
+    }
+
+    // Every pixel the box touches, not just those whose center it covers.
+    const int32_t x0 = std::max(int32_t(floorf(min_x)), 0);
+    const int32_t y0 = std::max(int32_t(floorf(min_y)), 0);
+    const int32_t x1 = std::min(int32_t(floorf(max_x)), int32_t(width ) - 1);
+    const int32_t y1 = std::min(int32_t(floorf(max_y)), int32_t(height) - 1);
+
+    if (x0 > x1 || y0 > y1)
+    {
+        return false;
+    }
+
+    for (int32_t tile_y = y0 / int32_t(TILE_SIZE); tile_y <= y1 / int32_t(TILE_SIZE); tile_y++)
+    {
+        for (int32_t tile_x = x0 / int32_t(TILE_SIZE); tile_x <= x1 / int32_t(TILE_SIZE); tile_x++)
+        {
+            if (tile_max[size_t(tile_y) * tiles_x + size_t(tile_x)] < min_z)
+            {
+                continue;
+            }
+
+            // Some pixel of the tile is farther than the box; check the ones
+            // the box covers. Rounding the span out to four-pixel blocks only
+            // makes the test more conservative.
+            const int32_t px0 = std::max(x0, tile_x * int32_t(TILE_SIZE)) & ~3;
+            const int32_t px1 = std::min(x1, tile_x * int32_t(TILE_SIZE) + int32_t(TILE_SIZE) - 1);
+            const int32_t py0 = std::max(y0, tile_y * int32_t(TILE_SIZE));
+            const int32_t py1 = std::min(y1, tile_y * int32_t(TILE_SIZE) + int32_t(TILE_SIZE) - 1);
+
+            for (int32_t y = py0; y <= py1; y++)
+            {
+                const float* row = depth.data() + size_t(y) * width;
+
+#if BX_CPU_X86
+                const __m128 z = _mm_set1_ps(min_z);
+
+                for (int32_t x = px0; x <= px1; x += 4)
+                {
+                    if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), z)))
+                    {
+                        return true;
+                    }
+                }
+#else
+                for (int32_t x = px0; x <= px1; x++)
+                {
+                    if (row[x] >= min_z)
+                    {
+                        return true;
+                    }
+                }
+#endif
+            }
+        }
+    }
+
+    return false;
+}
+
+uint32_t OcclusionBuffer::cull(const ObjectBounds& bounds, std::vector<uint32_t>& inout_visible) const
+{
+    const uint32_t count   = uint32_t(inout_visible.size());
+    uint32_t       visible = 0;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const uint32_t object = inout_visible[i];
+
+        inout_visible[visible] = object;
+        visible               += test(bounds.get(object));
+    }
+
+    inout_visible.resize(visible);
+
+    return count - visible;
+}
+
+
+// -----------------------------------------------------------------------------
+// OCCLUDER SELECTION
+// -----------------------------------------------------------------------------
+
+void select_occluders
+(
+    const ObjectBounds&          bounds,
+    const std::vector<uint32_t>& visible,
+    const glm::vec3&             eye,
+    uint32_t                     max_count,
+    float                        min_size,
+    std::vector<uint32_t>&       out_occluders
+)
+{
+    struct Candidate
+    {
+        float    size;
+        uint32_t object;
+    };
+
+    std::vector<Candidate> candidates;
+
+    for (const uint32_t i : visible)
+    {
+        const glm::vec3 center   = { bounds.center_x[i], bounds.center_y[i], bounds.center_z[i] };
+        const float     distance = std::max(glm::length(center - eye), 1e-3f);
+        const float     size     = bounds.radius[i] / distance;
+
+        if (size >= min_size)
+        {
+            candidates.push_back({ size, i });
+        }
+    }
+
+    const size_t count = std::min(candidates.size(), size_t(max_count));
+
+    std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end(), [](const Candidate& a, const Candidate& b)
+    {
+        return a.size > b.size;
+    });
+
+    out_occluders.clear();
+
+    for (size_t i = 0; i < count; i++)
+    {
+        out_occluders.push_back(candidates[i].object);
+    }
+}
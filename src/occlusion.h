@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdint.h>    // uint32_t
+
+#include <vector>      // vector
+
+#include <glm/glm.hpp> // mat4, vec3
+
+#include "mesh.h"      // Aabb, Mesh
+
+struct ObjectBounds;
+
+
+// -----------------------------------------------------------------------------
+// OCCLUSION BUFFER
+// -----------------------------------------------------------------------------
+
+// Low resolution software depth buffer with a second level holding the
+// farthest depth of each tile. Occluders are rasterized at pixel centers, four
+// pixels at a time, in parallel horizontal bands on the task pool; queries then
+// reject whole tiles first and only look at pixels of tiles that might show the
+// object. Depth is the -1..1 clip space depth remapped to 0 (near) .. 1 (far).
+//
+// Rasterizing at pixel centers (rather than conservatively) means an object
+// peeking less than a pixel past an occluder silhouette can be rejected, which
+// is the usual trade-off at these resolutions.
+struct OcclusionBuffer
+{
+    static constexpr uint32_t TILE_SIZE = 8;
+
+    uint32_t           width   = 0;
+    uint32_t           height  = 0;
+    uint32_t           tiles_x = 0;
+    uint32_t           tiles_y = 0;
+
+    glm::mat4          view_proj = glm::mat4(1.0f);
+
+    std::vector<float> depth;    // Per pixel, rows top to bottom.
+    std::vector<float> tile_max; // Farthest depth per tile.
+
+    // Rounds the size up to whole tiles.
+    void resize(uint32_t width, uint32_t height);
+
+    // Clears the buffer and rasterizes the given world-space meshes. Triangles
+    // are two-sided; those crossing the near plane are skipped. Returns the
+    // number of triangles that made it to the rasterizer.
+    uint32_t rasterize(const glm::mat4& view_proj, const Mesh* const* occluders, uint32_t count);
+
+    // Returns `false` only if the box is entirely behind the rasterized depth.
+    bool test(const Aabb& box) const;
+
+    // Keeps only the objects in `inout_visible` that pass `test`, preserving
+    // their order. Returns the number of removed objects.
+    uint32_t cull(const ObjectBounds& bounds, std::vector<uint32_t>& inout_visible) const;
+
+    // Per-frame scratch.
+    struct Triangle
+    {
+        float    edge_a[3];
+        float    edge_b[3];
+        float    edge_c[3];
+        float    depth_a;
+        float    depth_b;
+        float    depth_c;
+        int32_t  min_x;
+        int32_t  min_y;
+        int32_t  max_x;
+        int32_t  max_y;
+    };
+
+    std::vector<float>    clip_x;
+    std::vector<float>    clip_y;
+    std::vector<float>    clip_z;
+    std::vector<float>    clip_w;
+    std::vector<Triangle> triangles;
+
+    void rasterize_band(uint32_t tile_row);
+};
+
+// Picks up to `max_count` of the `visible` objects whose bounding spheres
+// appear the largest from `eye`, ignoring those smaller than `min_size` (ratio
+// of radius to distance). Largest first.
+void select_occluders
+(
+    const ObjectBounds&          bounds,
+    const std::vector<uint32_t>& visible,
+    const glm::vec3&             eye,
+    uint32_t                     max_count,
+    float                        min_size,
+    std::vector<uint32_t>&       out_occluders
+);
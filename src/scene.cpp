@@ -0,0 +1,226 @@
+#include "scene.h"
+
+#include <algorithm>         // max, min
+#include <utility>           // move
+
+#include "mesh_kernels.h"    // compute_aabb, compute_vertex_normals
+#include "tasks.h"           // parallel_for
+
+
+// -----------------------------------------------------------------------------
+// OBJECT PREPARATION
+// -----------------------------------------------------------------------------
+
+struct SceneVertex
+{
+    glm::vec3 position;
+    uint32_t  color;
+};
+
+static uint32_t shade_color(uint32_t color, const glm::vec3& normal)
+{
+    const glm::vec3 light     = glm::normalize(glm::vec3(0.3f, 0.8f, 0.5f));
+    const float     intensity = 0.35f + 0.65f * std::max(0.0f, glm::dot(normal, light));
+
+    uint32_t shaded = color & 0xff000000;
+
+    for (uint32_t shift = 0; shift < 24; shift += 8)
+    {
+        const float channel = float((color >> shift) & 0xff) * intensity;
+
+        shaded |= uint32_t(channel + 0.5f) << shift;
+    }
+
+    return shaded;
+}
+
+// Everything but the GPU upload; safe to run on any thread.
+static void prepare(SceneObject& object, uint32_t color)
+{
+    Mesh& mesh = object.mesh;
+
+    if (!mesh.has_colors())
+    {
+        if (!mesh.has_normals())
+        {
+            compute_vertex_normals(mesh);
+        }
+
+        mesh.colors.resize(mesh.vertex_count());
+
+        for (uint32_t i = 0; i < mesh.vertex_count(); i++)
+        {
+            mesh.colors[i] = shade_color(color, { mesh.normal_x[i], mesh.normal_y[i], mesh.normal_z[i] });
+        }
+    }
+
+    object.bounds = compute_aabb(mesh.positions(), mesh.vertex_count());
+    object.bvh.build(mesh);
+
+    if (mesh.triangle_count() >= Scene::MIN_CLUSTERED_TRIANGLES)
+    {
+        object.clusters.build(mesh);
+    }
+}
+
+
+// -----------------------------------------------------------------------------
+// GPU UPLOAD
+// -----------------------------------------------------------------------------
+
+static void upload(SceneObject& object)
+{
+    const Mesh&    mesh  = object.mesh;
+    const uint32_t count = mesh.vertex_count();
+
+    const bgfx::Memory* vertices = bgfx::alloc(uint32_t(count * sizeof(SceneVertex)));
+    SceneVertex*        data     = reinterpret_cast<SceneVertex*>(vertices->data);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        data[i].position = mesh.position(i);
+        data[i].color    = mesh.colors[i];
+    }
+
+    object.vertex_buffer = bgfx::createVertexBuffer(vertices, Scene::vertex_layout());
+
+    object.index_buffer = bgfx::createIndexBuffer(
+        bgfx::copy(mesh.indices.data(), uint32_t(mesh.indices.size() * sizeof(uint32_t))),
+        BGFX_BUFFER_INDEX32
+    );
+}
+
+
+// -----------------------------------------------------------------------------
+// RENDER SCENE
+// -----------------------------------------------------------------------------
+
+const bgfx::VertexLayout& Scene::vertex_layout()
+{
+    static const bgfx::VertexLayout layout = []()
+    {
+        bgfx::VertexLayout result;
+        result
+            .begin()
+            .add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float)
+            .add(bgfx::Attrib::Color0,   4, bgfx::AttribType::Uint8, true)
+            .end();
+
+        return result;
+    }();
+
+    return layout;
+}
+
+void Scene::add(Mesh&& mesh, uint32_t color)
+{
+    SceneObject& object = objects.emplace_back();
+    object.mesh = std::move(mesh);
+
+    prepare(object, color);
+
+    bounds.add(object.bounds);
+}
+
+void Scene::add(std::vector<Mesh>&& meshes, const std::vector<uint32_t>& colors)
+{
+    const uint32_t first = uint32_t(objects.size());
+    const uint32_t count = uint32_t(meshes.size());
+
+    objects.resize(first + count);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        objects[first + i].mesh = std::move(meshes[i]);
+    }
+
+    parallel_for(0, count, 1, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t i = begin; i < end; i++)
+        {
+            prepare(objects[first + i], i < colors.size() ? colors[i] : DEFAULT_COLOR);
+        }
+    });
+
+    for (uint32_t i = first; i < first + count; i++)
+    {
+        bounds.add(objects[i].bounds);
+    }
+}
+
+void Scene::take(Scene& other)
+{
+    objects.reserve(objects.size() + other.objects.size());
+
+    for (SceneObject& object : other.objects)
+    {
+        bounds.add(object.bounds);
+        objects.push_back(std::move(object));
+    }
+
+    other.objects  .clear();
+    other.bounds   .clear();
+    other.hierarchy = {};
+}
+
+void Scene::upload()
+{
+    for (SceneObject& object : objects)
+    {
+        // Zero-size buffers are invalid in some renderers.
+        if (!bgfx::isValid(object.vertex_buffer) && !object.mesh.indices.empty())
+        {
+            ::upload(object);
+        }
+    }
+}
+
+void Scene::clear()
+{
+    for (SceneObject& object : objects)
+    {
+        if (bgfx::isValid(object.vertex_buffer))
+        {
+            bgfx::destroy(object.vertex_buffer);
+            bgfx::destroy(object.index_buffer );
+        }
+    }
+
+    objects  .clear();
+    bounds   .clear();
+    hierarchy = {};
+}
+
+void Scene::update_hierarchy()
+{
+    std::vector<Aabb> boxes;
+    boxes.reserve(objects.size());
+
+    for (const SceneObject& object : objects)
+    {
+        boxes.push_back(object.bounds);
+    }
+
+    hierarchy.build(boxes.data(), uint32_t(boxes.size()));
+}
+
+bool Scene::pick(const Ray& ray, uint32_t& out_object, RayHit& out_hit) const
+{
+    out_hit = {};
+
+    for (uint32_t i = 0; i < objects.size(); i++)
+    {
+        Ray clipped   = ray;
+        clipped.t_max = std::min(ray.t_max, out_hit.t);
+
+        const RayHit hit = objects[i].bvh.ray_cast(objects[i].mesh, clipped);
+
+        if (hit.hit() && hit.t < out_hit.t)
+        {
+            out_object = i;
+            out_hit    = hit;
+        }
+    }
+
+    return out_hit.hit();
+}
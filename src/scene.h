@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>    // uint32_t
+
+#include <vector>      // vector
+
+#include <bgfx/bgfx.h> // *Handle, VertexLayout
+
+#include "bvh.h"       // Bvh, Ray, RayHit
+#include "clusters.h"  // MeshClusters
+#include "culling.h"   // ObjectBounds
+#include "mesh.h"      // Aabb, Mesh
+
+
+// -----------------------------------------------------------------------------
+// RENDER SCENE
+// -----------------------------------------------------------------------------
+
+struct SceneObject
+{
+    // The CPU copy stays around for picking and the CPU culling stages.
+    Mesh                     mesh;
+    Bvh                      bvh;
+    Aabb                     bounds;
+
+    // Only for meshes large enough to benefit from culling their parts.
+    MeshClusters             clusters;
+
+    bgfx::VertexBufferHandle vertex_buffer = BGFX_INVALID_HANDLE;
+    bgfx::IndexBufferHandle  index_buffer  = BGFX_INVALID_HANDLE;
+};
+
+// World-space objects uploaded to the GPU, plus the flat bounds list and the
+// BVH over it that the culling stages consume. Everything except `upload` and
+// `clear` can run off the rendering thread.
+struct Scene
+{
+    static constexpr uint32_t MIN_CLUSTERED_TRIANGLES = 4096;
+    static constexpr uint32_t DEFAULT_COLOR           = 0xffd0d0d0;
+
+    std::vector<SceneObject> objects;
+    ObjectBounds             bounds;
+    Bvh                      hierarchy;
+
+    // Position and color, matching the `position_color` program. Meshes
+    // without vertex colors get the object color shaded by a fixed
+    // directional light.
+    static const bgfx::VertexLayout& vertex_layout();
+
+    void add(Mesh&& mesh, uint32_t color = DEFAULT_COLOR);
+
+    // Prepares the objects in parallel on the task pool.
+    void add(std::vector<Mesh>&& meshes, const std::vector<uint32_t>& colors);
+
+    // Moves the objects of `other` over, in order, leaving it empty.
+    void take(Scene& other);
+
+    // Creates the GPU buffers of objects that don't have them yet, except for
+    // objects without triangles, which stay without buffers and aren't drawn.
+    void upload();
+
+    // Destroys the GPU buffers of all objects and removes them.
+    void clear();
+
+    // Rebuilds the object hierarchy; call after adding objects.
+    void update_hierarchy();
+
+    bool pick(const Ray& ray, uint32_t& out_object, RayHit& out_hit) const;
+};
@@ -0,0 +1,3507 @@
+#include "script.h"
+
+#include <math.h>                       // cosf, sinf
+#include <stdio.h>                      // fopen, fprintf, fread, fwrite, remove, snprintf
+#include <stdlib.h>                     // free
+#include <string.h>                     // memcpy, strcmp, strlen
+
+#include <algorithm>                    // find, max, min, sort
+#include <bit>                          // bit_width
+#include <condition_variable>           // condition_variable
+#include <filesystem>                   // create_directories, directory_iterator, last_write_time, remove, rename
+#include <memory>                       // make_shared, shared_ptr
+#include <mutex>                        // lock_guard, mutex, unique_lock
+#include <new>                          // nothrow, placement new
+#include <thread>                       // thread
+#include <utility>                      // move, pair, swap
+
+#include <bx/timer.h>                   // getHPCounter, getHPFrequency
+
+#include <glm/glm.hpp>                  // glm::*
+#include <glm/gtc/matrix_transform.hpp> // rotate, scale, translate
+
+#include <meshoptimizer.h>              // meshopt_generateVertexRemap
+
+#ifdef WITH_LUAU
+#   include <lua.h>                     // lua_*
+#   include <luacode.h>                 // luau_compile
+#   include <lualib.h>                  // luaL_*
+#   include <Luau/Parser.h>             // Luau::Ast*, Luau::Parser
+#endif
+
+#ifdef WITH_LUAU_CODEGEN
+#   include <Luau/CodeGen.h>            // Luau::CodeGen::*
+#endif
+
+#include "csg.h"                        // CsgOperation, mesh_boolean
+#include "mesh_kernels.h"               // transform_points
+#include "sdf.h"                        // contour_sdf, mesh_brick_map, mesh_sdf, snap_sdf_bounds, SdfBrickMap, SdfGridSnap, SdfTree
+#include "subdivision.h"                // SubdivisionScheme, SubdivisionSurface
+#include "tasks.h"                      // task_run, task_set_thread_queue, task_wait, TaskCancel
+
+
+#ifdef WITH_LUAU
+
+// -----------------------------------------------------------------------------
+// MESH PRIMITIVES
+// -----------------------------------------------------------------------------
+
+// All primitives are centered at the origin, with triangles wound counter-
+// clockwise when seen from the outside.
+
+static void add_quad(Mesh& mesh, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec3& d)
+{
+    const uint32_t i = mesh.add_vertex(a);
+    mesh.add_vertex(b);
+    mesh.add_vertex(c);
+    mesh.add_vertex(d);
+
+    mesh.add_triangle(i, i + 1, i + 2);
+    mesh.add_triangle(i, i + 2, i + 3);
+}
+
+// Separate vertices per face, to keep the normals flat.
+static void make_box(Mesh& mesh, const glm::vec3& size)
+{
+    const glm::vec3 h = size * 0.5f;
+
+    add_quad(mesh, {-h.x, -h.y,  h.z}, { h.x, -h.y,  h.z}, { h.x,  h.y,  h.z}, {-h.x,  h.y,  h.z}); // +Z
+    add_quad(mesh, { h.x, -h.y, -h.z}, {-h.x, -h.y, -h.z}, {-h.x,  h.y, -h.z}, { h.x,  h.y, -h.z}); // -Z
+    add_quad(mesh, { h.x, -h.y,  h.z}, { h.x, -h.y, -h.z}, { h.x,  h.y, -h.z}, { h.x,  h.y,  h.z}); // +X
+    add_quad(mesh, {-h.x, -h.y, -h.z}, {-h.x, -h.y,  h.z}, {-h.x,  h.y,  h.z}, {-h.x,  h.y, -h.z}); // -X
+    add_quad(mesh, {-h.x,  h.y,  h.z}, { h.x,  h.y,  h.z}, { h.x,  h.y, -h.z}, {-h.x,  h.y, -h.z}); // +Y
+    add_quad(mesh, {-h.x, -h.y, -h.z}, { h.x, -h.y, -h.z}, { h.x, -h.y,  h.z}, {-h.x, -h.y,  h.z}); // -Y
+}
+
+static void make_sphere(Mesh& mesh, float radius, uint32_t segments)
+{
+    const uint32_t rings = std::max(segments / 2, 2u);
+
+    const uint32_t top = mesh.add_vertex({ 0.0f, radius, 0.0f });
+
+    for (uint32_t i = 1; i < rings; i++)
+    {
+        const float theta = 3.14159265f * float(i) / float(rings);
+
+        for (uint32_t j = 0; j < segments; j++)
+        {
+            const float phi = 6.28318531f * float(j) / float(segments);
+
+            mesh.add_vertex(radius * glm::vec3(sinf(theta) * cosf(phi), cosf(theta), -sinf(theta) * sinf(phi)));
+        }
+    }
+
+    const uint32_t bottom = mesh.add_vertex({ 0.0f, -radius, 0.0f });
+    const uint32_t first  = top + 1;
+
+    for (uint32_t j = 0; j < segments; j++)
+    {
+        const uint32_t k = (j + 1) % segments;
+
+        mesh.add_triangle(top, first + j, first + k);
+        mesh.add_triangle(bottom, first + (rings - 2) * segments + k, first + (rings - 2) * segments + j);
+    }
+
+    for (uint32_t i = 0; i + 2 < rings; i++)
+    {
+        for (uint32_t j = 0; j < segments; j++)
+        {
+            const uint32_t a = first + i * segments + j;
+            const uint32_t b = first + i * segments + (j + 1) % segments;
+            const uint32_t c = a + segments;
+            const uint32_t d = b + segments;
+
+            mesh.add_triangle(a, c, d);
+            mesh.add_triangle(a, d, b);
+        }
+    }
+}
+
+// Along the Y axis, with separate cap vertices.
+static void make_cylinder(Mesh& mesh, float radius, float height, uint32_t segments)
+{
+    const float    h     = height * 0.5f;
+    const uint32_t first = mesh.vertex_count();
+
+    for (uint32_t j = 0; j < segments; j++)
+    {
+        const float phi = 6.28318531f * float(j) / float(segments);
+        const float x   =  radius * cosf(phi);
+        const float z   = -radius * sinf(phi);
+
+        mesh.add_vertex({ x, -h, z });
+        mesh.add_vertex({ x,  h, z });
+    }
+
+    for (uint32_t j = 0; j < segments; j++)
+    {
+        const uint32_t k = (j + 1) % segments;
+
+        mesh.add_triangle(first + j * 2, first + k * 2, first + k * 2 + 1);
+        mesh.add_triangle(first + j * 2, first + k * 2 + 1, first + j * 2 + 1);
+    }
+
+    for (const float y : { -h, h })
+    {
+        const uint32_t center = mesh.add_vertex({ 0.0f, y, 0.0f });
+
+        for (uint32_t j = 0; j < segments; j++)
+        {
+            mesh.add_vertex({ mesh.position_x[first + j * 2], y, mesh.position_z[first + j * 2] });
+        }
+
+        for (uint32_t j = 0; j < segments; j++)
+        {
+            const uint32_t a = center + 1 + j;
+            const uint32_t b = center + 1 + (j + 1) % segments;
+
+            if (y > 0.0f)
+            {
+                mesh.add_triangle(center, a, b);
+            }
+            else
+            {
+                mesh.add_triangle(center, b, a);
+            }
+        }
+    }
+}
+
+// Normals and colors are kept when both meshes have them, or taken over when
+// `mesh` had no vertices yet, and dropped otherwise. `other` must not be `mesh`.
+static void append_mesh(Mesh& mesh, const Mesh& other)
+{
+    if (other.vertex_count() == 0)
+    {
+        return;
+    }
+
+    const uint32_t offset = mesh.vertex_count();
+
+    if (offset == 0 || (mesh.has_normals() && other.has_normals()))
+    {
+        mesh.normal_x.insert(mesh.normal_x.end(), other.normal_x.begin(), other.normal_x.end());
+        mesh.normal_y.insert(mesh.normal_y.end(), other.normal_y.begin(), other.normal_y.end());
+        mesh.normal_z.insert(mesh.normal_z.end(), other.normal_z.begin(), other.normal_z.end());
+    }
+    else
+    {
+        mesh.normal_x.clear();
+        mesh.normal_y.clear();
+        mesh.normal_z.clear();
+    }
+
+    if (offset == 0 || (mesh.has_colors() && other.has_colors()))
+    {
+        mesh.colors.insert(mesh.colors.end(), other.colors.begin(), other.colors.end());
+    }
+    else
+    {
+        mesh.colors.clear();
+    }
+
+    mesh.position_x.insert(mesh.position_x.end(), other.position_x.begin(), other.position_x.end());
+    mesh.position_y.insert(mesh.position_y.end(), other.position_y.begin(), other.position_y.end());
+    mesh.position_z.insert(mesh.position_z.end(), other.position_z.begin(), other.position_z.end());
+
+    for (const uint32_t index : other.indices)
+    {
+        mesh.indices.push_back(offset + index);
+    }
+}
+
+// Merges the vertices that snap to the same point of a grid with `tolerance`
+// spacing, and drops the triangles that collapse in the process.
+static void weld_mesh(const Mesh& mesh, float tolerance, Mesh& out_mesh)
+{
+    const uint32_t count = mesh.vertex_count();
+    const float    scale = 1.0f / tolerance;
+
+    std::vector<int32_t> cells(size_t(count) * 3);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const glm::vec3 cell = glm::clamp(glm::floor(mesh.position(i) * scale + 0.5f), glm::vec3(-2e9f), glm::vec3(2e9f));
+
+        cells[i * 3 + 0] = int32_t(cell.x);
+        cells[i * 3 + 1] = int32_t(cell.y);
+        cells[i * 3 + 2] = int32_t(cell.z);
+    }
+
+    std::vector<uint32_t> remap(count);
+
+    const size_t unique = meshopt_generateVertexRemap(
+        remap.data(),
+        mesh.indices.data(),
+        mesh.indices.size(),
+        cells.data(),
+        count,
+        sizeof(int32_t) * 3
+    );
+
+    out_mesh.position_x.resize(unique);
+    out_mesh.position_y.resize(unique);
+    out_mesh.position_z.resize(unique);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        // Unreferenced vertices map to ~0u.
+        if (remap[i] < unique)
+        {
+            out_mesh.position_x[remap[i]] = mesh.position_x[i];
+            out_mesh.position_y[remap[i]] = mesh.position_y[i];
+            out_mesh.position_z[remap[i]] = mesh.position_z[i];
+        }
+    }
+
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+    {
+        const uint32_t a = remap[mesh.indices[i + 0]];
+        const uint32_t b = remap[mesh.indices[i + 1]];
+        const uint32_t c = remap[mesh.indices[i + 2]];
+
+        if (a != b && b != c && c != a)
+        {
+            out_mesh.add_triangle(a, b, c);
+        }
+    }
+}
+
+static void transform_mesh(const glm::mat4& matrix, const Mesh& mesh, Mesh& out_mesh)
+{
+    out_mesh.position_x.resize(mesh.vertex_count());
+    out_mesh.position_y.resize(mesh.vertex_count());
+    out_mesh.position_z.resize(mesh.vertex_count());
+    out_mesh.indices = mesh.indices;
+
+    transform_points(matrix, mesh.positions(), out_mesh.positions(), mesh.vertex_count());
+}
+
+
+// -----------------------------------------------------------------------------
+// LUAU BINDINGS
+// -----------------------------------------------------------------------------
+
+static const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+
+static uint64_t fnv1a(const void* data, size_t size, uint64_t hash = FNV_OFFSET_BASIS)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+// Everything the native functions and the interrupt callback need, reached
+// through `lua_callbacks(L)->userdata`.
+struct ScriptTaskPool;
+
+struct ScriptContext
+{
+    ScriptResult*            result    = nullptr;
+    ScriptCache*             cache     = nullptr;
+    bool                     native    = false;
+
+    SdfTree                  sdf;                 // Nodes of the script's fields.
+
+    ScriptPartQueue*         parts     = nullptr; // Streamed to, if set.
+    bool                     overflow  = false;   // Parts no longer fit.
+
+    ScriptPreviewQueue*      previews  = nullptr; // Sent to, if set.
+    uint32_t                 sdf_calls = 0;       // Meshing calls so far.
+    std::vector<uint64_t>    brick_maps;          // Keys of those in the result's bytes.
+
+    ScriptProfile*           profile     = nullptr; // Sampled into, if set.
+    int64_t                  interval    = 0;       // Sampling, in HP ticks.
+    int64_t                  last_sample = 0;       // HP counter.
+
+    ScriptTaskPool*          pool      = nullptr;
+    uint32_t                 tasks     = 0;     // Registered with `task`.
+    bool                     worker    = false; // VM of the task pool.
+
+    const std::atomic<bool>* cancel    = nullptr;
+    const std::atomic<bool>* abort     = nullptr; // Tasks no longer needed.
+    int64_t                  deadline  = INT64_MAX; // HP counter.
+    uint64_t                 max_steps = 0;
+    uint64_t                 steps     = 0;
+    ScriptStatus             status    = ScriptStatus::SUCCESS;
+};
+
+static ScriptContext& get_context(lua_State* L)
+{
+    return *static_cast<ScriptContext*>(lua_callbacks(L)->userdata);
+}
+
+// Lets long native calls stop with the script, which the interrupt can't do
+// while they run.
+static TaskCancel get_cancel(const ScriptContext& context)
+{
+    TaskCancel cancel;
+    cancel.flags[0] = context.cancel;
+    cancel.flags[1] = context.abort;
+    cancel.deadline = context.deadline;
+
+    return cancel;
+}
+
+// Raises the interrupt's error if the native call stopped early, before its
+// incomplete output gets cached.
+static void check_cancel(lua_State* L, const TaskCancel& cancel)
+{
+    if (!cancel.requested())
+    {
+        return;
+    }
+
+    ScriptContext& context = get_context(L);
+
+    const bool stopped = (context.cancel && context.cancel->load(std::memory_order_relaxed)) ||
+                         (context.abort  && context.abort ->load(std::memory_order_relaxed));
+
+    context.status = stopped ? ScriptStatus::CANCELLED : ScriptStatus::TIMED_OUT;
+
+    luaL_error(L, "%s", stopped ? "cancelled" : "out of budget");
+}
+
+// Identity of a geometry call: FNV-1a over the function name, the converted
+// arguments and the keys of the input meshes. Since input keys are themselves
+// hashes of their calls, equal keys mean equal upstream subtrees, and changing
+// one parameter changes the keys of exactly the calls downstream of it.
+struct CallKey
+{
+    uint64_t value = FNV_OFFSET_BASIS;
+
+    explicit CallKey(const char* name)
+    {
+        add(name, strlen(name) + 1);
+    }
+
+    void add(const void* data, size_t size)
+    {
+        value = fnv1a(data, size, value);
+    }
+
+    template <typename T>
+    void add(const T& x)
+    {
+        add(&x, sizeof(x));
+    }
+};
+
+static const uint32_t NO_SDF_CALL = UINT32_MAX;
+
+// Mesh userdata. Meshes made by geometry calls are immutable, so they are
+// shared with the cache and between script values. Those the script builds
+// itself with `mesh` or `copy` are writable through attribute views; they are
+// never cached, and their key is a hash of their current contents.
+//
+// Meshes of fields, and their transforms, remember the meshing call, for the
+// placements of the result (see `ScriptSdfPlacement`).
+struct ScriptMesh
+{
+    std::shared_ptr<const Mesh> mesh;
+    Mesh*                       writable   = nullptr;     // Same mesh, if writable.
+    uint64_t                    key        = 0;           // Unused when writable.
+    uint32_t                    sdf_call   = NO_SDF_CALL;
+    glm::mat4                   sdf_matrix = glm::mat4(1.0f);
+};
+
+enum struct MeshAttribute
+{
+    POSITIONS,
+    NORMALS,
+    INDICES,
+};
+
+// Attribute view userdata, indexed from 1 like Lua arrays. Positions and
+// normals read and write as vectors, indices as integers (also from 1). Every
+// access is checked against the current size of the array, so views stay
+// valid when the mesh grows.
+struct ScriptMeshView
+{
+    std::shared_ptr<const Mesh> mesh;
+    Mesh*                       writable  = nullptr;
+    MeshAttribute               attribute = MeshAttribute::POSITIONS;
+};
+
+static const char* MESH_TYPE      = "Mesh";
+static const char* MESH_VIEW_TYPE = "MeshView";
+
+template <typename T>
+static void push_userdata(lua_State* L, const char* type, T&& value)
+{
+    void* memory = lua_newuserdatadtor(L, sizeof(T), [](void* ptr)
+    {
+        static_cast<T*>(ptr)->~T();
+    });
+
+    new (memory) T(std::move(value));
+
+    luaL_getmetatable(L, type);
+    lua_setmetatable(L, -2);
+}
+
+// Pushes the output of the call identified by `key`, taking it from the cache
+// when an earlier evaluation made the same call, and running `build` on a new
+// mesh otherwise.
+template <typename Build>
+static void push_mesh(lua_State* L, const CallKey& key, Build&& build)
+{
+    ScriptContext&              context = get_context(L);
+    std::shared_ptr<const Mesh> mesh;
+
+    if (context.cache)
+    {
+        mesh = context.cache->find(key.value);
+    }
+
+    if (mesh)
+    {
+        context.result->cache_hits++;
+    }
+    else
+    {
+        std::shared_ptr<Mesh> built = std::make_shared<Mesh>();
+        build(*built);
+
+        mesh = std::move(built);
+        context.result->cache_misses++;
+
+        if (context.cache)
+        {
+            context.cache->insert(key.value, mesh);
+        }
+    }
+
+    push_userdata(L, MESH_TYPE, ScriptMesh{ std::move(mesh), nullptr, key.value });
+}
+
+static Mesh& push_writable_mesh(lua_State* L)
+{
+    std::shared_ptr<Mesh> mesh     = std::make_shared<Mesh>();
+    Mesh*                 writable = mesh.get();
+
+    push_userdata(L, MESH_TYPE, ScriptMesh{ std::move(mesh), writable });
+
+    return *writable;
+}
+
+static const ScriptMesh& check_mesh(lua_State* L, int arg)
+{
+    return *static_cast<const ScriptMesh*>(luaL_checkudata(L, arg, MESH_TYPE));
+}
+
+static Mesh& check_writable_mesh(lua_State* L, int arg)
+{
+    const ScriptMesh& mesh = check_mesh(L, arg);
+
+    luaL_argcheck(L, mesh.writable, arg, "mesh is read-only, make a copy first");
+
+    return *mesh.writable;
+}
+
+// Word-at-a-time hash, for the contents of writable meshes.
+static uint64_t hash_words(const void* data, size_t size, uint64_t hash)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    size_t         i     = 0;
+
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+
+        hash  = (hash ^ word) * 0x9e3779b97f4a7c15ull;
+        hash ^= hash >> 32;
+    }
+
+    return fnv1a(bytes + i, size - i, hash);
+}
+
+template <typename T>
+static uint64_t hash_words(const std::vector<T>& values, uint64_t hash)
+{
+    return hash_words(values.data(), values.size() * sizeof(T), hash);
+}
+
+static uint64_t mesh_key(const ScriptMesh& script_mesh)
+{
+    if (!script_mesh.writable)
+    {
+        return script_mesh.key;
+    }
+
+    const Mesh& mesh = *script_mesh.mesh;
+
+    CallKey key("mesh");
+    key.value = hash_words(mesh.position_x, key.value);
+    key.value = hash_words(mesh.position_y, key.value);
+    key.value = hash_words(mesh.position_z, key.value);
+    key.value = hash_words(mesh.normal_x  , key.value);
+    key.value = hash_words(mesh.normal_y  , key.value);
+    key.value = hash_words(mesh.normal_z  , key.value);
+    key.value = hash_words(mesh.indices   , key.value);
+
+    return key.value;
+}
+
+// Either a vector or three numbers, starting at `arg`.
+static glm::vec3 check_vec3(lua_State* L, int arg)
+{
+    if (lua_isvector(L, arg))
+    {
+        const float* v = lua_tovector(L, arg);
+
+        return { v[0], v[1], v[2] };
+    }
+
+    return
+    {
+        float(luaL_checknumber(L, arg + 0)),
+        float(luaL_checknumber(L, arg + 1)),
+        float(luaL_checknumber(L, arg + 2)),
+    };
+}
+
+static uint32_t check_segments(lua_State* L, int arg)
+{
+    const int segments = luaL_optinteger(L, arg, 32);
+
+    luaL_argcheck(L, segments >= 3 && segments <= 4096, arg, "segment count out of range");
+
+    return uint32_t(segments);
+}
+
+// box(sx, sy, sz)
+static int script_box(lua_State* L)
+{
+    const float x = float(luaL_checknumber(L, 1));
+    const float y = float(luaL_optnumber (L, 2, x));
+    const float z = float(luaL_optnumber (L, 3, x));
+
+    CallKey key("box");
+    key.add(glm::vec3(x, y, z));
+
+    push_mesh(L, key, [&](Mesh& mesh) { make_box(mesh, { x, y, z }); });
+
+    return 1;
+}
+
+// sphere(radius, [segments])
+static int script_sphere(lua_State* L)
+{
+    const float    radius   = float(luaL_checknumber(L, 1));
+    const uint32_t segments = check_segments(L, 2);
+
+    CallKey key("sphere");
+    key.add(radius);
+    key.add(segments);
+
+    push_mesh(L, key, [&](Mesh& mesh) { make_sphere(mesh, radius, segments); });
+
+    return 1;
+}
+
+// cylinder(radius, height, [segments])
+static int script_cylinder(lua_State* L)
+{
+    const float    radius   = float(luaL_checknumber(L, 1));
+    const float    height   = float(luaL_checknumber(L, 2));
+    const uint32_t segments = check_segments(L, 3);
+
+    CallKey key("cylinder");
+    key.add(radius);
+    key.add(height);
+    key.add(segments);
+
+    push_mesh(L, key, [&](Mesh& mesh) { make_cylinder(mesh, radius, height, segments); });
+
+    return 1;
+}
+
+static void push_transformed_mesh(lua_State* L, const char* name, const ScriptMesh& input, const glm::mat4& matrix)
+{
+    CallKey key(name);
+    key.add(mesh_key(input));
+    key.add(matrix);
+
+    push_mesh(L, key, [&](Mesh& mesh) { transform_mesh(matrix, *input.mesh, mesh); });
+
+    if (input.sdf_call != NO_SDF_CALL)
+    {
+        ScriptMesh& output = *static_cast<ScriptMesh*>(lua_touserdata(L, -1));
+        output.sdf_call   = input.sdf_call;
+        output.sdf_matrix = matrix * input.sdf_matrix;
+    }
+}
+
+// translate(mesh, offset)
+static int script_translate(lua_State* L)
+{
+    const ScriptMesh& input  = check_mesh(L, 1);
+    const glm::vec3   offset = check_vec3(L, 2);
+
+    push_transformed_mesh(L, "translate", input, glm::translate(glm::mat4(1.0f), offset));
+
+    return 1;
+}
+
+// scale(mesh, factors), or scale(mesh, factor) for a uniform one.
+static int script_scale(lua_State* L)
+{
+    const ScriptMesh& input   = check_mesh(L, 1);
+    const glm::vec3   factors = lua_isnumber(L, 2) && lua_isnoneornil(L, 3)
+        ? glm::vec3(float(lua_tonumber(L, 2)))
+        : check_vec3(L, 2);
+
+    push_transformed_mesh(L, "scale", input, glm::scale(glm::mat4(1.0f), factors));
+
+    return 1;
+}
+
+// rotate(mesh, degrees, axis)
+static int script_rotate(lua_State* L)
+{
+    const ScriptMesh& input = check_mesh(L, 1);
+    const float       angle = float(luaL_checknumber(L, 2));
+    const glm::vec3   axis  = check_vec3(L, 3);
+
+    luaL_argcheck(L, glm::length(axis) > 0.0f, 3, "zero rotation axis");
+
+    push_transformed_mesh(L, "rotate", input, glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::normalize(axis)));
+
+    return 1;
+}
+
+// transform(mesh, origin, x_axis, y_axis, z_axis), mapping each point p to
+// origin + p.x * x_axis + p.y * y_axis + p.z * z_axis.
+static int script_transform(lua_State* L)
+{
+    const ScriptMesh& input  = check_mesh(L, 1);
+    const glm::vec3   origin = check_vec3(L, 2);
+
+    glm::mat4 matrix(1.0f);
+
+    for (int i = 0; i < 3; i++)
+    {
+        luaL_checktype(L, 3 + i, LUA_TVECTOR);
+
+        matrix[i] = glm::vec4(check_vec3(L, 3 + i), 0.0f);
+    }
+
+    matrix[3] = glm::vec4(origin, 1.0f);
+
+    push_transformed_mesh(L, "transform", input, matrix);
+
+    return 1;
+}
+
+// merge(mesh, ...)
+static int script_merge(lua_State* L)
+{
+    const int count = lua_gettop(L);
+
+    CallKey key("merge");
+
+    for (int i = 1; i <= count; i++)
+    {
+        key.add(mesh_key(check_mesh(L, i)));
+    }
+
+    push_mesh(L, key, [&](Mesh& merged)
+    {
+        for (int i = 1; i <= count; i++)
+        {
+            append_mesh(merged, *check_mesh(L, i).mesh);
+        }
+    });
+
+    return 1;
+}
+
+// weld(mesh, [tolerance])
+static int script_weld(lua_State* L)
+{
+    const ScriptMesh& input     = check_mesh(L, 1);
+    const float       tolerance = float(luaL_optnumber(L, 2, 1e-5));
+
+    luaL_argcheck(L, tolerance > 0.0f, 2, "tolerance must be positive");
+
+    CallKey key("weld");
+    key.add(mesh_key(input));
+    key.add(tolerance);
+
+    push_mesh(L, key, [&](Mesh& mesh) { weld_mesh(*input.mesh, tolerance, mesh); });
+
+    return 1;
+}
+
+static int push_mesh_boolean(lua_State* L, const char* name, CsgOperation operation)
+{
+    const ScriptMesh& a = check_mesh(L, 1);
+    const ScriptMesh& b = check_mesh(L, 2);
+
+    CallKey key(name);
+    key.add(mesh_key(a));
+    key.add(mesh_key(b));
+
+    push_mesh(L, key, [&](Mesh& mesh)
+    {
+        const TaskCancel cancel = get_cancel(get_context(L));
+        mesh_boolean(*a.mesh, *b.mesh, operation, mesh, &cancel);
+        check_cancel(L, cancel);
+    });
+
+    return 1;
+}
+
+// union(a, b), difference(a, b), intersection(a, b) of closed meshes
+static int script_union       (lua_State* L) { return push_mesh_boolean(L, "union"       , CsgOperation::UNION       ); }
+static int script_difference  (lua_State* L) { return push_mesh_boolean(L, "difference"  , CsgOperation::DIFFERENCE  ); }
+static int script_intersection(lua_State* L) { return push_mesh_boolean(L, "intersection", CsgOperation::INTERSECTION); }
+
+// subdivide(mesh, levels, ["catmull-clark" | "loop"]), smoothing the mesh as
+// a cage. Catmull-Clark takes consecutive triangles sharing an edge as quads,
+// like those of the primitives; weld them first. The stencils are cached by
+// the cage's topology, so only the positions are re-evaluated when just they
+// change.
+static int script_subdivide(lua_State* L)
+{
+    static const char* const SCHEMES[] = { "catmull-clark", "loop", nullptr };
+
+    const ScriptMesh&       input  = check_mesh(L, 1);
+    const int               levels = luaL_checkinteger(L, 2);
+    const SubdivisionScheme scheme = SubdivisionScheme(luaL_checkoption(L, 3, SCHEMES[0], SCHEMES));
+
+    luaL_argcheck(L, levels >= 0 && levels <= 6, 2, "levels must be between 0 and 6");
+    luaL_argcheck(L, SubdivisionSurface::count_triangles(*input.mesh, scheme, uint32_t(levels), true) <= (1u << 26), 2, "too many triangles");
+
+    CallKey key("subdivide");
+    key.add(mesh_key(input));
+    key.add(levels);
+    key.add(scheme);
+
+    push_mesh(L, key, [&](Mesh& mesh)
+    {
+        ScriptContext&   context = get_context(L);
+        const Mesh&      cage    = *input.mesh;
+        const TaskCancel cancel  = get_cancel(context);
+
+        CallKey topology_key("subdivide topology");
+        topology_key.value = hash_words(cage.indices, topology_key.value);
+        topology_key.add(cage.vertex_count());
+        topology_key.add(levels);
+        topology_key.add(scheme);
+
+        std::shared_ptr<const SubdivisionSurface> surface;
+
+        if (context.cache)
+        {
+            surface = context.cache->find_subdivision(topology_key.value);
+        }
+
+        if (!surface)
+        {
+            std::shared_ptr<SubdivisionSurface> built = std::make_shared<SubdivisionSurface>();
+            built->build(cage, scheme, uint32_t(levels), true, &cancel);
+            check_cancel(L, cancel);
+
+            surface = std::move(built);
+
+            if (context.cache)
+            {
+                context.cache->insert_subdivision(topology_key.value, surface);
+            }
+        }
+
+        surface->evaluate(cage.positions(), mesh, &cancel);
+        check_cancel(L, cancel);
+    });
+
+    return 1;
+}
+
+// mesh(vertex_count, triangle_count), a writable mesh with all positions at
+// the origin and all triangles on the first vertex.
+static int script_mesh(lua_State* L)
+{
+    const int vertex_count   = luaL_checkinteger(L, 1);
+    const int triangle_count = luaL_optinteger (L, 2, 0);
+
+    const int max_count = 1 << 26;
+
+    luaL_argcheck(L, vertex_count   >= 0 && vertex_count   <= max_count, 1, "vertex count out of range");
+    luaL_argcheck(L, triangle_count >= 0 && triangle_count <= max_count, 2, "triangle count out of range");
+    luaL_argcheck(L, vertex_count > 0 || triangle_count == 0, 1, "triangles need vertices");
+
+    Mesh& mesh = push_writable_mesh(L);
+
+    mesh.position_x.resize(size_t(vertex_count));
+    mesh.position_y.resize(size_t(vertex_count));
+    mesh.position_z.resize(size_t(vertex_count));
+    mesh.indices   .resize(size_t(triangle_count) * 3);
+
+    return 1;
+}
+
+// copy(mesh), a writable copy.
+static int script_copy(lua_State* L)
+{
+    const ScriptMesh& input = check_mesh(L, 1);
+
+    push_writable_mesh(L) = *input.mesh;
+
+    return 1;
+}
+
+// append(mesh, other, ...), appending in place to a writable mesh. Returns it.
+static int script_append(lua_State* L)
+{
+    Mesh&     mesh  = check_writable_mesh(L, 1);
+    const int count = lua_gettop(L);
+
+    for (int i = 2; i <= count; i++)
+    {
+        check_mesh(L, i);
+    }
+
+    for (int i = 2; i <= count; i++)
+    {
+        const Mesh& other = *check_mesh(L, i).mesh;
+
+        // Appending a mesh to itself would read what it's writing.
+        if (&other == &mesh)
+        {
+            const Mesh copy = other;
+            append_mesh(mesh, copy);
+        }
+        else
+        {
+            append_mesh(mesh, other);
+        }
+    }
+
+    lua_settop(L, 1);
+
+    return 1;
+}
+
+static int push_mesh_view(lua_State* L, MeshAttribute attribute)
+{
+    const ScriptMesh& mesh = check_mesh(L, 1);
+
+    if (attribute == MeshAttribute::NORMALS && !mesh.mesh->has_normals())
+    {
+        luaL_argcheck(L, mesh.writable, 1, "read-only mesh without normals");
+
+        mesh.writable->resize_normals();
+    }
+
+    push_userdata(L, MESH_VIEW_TYPE, ScriptMeshView{ mesh.mesh, mesh.writable, attribute });
+
+    return 1;
+}
+
+// positions(mesh), normals(mesh), indices(mesh)
+static int script_positions(lua_State* L) { return push_mesh_view(L, MeshAttribute::POSITIONS); }
+static int script_normals  (lua_State* L) { return push_mesh_view(L, MeshAttribute::NORMALS  ); }
+static int script_indices  (lua_State* L) { return push_mesh_view(L, MeshAttribute::INDICES  ); }
+
+static const ScriptMeshView& check_mesh_view(lua_State* L, int arg)
+{
+    return *static_cast<const ScriptMeshView*>(luaL_checkudata(L, arg, MESH_VIEW_TYPE));
+}
+
+static uint32_t mesh_view_size(const ScriptMeshView& view)
+{
+    switch (view.attribute)
+    {
+    case MeshAttribute::POSITIONS: return uint32_t(view.mesh->position_x.size());
+    case MeshAttribute::NORMALS  : return uint32_t(view.mesh->normal_x  .size());
+    default                      : return uint32_t(view.mesh->indices   .size());
+    }
+}
+
+static uint32_t check_mesh_view_index(lua_State* L, const ScriptMeshView& view)
+{
+    const int index = luaL_checkinteger(L, 2);
+
+    luaL_argcheck(L, index >= 1 && uint32_t(index) <= mesh_view_size(view), 2, "index out of range");
+
+    return uint32_t(index - 1);
+}
+
+static int script_mesh_view_index(lua_State* L)
+{
+    const ScriptMeshView& view = check_mesh_view(L, 1);
+    const uint32_t        i    = check_mesh_view_index(L, view);
+    const Mesh&           mesh = *view.mesh;
+
+    switch (view.attribute)
+    {
+    case MeshAttribute::POSITIONS:
+        lua_pushvector(L, mesh.position_x[i], mesh.position_y[i], mesh.position_z[i]);
+        break;
+
+    case MeshAttribute::NORMALS:
+        lua_pushvector(L, mesh.normal_x[i], mesh.normal_y[i], mesh.normal_z[i]);
+        break;
+
+    case MeshAttribute::INDICES:
+        lua_pushinteger(L, int(mesh.indices[i]) + 1);
+        break;
+    }
+
+    return 1;
+}
+
+static int script_mesh_view_newindex(lua_State* L)
+{
+    const ScriptMeshView& view = check_mesh_view(L, 1);
+    const uint32_t        i    = check_mesh_view_index(L, view);
+
+    luaL_argcheck(L, view.writable, 1, "mesh is read-only, make a copy first");
+
+    Mesh& mesh = *view.writable;
+
+    switch (view.attribute)
+    {
+    case MeshAttribute::POSITIONS:
+    {
+        const float* v = luaL_checkvector(L, 3);
+
+        mesh.position_x[i] = v[0];
+        mesh.position_y[i] = v[1];
+        mesh.position_z[i] = v[2];
+        break;
+    }
+
+    case MeshAttribute::NORMALS:
+    {
+        const float* v = luaL_checkvector(L, 3);
+
+        mesh.normal_x[i] = v[0];
+        mesh.normal_y[i] = v[1];
+        mesh.normal_z[i] = v[2];
+        break;
+    }
+
+    case MeshAttribute::INDICES:
+    {
+        const int index = luaL_checkinteger(L, 3);
+
+        luaL_argcheck(L, index >= 1 && uint32_t(index) <= mesh.vertex_count(), 3, "vertex index out of range");
+
+        mesh.indices[i] = uint32_t(index - 1);
+        break;
+    }
+    }
+
+    return 0;
+}
+
+static int script_mesh_view_len(lua_State* L)
+{
+    lua_pushinteger(L, int(mesh_view_size(check_mesh_view(L, 1))));
+
+    return 1;
+}
+
+// vector(x, y, z)
+static int script_vector(lua_State* L)
+{
+    lua_pushvector(
+        L,
+        float(luaL_checknumber(L, 1)),
+        float(luaL_checknumber(L, 2)),
+        float(luaL_checknumber(L, 3))
+    );
+
+    return 1;
+}
+
+// emit(mesh, [color]), with the color as 0xRRGGBB.
+// Streams the part if possible, or adds it to the result.
+static void emit_part(ScriptContext& context, Mesh&& mesh, uint32_t color)
+{
+    ScriptResult& result = *context.result;
+
+    if (context.parts && !context.overflow)
+    {
+        ScriptPart part = { std::move(mesh), color, result.generation };
+
+        if (context.parts->push(std::move(part)))
+        {
+            result.streamed++;
+
+            return;
+        }
+
+        // Keeps the order: the consumer appends the result to the streamed parts.
+        context.overflow = true;
+        mesh             = std::move(part.mesh);
+    }
+
+    result.meshes.push_back(std::move(mesh));
+    result.colors.push_back(color);
+}
+
+static int script_emit(lua_State* L)
+{
+    ScriptContext&    context = get_context(L);
+    const ScriptMesh& mesh    = check_mesh(L, 1);
+    const uint32_t    rgb     = uint32_t(luaL_optunsigned(L, 2, 0xd0d0d0));
+    const uint32_t    color   = 0xff000000 | ((rgb & 0xff) << 16) | (rgb & 0xff00) | ((rgb >> 16) & 0xff);
+
+    if (mesh.sdf_call != NO_SDF_CALL && !context.worker)
+    {
+        ScriptResult& result = *context.result;
+
+        result.sdf_placements.push_back({
+            .part   = result.streamed + uint32_t(result.meshes.size()),
+            .call   = mesh.sdf_call,
+            .matrix = mesh.sdf_matrix,
+            .color  = color,
+        });
+    }
+
+    emit_part(context, Mesh(*mesh.mesh), color);
+
+    return 0;
+}
+
+// native(f), marking a function (and the functions nested in it) for machine
+// code generation. Returns `f`, so it can wrap a function definition. Without
+// native code enabled, `f` simply stays interpreted.
+static int script_native(lua_State* L)
+{
+    luaL_checktype(L, 1, LUA_TFUNCTION);
+    luaL_argcheck(L, !lua_iscfunction(L, 1), 1, "expected a Luau function");
+
+#ifdef WITH_LUAU_CODEGEN
+    if (get_context(L).native)
+    {
+        Luau::CodeGen::compile(L, 1);
+    }
+#endif
+
+    lua_settop(L, 1);
+
+    return 1;
+}
+
+static void register_script_api(lua_State* L)
+{
+    luaL_newmetatable(L, MESH_TYPE);
+    lua_pushstring(L, MESH_TYPE);
+    lua_setfield(L, -2, "__type");
+    lua_pop(L, 1);
+
+    luaL_newmetatable(L, MESH_VIEW_TYPE);
+    lua_pushstring(L, MESH_VIEW_TYPE);
+    lua_setfield(L, -2, "__type");
+    lua_pushcfunction(L, script_mesh_view_index, "__index");
+    lua_setfield(L, -2, "__index");
+    lua_pushcfunction(L, script_mesh_view_newindex, "__newindex");
+    lua_setfield(L, -2, "__newindex");
+    lua_pushcfunction(L, script_mesh_view_len, "__len");
+    lua_setfield(L, -2, "__len");
+    lua_pop(L, 1);
+
+    static const luaL_Reg functions[] =
+    {
+        { "append"      , script_append       },
+        { "box"         , script_box          },
+        { "copy"        , script_copy         },
+        { "cylinder"    , script_cylinder     },
+        { "difference"  , script_difference   },
+        { "emit"        , script_emit         },
+        { "indices"     , script_indices      },
+        { "intersection", script_intersection },
+        { "merge"       , script_merge        },
+        { "mesh"        , script_mesh         },
+        { "native"      , script_native       },
+        { "normals"     , script_normals      },
+        { "positions"   , script_positions    },
+        { "rotate"      , script_rotate       },
+        { "scale"       , script_scale        },
+        { "sphere"      , script_sphere       },
+        { "subdivide"   , script_subdivide    },
+        { "transform"   , script_transform    },
+        { "translate"   , script_translate    },
+        { "union"       , script_union        },
+        { "vector"      , script_vector       },
+        { "weld"        , script_weld         },
+
+        { nullptr    , nullptr          }
+    };
+
+    lua_pushvalue(L, LUA_GLOBALSINDEX);
+    luaL_register(L, nullptr, functions);
+    lua_pop(L, 1);
+}
+
+
+// -----------------------------------------------------------------------------
+// SDF BINDINGS
+// -----------------------------------------------------------------------------
+
+// Signed distance field userdata: a node of the evaluation's `SdfTree`. Fields
+// are cheap to combine; only `sdf.mesh` and `sdf.contour` do real work, and
+// they're memoized by the subtree's hash like the other geometry calls.
+struct ScriptSdf
+{
+    uint32_t node = 0;
+};
+
+// Brick map userdata, sampled from a field by `sdf.bricks`, for meshing and
+// distance queries. Immutable, and shared with the cache.
+struct ScriptSdfBricks
+{
+    std::shared_ptr<const SdfBrickMap> map;
+    uint64_t                           key = 0;
+};
+
+static const char* SDF_TYPE        = "Sdf";
+static const char* SDF_BRICKS_TYPE = "SdfBricks";
+
+// Bounds the grids of `sdf.mesh` and `sdf.contour`.
+static const uint64_t MAX_SDF_CELLS = 1ull << 27;
+
+static int push_sdf(lua_State* L, uint32_t node)
+{
+    if (get_context(L).sdf.nodes[node].depth > SdfTree::MAX_DEPTH)
+    {
+        luaL_error(L, "field nested too deeply (over %d operations); combine parts pairwise", int(SdfTree::MAX_DEPTH));
+    }
+
+    push_userdata(L, SDF_TYPE, ScriptSdf{ node });
+
+    return 1;
+}
+
+static uint32_t check_sdf(lua_State* L, int arg)
+{
+    return static_cast<const ScriptSdf*>(luaL_checkudata(L, arg, SDF_TYPE))->node;
+}
+
+static SdfTree& get_sdf_tree(lua_State* L)
+{
+    return get_context(L).sdf;
+}
+
+// sdf.sphere(radius)
+static int script_sdf_sphere(lua_State* L)
+{
+    return push_sdf(L, get_sdf_tree(L).sphere(float(luaL_checknumber(L, 1))));
+}
+
+// sdf.box(size, [rounding]), with a vector or uniform size.
+static int script_sdf_box(lua_State* L)
+{
+    const glm::vec3 size     = lua_isnumber(L, 1) ? glm::vec3(float(lua_tonumber(L, 1))) : check_vec3(L, 1);
+    const float     rounding = float(luaL_optnumber(L, 2, 0.0));
+
+    return push_sdf(L, get_sdf_tree(L).box(size * 0.5f, rounding));
+}
+
+// sdf.cylinder(radius, height)
+static int script_sdf_cylinder(lua_State* L)
+{
+    return push_sdf(L, get_sdf_tree(L).cylinder(float(luaL_checknumber(L, 1)), float(luaL_checknumber(L, 2)) * 0.5f));
+}
+
+// sdf.torus(major_radius, minor_radius)
+static int script_sdf_torus(lua_State* L)
+{
+    return push_sdf(L, get_sdf_tree(L).torus(float(luaL_checknumber(L, 1)), float(luaL_checknumber(L, 2))));
+}
+
+// sdf.capsule(radius, length)
+static int script_sdf_capsule(lua_State* L)
+{
+    return push_sdf(L, get_sdf_tree(L).capsule(float(luaL_checknumber(L, 1)), float(luaL_checknumber(L, 2)) * 0.5f));
+}
+
+// sdf.plane(normal, offset)
+static int script_sdf_plane(lua_State* L)
+{
+    const glm::vec3 normal = check_vec3(L, 1);
+
+    luaL_argcheck(L, glm::length(normal) > 0.0f, 1, "zero normal");
+
+    return push_sdf(L, get_sdf_tree(L).plane(normal, float(luaL_optnumber(L, 2, 0.0))));
+}
+
+// sdf.union(a, b, [radius]), sdf.intersect(a, b, [radius]) and
+// sdf.subtract(a, b, [radius]), smooth with a blending radius.
+static int script_sdf_union(lua_State* L)
+{
+    return push_sdf(L, get_sdf_tree(L).unite(check_sdf(L, 1), check_sdf(L, 2), float(luaL_optnumber(L, 3, 0.0))));
+}
+
+static int script_sdf_intersect(lua_State* L)
+{
+    return push_sdf(L, get_sdf_tree(L).intersect(check_sdf(L, 1), check_sdf(L, 2), float(luaL_optnumber(L, 3, 0.0))));
+}
+
+static int script_sdf_subtract(lua_State* L)
+{
+    return push_sdf(L, get_sdf_tree(L).subtract(check_sdf(L, 1), check_sdf(L, 2), float(luaL_optnumber(L, 3, 0.0))));
+}
+
+// sdf.translate(field, offset)
+static int script_sdf_translate(lua_State* L)
+{
+    const uint32_t node = check_sdf(L, 1);
+
+    return push_sdf(L, get_sdf_tree(L).transform(node, glm::translate(glm::mat4(1.0f), check_vec3(L, 2))));
+}
+
+// sdf.rotate(field, degrees, axis)
+static int script_sdf_rotate(lua_State* L)
+{
+    const uint32_t  node  = check_sdf(L, 1);
+    const float     angle = float(luaL_checknumber(L, 2));
+    const glm::vec3 axis  = check_vec3(L, 3);
+
+    luaL_argcheck(L, glm::length(axis) > 0.0f, 3, "zero rotation axis");
+
+    return push_sdf(L, get_sdf_tree(L).transform(node, glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::normalize(axis))));
+}
+
+// sdf.scale(field, factors), or sdf.scale(field, factor) for a uniform one.
+static int script_sdf_scale(lua_State* L)
+{
+    const uint32_t  node    = check_sdf(L, 1);
+    const glm::vec3 factors = lua_isnumber(L, 2) && lua_isnoneornil(L, 3)
+        ? glm::vec3(float(lua_tonumber(L, 2)))
+        : check_vec3(L, 2);
+
+    luaL_argcheck(L, factors.x != 0.0f && factors.y != 0.0f && factors.z != 0.0f, 2, "zero scale");
+
+    return push_sdf(L, get_sdf_tree(L).transform(node, glm::scale(glm::mat4(1.0f), factors)));
+}
+
+// sdf.repeat(field, period), with a zero period for the axes not to repeat.
+static int script_sdf_repeat(lua_State* L)
+{
+    const uint32_t node = check_sdf(L, 1);
+
+    return push_sdf(L, get_sdf_tree(L).repeat(node, check_vec3(L, 2)));
+}
+
+// sdf.mirror(field, x, y, z), with booleans for the mirrored axes.
+static int script_sdf_mirror(lua_State* L)
+{
+    const uint32_t node = check_sdf(L, 1);
+
+    return push_sdf(L, get_sdf_tree(L).mirror(node, lua_toboolean(L, 2), lua_toboolean(L, 3), lua_toboolean(L, 4)));
+}
+
+// sdf.twist(field, degrees_per_unit), around the Y axis.
+static int script_sdf_twist(lua_State* L)
+{
+    const uint32_t node = check_sdf(L, 1);
+
+    return push_sdf(L, get_sdf_tree(L).twist(node, glm::radians(float(luaL_checknumber(L, 2)))));
+}
+
+// sdf.round(field, radius) and sdf.shell(field, thickness)
+static int script_sdf_round(lua_State* L)
+{
+    const uint32_t node = check_sdf(L, 1);
+
+    return push_sdf(L, get_sdf_tree(L).round(node, float(luaL_checknumber(L, 2))));
+}
+
+static int script_sdf_shell(lua_State* L)
+{
+    const uint32_t node = check_sdf(L, 1);
+
+    return push_sdf(L, get_sdf_tree(L).shell(node, float(luaL_checknumber(L, 2))));
+}
+
+// Grid bounds of the meshing calls: the arguments from `arg` on, or the field's
+// own bounds when absent; unbounded fields need them. With `out_snap`, the
+// field's own bounds are to be snapped to the block lattice, see `mesh_sdf`.
+static Aabb check_sdf_bounds(lua_State* L, const SdfTree& tree, uint32_t node, float cell_size, int arg, SdfGridSnap* out_snap = nullptr)
+{
+    Aabb bounds;
+
+    if (out_snap)
+    {
+        *out_snap = SdfGridSnap::NONE;
+    }
+
+    if (lua_isnoneornil(L, arg))
+    {
+        bounds = tree.bounds(node);
+
+        luaL_argcheck(L, bounds.max.x - bounds.min.x < 1e29f && bounds.max.y - bounds.min.y < 1e29f && bounds.max.z - bounds.min.z < 1e29f,
+            1, "unbounded field, pass the bounds to mesh");
+
+        // Keeps the surface off the grid's outer faces, where it'd stay open.
+        bounds.min -= glm::vec3(cell_size * 1.5f);
+        bounds.max += glm::vec3(cell_size * 1.5f);
+
+        if (out_snap)
+        {
+            *out_snap = SdfGridSnap::BLOCKS;
+        }
+    }
+    else
+    {
+        luaL_checktype(L, arg    , LUA_TVECTOR);
+        luaL_checktype(L, arg + 1, LUA_TVECTOR);
+
+        bounds.extend(check_vec3(L, arg    ));
+        bounds.extend(check_vec3(L, arg + 1));
+    }
+
+    const Aabb      grid  = out_snap && *out_snap == SdfGridSnap::BLOCKS ? snap_sdf_bounds(bounds, cell_size) : bounds;
+    const glm::vec3 cells = glm::ceil(grid.extent() / cell_size);
+
+    luaL_argcheck(L, double(cells.x) * double(cells.y) * double(cells.z) <= double(MAX_SDF_CELLS), 2, "too many cells");
+
+    return bounds;
+}
+
+// Numbers the meshing calls of the script's own VM, which are the ones with
+// placements; the order of tasks' calls depends on scheduling.
+static uint32_t next_sdf_call(ScriptContext& context)
+{
+    return context.worker ? NO_SDF_CALL : context.sdf_calls++;
+}
+
+// Sends the field of a meshing call that's about to mesh it, if previews are
+// on. They're dropped when the queue is full; the mesh comes in anyway.
+static void send_sdf_preview(const ScriptContext& context, uint32_t node, const Aabb& bounds, uint32_t call)
+{
+    if (!context.previews || call == NO_SDF_CALL)
+    {
+        return;
+    }
+
+    ScriptSdfPreview preview;
+    preview.root       = context.sdf.prune(node, bounds, preview.tree);
+    preview.bounds     = bounds;
+    preview.call       = call;
+    preview.generation = context.result->generation;
+
+    context.previews->push(std::move(preview));
+}
+
+// Tags the mesh on top of the stack with its meshing call.
+static void set_sdf_call(lua_State* L, uint32_t call)
+{
+    static_cast<ScriptMesh*>(lua_touserdata(L, -1))->sdf_call = call;
+}
+
+static const ScriptSdfBricks* to_sdf_bricks(lua_State* L, int arg)
+{
+    void* data = lua_touserdata(L, arg);
+
+    if (!data || !lua_getmetatable(L, arg))
+    {
+        return nullptr;
+    }
+
+    luaL_getmetatable(L, SDF_BRICKS_TYPE);
+
+    const bool is_bricks = lua_rawequal(L, -1, -2);
+    lua_pop(L, 2);
+
+    return is_bricks ? static_cast<const ScriptSdfBricks*>(data) : nullptr;
+}
+
+// sdf.mesh(bricks), meshing a brick map over its whole grid.
+static int script_sdf_mesh_bricks(lua_State* L, const ScriptSdfBricks& bricks)
+{
+    CallKey key("sdf.mesh bricks");
+    key.add(bricks.key);
+
+    push_mesh(L, key, [&](Mesh& mesh)
+    {
+        mesh_brick_map(*bricks.map, mesh);
+    });
+
+    return 1;
+}
+
+// sdf.mesh(field, cell_size, [min, max]), within the field's own bounds unless
+// given; unbounded fields need them. Also takes brick maps, see above.
+static int script_sdf_mesh(lua_State* L)
+{
+    if (const ScriptSdfBricks* bricks = to_sdf_bricks(L, 1))
+    {
+        return script_sdf_mesh_bricks(L, *bricks);
+    }
+
+    ScriptContext& context   = get_context(L);
+    const SdfTree& tree      = context.sdf;
+    const uint32_t node      = check_sdf(L, 1);
+    const float    cell_size = float(luaL_checknumber(L, 2));
+
+    luaL_argcheck(L, cell_size > 0.0f, 2, "cell size must be positive");
+
+    SdfGridSnap snap;
+    const Aabb  bounds = check_sdf_bounds(L, tree, node, cell_size, 3, &snap);
+
+    CallKey key("sdf.mesh");
+    key.add(cell_size);
+    key.add(bounds.min);
+    key.add(bounds.max);
+    key.add(snap);
+    key.add(tree.nodes[node].hash);
+
+    ScriptCache*   cache = context.cache;
+    const uint32_t call  = next_sdf_call(context);
+
+    // Even when the mesh itself is cached, its blocks are kept for the next
+    // edit.
+    if (cache)
+    {
+        cache->sdf_blocks.retain(key.value);
+    }
+
+    push_mesh(L, key, [&](Mesh& mesh)
+    {
+        send_sdf_preview(context, node, snap == SdfGridSnap::BLOCKS ? snap_sdf_bounds(bounds, cell_size) : bounds, call);
+
+        const TaskCancel cancel = get_cancel(context);
+
+        mesh_sdf(tree, node, bounds, cell_size, mesh, cache ? &cache->sdf_blocks : nullptr, snap, key.value, &cancel);
+        check_cancel(L, cancel);
+    });
+
+    set_sdf_call(L, call);
+
+    return 1;
+}
+
+// sdf.contour(field, cell_size, tolerance, [min, max]), like `sdf.mesh` but
+// adaptive and keeping sharp features; flat regions merge into cells as large
+// as the distance `tolerance` from the surface allows.
+static int script_sdf_contour(lua_State* L)
+{
+    ScriptContext& context   = get_context(L);
+    const SdfTree& tree      = context.sdf;
+    const uint32_t node      = check_sdf(L, 1);
+    const float    cell_size = float(luaL_checknumber(L, 2));
+    const float    tolerance = float(luaL_checknumber(L, 3));
+
+    luaL_argcheck(L, cell_size > 0.0f, 2, "cell size must be positive");
+    luaL_argcheck(L, tolerance >= 0.0f, 3, "tolerance must not be negative");
+
+    const Aabb bounds = check_sdf_bounds(L, tree, node, cell_size, 4);
+
+    CallKey key("sdf.contour");
+    key.add(tree.nodes[node].hash);
+    key.add(cell_size);
+    key.add(tolerance);
+    key.add(bounds.min);
+    key.add(bounds.max);
+
+    const uint32_t call = next_sdf_call(context);
+
+    push_mesh(L, key, [&](Mesh& mesh)
+    {
+        send_sdf_preview(context, node, bounds, call);
+
+        const TaskCancel cancel = get_cancel(context);
+
+        contour_sdf(tree, node, bounds, cell_size, tolerance, mesh, &cancel);
+        check_cancel(L, cancel);
+    });
+
+    set_sdf_call(L, call);
+
+    return 1;
+}
+
+// sdf.bricks(field, cell_size, [band], [min, max]), sampling the field into a
+// brick map that keeps the distances within `band` of the surface, at least two
+// cells, which is also the default. Grids are bounded like those of `sdf.mesh`.
+static int script_sdf_bricks(lua_State* L)
+{
+    ScriptContext& context   = get_context(L);
+    const SdfTree& tree      = context.sdf;
+    const uint32_t node      = check_sdf(L, 1);
+    const float    cell_size = float(luaL_checknumber(L, 2));
+    const float    band      = float(luaL_optnumber(L, 3, 0.0));
+
+    luaL_argcheck(L, cell_size > 0.0f, 2, "cell size must be positive");
+    luaL_argcheck(L, band >= 0.0f, 3, "band must not be negative");
+
+    const Aabb bounds = check_sdf_bounds(L, tree, node, cell_size, 4);
+
+    CallKey key("sdf.bricks");
+    key.add(tree.nodes[node].hash);
+    key.add(cell_size);
+    key.add(band);
+    key.add(bounds.min);
+    key.add(bounds.max);
+
+    std::shared_ptr<const SdfBrickMap> map;
+
+    if (context.cache)
+    {
+        map = context.cache->find_brick_map(key.value);
+    }
+
+    if (map)
+    {
+        context.result->cache_hits++;
+    }
+    else
+    {
+        std::shared_ptr<SdfBrickMap> built = std::make_shared<SdfBrickMap>();
+        const TaskCancel cancel = get_cancel(context);
+        built->build(tree, node, bounds, cell_size, band, &cancel);
+        check_cancel(L, cancel);
+
+        map = std::move(built);
+        context.result->cache_misses++;
+
+        if (context.cache)
+        {
+            context.cache->insert_brick_map(key.value, map);
+        }
+    }
+
+    if (std::find(context.brick_maps.begin(), context.brick_maps.end(), key.value) == context.brick_maps.end())
+    {
+        context.brick_maps.push_back(key.value);
+        context.result->sdf_brick_bytes += map->memory_usage();
+    }
+
+    push_userdata(L, SDF_BRICKS_TYPE, ScriptSdfBricks{ std::move(map), key.value });
+
+    return 1;
+}
+
+// sdf.distance(field, point), exact, or sdf.distance(bricks, point), clamped to
+// the band and interpolated between samples.
+static int script_sdf_distance(lua_State* L)
+{
+    if (const ScriptSdfBricks* bricks = to_sdf_bricks(L, 1))
+    {
+        lua_pushnumber(L, bricks->map->distance(check_vec3(L, 2)));
+
+        return 1;
+    }
+
+    const uint32_t node = check_sdf(L, 1);
+
+    lua_pushnumber(L, get_sdf_tree(L).evaluate(node, check_vec3(L, 2)));
+
+    return 1;
+}
+
+static void register_sdf_api(lua_State* L)
+{
+    for (const char* type : { SDF_TYPE, SDF_BRICKS_TYPE })
+    {
+        luaL_newmetatable(L, type);
+        lua_pushstring(L, type);
+        lua_setfield(L, -2, "__type");
+        lua_pop(L, 1);
+    }
+
+    static const luaL_Reg functions[] =
+    {
+        { "box"      , script_sdf_box       },
+        { "bricks"   , script_sdf_bricks    },
+        { "capsule"  , script_sdf_capsule   },
+        { "contour"  , script_sdf_contour   },
+        { "cylinder" , script_sdf_cylinder  },
+        { "distance" , script_sdf_distance  },
+        { "intersect", script_sdf_intersect },
+        { "mesh"     , script_sdf_mesh      },
+        { "mirror"   , script_sdf_mirror    },
+        { "plane"    , script_sdf_plane     },
+        { "repeat"   , script_sdf_repeat    },
+        { "rotate"   , script_sdf_rotate    },
+        { "round"    , script_sdf_round     },
+        { "scale"    , script_sdf_scale     },
+        { "shell"    , script_sdf_shell     },
+        { "sphere"   , script_sdf_sphere    },
+        { "subtract" , script_sdf_subtract  },
+        { "torus"    , script_sdf_torus     },
+        { "translate", script_sdf_translate },
+        { "twist"    , script_sdf_twist     },
+        { "union"    , script_sdf_union     },
+
+        { nullptr    , nullptr              }
+    };
+
+    luaL_register(L, "sdf", functions);
+    lua_pop(L, 1);
+}
+
+static const int MAX_PROFILE_DEPTH = 64;
+
+static std::string frame_name(const lua_Debug& frame)
+{
+    char name[256];
+
+    if (frame.what && strcmp(frame.what, "C") == 0)
+    {
+        snprintf(name, sizeof(name), "[C] %s", frame.name ? frame.name : "?");
+    }
+    else if (frame.what && strcmp(frame.what, "main") == 0)
+    {
+        snprintf(name, sizeof(name), "main");
+    }
+    else
+    {
+        snprintf(name, sizeof(name), "%s:%d", frame.name ? frame.name : "anonymous", frame.linedefined);
+    }
+
+    return name;
+}
+
+// Adds a sample of the stack of `L`, outermost frame first, to the call tree.
+// Stacks deeper than `MAX_PROFILE_DEPTH` lose their outermost frames.
+static void sample_stack(lua_State* L, ScriptProfile& profile, uint32_t weight)
+{
+    if (profile.nodes.empty())
+    {
+        profile.nodes.push_back({ "model" });
+    }
+
+    profile.samples          += weight;
+    profile.nodes[0].samples += weight;
+
+    uint32_t  node = 0;
+    lua_Debug frame;
+
+    for (int level = std::min(lua_stackdepth(L), MAX_PROFILE_DEPTH) - 1; level >= 0; level--)
+    {
+        if (!lua_getinfo(L, level, "sln", &frame))
+        {
+            continue;
+        }
+
+        const std::string name  = frame_name(frame);
+        uint32_t          child = profile.nodes[node].first_child;
+
+        while (child && profile.nodes[child].name != name)
+        {
+            child = profile.nodes[child].next_sibling;
+        }
+
+        if (!child)
+        {
+            child = uint32_t(profile.nodes.size());
+
+            ScriptProfileNode& added = profile.nodes.emplace_back();
+            added.name         = name;
+            added.parent       = node;
+            added.next_sibling = profile.nodes[node].first_child;
+
+            profile.nodes[node].first_child = child;
+        }
+
+        node = child;
+        profile.nodes[node].samples += weight;
+
+        // The line of the innermost Lua frame is the hot one.
+        if (level == 0 && frame.currentline > 0)
+        {
+            if (profile.line_samples.size() <= size_t(frame.currentline))
+            {
+                profile.line_samples.resize(size_t(frame.currentline) + 1, 0);
+            }
+
+            profile.line_samples[frame.currentline] += weight;
+        }
+    }
+
+    profile.nodes[node].self_samples += weight;
+}
+
+// Called by the VM on function calls and loop back-edges. The cancel flag is a
+// relaxed load and cheap enough for every call; the clock is only read every
+// 256 steps, for the deadline and the profiler. Once tripped, the status is
+// sticky, so a `pcall` in the script can't swallow the error and carry on.
+static void script_interrupt(lua_State* L, int gc)
+{
+    // Negative outside of garbage collection, the only time errors are allowed.
+    if (gc >= 0)
+    {
+        return;
+    }
+
+    ScriptContext& state = get_context(L);
+
+    state.steps++;
+
+    if (state.status == ScriptStatus::SUCCESS)
+    {
+        if ((state.cancel && state.cancel->load(std::memory_order_relaxed)) ||
+            (state.abort  && state.abort ->load(std::memory_order_relaxed)))
+        {
+            state.status = ScriptStatus::CANCELLED;
+        }
+        else if (state.max_steps && state.steps > state.max_steps)
+        {
+            state.status = ScriptStatus::TIMED_OUT;
+        }
+        else if ((state.steps & 255) == 0)
+        {
+            const int64_t now = bx::getHPCounter();
+
+            if (now > state.deadline)
+            {
+                state.status = ScriptStatus::TIMED_OUT;
+            }
+            else if (state.profile && now - state.last_sample >= state.interval)
+            {
+                sample_stack(L, *state.profile, uint32_t((now - state.last_sample) / state.interval));
+
+                state.last_sample = now;
+            }
+        }
+    }
+
+    if (state.status != ScriptStatus::SUCCESS)
+    {
+        luaL_error(L, "%s", state.status == ScriptStatus::CANCELLED ? "cancelled" : "out of budget");
+    }
+}
+
+// Bump when the compile options below change in a way that isn't reflected in
+// the cache key.
+static const uint32_t BYTECODE_CACHE_VERSION = 2;
+
+static lua_CompileOptions script_compile_options()
+{
+    lua_CompileOptions options = {};
+    options.optimizationLevel  = 1;
+    options.debugLevel         = 1;        // Line info for error messages.
+    options.vectorCtor         = "vector"; // Built-in fast path for `vector(x, y, z)`.
+
+    return options;
+}
+
+static bool read_file(const std::string& path, std::string& out_data)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+
+    if (!file)
+    {
+        return false;
+    }
+
+    bool success = fseek(file, 0, SEEK_END) == 0;
+
+    const long size = success ? ftell(file) : -1;
+
+    success = size > 0 && fseek(file, 0, SEEK_SET) == 0;
+
+    if (success)
+    {
+        out_data.resize(size_t(size));
+        success = fread(out_data.data(), 1, out_data.size(), file) == out_data.size();
+    }
+
+    fclose(file);
+
+    return success;
+}
+
+// Writes to a temporary file first and renames it over the target, so that a
+// concurrent reader or a crash never leaves a truncated file behind.
+static void write_file(const std::string& path, const char* data, size_t size)
+{
+    const std::string temp_path = path + ".tmp";
+
+    FILE* file = fopen(temp_path.c_str(), "wb");
+
+    if (!file)
+    {
+        return;
+    }
+
+    const bool success = fwrite(data, 1, size, file) == size;
+
+    if (fclose(file) == 0 && success)
+    {
+        std::error_code error;
+        std::filesystem::rename(temp_path, path, error);
+
+        if (!error)
+        {
+            return;
+        }
+    }
+
+    remove(temp_path.c_str());
+}
+
+// Removes the least recently written bytecode files of the directory, except
+// `keep`, until at most `max_files` are left. Loads refresh the files' times,
+// so the ones still in use stay.
+static void prune_bytecode_directory(const std::string& directory, const std::filesystem::path& keep, uint32_t max_files)
+{
+    std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path>> files;
+
+    std::error_code error;
+
+    for (std::filesystem::directory_iterator it(directory, error), end; !error && it != end; it.increment(error))
+    {
+        if (it->path().extension() == ".luauc" && it->path() != keep)
+        {
+            files.emplace_back(it->last_write_time(error), it->path());
+        }
+    }
+
+    // The kept file counts too.
+    if (files.size() < max_files)
+    {
+        return;
+    }
+
+    std::sort(files.begin(), files.end());
+
+    for (size_t i = 0; i + max_files <= files.size(); i++)
+    {
+        std::filesystem::remove(files[i].second, error);
+    }
+}
+
+// Compiles the source into a function on top of the stack of `T`, going
+// through the on-disk cache when `directory` isn't empty, which keeps at most
+// `max_files` files. Files are named after a hash of the source and the
+// compile options. Bytecode from a different Luau
+// version is rejected by `luau_load` and simply recompiled. Returns the status
+// of `luau_load`, with the error message on the stack on failure, and the
+// bytecode that was loaded in `out_bytecode`.
+static int load_script
+(
+    lua_State*         T,
+    const std::string& source,
+    const std::string& directory,
+    uint32_t           max_files,
+    std::string&       out_bytecode,
+    bool&              out_cached
+)
+{
+    lua_CompileOptions options = script_compile_options();
+
+    std::string path;
+
+    if (!directory.empty())
+    {
+        uint64_t key = fnv1a(source.data(), source.size());
+        key = fnv1a(&BYTECODE_CACHE_VERSION    , sizeof(BYTECODE_CACHE_VERSION    ), key);
+        key = fnv1a(&options.optimizationLevel, sizeof(options.optimizationLevel), key);
+        key = fnv1a(&options.debugLevel       , sizeof(options.debugLevel       ), key);
+        key = fnv1a(&options.coverageLevel    , sizeof(options.coverageLevel    ), key);
+
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.luauc", (unsigned long long)key);
+
+        path = directory + "/" + name;
+
+        if (read_file(path, out_bytecode))
+        {
+            if (luau_load(T, "=model", out_bytecode.data(), out_bytecode.size(), 0) == 0)
+            {
+                out_cached = true;
+
+                std::error_code error;
+                std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+
+                return 0;
+            }
+
+            lua_pop(T, 1);
+        }
+    }
+
+    size_t bytecode_size = 0;
+    char*  bytecode      = luau_compile(source.data(), source.size(), &options, &bytecode_size);
+
+    const int status = luau_load(T, "=model", bytecode, bytecode_size, 0);
+
+    out_bytecode.assign(bytecode, bytecode_size);
+
+    // Compilation errors come back as bytecode that fails to load; those are
+    // not worth caching.
+    if (status == 0 && !path.empty())
+    {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+
+        write_file(path, bytecode, bytecode_size);
+        prune_bytecode_directory(directory, path, max_files);
+    }
+
+    free(bytecode);
+
+    return status;
+}
+
+#ifdef WITH_LUAU_CODEGEN
+
+// Whether one of the leading comment lines is the given `--!` directive.
+static bool has_directive(const std::string& source, const char* directive)
+{
+    const size_t length = strlen(directive);
+
+    for (size_t line = 0; source.compare(line, 2, "--") == 0; )
+    {
+        if (source.compare(line, 3, "--!") == 0 && source.compare(line + 3, length, directive) == 0)
+        {
+            return true;
+        }
+
+        line = source.find('\n', line);
+
+        if (line == std::string::npos)
+        {
+            break;
+        }
+
+        line++;
+    }
+
+    return false;
+}
+
+#endif // WITH_LUAU_CODEGEN
+
+static void set_error(ScriptResult& result, ScriptStatus status, const char* error)
+{
+    switch (status)
+    {
+    case ScriptStatus::SUCCESS:
+    case ScriptStatus::FAILURE:
+        result.status = ScriptStatus::FAILURE;
+        result.error  = error ? error : "Unknown error.";
+        break;
+
+    case ScriptStatus::CANCELLED:
+        result.status = ScriptStatus::CANCELLED;
+        result.error  = "Evaluation cancelled.";
+        break;
+
+    case ScriptStatus::TIMED_OUT:
+        result.status = ScriptStatus::TIMED_OUT;
+        result.error  = "Evaluation exceeded its time or step budget.";
+        break;
+    }
+
+    result.meshes.clear();
+    result.colors.clear();
+}
+
+static lua_State* open_state(ScriptContext& context, ScriptArena* arena);
+
+
+// -----------------------------------------------------------------------------
+// PARALLEL TASKS
+// -----------------------------------------------------------------------------
+
+// Scripts register task functions with `task(f)`, queue them on the task pool
+// with `spawn(f, ...)`, and wait for them with `join()`. Tasks run in a pool of
+// extra VMs, one per thread that picks them up (`ScriptTaskWorkers`). Those
+// only run the leading statements of the script that define things: functions,
+// constants, tables of them, and `task` registrations. So they register the
+// same task functions in the same order as the main VM, and tasks are
+// identified by registration number. Task functions must therefore be
+// registered at the top of the script, and can only use what's defined there
+// (and the script API). The worker VMs are kept while the definitions stay the
+// same, with fresh globals for each evaluation.
+//
+// Arguments are copied to the worker (nil, booleans, numbers, vectors, strings
+// and meshes). The meshes a task emits are merged into the result at `join` in
+// spawn order, and `join` returns the meshes the tasks returned in the same
+// order, so results never depend on scheduling. Spawned tasks that weren't
+// joined are joined at the end of the script.
+
+static const char* TASKS_KEY = "tasks";
+
+static const char* DEFINITIONS_KEY = "definitions"; // Chunk of the worker VMs.
+
+struct TaskValue
+{
+    int         type   = LUA_TNIL;
+    double      number = 0.0; // Also booleans.
+    glm::vec3   vector = glm::vec3(0.0f);
+    std::string string;
+    ScriptMesh  mesh;
+};
+
+struct ScriptTask
+{
+    uint32_t               function = 0; // Registration number, from 1.
+    std::vector<TaskValue> arguments;
+    ScriptResult           result;
+    ScriptMesh             returned;     // Null mesh when none.
+};
+
+struct ScriptTaskWorker
+{
+    lua_State*    L          = nullptr;
+    lua_State*    T          = nullptr; // Thread holding the definitions' globals.
+    uint32_t      evaluation = 0;       // They were last run for.
+    ScriptContext context;
+};
+
+struct ScriptTaskPool
+{
+    const std::string*                       source       = nullptr;
+    bool                                     native_chunk = false;
+    ScriptContext                            settings;               // Copied by the workers.
+    std::atomic<bool>                        abort        = false;
+
+    ScriptTaskWorkers*                       workers      = nullptr;
+    bool                                     prepared     = false;   // For this evaluation.
+    std::string                              worker_error;           // Of the first failed setup.
+
+    std::vector<std::unique_ptr<ScriptTask>> tasks;
+    uint32_t                                 joined       = 0;
+    TaskCounter                              counter;
+};
+
+// Returns the mesh at `idx`, or null if it isn't one. Unlike `check_mesh`, it
+// doesn't raise errors, so it's safe outside of protected calls.
+static const ScriptMesh* to_mesh(lua_State* L, int idx)
+{
+    void* data = lua_touserdata(L, idx);
+
+    if (!data || !lua_getmetatable(L, idx))
+    {
+        return nullptr;
+    }
+
+    luaL_getmetatable(L, MESH_TYPE);
+
+    const bool is_mesh = lua_rawequal(L, -1, -2);
+    lua_pop(L, 2);
+
+    return is_mesh ? static_cast<const ScriptMesh*>(data) : nullptr;
+}
+
+// Writable meshes are copied, since their VM may keep changing them.
+static ScriptMesh share_mesh(const ScriptMesh& mesh)
+{
+    if (!mesh.writable)
+    {
+        return mesh;
+    }
+
+    return { std::make_shared<const Mesh>(*mesh.mesh), nullptr, mesh_key(mesh) };
+}
+
+static TaskValue check_task_value(lua_State* L, int arg)
+{
+    TaskValue value;
+    value.type = lua_type(L, arg);
+
+    switch (value.type)
+    {
+    case LUA_TNIL:
+        break;
+
+    case LUA_TBOOLEAN:
+        value.number = lua_toboolean(L, arg);
+        break;
+
+    case LUA_TNUMBER:
+        value.number = lua_tonumber(L, arg);
+        break;
+
+    case LUA_TVECTOR:
+        value.vector = check_vec3(L, arg);
+        break;
+
+    case LUA_TSTRING:
+    {
+        size_t      length = 0;
+        const char* string = lua_tolstring(L, arg, &length);
+
+        value.string.assign(string, length);
+        break;
+    }
+
+    case LUA_TUSERDATA:
+        value.mesh = share_mesh(check_mesh(L, arg));
+        break;
+
+    default:
+        luaL_argerror(L, arg, "tasks only take nil, booleans, numbers, vectors, strings and meshes");
+    }
+
+    return value;
+}
+
+static void push_task_value(lua_State* L, const TaskValue& value)
+{
+    switch (value.type)
+    {
+    case LUA_TBOOLEAN:
+        lua_pushboolean(L, value.number != 0.0);
+        break;
+
+    case LUA_TNUMBER:
+        lua_pushnumber(L, value.number);
+        break;
+
+    case LUA_TVECTOR:
+        lua_pushvector(L, value.vector.x, value.vector.y, value.vector.z);
+        break;
+
+    case LUA_TSTRING:
+        lua_pushlstring(L, value.string.data(), value.string.size());
+        break;
+
+    case LUA_TUSERDATA:
+        push_userdata(L, MESH_TYPE, ScriptMesh(value.mesh));
+        break;
+
+    default:
+        lua_pushnil(L);
+        break;
+    }
+}
+
+// Whether evaluating `expr` only defines things, without side effects or
+// noticeable cost.
+static bool is_definition(Luau::AstExpr* expr);
+
+// task(f, ...), with definitions as arguments.
+static bool is_task_registration(Luau::AstExprCall* call)
+{
+    Luau::AstExprGlobal* func = call->func->as<Luau::AstExprGlobal>();
+
+    if (!func || call->self || strcmp(func->name.value, "task") != 0)
+    {
+        return false;
+    }
+
+    for (Luau::AstExpr* arg : call->args)
+    {
+        if (!is_definition(arg))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool is_definition(Luau::AstExpr* expr)
+{
+    if (expr->is<Luau::AstExprConstantNil   >() ||
+        expr->is<Luau::AstExprConstantBool  >() ||
+        expr->is<Luau::AstExprConstantNumber>() ||
+        expr->is<Luau::AstExprConstantString>() ||
+        expr->is<Luau::AstExprFunction      >() ||
+        expr->is<Luau::AstExprLocal         >() ||
+        expr->is<Luau::AstExprGlobal        >())
+    {
+        return true;
+    }
+
+    if (Luau::AstExprGroup* group = expr->as<Luau::AstExprGroup>())
+    {
+        return is_definition(group->expr);
+    }
+
+    if (Luau::AstExprIndexName* index = expr->as<Luau::AstExprIndexName>())
+    {
+        return is_definition(index->expr);
+    }
+
+    if (Luau::AstExprUnary* unary = expr->as<Luau::AstExprUnary>())
+    {
+        return is_definition(unary->expr);
+    }
+
+    if (Luau::AstExprBinary* binary = expr->as<Luau::AstExprBinary>())
+    {
+        return is_definition(binary->left) && is_definition(binary->right);
+    }
+
+    if (Luau::AstExprTable* table = expr->as<Luau::AstExprTable>())
+    {
+        for (const Luau::AstExprTable::Item& item : table->items)
+        {
+            if ((item.key && !is_definition(item.key)) || !is_definition(item.value))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    if (Luau::AstExprCall* call = expr->as<Luau::AstExprCall>())
+    {
+        return is_task_registration(call);
+    }
+
+    return false;
+}
+
+static bool is_definition(Luau::AstStat* stat)
+{
+    if (stat->is<Luau::AstStatFunction     >() ||
+        stat->is<Luau::AstStatLocalFunction>() ||
+        stat->is<Luau::AstStatTypeAlias    >())
+    {
+        return true;
+    }
+
+    if (Luau::AstStatLocal* local = stat->as<Luau::AstStatLocal>())
+    {
+        for (Luau::AstExpr* value : local->values)
+        {
+            if (!is_definition(value))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    if (Luau::AstStatAssign* assign = stat->as<Luau::AstStatAssign>())
+    {
+        for (Luau::AstExpr* var : assign->vars)
+        {
+            if (!var->is<Luau::AstExprGlobal>())
+            {
+                return false;
+            }
+        }
+
+        for (Luau::AstExpr* value : assign->values)
+        {
+            if (!is_definition(value))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    if (Luau::AstStatExpr* call = stat->as<Luau::AstStatExpr>())
+    {
+        return call->expr->is<Luau::AstExprCall>() && is_task_registration(call->expr->as<Luau::AstExprCall>());
+    }
+
+    return false;
+}
+
+// Length of the leading definitions of `source`, which the worker VMs run.
+static size_t definitions_length(const std::string& source)
+{
+    Luau::Allocator     allocator;
+    Luau::AstNameTable  names(allocator);
+    Luau::ParseResult   parsed = Luau::Parser::parse(source.data(), source.size(), names, allocator);
+
+    if (!parsed.errors.empty())
+    {
+        return 0;
+    }
+
+    Luau::Position end(0, 0);
+
+    for (Luau::AstStat* stat : parsed.root->body)
+    {
+        if (!is_definition(stat))
+        {
+            break;
+        }
+
+        end = stat->location.end;
+    }
+
+    size_t offset = 0;
+
+    for (unsigned line = 0; line < end.line && offset != std::string::npos; line++)
+    {
+        offset = source.find('\n', offset);
+        offset = offset == std::string::npos ? offset : offset + 1;
+    }
+
+    return offset == std::string::npos ? source.size() : std::min(source.size(), offset + end.column);
+}
+
+// Compiles the definitions for the worker VMs on the first spawn of an
+// evaluation, and drops the VMs if they no longer match.
+static void prepare_workers(ScriptTaskPool& pool)
+{
+    const std::string  definitions = pool.source->substr(0, definitions_length(*pool.source));
+    lua_CompileOptions options     = script_compile_options();
+
+    size_t bytecode_size = 0;
+    char*  bytecode      = luau_compile(definitions.data(), definitions.size(), &options, &bytecode_size);
+
+    uint64_t key = fnv1a(bytecode, bytecode_size);
+    key = fnv1a(&pool.native_chunk   , sizeof(pool.native_chunk   ), key);
+    key = fnv1a(&pool.settings.native, sizeof(pool.settings.native), key);
+
+    ScriptTaskWorkers& workers = *pool.workers;
+
+    if (key != workers.key)
+    {
+        workers.clear();
+        workers.key = key;
+        workers.bytecode.assign(bytecode, bytecode_size);
+    }
+
+    free(bytecode);
+
+    workers.evaluation++;
+    pool.prepared = true;
+}
+
+// Records the error of a failed worker setup.
+static void set_worker_error(ScriptTaskPool& pool, ScriptTaskWorker& worker, const char* message)
+{
+    ScriptResult setup_result;
+    set_error(setup_result, worker.context.status, message);
+
+    std::lock_guard<std::mutex> lock(pool.workers->mutex);
+
+    if (pool.worker_error.empty())
+    {
+        pool.worker_error = setup_result.error;
+    }
+}
+
+// A new VM with the definitions' chunk loaded into the registry. Null if they
+// don't load.
+static std::unique_ptr<ScriptTaskWorker> create_worker(ScriptTaskPool& pool)
+{
+    std::unique_ptr<ScriptTaskWorker> worker = std::make_unique<ScriptTaskWorker>();
+
+    worker->context        = pool.settings;
+    worker->context.worker = true;
+
+    worker->L = open_state(worker->context, nullptr);
+
+    const std::string& bytecode = pool.workers->bytecode;
+
+    if (luau_load(worker->L, "=model", bytecode.data(), bytecode.size(), 0) != 0)
+    {
+        set_worker_error(pool, *worker, lua_tostring(worker->L, -1));
+        lua_close(worker->L);
+
+        return nullptr;
+    }
+
+#ifdef WITH_LUAU_CODEGEN
+    if (pool.native_chunk)
+    {
+        Luau::CodeGen::compile(worker->L, -1);
+    }
+#endif
+
+    lua_setfield(worker->L, LUA_REGISTRYINDEX, DEFINITIONS_KEY);
+
+    return worker;
+}
+
+// Runs the definitions in a fresh thread with its own globals, so nothing of
+// earlier evaluations is left.
+static bool reset_worker(ScriptTaskPool& pool, ScriptTaskWorker& worker)
+{
+    ScriptResult setup_result;
+
+    worker.context        = pool.settings;
+    worker.context.result = &setup_result;
+    worker.context.worker = true;
+
+    lua_State* L = worker.L;
+
+    lua_newtable(L);
+    lua_setfield(L, LUA_REGISTRYINDEX, TASKS_KEY);
+
+    // The previous thread goes, the new one stays on the stack.
+    lua_settop(L, 0);
+
+    worker.T = lua_newthread(L);
+    luaL_sandboxthread(worker.T);
+
+    lua_getfield(worker.T, LUA_REGISTRYINDEX, DEFINITIONS_KEY);
+    lua_pushvalue(worker.T, LUA_GLOBALSINDEX);
+    lua_setfenv(worker.T, -2);
+
+    const bool ok = lua_pcall(worker.T, 0, 0, 0) == 0 && worker.context.status == ScriptStatus::SUCCESS;
+
+    if (!ok)
+    {
+        set_worker_error(pool, worker, lua_tostring(worker.T, -1));
+    }
+
+    lua_settop(worker.T, 0);
+    worker.context.result = nullptr;
+
+    return ok;
+}
+
+// Takes an idle worker, or sets up a new one, with the definitions run for
+// this evaluation. Null if that fails.
+static ScriptTaskWorker* acquire_worker(ScriptTaskPool& pool)
+{
+    ScriptTaskWorkers& workers = *pool.workers;
+    ScriptTaskWorker*  worker  = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(workers.mutex);
+
+        if (!workers.idle.empty())
+        {
+            worker = workers.idle.back();
+            workers.idle.pop_back();
+        }
+    }
+
+    if (!worker)
+    {
+        std::unique_ptr<ScriptTaskWorker> created = create_worker(pool);
+
+        if (!created)
+        {
+            return nullptr;
+        }
+
+        worker = created.get();
+
+        std::lock_guard<std::mutex> lock(workers.mutex);
+        workers.workers.push_back(std::move(created));
+    }
+
+    if (worker->evaluation != workers.evaluation)
+    {
+        if (!reset_worker(pool, *worker))
+        {
+            std::lock_guard<std::mutex> lock(workers.mutex);
+            workers.idle.push_back(worker);
+
+            return nullptr;
+        }
+
+        worker->evaluation = workers.evaluation;
+    }
+
+    return worker;
+}
+
+static void run_task(ScriptTaskPool& pool, ScriptTask& task)
+{
+    ScriptTaskWorker* worker = acquire_worker(pool);
+
+    if (!worker)
+    {
+        std::lock_guard<std::mutex> lock(pool.workers->mutex);
+
+        task.result.status = ScriptStatus::FAILURE;
+        task.result.error  = "Task VM setup failed: " + pool.worker_error;
+
+        return;
+    }
+
+    ScriptContext& context = worker->context;
+    lua_State*     T       = worker->T;
+
+    context.result = &task.result;
+
+    context.brick_maps.clear();
+
+    lua_getfield(T, LUA_REGISTRYINDEX, TASKS_KEY);
+    lua_rawgeti(T, -1, int(task.function));
+    lua_remove(T, -2);
+
+    if (!lua_isfunction(T, -1))
+    {
+        task.result.status = ScriptStatus::FAILURE;
+        task.result.error  = "Task function wasn't registered with the definitions at the top of the script.";
+    }
+    else
+    {
+        for (const TaskValue& argument : task.arguments)
+        {
+            push_task_value(T, argument);
+        }
+
+        if (lua_pcall(T, int(task.arguments.size()), 1, 0) != 0)
+        {
+            set_error(task.result, context.status, lua_tostring(T, -1));
+        }
+        else if (const ScriptMesh* returned = to_mesh(T, -1))
+        {
+            task.returned = share_mesh(*returned);
+        }
+    }
+
+    lua_settop(T, 0);
+
+    context.result = nullptr;
+
+    std::lock_guard<std::mutex> lock(pool.workers->mutex);
+    pool.workers->idle.push_back(worker);
+}
+
+// Merges the results of the tasks spawned since the last join, in spawn order.
+// Returns the first task that failed instead, without merging anything.
+static const ScriptTask* merge_tasks(ScriptContext& context)
+{
+    ScriptTaskPool& pool   = *context.pool;
+    ScriptResult&   result = *context.result;
+
+    for (size_t i = pool.joined; i < pool.tasks.size(); i++)
+    {
+        if (pool.tasks[i]->result.status != ScriptStatus::SUCCESS)
+        {
+            return pool.tasks[i].get();
+        }
+    }
+
+    for (size_t i = pool.joined; i < pool.tasks.size(); i++)
+    {
+        ScriptResult& task = pool.tasks[i]->result;
+
+        for (size_t j = 0; j < task.meshes.size(); j++)
+        {
+            emit_part(context, std::move(task.meshes[j]), task.colors[j]);
+        }
+
+        result.cache_hits      += task.cache_hits;
+        result.cache_misses    += task.cache_misses;
+        result.sdf_brick_bytes += task.sdf_brick_bytes;
+        result.tasks++;
+    }
+
+    pool.joined = uint32_t(pool.tasks.size());
+
+    return nullptr;
+}
+
+// task(f), registering `f` as a task function. Returns `f`.
+static int script_task(lua_State* L)
+{
+    luaL_checktype(L, 1, LUA_TFUNCTION);
+
+    ScriptContext& context = get_context(L);
+
+    lua_getfield(L, LUA_REGISTRYINDEX, TASKS_KEY);
+    lua_pushvalue(L, 1);
+    lua_rawget(L, -2);
+
+    if (lua_isnil(L, -1))
+    {
+        const int index = int(++context.tasks);
+
+        lua_pop(L, 1);
+
+        lua_pushvalue(L, 1);
+        lua_pushinteger(L, index);
+        lua_rawset(L, -3);
+
+        lua_pushvalue(L, 1);
+        lua_rawseti(L, -2, index);
+    }
+
+    lua_settop(L, 1);
+
+    return 1;
+}
+
+// spawn(f, ...), running the task function `f` with the given arguments.
+static int script_spawn(lua_State* L)
+{
+    ScriptContext& context = get_context(L);
+
+    if (context.worker)
+    {
+        luaL_error(L, "tasks can't spawn tasks");
+    }
+
+    luaL_checktype(L, 1, LUA_TFUNCTION);
+
+    lua_getfield(L, LUA_REGISTRYINDEX, TASKS_KEY);
+    lua_pushvalue(L, 1);
+    lua_rawget(L, -2);
+
+    const int function = lua_isnumber(L, -1) ? lua_tointeger(L, -1) : 0;
+
+    luaL_argcheck(L, function > 0, 1, "not a task function, register it with task(f)");
+    lua_pop(L, 2);
+
+    std::unique_ptr<ScriptTask> task = std::make_unique<ScriptTask>();
+    task->function = uint32_t(function);
+
+    for (int i = 2; i <= lua_gettop(L); i++)
+    {
+        task->arguments.push_back(check_task_value(L, i));
+    }
+
+    ScriptTaskPool& pool = *context.pool;
+    ScriptTask*     ptr  = task.get();
+
+    if (!pool.prepared)
+    {
+        prepare_workers(pool);
+    }
+
+    pool.tasks.push_back(std::move(task));
+
+    task_run(pool.counter, [&pool, ptr]()
+    {
+        run_task(pool, *ptr);
+    });
+
+    return 0;
+}
+
+// join(), waiting for the spawned tasks. Returns the meshes they returned.
+static int script_join(lua_State* L)
+{
+    ScriptContext& context = get_context(L);
+
+    if (context.worker)
+    {
+        luaL_error(L, "tasks can't join tasks");
+    }
+
+    ScriptTaskPool& pool  = *context.pool;
+    const uint32_t  first = pool.joined;
+
+    task_wait(pool.counter);
+
+    if (const ScriptTask* failed = merge_tasks(context))
+    {
+        // Keeps cancellations and timeouts of tasks what they are.
+        if (failed->result.status != ScriptStatus::FAILURE)
+        {
+            context.status = failed->result.status;
+        }
+
+        luaL_error(L, "task: %s", failed->result.error.c_str());
+    }
+
+    lua_createtable(L, int(pool.joined - first), 0);
+
+    for (uint32_t i = first; i < pool.joined; i++)
+    {
+        const ScriptMesh& returned = pool.tasks[i]->returned;
+
+        if (returned.mesh)
+        {
+            push_userdata(L, MESH_TYPE, ScriptMesh(returned));
+            lua_rawseti(L, -2, int(i - first + 1));
+        }
+    }
+
+    return 1;
+}
+
+static void register_task_api(lua_State* L)
+{
+    lua_newtable(L);
+    lua_setfield(L, LUA_REGISTRYINDEX, TASKS_KEY);
+
+    static const luaL_Reg functions[] =
+    {
+        { "join" , script_join  },
+        { "spawn", script_spawn },
+        { "task" , script_task  },
+
+        { nullptr, nullptr      }
+    };
+
+    lua_pushvalue(L, LUA_GLOBALSINDEX);
+    luaL_register(L, nullptr, functions);
+    lua_pop(L, 1);
+}
+
+
+// -----------------------------------------------------------------------------
+// SCRIPT EXECUTION
+// -----------------------------------------------------------------------------
+
+static void* script_allocate(void* ud, void* ptr, size_t old_size, size_t new_size)
+{
+    return static_cast<ScriptArena*>(ud)->reallocate(ptr, old_size, new_size);
+}
+
+// A sandboxed VM with the script API, reporting to `context`.
+static lua_State* open_state(ScriptContext& context, ScriptArena* arena)
+{
+    lua_State* L = arena ? lua_newstate(script_allocate, arena) : luaL_newstate();
+
+    // The state goes away after one run, or (task VMs) drops its globals for
+    // the next one, so trade some peak memory for fewer collection steps (the
+    // default goal is 200%).
+    lua_gc(L, LUA_GCSETGOAL, 400);
+
+    luaL_openlibs(L);
+    register_script_api(L);
+    register_sdf_api(L);
+    register_task_api(L);
+    luaL_sandbox(L);
+
+    lua_callbacks(L)->userdata  = &context;
+    lua_callbacks(L)->interrupt = script_interrupt;
+
+#ifdef WITH_LUAU_CODEGEN
+    if (context.native)
+    {
+        Luau::CodeGen::create(L);
+    }
+#endif
+
+    return L;
+}
+
+static void run_script
+(
+    const std::string&       source,
+    const ScriptOptions&     options,
+    const std::atomic<bool>* cancel,
+    ScriptCache*             cache,
+    ScriptArena*             arena,
+    ScriptPartQueue*         parts,
+    ScriptPreviewQueue*      previews,
+    ScriptTaskWorkers*       task_workers,
+    ScriptResult&            result
+)
+{
+    // Without persistent ones, the workers only live for this evaluation.
+    ScriptTaskWorkers local_workers;
+
+    ScriptTaskPool pool;
+    pool.source  = &source;
+    pool.workers = task_workers ? task_workers : &local_workers;
+
+    ScriptContext context;
+    context.result    = &result;
+    context.cache     = cache;
+    context.native    = options.native_code && script_native_code_supported();
+    context.parts     = parts;
+    context.previews  = previews;
+    context.pool      = &pool;
+    context.cancel    = cancel;
+    context.max_steps = options.step_budget;
+
+    if (options.time_budget_ms > 0.0)
+    {
+        context.deadline = bx::getHPCounter() + int64_t(options.time_budget_ms * 0.001 * double(bx::getHPFrequency()));
+    }
+
+    if (options.profile_interval_ms > 0.0)
+    {
+        context.profile     = &result.profile;
+        context.interval    = std::max<int64_t>(1, int64_t(options.profile_interval_ms * 0.001 * double(bx::getHPFrequency())));
+        context.last_sample = bx::getHPCounter();
+
+        result.profile.interval_ms = options.profile_interval_ms;
+    }
+
+    pool.settings          = context;
+    pool.settings.result   = nullptr;
+    pool.settings.parts    = nullptr;
+    pool.settings.previews = nullptr;
+    pool.settings.profile  = nullptr;
+    pool.settings.abort    = &pool.abort;
+
+    lua_State* L = open_state(context, arena);
+
+    // The script gets its own thread with a writable global table on top of
+    // the read-only sandboxed one.
+    lua_State* T = lua_newthread(L);
+    luaL_sandboxthread(T);
+
+    std::string bytecode;
+
+    const int status = cache
+        ? load_script(T, source, cache->bytecode_directory, cache->bytecode_max_files, bytecode, result.bytecode_cached)
+        : load_script(T, source, std::string(), 0, bytecode, result.bytecode_cached);
+
+#ifdef WITH_LUAU_CODEGEN
+    pool.native_chunk = context.native && has_directive(source, "native");
+
+    if (status == 0 && pool.native_chunk)
+    {
+        Luau::CodeGen::compile(T, -1);
+    }
+#endif
+
+    if (status != 0 || lua_pcall(T, 0, 0, 0) != 0)
+    {
+        pool.abort.store(true, std::memory_order_relaxed);
+        task_wait(pool.counter);
+
+        set_error(result, context.status, lua_tostring(T, -1));
+    }
+    else
+    {
+        task_wait(pool.counter);
+
+        if (const ScriptTask* failed = merge_tasks(context))
+        {
+            set_error(result, failed->result.status, ("task: " + failed->result.error).c_str());
+        }
+    }
+
+    lua_close(L);
+}
+
+#endif // WITH_LUAU
+
+
+// -----------------------------------------------------------------------------
+// EVALUATION
+// -----------------------------------------------------------------------------
+
+static double elapsed_ms(int64_t start)
+{
+    return double(bx::getHPCounter() - start) * 1000.0 / double(bx::getHPFrequency());
+}
+
+void ScriptResult::clear()
+{
+    meshes.clear();
+    colors.clear();
+    error .clear();
+
+    status       = ScriptStatus::SUCCESS;
+    generation   = 0;
+    time_ms      = 0.0;
+    streamed        = 0;
+    tasks           = 0;
+    cache_hits      = 0;
+    cache_misses    = 0;
+    bytecode_cached = false;
+    memory_peak     = 0;
+    allocations     = 0;
+    sdf_brick_bytes = 0;
+
+    profile.clear();
+
+    sdf_placements.clear();
+}
+
+#ifndef WITH_LUAU
+struct ScriptTaskWorker
+{
+};
+#endif
+
+ScriptTaskWorkers::ScriptTaskWorkers() = default;
+
+ScriptTaskWorkers::~ScriptTaskWorkers()
+{
+    clear();
+}
+
+void ScriptTaskWorkers::clear()
+{
+#ifdef WITH_LUAU
+    for (const std::unique_ptr<ScriptTaskWorker>& worker : workers)
+    {
+        lua_close(worker->L);
+    }
+#endif
+
+    workers .clear();
+    idle    .clear();
+    bytecode.clear();
+
+    key = 0;
+}
+
+void ScriptProfile::clear()
+{
+    nodes       .clear();
+    line_samples.clear();
+
+    interval_ms = 0.0;
+    samples     = 0;
+}
+
+bool ScriptProfile::write_folded(const char* path) const
+{
+    FILE* file = fopen(path, "w");
+
+    if (!file)
+    {
+        return false;
+    }
+
+    // Depth-first, with the stack of names built up in `stack`.
+    std::string           stack;
+    std::vector<size_t>   lengths;
+    std::vector<uint32_t> pending;
+
+    if (!nodes.empty())
+    {
+        pending.push_back(0);
+        lengths.push_back(0);
+    }
+
+    while (!pending.empty())
+    {
+        const uint32_t           index = pending.back();
+        const ScriptProfileNode& node  = nodes[index];
+
+        pending.pop_back();
+        stack.resize(lengths.back());
+        lengths.pop_back();
+
+        if (!stack.empty())
+        {
+            stack += ';';
+        }
+
+        stack += node.name;
+
+        if (node.self_samples)
+        {
+            fprintf(file, "%s %u\n", stack.c_str(), node.self_samples);
+        }
+
+        for (uint32_t child = node.first_child; child; child = nodes[child].next_sibling)
+        {
+            pending.push_back(child);
+            lengths.push_back(stack.size());
+        }
+    }
+
+    return fclose(file) == 0;
+}
+
+std::shared_ptr<const Mesh> ScriptCache::find(uint64_t key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    const auto it = entries.find(key);
+
+    if (it == entries.end())
+    {
+        return nullptr;
+    }
+
+    it->second.last_used = evaluation;
+
+    return it->second.mesh;
+}
+
+void ScriptCache::insert(uint64_t key, std::shared_ptr<const Mesh> mesh)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    entries[key] = { std::move(mesh), evaluation };
+}
+
+std::shared_ptr<const SdfBrickMap> ScriptCache::find_brick_map(uint64_t key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    const auto it = brick_maps.find(key);
+
+    if (it == brick_maps.end())
+    {
+        return nullptr;
+    }
+
+    it->second.last_used = evaluation;
+
+    return it->second.map;
+}
+
+void ScriptCache::insert_brick_map(uint64_t key, std::shared_ptr<const SdfBrickMap> map)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    brick_maps[key] = { std::move(map), evaluation };
+}
+
+std::shared_ptr<const SubdivisionSurface> ScriptCache::find_subdivision(uint64_t key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    const auto it = subdivisions.find(key);
+
+    if (it == subdivisions.end())
+    {
+        return nullptr;
+    }
+
+    it->second.last_used = evaluation;
+
+    return it->second.surface;
+}
+
+void ScriptCache::insert_subdivision(uint64_t key, std::shared_ptr<const SubdivisionSurface> surface)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    subdivisions[key] = { std::move(surface), evaluation };
+}
+
+void ScriptCache::begin()
+{
+    evaluation++;
+
+    sdf_blocks.begin();
+}
+
+void ScriptCache::evict_unused()
+{
+    std::erase_if(entries, [&](const auto& entry)
+    {
+        return entry.second.last_used != evaluation;
+    });
+
+    sdf_blocks.evict_unused();
+
+    std::erase_if(brick_maps, [&](const auto& entry)
+    {
+        return entry.second.last_used != evaluation;
+    });
+
+    std::erase_if(subdivisions, [&](const auto& entry)
+    {
+        return entry.second.last_used != evaluation;
+    });
+}
+
+void ScriptCache::clear()
+{
+    entries.clear();
+    sdf_blocks.clear();
+    brick_maps.clear();
+    subdivisions.clear();
+}
+
+static uint32_t size_class(size_t size)
+{
+    if (size <= 512)
+    {
+        return uint32_t((size + 15) / 16) - 1;
+    }
+
+    return 32 + uint32_t(std::bit_width(size - 1)) - 10;
+}
+
+static size_t class_size(uint32_t c)
+{
+    return c < 32 ? (c + 1) * 16 : size_t(1024) << (c - 32);
+}
+
+void* ScriptArena::allocate(size_t size)
+{
+    if (size > MAX_CLASS_SIZE)
+    {
+        void* ptr = malloc(size);
+
+        if (ptr)
+        {
+            allocations++;
+            bytes     += size;
+            peak_bytes = std::max(peak_bytes, bytes);
+        }
+
+        return ptr;
+    }
+
+    const uint32_t c   = size_class(size);
+    void*          ptr = free_lists[c];
+
+    if (ptr)
+    {
+        free_lists[c] = *static_cast<void**>(ptr);
+    }
+    else
+    {
+        const size_t block = class_size(c);
+
+        if (chunk < chunks.size() && chunk_offset + block > CHUNK_SIZE)
+        {
+            chunk++;
+            chunk_offset = 0;
+        }
+
+        if (chunk == chunks.size())
+        {
+            chunks.emplace_back(new (std::nothrow) uint8_t[CHUNK_SIZE]);
+
+            if (!chunks.back())
+            {
+                chunks.pop_back();
+
+                return nullptr;
+            }
+        }
+
+        ptr           = chunks[chunk].get() + chunk_offset;
+        chunk_offset += block;
+    }
+
+    allocations++;
+    bytes     += size;
+    peak_bytes = std::max(peak_bytes, bytes);
+
+    return ptr;
+}
+
+void ScriptArena::deallocate(void* ptr, size_t size)
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    bytes -= size;
+
+    if (size > MAX_CLASS_SIZE)
+    {
+        free(ptr);
+
+        return;
+    }
+
+    const uint32_t c = size_class(size);
+
+    *static_cast<void**>(ptr) = free_lists[c];
+    free_lists[c]             = ptr;
+}
+
+void* ScriptArena::reallocate(void* ptr, size_t old_size, size_t new_size)
+{
+    if (new_size == 0)
+    {
+        deallocate(ptr, old_size);
+
+        return nullptr;
+    }
+
+    if (!ptr)
+    {
+        return allocate(new_size);
+    }
+
+    // Growing or shrinking within the block it already has.
+    if (old_size <= MAX_CLASS_SIZE && new_size <= MAX_CLASS_SIZE && size_class(old_size) == size_class(new_size))
+    {
+        bytes      = bytes - old_size + new_size;
+        peak_bytes = std::max(peak_bytes, bytes);
+
+        return ptr;
+    }
+
+    void* result = allocate(new_size);
+
+    if (result)
+    {
+        memcpy(result, ptr, std::min(old_size, new_size));
+        deallocate(ptr, old_size);
+    }
+
+    return result;
+}
+
+void ScriptArena::reset()
+{
+    if (chunks.size() > MAX_RETAINED_CHUNKS)
+    {
+        chunks.resize(MAX_RETAINED_CHUNKS);
+    }
+
+    chunk        = 0;
+    chunk_offset = 0;
+
+    for (void*& list : free_lists)
+    {
+        list = nullptr;
+    }
+
+    bytes       = 0;
+    peak_bytes  = 0;
+    allocations = 0;
+}
+
+bool script_native_code_supported()
+{
+#ifdef WITH_LUAU_CODEGEN
+    return Luau::CodeGen::isSupported();
+#else
+    return false;
+#endif
+}
+
+void evaluate_script
+(
+    const std::string&       source,
+    ScriptResult&            out_result,
+    const ScriptOptions&     options,
+    const std::atomic<bool>* cancel,
+    ScriptCache*             cache,
+    ScriptArena*             arena,
+    ScriptPartQueue*         parts,
+    uint32_t                 generation,
+    ScriptPreviewQueue*      previews,
+    ScriptTaskWorkers*       task_workers
+)
+{
+    const int64_t start = bx::getHPCounter();
+
+    out_result.clear();
+    out_result.generation = generation;
+
+#ifdef WITH_LUAU
+    if (cache)
+    {
+        cache->begin();
+    }
+
+    run_script(source, options, cancel, cache, arena, parts, previews, task_workers, out_result);
+
+    if (arena)
+    {
+        out_result.memory_peak = arena->peak_bytes;
+        out_result.allocations = arena->allocations;
+
+        arena->reset();
+    }
+
+    // A cancelled or failed evaluation only got through part of the model, so
+    // what it didn't use may well be needed by the next one.
+    if (cache && out_result.status == ScriptStatus::SUCCESS)
+    {
+        cache->evict_unused();
+    }
+#else
+    (void)source;
+    (void)options;
+    (void)cancel;
+    (void)cache;
+    (void)arena;
+    (void)parts;
+    (void)previews;
+    (void)task_workers;
+    out_result.status = ScriptStatus::FAILURE;
+    out_result.error  = "Built without Luau support (WITH_LUAU).";
+#endif
+
+    out_result.time_ms = elapsed_ms(start);
+}
+
+
+// -----------------------------------------------------------------------------
+// BACKGROUND EVALUATOR
+// -----------------------------------------------------------------------------
+
+struct ScriptEvaluatorState
+{
+    std::thread             thread;
+    std::mutex              mutex;
+    std::condition_variable condition;
+
+    std::string             pending_source;
+    uint32_t                pending_generation = 0;
+    bool                    has_pending        = false;
+
+    ScriptResult            ready;
+    bool                    has_ready          = false;
+
+    ScriptOptions           options;
+    ScriptStats             stats;
+
+    // Only used by the worker thread.
+    ScriptCache             cache;
+    ScriptArena             arena;
+    ScriptTaskWorkers       task_workers;
+
+    // Filled by the worker thread, drained by the one polling.
+    ScriptPartQueue         parts;
+    ScriptPreviewQueue      previews;
+
+    // Set by a submission while an evaluation is running.
+    std::atomic<bool>       cancel             = false;
+    int64_t                 cancel_time        = 0;
+
+    bool                    busy               = false;
+    bool                    quit               = false;
+
+    void run()
+    {
+        ScriptResult back;
+        std::string  source;
+
+        // Geometry of scripts is built on the background workers.
+        task_set_thread_queue(TaskQueue::BACKGROUND);
+
+        for (;;)
+        {
+            uint32_t      generation;
+            ScriptOptions current_options;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [&]() { return has_pending || quit; });
+
+                if (quit)
+                {
+                    return;
+                }
+
+                source.swap(pending_source);
+                generation      = pending_generation;
+                current_options = options;
+                has_pending     = false;
+                busy            = true;
+
+                cancel.store(false, std::memory_order_relaxed);
+            }
+
+            evaluate_script(source, back, current_options, &cancel, &cache, &arena,
+                current_options.stream_parts ? &parts : nullptr,
+                generation,
+                current_options.sdf_previews ? &previews : nullptr,
+                &task_workers
+            );
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                busy = false;
+
+                if (back.status == ScriptStatus::CANCELLED)
+                {
+                    const double latency = elapsed_ms(cancel_time);
+
+                    stats.cancelled++;
+                    stats.wasted_ms             += back.time_ms;
+                    stats.last_cancel_latency_ms = latency;
+                    stats.max_cancel_latency_ms  = std::max(stats.max_cancel_latency_ms, latency);
+
+                    continue;
+                }
+
+                if (has_ready)
+                {
+                    stats.superseded++;
+                    stats.wasted_ms += ready.time_ms;
+                }
+
+                std::swap(ready, back);
+                has_ready = true;
+            }
+        }
+    }
+};
+
+void ScriptEvaluator::init(const std::string& bytecode_directory)
+{
+    state                           = new ScriptEvaluatorState();
+    state->cache.bytecode_directory = bytecode_directory;
+    state->thread = std::thread([state = state]() { state->run(); });
+}
+
+void ScriptEvaluator::shutdown()
+{
+    if (!state)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->quit = true;
+        state->cancel.store(true, std::memory_order_relaxed);
+    }
+
+    state->condition.notify_one();
+    state->thread.join();
+
+    delete state;
+    state = nullptr;
+}
+
+void ScriptEvaluator::set_options(const ScriptOptions& options)
+{
+    std::lock_guard<std::mutex> lock(state->mutex);
+
+    state->options = options;
+}
+
+uint32_t ScriptEvaluator::submit(const std::string& source)
+{
+    uint32_t generation;
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+
+        state->pending_source = source;
+        state->has_pending    = true;
+        generation            = ++state->pending_generation;
+
+        // The running evaluation is stale now; the worker picks up the new
+        // source as soon as the interrupt callback has unwound it.
+        if (state->busy && !state->cancel.load(std::memory_order_relaxed))
+        {
+            state->cancel_time = bx::getHPCounter();
+            state->cancel.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    state->condition.notify_one();
+
+    return generation;
+}
+
+bool ScriptEvaluator::poll(ScriptResult& inout_result)
+{
+    std::lock_guard<std::mutex> lock(state->mutex);
+
+    if (!state->has_ready)
+    {
+        return false;
+    }
+
+    std::swap(inout_result, state->ready);
+    state->has_ready = false;
+
+    state->stats.completed++;
+    state->stats.useful_ms += inout_result.time_ms;
+
+    return true;
+}
+
+bool ScriptEvaluator::poll_part(ScriptPart& out_part)
+{
+    return state->parts.pop(out_part);
+}
+
+bool ScriptEvaluator::poll_sdf_preview(ScriptSdfPreview& out_preview)
+{
+    return state->previews.pop(out_preview);
+}
+
+bool ScriptEvaluator::is_busy() const
+{
+    std::lock_guard<std::mutex> lock(state->mutex);
+
+    return state->busy || state->has_pending;
+}
+
+ScriptStats ScriptEvaluator::get_stats() const
+{
+    std::lock_guard<std::mutex> lock(state->mutex);
+
+    return state->stats;
+}
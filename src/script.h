@@ -0,0 +1,369 @@
+#pragma once
+
+#include <stddef.h>      // size_t
+#include <stdint.h>      // uint*_t
+
+#include <atomic>        // atomic
+#include <memory>        // shared_ptr, unique_ptr
+#include <mutex>         // mutex
+#include <string>        // string
+#include <unordered_map> // unordered_map
+#include <vector>        // vector
+
+#include <glm/glm.hpp>   // mat4
+
+#include "mesh.h"        // Mesh
+#include "sdf.h"         // Aabb, SdfBrickMap, SdfMeshCache, SdfTree
+#include "spsc_queue.h"  // SpscQueue
+#include "subdivision.h" // SubdivisionSurface
+
+
+// -----------------------------------------------------------------------------
+// MODEL SCRIPT EVALUATION
+// -----------------------------------------------------------------------------
+
+enum struct ScriptStatus
+{
+    SUCCESS,
+    FAILURE,   // Compilation or runtime error.
+    CANCELLED, // Stopped on request, typically for a newer submission.
+    TIMED_OUT, // Over the time or step budget.
+};
+
+struct ScriptOptions
+{
+    // Limits enforced from Luau's interrupt callback, which runs on function
+    // calls and loop iterations, by `sdf.mesh` and `sdf.contour` between
+    // blocks, by `sdf.bricks` between pages, by mesh booleans between chunks
+    // of triangle pairs, and by `subdivide` between chunks of stencil rows.
+    // Other long native calls (e.g. a huge sphere) can't be interrupted in the
+    // middle.
+    double   time_budget_ms = 0.0;   // Zero for unlimited.
+    uint64_t step_budget    = 0;     // Interrupt checks; zero for unlimited.
+
+    // Compiles the functions that scripts opt in with `native(f)`, and whole
+    // scripts starting with a `--!native` comment, to machine code. Ignored
+    // where `script_native_code_supported` is false.
+    bool     native_code    = false;
+
+    // `ScriptEvaluator` only: hands the emitted parts over through `poll_part`
+    // while the evaluation runs, instead of all at once in the result.
+    bool     stream_parts   = false;
+
+    // `ScriptEvaluator` only: hands the fields of `sdf.mesh` and `sdf.contour`
+    // calls over through `poll_sdf_preview` before meshing them, so they can
+    // be previewed meanwhile.
+    bool     sdf_previews   = false;
+
+    // Samples the call stack of the script at roughly this interval, from the
+    // interrupt callback, into `ScriptResult::profile`. Zero disables it.
+    // Tasks running on other VMs aren't sampled.
+    double   profile_interval_ms = 0.0;
+};
+
+// Part of a model emitted by a running evaluation, in world space.
+struct ScriptPart
+{
+    Mesh     mesh;
+    uint32_t color      = 0; // ABGR.
+    uint32_t generation = 0; // Of the evaluation.
+};
+
+// Parts that don't fit stay in the result, along with all later ones, so the
+// streamed parts are always a prefix of the model.
+using ScriptPartQueue = SpscQueue<ScriptPart, 256>;
+
+// Emitted part that was made by meshing a field, and then maybe transformed,
+// so viewers can draw the field in its place. Tasks' parts aren't tracked.
+struct ScriptSdfPlacement
+{
+    uint32_t  part   = 0;               // In emission order.
+    uint32_t  call   = 0;               // Of the meshing calls, in call order.
+    glm::mat4 matrix = glm::mat4(1.0f); // From the field's space to the world.
+    uint32_t  color  = 0;               // ABGR.
+};
+
+// Field of a meshing call that wasn't cached, sent before it's meshed. Paired
+// with the placements of the same call in the previous result, which survive
+// most edits, a viewer can draw it until the new mesh comes in.
+struct ScriptSdfPreview
+{
+    SdfTree  tree;           // Pruned to `bounds`.
+    uint32_t root       = 0;
+    Aabb     bounds;         // Of the grid; the mesh is empty outside of it.
+    uint32_t call       = 0;
+    uint32_t generation = 0;
+};
+
+using ScriptPreviewQueue = SpscQueue<ScriptSdfPreview, 16>;
+
+// Function at a given call path of a profile.
+struct ScriptProfileNode
+{
+    std::string name;             // "function:line" of its definition, or "[C] function".
+    uint32_t    parent       = 0;
+    uint32_t    first_child  = 0; // Zero for none.
+    uint32_t    next_sibling = 0; // Ditto.
+    uint32_t    samples      = 0; // With it anywhere on the stack.
+    uint32_t    self_samples = 0; // With it on top.
+};
+
+// Call tree of sampled stacks. Samples are weighted by the number of intervals
+// since the previous one, so time spent in long native calls, where the
+// interrupt can't fire, goes to the frame that resumes after them.
+struct ScriptProfile
+{
+    double                         interval_ms = 0.0;
+    uint32_t                       samples     = 0;
+    std::vector<ScriptProfileNode> nodes;        // The root is `nodes[0]`.
+    std::vector<uint32_t>          line_samples; // Self samples per source line, from 1.
+
+    void clear();
+
+    // One "root;caller;callee samples" line per distinct stack, the format of
+    // flamegraph.pl and speedscope. Returns false if the file can't be written.
+    bool write_folded(const char* path) const;
+};
+
+// Output of one evaluation of a model script. Meshes are in world space, with
+// an ABGR color each.
+struct ScriptResult
+{
+    std::vector<Mesh>     meshes;
+    std::vector<uint32_t> colors;
+    std::string           error;      // Empty on success.
+    ScriptStatus          status       = ScriptStatus::SUCCESS;
+    uint32_t              generation   = 0;
+    double                time_ms      = 0.0;
+    uint32_t              streamed        = 0;     // Parts sent ahead instead.
+    uint32_t              tasks           = 0;     // Parallel tasks merged.
+    uint32_t              cache_hits      = 0;     // Geometry calls served from
+    uint32_t              cache_misses    = 0;     // the cache, and the others.
+    bool                  bytecode_cached = false; // Loaded from disk.
+    size_t                memory_peak     = 0;     // VM bytes, with an arena.
+    uint32_t              allocations     = 0;     // VM allocations, ditto.
+    size_t                sdf_brick_bytes = 0;     // Of the distinct brick maps used.
+    ScriptProfile         profile;                 // With `profile_interval_ms`.
+
+    std::vector<ScriptSdfPlacement> sdf_placements;
+
+    void clear();
+};
+
+struct ScriptCacheEntry
+{
+    std::shared_ptr<const Mesh> mesh;
+    uint32_t                    last_used = 0; // Evaluation number.
+};
+
+// Brick map of an `sdf.bricks` call.
+struct ScriptBrickMapEntry
+{
+    std::shared_ptr<const SdfBrickMap> map;
+    uint32_t                           last_used = 0;
+};
+
+// Topology and stencils of a `subdivide` call, shared by the cages with the
+// same faces.
+struct ScriptSubdivisionEntry
+{
+    std::shared_ptr<const SubdivisionSurface> surface;
+    uint32_t                                  last_used = 0;
+};
+
+// Outputs of the geometry-producing calls (primitives, transforms, merges) of
+// earlier evaluations, keyed by a hash of the call's name, its arguments and
+// the keys of its input meshes. The keys chain, so they form a content-
+// addressed dependency graph: after an edit, only the calls downstream of the
+// change miss and get re-meshed. Lookups and insertions are thread-safe, for
+// parallel tasks; the rest is meant to be called by the thread evaluating the
+// scripts only.
+//
+// Compiled bytecode is cached on disk instead, in `bytecode_directory`, so it
+// survives restarts. Each edit compiles a new source, so only the most
+// recently used `bytecode_max_files` files are kept.
+//
+// Signed distance fields also keep the block meshes of `sdf.mesh`, so that a
+// call that misses after an edit to its field only remeshes the blocks the
+// edit reaches. Grids default to the field's bounds snapped to the block
+// lattice, so that edits that move the bounds keep the blocks as well. The
+// brick maps of `sdf.bricks` are kept by call key too, since sampling them is
+// the expensive part.
+//
+// Subdivision surfaces are kept by the topology of their cage, so moving cage
+// vertices only re-evaluates the stencils.
+struct ScriptCache
+{
+    std::unordered_map<uint64_t, ScriptCacheEntry>       entries;
+    SdfMeshCache                                         sdf_blocks;
+    std::unordered_map<uint64_t, ScriptBrickMapEntry>    brick_maps;
+    std::unordered_map<uint64_t, ScriptSubdivisionEntry> subdivisions;
+    uint32_t                                             evaluation = 0;
+
+    std::string                                          bytecode_directory; // Empty to disable.
+    uint32_t                                             bytecode_max_files = 256;
+
+    std::mutex                                           mutex;
+
+    std::shared_ptr<const Mesh> find(uint64_t key);
+
+    void insert(uint64_t key, std::shared_ptr<const Mesh> mesh);
+
+    std::shared_ptr<const SdfBrickMap> find_brick_map(uint64_t key);
+
+    void insert_brick_map(uint64_t key, std::shared_ptr<const SdfBrickMap> map);
+
+    std::shared_ptr<const SubdivisionSurface> find_subdivision(uint64_t key);
+
+    void insert_subdivision(uint64_t key, std::shared_ptr<const SubdivisionSurface> surface);
+
+    // Starts the next evaluation.
+    void begin();
+
+    // Drops the entries that the current evaluation didn't use.
+    void evict_unused();
+
+    void clear();
+};
+
+// Size-class allocator for the Luau VM of one evaluation at a time. Blocks up
+// to 64 KiB come from per-class free lists, refilled by bumping through 1 MiB
+// chunks that are kept across evaluations; `reset` recycles all of them at
+// once after the VM is closed. Larger blocks go straight to malloc. Not
+// thread-safe, unlike `ScriptCache`.
+struct ScriptArena
+{
+    static constexpr uint32_t CLASS_COUNT         = 39; // 16..512 by 16, then 1..64 KiB by powers of two.
+    static constexpr size_t   MAX_CLASS_SIZE      = 65536;
+    static constexpr size_t   CHUNK_SIZE          = 1 << 20;
+    static constexpr uint32_t MAX_RETAINED_CHUNKS = 64;
+
+    std::vector<std::unique_ptr<uint8_t[]>> chunks;
+    uint32_t                                chunk        = 0; // Being bumped through.
+    size_t                                  chunk_offset = 0;
+
+    void*                                   free_lists[CLASS_COUNT] = {};
+
+    size_t                                  bytes       = 0; // Since the last reset.
+    size_t                                  peak_bytes  = 0;
+    uint32_t                                allocations = 0;
+
+    void* allocate(size_t size);
+
+    void deallocate(void* ptr, size_t size);
+
+    // Same contract as `lua_Alloc`: frees with a zero `new_size`.
+    void* reallocate(void* ptr, size_t old_size, size_t new_size);
+
+    // Everything allocated must be unused by now.
+    void reset();
+};
+
+struct ScriptTaskWorker;
+
+// Luau VMs running the parallel tasks of scripts, at most one per thread of
+// the background task queue. They only run the definitions at the top of the
+// script, which register its task functions, and are kept for the evaluations
+// that follow while those definitions compile the same. Meant for one
+// evaluation at a time, like `ScriptArena`.
+struct ScriptTaskWorkers
+{
+    std::vector<std::unique_ptr<ScriptTaskWorker>> workers;
+    std::vector<ScriptTaskWorker*>                 idle;
+    std::mutex                                     mutex;
+
+    std::string                                    bytecode;       // Of the definitions.
+    uint64_t                                       key        = 0; // Ditto, and of the VM settings.
+    uint32_t                                       evaluation = 0; // With tasks, so far.
+
+    ScriptTaskWorkers();
+
+    ~ScriptTaskWorkers();
+
+    // Closes the VMs.
+    void clear();
+};
+
+// Where the evaluation time went. Useful time is that of results that were
+// polled; wasted time is that of cancelled evaluations and of results replaced
+// by newer ones before anybody polled them.
+struct ScriptStats
+{
+    uint32_t completed              = 0;
+    uint32_t cancelled              = 0;
+    uint32_t superseded             = 0;
+    double   useful_ms              = 0.0;
+    double   wasted_ms              = 0.0;
+    double   last_cancel_latency_ms = 0.0; // From the request to the worker
+    double   max_cancel_latency_ms  = 0.0; // being free again.
+};
+
+struct ScriptEvaluatorState;
+
+// Runs model scripts in a Luau VM on a dedicated worker thread. Only the most
+// recently submitted source is evaluated: a submission cancels the evaluation
+// in flight, and older pending submissions are simply dropped. Finished results
+// are double-buffered: the worker fills its own copy and publishes it by
+// swapping, so polling never blocks on an evaluation.
+//
+// Without `WITH_LUAU`, every evaluation fails with an error message.
+struct ScriptEvaluator
+{
+    ScriptEvaluatorState* state = nullptr;
+
+    // Compiled scripts are cached in `bytecode_directory`, unless empty.
+    void init(const std::string& bytecode_directory = {});
+
+    void shutdown();
+
+    // Applies from the next evaluation on.
+    void set_options(const ScriptOptions& options);
+
+    // Returns the generation number of the submission.
+    uint32_t submit(const std::string& source);
+
+    // Swaps the latest finished result into `inout_result`, if there is one
+    // that wasn't polled yet. Cancelled evaluations never produce a result.
+    // All streamed parts of a result are queued before it can be polled.
+    bool poll(ScriptResult& inout_result);
+
+    // Takes the next streamed part, with `stream_parts` on. Parts come in
+    // emission order, and those of cancelled or failed evaluations are sent
+    // as well; consumers tell them apart by generation.
+    bool poll_part(ScriptPart& out_part);
+
+    // Takes the next field to preview, with `sdf_previews` on, in call order.
+    // Like parts, those of cancelled evaluations are sent as well.
+    bool poll_sdf_preview(ScriptSdfPreview& out_preview);
+
+    bool is_busy() const;
+
+    ScriptStats get_stats() const;
+};
+
+// Whether Luau's code generator was built in (`WITH_LUAU_CODEGEN`) and
+// supports the CPU.
+bool script_native_code_supported();
+
+// Evaluates the script on the calling thread. Setting `cancel` from another
+// thread stops the evaluation at the next interrupt check. With a `cache`,
+// geometry calls that match ones of earlier evaluations reuse their meshes.
+// With an `arena`, the VM allocates from it, and it's reset when done. With
+// `parts`, emitted parts are pushed to it as they come, tagged with
+// `generation`, which also goes into the result. With `previews`, the fields
+// of meshing calls that miss the cache are pushed to it before meshing. With
+// `task_workers`, the VMs of parallel tasks are reused from earlier
+// evaluations instead of being set up for this one only.
+void evaluate_script
+(
+    const std::string&       source,
+    ScriptResult&            out_result,
+    const ScriptOptions&     options      = {},
+    const std::atomic<bool>* cancel       = nullptr,
+    ScriptCache*             cache        = nullptr,
+    ScriptArena*             arena        = nullptr,
+    ScriptPartQueue*         parts        = nullptr,
+    uint32_t                 generation   = 0,
+    ScriptPreviewQueue*      previews     = nullptr,
+    ScriptTaskWorkers*       task_workers = nullptr
+);
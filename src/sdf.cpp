@@ -0,0 +1,3224 @@
+#include "sdf.h"
+
+#include <math.h>           // cosf, fabs, fabsf, floorf, lrintf, sinf, sqrt, sqrtf
+#include <stdarg.h>         // va_*
+#include <stdio.h>          // vsnprintf
+#include <string.h>         // memcmp
+
+#include <algorithm>        // clamp, count, max, min, minmax_element, sort
+#include <initializer_list> // initializer_list
+#include <iterator>         // next
+#include <mutex>            // lock_guard, mutex
+#include <unordered_map>    // unordered_map
+#include <utility>          // move, pair
+
+#include <meshoptimizer.h>  // meshopt_generateVertexRemap
+
+#include "mesh_kernels.h"   // evaluate_sdf_tape
+#include "tasks.h"          // parallel_for, task_cancelled, TaskCancel
+
+
+// -----------------------------------------------------------------------------
+// TREE CONSTRUCTION
+// -----------------------------------------------------------------------------
+
+static const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+
+static uint64_t fnv1a(const void* data, size_t size, uint64_t hash)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+static bool is_binary(SdfOp op)
+{
+    return op >= SdfOp::UNION && op <= SdfOp::SMOOTH_SUBTRACT;
+}
+
+static bool is_primitive(SdfOp op)
+{
+    return op < SdfOp::UNION;
+}
+
+uint32_t SdfTree::add(SdfOp op, uint32_t a, uint32_t b, const glm::vec4& params, const glm::mat4& matrix)
+{
+    SdfNode node;
+    node.op     = op;
+    node.a      = is_primitive(op) ? 0 : a;
+    node.b      = is_binary   (op) ? b : 0;
+    node.params = params;
+    node.matrix = matrix;
+
+    uint64_t hash = fnv1a(&op, sizeof(op), FNV_OFFSET_BASIS);
+    hash = fnv1a(&node.params, sizeof(node.params), hash);
+
+    if (op == SdfOp::TRANSFORM)
+    {
+        hash = fnv1a(&node.matrix, sizeof(node.matrix), hash);
+    }
+
+    if (!is_primitive(op))
+    {
+        hash       = fnv1a(&nodes[node.a].hash, sizeof(uint64_t), hash);
+        node.depth = nodes[node.a].depth + 1;
+    }
+
+    if (is_binary(op))
+    {
+        hash       = fnv1a(&nodes[node.b].hash, sizeof(uint64_t), hash);
+        node.depth = std::max(node.depth, nodes[node.b].depth + 1);
+    }
+
+    node.hash = hash;
+    nodes.push_back(node);
+
+    return uint32_t(nodes.size() - 1);
+}
+
+uint32_t SdfTree::sphere(float radius)
+{
+    return add(SdfOp::SPHERE, 0, 0, { radius, 0.0f, 0.0f, 0.0f });
+}
+
+uint32_t SdfTree::box(const glm::vec3& half_extents, float rounding)
+{
+    return add(SdfOp::BOX, 0, 0, { half_extents, rounding });
+}
+
+uint32_t SdfTree::cylinder(float radius, float half_height)
+{
+    return add(SdfOp::CYLINDER, 0, 0, { radius, half_height, 0.0f, 0.0f });
+}
+
+uint32_t SdfTree::torus(float major_radius, float minor_radius)
+{
+    return add(SdfOp::TORUS, 0, 0, { major_radius, minor_radius, 0.0f, 0.0f });
+}
+
+uint32_t SdfTree::capsule(float radius, float half_length)
+{
+    return add(SdfOp::CAPSULE, 0, 0, { radius, half_length, 0.0f, 0.0f });
+}
+
+uint32_t SdfTree::plane(const glm::vec3& normal, float offset)
+{
+    return add(SdfOp::PLANE, 0, 0, { glm::normalize(normal), offset });
+}
+
+uint32_t SdfTree::unite(uint32_t a, uint32_t b, float radius)
+{
+    return radius > 0.0f
+        ? add(SdfOp::SMOOTH_UNION, a, b, { radius, 0.0f, 0.0f, 0.0f })
+        : add(SdfOp::UNION       , a, b, glm::vec4(0.0f));
+}
+
+uint32_t SdfTree::intersect(uint32_t a, uint32_t b, float radius)
+{
+    return radius > 0.0f
+        ? add(SdfOp::SMOOTH_INTERSECT, a, b, { radius, 0.0f, 0.0f, 0.0f })
+        : add(SdfOp::INTERSECT       , a, b, glm::vec4(0.0f));
+}
+
+uint32_t SdfTree::subtract(uint32_t a, uint32_t b, float radius)
+{
+    return radius > 0.0f
+        ? add(SdfOp::SMOOTH_SUBTRACT, a, b, { radius, 0.0f, 0.0f, 0.0f })
+        : add(SdfOp::SUBTRACT       , a, b, glm::vec4(0.0f));
+}
+
+uint32_t SdfTree::transform(uint32_t a, const glm::mat4& matrix)
+{
+    // Distances in the child's space shrink by at most the smallest scale.
+    const float scale = std::min({
+        glm::length(glm::vec3(matrix[0])),
+        glm::length(glm::vec3(matrix[1])),
+        glm::length(glm::vec3(matrix[2])),
+    });
+
+    return add(SdfOp::TRANSFORM, a, 0, { scale, 0.0f, 0.0f, 0.0f }, glm::inverse(matrix));
+}
+
+uint32_t SdfTree::repeat(uint32_t a, const glm::vec3& period)
+{
+    return add(SdfOp::REPEAT, a, 0, { glm::max(period, glm::vec3(0.0f)), 0.0f });
+}
+
+uint32_t SdfTree::mirror(uint32_t a, bool x, bool y, bool z)
+{
+    return add(SdfOp::MIRROR, a, 0, { float(x), float(y), float(z), 0.0f });
+}
+
+uint32_t SdfTree::twist(uint32_t a, float radians_per_unit)
+{
+    return add(SdfOp::TWIST, a, 0, { radians_per_unit, 0.0f, 0.0f, 0.0f });
+}
+
+uint32_t SdfTree::round(uint32_t a, float radius)
+{
+    return add(SdfOp::ROUND, a, 0, { radius, 0.0f, 0.0f, 0.0f });
+}
+
+uint32_t SdfTree::shell(uint32_t a, float thickness)
+{
+    return add(SdfOp::SHELL, a, 0, { thickness, 0.0f, 0.0f, 0.0f });
+}
+
+void SdfTree::clear()
+{
+    nodes.clear();
+}
+
+
+// -----------------------------------------------------------------------------
+// EVALUATION
+// -----------------------------------------------------------------------------
+
+// Polynomial smooth minimum; deviates from `min` by at most `k / 4`.
+static float smooth_min(float a, float b, float k)
+{
+    const float h = std::max(k - fabsf(a - b), 0.0f) / k;
+
+    return std::min(a, b) - h * h * k * 0.25f;
+}
+
+float SdfTree::evaluate(uint32_t index, const glm::vec3& point) const
+{
+    const SdfNode&   node = nodes[index];
+    const glm::vec4& k    = node.params;
+
+    switch (node.op)
+    {
+    case SdfOp::SPHERE:
+        return glm::length(point) - k.x;
+
+    case SdfOp::BOX:
+    {
+        const glm::vec3 q = glm::abs(point) - (glm::vec3(k) - k.w);
+
+        return glm::length(glm::max(q, 0.0f)) + std::min(std::max(q.x, std::max(q.y, q.z)), 0.0f) - k.w;
+    }
+
+    case SdfOp::CYLINDER:
+    {
+        const glm::vec2 d = glm::abs(glm::vec2(glm::length(glm::vec2(point.x, point.z)), point.y)) - glm::vec2(k.x, k.y);
+
+        return std::min(std::max(d.x, d.y), 0.0f) + glm::length(glm::max(d, 0.0f));
+    }
+
+    case SdfOp::TORUS:
+        return glm::length(glm::vec2(glm::length(glm::vec2(point.x, point.z)) - k.x, point.y)) - k.y;
+
+    case SdfOp::CAPSULE:
+        return glm::length(glm::vec3(point.x, point.y - glm::clamp(point.y, -k.y, k.y), point.z)) - k.x;
+
+    case SdfOp::PLANE:
+        return glm::dot(point, glm::vec3(k)) - k.w;
+
+    case SdfOp::UNION:
+        return std::min(evaluate(node.a, point), evaluate(node.b, point));
+
+    case SdfOp::INTERSECT:
+        return std::max(evaluate(node.a, point), evaluate(node.b, point));
+
+    case SdfOp::SUBTRACT:
+        return std::max(evaluate(node.a, point), -evaluate(node.b, point));
+
+    case SdfOp::SMOOTH_UNION:
+        return smooth_min(evaluate(node.a, point), evaluate(node.b, point), k.x);
+
+    case SdfOp::SMOOTH_INTERSECT:
+        return -smooth_min(-evaluate(node.a, point), -evaluate(node.b, point), k.x);
+
+    case SdfOp::SMOOTH_SUBTRACT:
+        return -smooth_min(-evaluate(node.a, point), evaluate(node.b, point), k.x);
+
+    case SdfOp::TRANSFORM:
+        return evaluate(node.a, glm::vec3(node.matrix * glm::vec4(point, 1.0f))) * k.x;
+
+    case SdfOp::REPEAT:
+    {
+        glm::vec3 local = point;
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (k[axis] > 0.0f)
+            {
+                local[axis] -= k[axis] * floorf(local[axis] / k[axis] + 0.5f);
+            }
+        }
+
+        return evaluate(node.a, local);
+    }
+
+    case SdfOp::MIRROR:
+        return evaluate(node.a, {
+            k.x != 0.0f ? fabsf(point.x) : point.x,
+            k.y != 0.0f ? fabsf(point.y) : point.y,
+            k.z != 0.0f ? fabsf(point.z) : point.z,
+        });
+
+    case SdfOp::TWIST:
+    {
+        const float c = cosf(k.x * point.y);
+        const float s = sinf(k.x * point.y);
+
+        return evaluate(node.a, { c * point.x - s * point.z, point.y, s * point.x + c * point.z });
+    }
+
+    case SdfOp::ROUND:
+        return evaluate(node.a, point) - k.x;
+
+    case SdfOp::SHELL:
+        return fabsf(evaluate(node.a, point)) - k.x;
+    }
+
+    return 1e30f;
+}
+
+glm::vec3 SdfTree::normal(uint32_t index, const glm::vec3& point, float epsilon) const
+{
+    const glm::vec3 gradient =
+    {
+        evaluate(index, point + glm::vec3(epsilon, 0.0f, 0.0f)) - evaluate(index, point - glm::vec3(epsilon, 0.0f, 0.0f)),
+        evaluate(index, point + glm::vec3(0.0f, epsilon, 0.0f)) - evaluate(index, point - glm::vec3(0.0f, epsilon, 0.0f)),
+        evaluate(index, point + glm::vec3(0.0f, 0.0f, epsilon)) - evaluate(index, point - glm::vec3(0.0f, 0.0f, epsilon)),
+    };
+
+    const float length = glm::length(gradient);
+
+    return length > 0.0f ? gradient / length : glm::vec3(0.0f);
+}
+
+static const float INFINITE_EXTENT = 1e30f;
+
+static Aabb infinite_bounds()
+{
+    return { glm::vec3(-INFINITE_EXTENT), glm::vec3(INFINITE_EXTENT) };
+}
+
+static bool is_infinite(const Aabb& box)
+{
+    return glm::any(glm::greaterThanEqual(glm::max(-box.min, box.max), glm::vec3(INFINITE_EXTENT)));
+}
+
+static Aabb transform_box(const glm::mat4& matrix, const Aabb& box)
+{
+    Aabb result;
+
+    for (uint32_t corner = 0; corner < 8; corner++)
+    {
+        const glm::vec3 point =
+        {
+            corner & 1 ? box.max.x : box.min.x,
+            corner & 2 ? box.max.y : box.min.y,
+            corner & 4 ? box.max.z : box.min.z,
+        };
+
+        result.extend(glm::vec3(matrix * glm::vec4(point, 1.0f)));
+    }
+
+    return result;
+}
+
+Aabb SdfTree::bounds(uint32_t index) const
+{
+    const SdfNode&   node = nodes[index];
+    const glm::vec4& k    = node.params;
+
+    switch (node.op)
+    {
+    case SdfOp::SPHERE:
+        return { glm::vec3(-k.x), glm::vec3(k.x) };
+
+    case SdfOp::BOX:
+        return { -glm::vec3(k), glm::vec3(k) };
+
+    case SdfOp::CYLINDER:
+        return { -glm::vec3(k.x, k.y, k.x), glm::vec3(k.x, k.y, k.x) };
+
+    case SdfOp::TORUS:
+        return { -glm::vec3(k.x + k.y, k.y, k.x + k.y), glm::vec3(k.x + k.y, k.y, k.x + k.y) };
+
+    case SdfOp::CAPSULE:
+        return { -glm::vec3(k.x, k.x + k.y, k.x), glm::vec3(k.x, k.x + k.y, k.x) };
+
+    case SdfOp::PLANE:
+        return infinite_bounds();
+
+    case SdfOp::UNION:
+    case SdfOp::SMOOTH_UNION:
+    {
+        Aabb box = bounds(node.a);
+        box.extend(bounds(node.b));
+
+        if (node.op == SdfOp::SMOOTH_UNION)
+        {
+            box.min -= k.x * 0.25f;
+            box.max += k.x * 0.25f;
+        }
+
+        return box;
+    }
+
+    case SdfOp::INTERSECT:
+    case SdfOp::SMOOTH_INTERSECT:
+    {
+        const Aabb a = bounds(node.a);
+        const Aabb b = bounds(node.b);
+
+        return { glm::max(a.min, b.min), glm::min(a.max, b.max) };
+    }
+
+    case SdfOp::SUBTRACT:
+    case SdfOp::SMOOTH_SUBTRACT:
+        return bounds(node.a);
+
+    case SdfOp::TRANSFORM:
+    {
+        const Aabb child = bounds(node.a);
+
+        if (is_infinite(child))
+        {
+            return infinite_bounds();
+        }
+
+        return transform_box(glm::inverse(node.matrix), child);
+    }
+
+    case SdfOp::REPEAT:
+    {
+        Aabb box = bounds(node.a);
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (k[axis] > 0.0f)
+            {
+                box.min[axis] = -INFINITE_EXTENT;
+                box.max[axis] =  INFINITE_EXTENT;
+            }
+        }
+
+        return box;
+    }
+
+    case SdfOp::MIRROR:
+    {
+        Aabb box = bounds(node.a);
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (k[axis] != 0.0f)
+            {
+                box.max[axis] = std::max(-box.min[axis], box.max[axis]);
+                box.min[axis] = -box.max[axis];
+            }
+        }
+
+        return box;
+    }
+
+    case SdfOp::TWIST:
+    {
+        Aabb box = bounds(node.a);
+
+        const float x      = std::max(-box.min.x, box.max.x);
+        const float z      = std::max(-box.min.z, box.max.z);
+        const float radius = sqrtf(x * x + z * z);
+
+        box.min.x = box.min.z = -radius;
+        box.max.x = box.max.z =  radius;
+
+        return box;
+    }
+
+    case SdfOp::ROUND:
+    case SdfOp::SHELL:
+    {
+        Aabb box = bounds(node.a);
+        box.min -= k.x;
+        box.max += k.x;
+
+        return box;
+    }
+    }
+
+    return infinite_bounds();
+}
+
+
+// -----------------------------------------------------------------------------
+// INTERVAL ARITHMETIC
+// -----------------------------------------------------------------------------
+
+// Box containing the points at which the unary operation `node` evaluates its
+// child, for points in `box`.
+static Aabb local_box(const SdfNode& node, const Aabb& box)
+{
+    const glm::vec4& k = node.params;
+
+    switch (node.op)
+    {
+    case SdfOp::TRANSFORM:
+        return transform_box(node.matrix, box);
+
+    case SdfOp::REPEAT:
+    {
+        Aabb local = box;
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (k[axis] <= 0.0f)
+            {
+                continue;
+            }
+
+            const float first = floorf(box.min[axis] / k[axis] + 0.5f);
+            const float last  = floorf(box.max[axis] / k[axis] + 0.5f);
+
+            // Within a single period, the box just shifts; otherwise it can
+            // land anywhere in one.
+            if (first == last)
+            {
+                local.min[axis] -= k[axis] * first;
+                local.max[axis] -= k[axis] * first;
+            }
+            else
+            {
+                local.min[axis] = -0.5f * k[axis];
+                local.max[axis] =  0.5f * k[axis];
+            }
+        }
+
+        return local;
+    }
+
+    case SdfOp::MIRROR:
+    {
+        Aabb local = box;
+
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (k[axis] == 0.0f || box.min[axis] >= 0.0f)
+            {
+                continue;
+            }
+
+            if (box.max[axis] <= 0.0f)
+            {
+                local.min[axis] = -box.max[axis];
+                local.max[axis] = -box.min[axis];
+            }
+            else
+            {
+                local.min[axis] = 0.0f;
+                local.max[axis] = std::max(-box.min[axis], box.max[axis]);
+            }
+        }
+
+        return local;
+    }
+
+    case SdfOp::TWIST:
+    {
+        // Any rotation around Y; the disk containing the box in XZ.
+        const float x      = std::max(-box.min.x, box.max.x);
+        const float z      = std::max(-box.min.z, box.max.z);
+        const float radius = sqrtf(x * x + z * z);
+
+        Aabb local = box;
+        local.min.x = local.min.z = -radius;
+        local.max.x = local.max.z =  radius;
+
+        return local;
+    }
+
+    default:
+        return box;
+    }
+}
+
+SdfInterval SdfTree::evaluate_interval(uint32_t index, const Aabb& box) const
+{
+    const SdfNode&   node = nodes[index];
+    const glm::vec4& k    = node.params;
+
+    // Distances change by at most the distance moved.
+    if (is_primitive(node.op))
+    {
+        const float value  = evaluate(index, box.center());
+        const float radius = glm::length(box.extent()) * 0.5f;
+
+        return { value - radius, value + radius };
+    }
+
+    if (is_binary(node.op))
+    {
+        const SdfInterval a = evaluate_interval(node.a, box);
+        const SdfInterval b = evaluate_interval(node.b, box);
+
+        switch (node.op)
+        {
+        case SdfOp::UNION:
+            return { std::min(a.min, b.min), std::min(a.max, b.max) };
+
+        case SdfOp::INTERSECT:
+            return { std::max(a.min, b.min), std::max(a.max, b.max) };
+
+        case SdfOp::SUBTRACT:
+            return { std::max(a.min, -b.max), std::max(a.max, -b.min) };
+
+        // The smooth variants are within a quarter of the radius of the sharp
+        // ones, on the side they round towards.
+        case SdfOp::SMOOTH_UNION:
+            return { std::min(a.min, b.min) - k.x * 0.25f, std::min(a.max, b.max) };
+
+        case SdfOp::SMOOTH_INTERSECT:
+            return { std::max(a.min, b.min), std::max(a.max, b.max) + k.x * 0.25f };
+
+        case SdfOp::SMOOTH_SUBTRACT:
+            return { std::max(a.min, -b.max), std::max(a.max, -b.min) + k.x * 0.25f };
+
+        default:
+            break;
+        }
+    }
+
+    const SdfInterval child = evaluate_interval(node.a, local_box(node, box));
+
+    switch (node.op)
+    {
+    case SdfOp::TRANSFORM:
+        return { child.min * k.x, child.max * k.x };
+
+    case SdfOp::ROUND:
+        return { child.min - k.x, child.max - k.x };
+
+    case SdfOp::SHELL:
+    {
+        const float lower = child.contains_zero() ? 0.0f : std::min(fabsf(child.min), fabsf(child.max));
+        const float upper = std::max(fabsf(child.min), fabsf(child.max));
+
+        return { lower - k.x, upper - k.x };
+    }
+
+    default:
+        return child;
+    }
+}
+
+// Every pruning below keeps the operation's result bitwise identical, not just
+// equal: `min` and `max` return one of their arguments, and the smooth
+// variants reduce to exactly those where the children are a radius apart.
+uint32_t SdfTree::prune(uint32_t index, const Aabb& region, SdfTree& out_tree) const
+{
+    const SdfNode& node = nodes[index];
+
+    if (is_primitive(node.op))
+    {
+        return out_tree.add(node.op, 0, 0, node.params);
+    }
+
+    if (!is_binary(node.op))
+    {
+        const uint32_t child = prune(node.a, local_box(node, region), out_tree);
+
+        return out_tree.add(node.op, child, 0, node.params, node.matrix);
+    }
+
+    const SdfInterval a = evaluate_interval(node.a, region);
+    const SdfInterval b = evaluate_interval(node.b, region);
+    const float       k = node.params.x;
+
+    SdfOp op = node.op;
+
+    switch (op)
+    {
+    case SdfOp::UNION:
+        if (a.min >= b.max) return prune(node.b, region, out_tree);
+        if (b.min >= a.max) return prune(node.a, region, out_tree);
+        break;
+
+    case SdfOp::INTERSECT:
+        if (a.min >= b.max) return prune(node.a, region, out_tree);
+        if (b.min >= a.max) return prune(node.b, region, out_tree);
+        break;
+
+    case SdfOp::SUBTRACT:
+        if (a.min >= -b.min) return prune(node.a, region, out_tree);
+        break;
+
+    case SdfOp::SMOOTH_UNION:
+        if (a.min - b.max >= k) return prune(node.b, region, out_tree);
+        if (b.min - a.max >= k) return prune(node.a, region, out_tree);
+        break;
+
+    case SdfOp::SMOOTH_INTERSECT:
+        if (a.min - b.max >= k) return prune(node.a, region, out_tree);
+        if (b.min - a.max >= k) return prune(node.b, region, out_tree);
+        break;
+
+    case SdfOp::SMOOTH_SUBTRACT:
+        if (a.min + b.min >=  k) return prune(node.a, region, out_tree);
+        if (a.max + b.max <= -k) op = SdfOp::SUBTRACT;
+        break;
+
+    default:
+        break;
+    }
+
+    const uint32_t child_a = prune(node.a, region, out_tree);
+    const uint32_t child_b = prune(node.b, region, out_tree);
+
+    return out_tree.add(op, child_a, child_b, op == node.op ? node.params : glm::vec4(0.0f));
+}
+
+
+// -----------------------------------------------------------------------------
+// TAPE COMPILATION
+// -----------------------------------------------------------------------------
+
+struct SdfTapeCompiler
+{
+    const SdfTree*                         tree = nullptr;
+    SdfTape*                               tape = nullptr;
+    std::unordered_map<uint64_t, uint32_t> emitted; // Instruction hash to index.
+
+    // Returns the first output register, that of an identical earlier
+    // instruction if there is one.
+    uint32_t emit(SdfCode code, uint32_t a, uint32_t b, std::initializer_list<float> constants, uint32_t outputs = 1)
+    {
+        const size_t constants_size = constants.size() * sizeof(float);
+
+        uint64_t hash = fnv1a(&code, sizeof(code), FNV_OFFSET_BASIS);
+        hash = fnv1a(&a, sizeof(a), hash);
+        hash = fnv1a(&b, sizeof(b), hash);
+        hash = fnv1a(constants.begin(), constants_size, hash);
+
+        const auto found = emitted.find(hash);
+
+        if (found != emitted.end())
+        {
+            const SdfInstruction& earlier = tape->code[found->second];
+
+            if (earlier.code == code && earlier.a == a && earlier.b == b &&
+                memcmp(&tape->constants[earlier.constants], constants.begin(), constants_size) == 0)
+            {
+                return earlier.out;
+            }
+        }
+
+        SdfInstruction instruction;
+        instruction.code      = code;
+        instruction.out       = tape->register_count;
+        instruction.a         = a;
+        instruction.b         = b;
+        instruction.constants = uint32_t(tape->constants.size());
+
+        tape->constants.insert(tape->constants.end(), constants);
+        tape->register_count += outputs;
+
+        // On a hash collision, the first instruction keeps the slot.
+        emitted.emplace(hash, uint32_t(tape->code.size()));
+        tape->code.push_back(instruction);
+
+        return instruction.out;
+    }
+
+    // Point in registers `point` to `point + 2`, mapped by `affine`.
+    uint32_t apply(uint32_t point, const glm::mat4& affine)
+    {
+        if (affine == glm::mat4(1.0f))
+        {
+            return point;
+        }
+
+        const glm::mat4& m = affine;
+
+        return emit(SdfCode::AFFINE, point, 0,
+        {
+            m[0][0], m[1][0], m[2][0], m[3][0],
+            m[0][1], m[1][1], m[2][1], m[3][1],
+            m[0][2], m[1][2], m[2][2], m[3][2],
+        }, 3);
+    }
+
+    // Distance of `index` at the point in registers `point` to `point + 2`,
+    // mapped by `affine` first. The map is only applied once something needs
+    // the point, so nested transforms fold into one.
+    uint32_t lower(uint32_t index, uint32_t point, const glm::mat4& affine)
+    {
+        const SdfNode&   node = tree->nodes[index];
+        const glm::vec4& k    = node.params;
+
+        switch (node.op)
+        {
+        case SdfOp::SPHERE:
+            return emit(SdfCode::SPHERE, apply(point, affine), 0, { k.x });
+
+        case SdfOp::BOX:
+            return emit(SdfCode::BOX, apply(point, affine), 0, { k.x - k.w, k.y - k.w, k.z - k.w, k.w });
+
+        case SdfOp::CYLINDER:
+            return emit(SdfCode::CYLINDER, apply(point, affine), 0, { k.x, k.y });
+
+        case SdfOp::TORUS:
+            return emit(SdfCode::TORUS, apply(point, affine), 0, { k.x, k.y });
+
+        case SdfOp::CAPSULE:
+            return emit(SdfCode::CAPSULE, apply(point, affine), 0, { k.x, k.y });
+
+        case SdfOp::PLANE:
+        {
+            // `dot(n, M * p + t) - d` is `dot(transpose(M) * n, p) - (d - dot(n, t))`.
+            const glm::vec3 normal = glm::vec3(k);
+
+            return emit(SdfCode::PLANE, point, 0,
+            {
+                glm::dot(normal, glm::vec3(affine[0])),
+                glm::dot(normal, glm::vec3(affine[1])),
+                glm::dot(normal, glm::vec3(affine[2])),
+                k.w - glm::dot(normal, glm::vec3(affine[3])),
+            });
+        }
+
+        case SdfOp::UNION:
+        case SdfOp::INTERSECT:
+        case SdfOp::SUBTRACT:
+        case SdfOp::SMOOTH_UNION:
+        case SdfOp::SMOOTH_INTERSECT:
+        case SdfOp::SMOOTH_SUBTRACT:
+        {
+            const uint32_t a = lower(node.a, point, affine);
+            const uint32_t b = lower(node.b, point, affine);
+
+            switch (node.op)
+            {
+            case SdfOp::UNION           : return emit(SdfCode::MIN             , a, b, {});
+            case SdfOp::INTERSECT       : return emit(SdfCode::MAX             , a, b, {});
+            case SdfOp::SUBTRACT        : return emit(SdfCode::SUBTRACT        , a, b, {});
+            case SdfOp::SMOOTH_UNION    : return emit(SdfCode::SMOOTH_UNION    , a, b, { k.x });
+            case SdfOp::SMOOTH_INTERSECT: return emit(SdfCode::SMOOTH_INTERSECT, a, b, { k.x });
+            default                     : return emit(SdfCode::SMOOTH_SUBTRACT , a, b, { k.x });
+            }
+        }
+
+        case SdfOp::TRANSFORM:
+        {
+            const uint32_t child = lower(node.a, point, node.matrix * affine);
+
+            return k.x == 1.0f ? child : emit(SdfCode::MUL, child, 0, { k.x });
+        }
+
+        case SdfOp::REPEAT:
+        case SdfOp::MIRROR:
+        {
+            if (glm::vec3(k) == glm::vec3(0.0f))
+            {
+                return lower(node.a, point, affine);
+            }
+
+            const SdfCode  code  = node.op == SdfOp::REPEAT ? SdfCode::REPEAT : SdfCode::MIRROR;
+            const uint32_t local = emit(code, apply(point, affine), 0, { k.x, k.y, k.z }, 3);
+
+            return lower(node.a, local, glm::mat4(1.0f));
+        }
+
+        case SdfOp::TWIST:
+        {
+            if (k.x == 0.0f)
+            {
+                return lower(node.a, point, affine);
+            }
+
+            const uint32_t local = emit(SdfCode::TWIST, apply(point, affine), 0, { k.x }, 3);
+
+            return lower(node.a, local, glm::mat4(1.0f));
+        }
+
+        case SdfOp::ROUND:
+        {
+            const uint32_t child = lower(node.a, point, affine);
+
+            return k.x == 0.0f ? child : emit(SdfCode::ADD, child, 0, { -k.x });
+        }
+
+        case SdfOp::SHELL:
+            return emit(SdfCode::SHELL, lower(node.a, point, affine), 0, { -k.x });
+        }
+
+        return 0;
+    }
+};
+
+void SdfTape::compile(const SdfTree& tree, uint32_t node)
+{
+    code.clear();
+    constants.clear();
+    register_count = 3;
+
+    SdfTapeCompiler compiler;
+    compiler.tree = &tree;
+    compiler.tape = this;
+
+    result = compiler.lower(node, 0, glm::mat4(1.0f));
+}
+
+void SdfTape::evaluate(ConstFloat3Span points, uint32_t count, float* out, std::vector<float>& registers) const
+{
+    registers.resize(size_t(register_count) * SDF_TAPE_BATCH);
+
+    evaluate_sdf_tape(code.data(), uint32_t(code.size()), constants.data(), result, registers.data(), points, count, out);
+}
+
+void SdfTape::evaluate_gradient(ConstFloat3Span points, uint32_t count, float* out, Float3Span out_gradients, std::vector<float>& registers) const
+{
+    registers.resize(size_t(register_count) * SDF_TAPE_BATCH * 4);
+
+    evaluate_sdf_tape_gradient(code.data(), uint32_t(code.size()), constants.data(), result, registers.data(), points, count, out, out_gradients);
+}
+
+
+// -----------------------------------------------------------------------------
+// MESHING
+// -----------------------------------------------------------------------------
+
+struct SdfGrid
+{
+    glm::vec3  origin    = glm::vec3(0.0f);
+    glm::ivec3 offset    = glm::ivec3(0);   // Of the first point, in cells from `origin`.
+    float      cell_size = 1.0f;
+    glm::uvec3 cells     = glm::uvec3(0);
+
+    // The same for every block, so that shared samples come out identical,
+    // also with those of other grids with the same origin.
+    glm::vec3 point(const glm::uvec3& index, const glm::vec3& fraction = glm::vec3(0.0f)) const
+    {
+        return origin + (glm::vec3(glm::ivec3(index) + offset) + fraction) * cell_size;
+    }
+};
+
+enum struct SdfSampleState : uint8_t
+{
+    UNSET,
+    SIGN,  // Only the sign is right; in a region without surface.
+    EXACT,
+};
+
+// Fills the samples of a block by octree subdivision of its cells. Regions
+// whose interval excludes zero only get their sign, which is all the cells
+// without surface need; the corners of every cell with surface are evaluated,
+// since such a cell's own region can't be skipped. Leaves are evaluated with
+// the tape of the tree pruned to them, which gives the same results as that of
+// the whole tree there, so samples shared with the neighbor blocks still match.
+struct SdfBlockSampler
+{
+    const SdfGrid*              grid = nullptr;
+    glm::uvec3                  base = glm::uvec3(0); // First sampled point.
+    glm::uvec3                  size = glm::uvec3(0); // Sampled points per axis.
+    std::vector<float>          values;
+    std::vector<SdfSampleState> states;
+    std::vector<SdfTree>        trees;                // Pruned, per octree level.
+    std::vector<SdfTape>        leaves;               // Of the pruned trees, per evaluated leaf.
+    std::vector<uint32_t>       cell_leaves;          // Index into `leaves`, if evaluated.
+    uint64_t                    evaluated = 0;
+
+    // Batches of points for the tapes.
+    std::vector<float>          batch_x;
+    std::vector<float>          batch_y;
+    std::vector<float>          batch_z;
+    std::vector<float>          batch_values;
+    std::vector<float>          batch_gradient_x;
+    std::vector<float>          batch_gradient_y;
+    std::vector<float>          batch_gradient_z;
+    std::vector<uint32_t>       batch_samples;
+    std::vector<float>          registers;
+
+    size_t index(const glm::uvec3& point) const
+    {
+        return (size_t(point.z) * size.y + point.y) * size.x + point.x;
+    }
+
+    size_t cell_index(const glm::uvec3& cell) const
+    {
+        return (size_t(cell.z) * (size.y - 1) + cell.y) * (size.x - 1) + cell.x;
+    }
+
+    // Of the cells in [first, last), relative to `base`.
+    void sample(const SdfTree& tree, uint32_t root, const glm::uvec3& first, const glm::uvec3& last, uint32_t level)
+    {
+        // Padded well past the points, which covers the rounding of the
+        // intervals.
+        const float pad = grid->cell_size * 0.5f;
+
+        Aabb region;
+        region.min = grid->point(base + first) - pad;
+        region.max = grid->point(base + last ) + pad;
+
+        const SdfInterval interval = tree.evaluate_interval(root, region);
+
+        if (!interval.contains_zero())
+        {
+            const float sign = interval.min > 0.0f ? interval.min : interval.max;
+
+            for_each_point(first, last, [&](size_t i, const glm::uvec3&)
+            {
+                if (states[i] == SdfSampleState::UNSET)
+                {
+                    values[i] = sign;
+                    states[i] = SdfSampleState::SIGN;
+                }
+            });
+
+            return;
+        }
+
+        const glm::uvec3 cells = last - first;
+        const bool       leaf  = std::max({ cells.x, cells.y, cells.z }) <= SDF_LEAF_SIZE || level + 1 == trees.size();
+
+        SdfTree& pruned = trees[level];
+        pruned.clear();
+
+        const uint32_t pruned_root = tree.prune(root, region, pruned);
+
+        // Leaves keep their tapes, for the normals of their cells' vertices.
+        if (leaf)
+        {
+            SdfTape& tape = leaves.emplace_back();
+            tape.compile(pruned, pruned_root);
+
+            for (uint32_t z = first.z; z < last.z; z++)
+            {
+                for (uint32_t y = first.y; y < last.y; y++)
+                {
+                    for (uint32_t x = first.x; x < last.x; x++)
+                    {
+                        cell_leaves[cell_index({ x, y, z })] = uint32_t(leaves.size() - 1);
+                    }
+                }
+            }
+
+            clear_batch();
+
+            for_each_point(first, last, [&](size_t i, const glm::uvec3& point)
+            {
+                if (states[i] != SdfSampleState::EXACT)
+                {
+                    batch_samples.push_back(uint32_t(i));
+                    add_to_batch(grid->point(base + point));
+                }
+            });
+
+            run_batch(tape);
+
+            for (size_t i = 0; i < batch_samples.size(); i++)
+            {
+                values[batch_samples[i]] = batch_values[i];
+                states[batch_samples[i]] = SdfSampleState::EXACT;
+            }
+
+            evaluated += batch_samples.size();
+
+            return;
+        }
+
+        const glm::uvec3 middle = first + (cells + 1u) / 2u;
+
+        for (uint32_t child = 0; child < 8; child++)
+        {
+            glm::uvec3 child_first = first;
+            glm::uvec3 child_last  = last;
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                (child & (1 << axis) ? child_first : child_last)[axis] = middle[axis];
+            }
+
+            if (glm::all(glm::lessThan(child_first, child_last)))
+            {
+                sample(pruned, pruned_root, child_first, child_last, level + 1);
+            }
+        }
+    }
+
+    // From the gradients of the tapes of the vertices' leaves, in one pass
+    // instead of the six evaluations of central differences.
+    void compute_normals(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& vertex_leaves, std::vector<glm::vec3>& out_normals)
+    {
+        std::vector<float> values;
+
+        evaluate_gradients(positions, vertex_leaves, values, out_normals);
+
+        for (glm::vec3& normal : out_normals)
+        {
+            const float length = glm::length(normal);
+
+            normal = length > 0.0f ? normal / length : glm::vec3(0.0f);
+        }
+    }
+
+    // Values and gradients at `points`, each with the tape of its leaf; points
+    // of the same leaf are batched together.
+    void evaluate_gradients(const std::vector<glm::vec3>& points, const std::vector<uint32_t>& point_leaves, std::vector<float>& out_values, std::vector<glm::vec3>& out_gradients)
+    {
+        std::vector<uint32_t> order(points.size());
+
+        for (uint32_t i = 0; i < order.size(); i++)
+        {
+            order[i] = i;
+        }
+
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+        {
+            return point_leaves[a] != point_leaves[b] ? point_leaves[a] < point_leaves[b] : a < b;
+        });
+
+        out_values   .resize(points.size());
+        out_gradients.resize(points.size());
+
+        for (size_t begin = 0, end = 0; begin < order.size(); begin = end)
+        {
+            const uint32_t leaf = point_leaves[order[begin]];
+
+            clear_batch();
+
+            for (end = begin; end < order.size() && point_leaves[order[end]] == leaf; end++)
+            {
+                add_to_batch(points[order[end]]);
+            }
+
+            run_batch_gradient(leaves[leaf]);
+
+            for (size_t i = begin; i < end; i++)
+            {
+                out_values   [order[i]] = batch_values[i - begin];
+                out_gradients[order[i]] = { batch_gradient_x[i - begin], batch_gradient_y[i - begin], batch_gradient_z[i - begin] };
+            }
+        }
+    }
+
+    void clear_batch()
+    {
+        batch_x      .clear();
+        batch_y      .clear();
+        batch_z      .clear();
+        batch_samples.clear();
+    }
+
+    void add_to_batch(const glm::vec3& point)
+    {
+        batch_x.push_back(point.x);
+        batch_y.push_back(point.y);
+        batch_z.push_back(point.z);
+    }
+
+    void run_batch(const SdfTape& tape)
+    {
+        batch_values.resize(batch_x.size());
+
+        tape.evaluate({ batch_x.data(), batch_y.data(), batch_z.data() }, uint32_t(batch_x.size()), batch_values.data(), registers);
+    }
+
+    void run_batch_gradient(const SdfTape& tape)
+    {
+        batch_values    .resize(batch_x.size());
+        batch_gradient_x.resize(batch_x.size());
+        batch_gradient_y.resize(batch_x.size());
+        batch_gradient_z.resize(batch_x.size());
+
+        tape.evaluate_gradient(
+            { batch_x.data(), batch_y.data(), batch_z.data() },
+            uint32_t(batch_x.size()),
+            batch_values.data(),
+            { batch_gradient_x.data(), batch_gradient_y.data(), batch_gradient_z.data() },
+            registers
+        );
+    }
+
+    // The corner points of the cells in [first, last), with their indices.
+    template <typename Function>
+    void for_each_point(const glm::uvec3& first, const glm::uvec3& last, const Function& function) const
+    {
+        for (uint32_t z = first.z; z <= last.z; z++)
+        {
+            for (uint32_t y = first.y; y <= last.y; y++)
+            {
+                for (uint32_t x = first.x; x <= last.x; x++)
+                {
+                    function(index({ x, y, z }), glm::uvec3(x, y, z));
+                }
+            }
+        }
+    }
+};
+
+// Surface nets of the cells in [first, last), plus vertices for the layer of
+// cells just below, which the quads of edges on the block's lower faces use.
+static void mesh_block
+(
+    const SdfTree&    tree,
+    uint32_t          root,
+    const SdfGrid&    grid,
+    const glm::uvec3& first,
+    const glm::uvec3& last,
+    SdfBlockMesh&     out_mesh
+)
+{
+    SdfBlockSampler sampler;
+    sampler.grid = &grid;
+    sampler.base = glm::max(first, glm::uvec3(1)) - 1u;
+    sampler.size = last - sampler.base + 1u;
+
+    const size_t point_count = size_t(sampler.size.x) * sampler.size.y * sampler.size.z;
+
+    sampler.values     .resize(point_count);
+    sampler.states     .resize(point_count, SdfSampleState::UNSET);
+    sampler.trees      .resize(8);
+    sampler.cell_leaves.resize(size_t(sampler.size.x - 1) * (sampler.size.y - 1) * (sampler.size.z - 1), UINT32_MAX);
+
+    sampler.sample(tree, root, glm::uvec3(0), sampler.size - 1u, 0);
+
+    out_mesh.samples = sampler.evaluated;
+
+    // All signs alike, so no surface.
+    if (sampler.evaluated == 0)
+    {
+        return;
+    }
+
+    const glm::uvec3          base    = sampler.base;
+    const glm::uvec3          size    = sampler.size;
+    const std::vector<float>& samples = sampler.values;
+
+    const auto sample_index = [&](uint32_t x, uint32_t y, uint32_t z)
+    {
+        return sampler.index({ x, y, z });
+    };
+
+    // One vertex per cell crossed by the surface, at the average of the edge
+    // crossings. Cells are indexed by their lowest corner.
+    const glm::uvec3      cells = size - 1u;
+    std::vector<uint32_t> cell_vertices(size_t(cells.x) * cells.y * cells.z, UINT32_MAX);
+    std::vector<uint32_t> vertex_leaves;
+
+    const auto cell_index = [&](uint32_t x, uint32_t y, uint32_t z)
+    {
+        return (size_t(z) * cells.y + y) * cells.x + x;
+    };
+
+    for (uint32_t z = 0; z < cells.z; z++)
+    {
+        for (uint32_t y = 0; y < cells.y; y++)
+        {
+            for (uint32_t x = 0; x < cells.x; x++)
+            {
+                float    corners[8];
+                uint32_t inside = 0;
+
+                for (uint32_t i = 0; i < 8; i++)
+                {
+                    corners[i] = samples[sample_index(x + (i & 1), y + ((i >> 1) & 1), z + ((i >> 2) & 1))];
+                    inside    |= uint32_t(corners[i] < 0.0f) << i;
+                }
+
+                if (inside == 0 || inside == 0xff)
+                {
+                    continue;
+                }
+
+                glm::vec3 sum   = glm::vec3(0.0f);
+                uint32_t  count = 0;
+
+                for (uint32_t i = 0; i < 8; i++)
+                {
+                    for (uint32_t bit = 1; bit < 8; bit <<= 1)
+                    {
+                        const uint32_t j = i | bit;
+
+                        if (i & bit || ((inside >> i) & 1) == ((inside >> j) & 1))
+                        {
+                            continue;
+                        }
+
+                        const float     t    = corners[i] / (corners[i] - corners[j]);
+                        const glm::vec3 from = { float(i & 1), float((i >> 1) & 1), float((i >> 2) & 1) };
+                        const glm::vec3 to   = { float(j & 1), float((j >> 1) & 1), float((j >> 2) & 1) };
+
+                        sum += from + (to - from) * t;
+                        count++;
+                    }
+                }
+
+                const glm::vec3 position = grid.point(base + glm::uvec3(x, y, z), sum / float(count));
+
+                cell_vertices[cell_index(x, y, z)] = uint32_t(out_mesh.positions.size());
+
+                out_mesh.positions.push_back(position);
+
+                // Cells with surface are always in evaluated leaves.
+                vertex_leaves.push_back(sampler.cell_leaves[cell_index(x, y, z)]);
+            }
+        }
+    }
+
+    sampler.compute_normals(out_mesh.positions, vertex_leaves, out_mesh.normals);
+
+    // One quad per grid edge crossed by the surface, joining the vertices of
+    // the four cells around it. The block owns the edges starting at its own
+    // points; edges on the grid's outer faces have no cells on one side.
+    for (uint32_t z = first.z; z < last.z; z++)
+    {
+        for (uint32_t y = first.y; y < last.y; y++)
+        {
+            for (uint32_t x = first.x; x < last.x; x++)
+            {
+                const glm::uvec3 point = { x, y, z };
+                const glm::uvec3 local = point - base;
+                const bool       below = samples[sample_index(local.x, local.y, local.z)] < 0.0f;
+
+                for (uint32_t a = 0; a < 3; a++)
+                {
+                    const uint32_t b = (a + 1) % 3;
+                    const uint32_t c = (a + 2) % 3;
+
+                    if (point[b] == 0 || point[c] == 0)
+                    {
+                        continue;
+                    }
+
+                    glm::uvec3 next = local;
+                    next[a]++;
+
+                    if (below == (samples[sample_index(next.x, next.y, next.z)] < 0.0f))
+                    {
+                        continue;
+                    }
+
+                    glm::uvec3 quad[4] = { local, local, local, local };
+
+                    quad[0][b]--;
+                    quad[0][c]--;
+                    quad[1][c]--;
+                    quad[3][b]--;
+
+                    uint32_t vertices[4];
+
+                    for (uint32_t i = 0; i < 4; i++)
+                    {
+                        vertices[i] = cell_vertices[cell_index(quad[i].x, quad[i].y, quad[i].z)];
+                    }
+
+                    // Counter-clockwise seen from +a; the outside is where the
+                    // field grows.
+                    if (below)
+                    {
+                        out_mesh.indices.insert(out_mesh.indices.end(), { vertices[0], vertices[1], vertices[2], vertices[0], vertices[2], vertices[3] });
+                    }
+                    else
+                    {
+                        out_mesh.indices.insert(out_mesh.indices.end(), { vertices[0], vertices[2], vertices[1], vertices[0], vertices[3], vertices[2] });
+                    }
+                }
+            }
+        }
+    }
+}
+
+void SdfMeshCache::begin()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    pass++;
+}
+
+void SdfMeshCache::retain(uint64_t mesh_key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    const auto mesh = meshes.find(mesh_key);
+
+    if (mesh == meshes.end())
+    {
+        return;
+    }
+
+    mesh->second.last_used = pass;
+
+    for (const uint64_t key : mesh->second.keys)
+    {
+        const auto block = blocks.find(key);
+
+        if (block != blocks.end())
+        {
+            block->second.last_used = pass;
+        }
+    }
+}
+
+void SdfMeshCache::evict_unused()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (auto it = blocks.begin(); it != blocks.end(); )
+    {
+        it = it->second.last_used == pass ? std::next(it) : blocks.erase(it);
+    }
+
+    for (auto it = meshes.begin(); it != meshes.end(); )
+    {
+        it = it->second.last_used == pass ? std::next(it) : meshes.erase(it);
+    }
+}
+
+void SdfMeshCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    blocks.clear();
+    meshes.clear();
+    pass = 0;
+}
+
+// Whole blocks of the lattice through the world origin covering the bounds.
+static void snap_to_blocks(const Aabb& bounds, float cell_size, glm::ivec3& out_first, glm::ivec3& out_last)
+{
+    const float block_size = cell_size * float(SDF_BLOCK_SIZE);
+
+    out_first = glm::ivec3(glm::floor(bounds.min / block_size));
+    out_last  = glm::max(glm::ivec3(glm::ceil(bounds.max / block_size)), out_first + 1);
+}
+
+Aabb snap_sdf_bounds(const Aabb& bounds, float cell_size)
+{
+    glm::ivec3 first, last;
+    snap_to_blocks(bounds, cell_size, first, last);
+
+    const float block_size = cell_size * float(SDF_BLOCK_SIZE);
+
+    Aabb snapped;
+    snapped.min = glm::vec3(first) * block_size;
+    snapped.max = glm::vec3(last ) * block_size;
+
+    return snapped;
+}
+
+SdfMeshStats mesh_sdf
+(
+    const SdfTree&    tree,
+    uint32_t          root,
+    const Aabb&       bounds,
+    float             cell_size,
+    Mesh&             out_mesh,
+    SdfMeshCache*     cache,
+    SdfGridSnap       snap,
+    uint64_t          mesh_key,
+    const TaskCancel* cancel
+)
+{
+    out_mesh.clear();
+
+    SdfGrid grid;
+    grid.cell_size = cell_size;
+
+    if (snap == SdfGridSnap::BLOCKS)
+    {
+        glm::ivec3 first, last;
+        snap_to_blocks(bounds, cell_size, first, last);
+
+        grid.offset = first * int(SDF_BLOCK_SIZE);
+        grid.cells  = glm::uvec3(last - first) * SDF_BLOCK_SIZE;
+    }
+    else
+    {
+        grid.origin = bounds.min;
+        grid.cells  = glm::max(glm::uvec3(glm::ceil(bounds.extent() / cell_size)), glm::uvec3(1));
+    }
+
+    const glm::uvec3 blocks      = (grid.cells + SDF_BLOCK_SIZE - 1u) / SDF_BLOCK_SIZE;
+    const uint32_t   block_count = blocks.x * blocks.y * blocks.z;
+
+    // Those taken from the cache are owned by it, which doesn't erase any
+    // until `evict_unused`.
+    std::vector<SdfBlockMesh>        meshed(block_count);
+    std::vector<const SdfBlockMesh*> block_meshes(block_count, nullptr);
+    std::vector<uint64_t>            block_keys(cache ? block_count : 0);
+    std::vector<uint8_t>             remeshed(block_count, 0);
+
+    parallel_for(0, block_count, 1, [&](uint32_t begin, uint32_t end)
+    {
+        SdfTree pruned;
+
+        for (uint32_t i = begin; i < end && !task_cancelled(cancel); i++)
+        {
+            const glm::uvec3 block = { i % blocks.x, (i / blocks.x) % blocks.y, i / (blocks.x * blocks.y) };
+            const glm::uvec3 first = block * SDF_BLOCK_SIZE;
+            const glm::uvec3 last  = glm::min(first + SDF_BLOCK_SIZE, grid.cells);
+
+            uint64_t key = 0;
+
+            // The region that `mesh_block` samples, with the same padding, and
+            // everything else its mesh depends on: where the block is on the
+            // lattice, and which of the grid's lower faces it's on, as no
+            // quads start there.
+            if (cache)
+            {
+                const float pad = grid.cell_size * 0.5f;
+
+                Aabb region;
+                region.min = grid.point(glm::max(first, glm::uvec3(1)) - 1u) - pad;
+                region.max = grid.point(last) + pad;
+
+                pruned.clear();
+
+                const glm::ivec3 lattice_first = glm::ivec3(first) + grid.offset;
+                const glm::uvec3 size          = last - first;
+                const glm::bvec3 lower_face    = glm::equal(first, glm::uvec3(0));
+
+                key = pruned.nodes[tree.prune(root, region, pruned)].hash;
+                key = fnv1a(&grid.origin   , sizeof(grid.origin   ), key);
+                key = fnv1a(&grid.cell_size, sizeof(grid.cell_size), key);
+                key = fnv1a(&lattice_first , sizeof(lattice_first ), key);
+                key = fnv1a(&size          , sizeof(size          ), key);
+                key = fnv1a(&lower_face    , sizeof(lower_face    ), key);
+
+                block_keys[i] = key;
+
+                std::lock_guard<std::mutex> lock(cache->mutex);
+
+                const auto found = cache->blocks.find(key);
+
+                if (found != cache->blocks.end())
+                {
+                    found->second.last_used = cache->pass;
+                    block_meshes[i]         = &found->second;
+
+                    continue;
+                }
+            }
+
+            mesh_block(tree, root, grid, first, last, meshed[i]);
+
+            block_meshes[i] = &meshed[i];
+            remeshed[i]     = 1;
+
+            if (cache)
+            {
+                std::lock_guard<std::mutex> lock(cache->mutex);
+
+                // Another call may have meshed the same block meanwhile.
+                const auto inserted = cache->blocks.try_emplace(key, std::move(meshed[i])).first;
+
+                inserted->second.last_used = cache->pass;
+                block_meshes[i]            = &inserted->second;
+            }
+        }
+    });
+
+    // Some blocks may be missing; the finished ones stay cached.
+    if (task_cancelled(cancel))
+    {
+        return SdfMeshStats();
+    }
+
+    if (cache && mesh_key != 0)
+    {
+        std::lock_guard<std::mutex> lock(cache->mutex);
+
+        SdfMeshCache::MeshBlocks& mesh = cache->meshes[mesh_key];
+        mesh.keys      = std::move(block_keys);
+        mesh.last_used = cache->pass;
+    }
+
+    // Concatenates the blocks in order and welds the copies of the vertices
+    // along block faces, which are bitwise identical.
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<uint32_t>  indices;
+    uint64_t               samples = 0;
+
+    for (uint32_t i = 0; i < block_count; i++)
+    {
+        const SdfBlockMesh& block  = *block_meshes[i];
+        const uint32_t      offset = uint32_t(positions.size());
+
+        samples += remeshed[i] ? block.samples : 0;
+
+        positions.insert(positions.end(), block.positions.begin(), block.positions.end());
+        normals  .insert(normals  .end(), block.normals  .begin(), block.normals  .end());
+
+        for (uint32_t index : block.indices)
+        {
+            indices.push_back(offset + index);
+        }
+    }
+
+    std::vector<uint32_t> remap(positions.size());
+
+    const size_t unique = meshopt_generateVertexRemap(
+        remap.data(),
+        indices.data(),
+        indices.size(),
+        positions.data(),
+        positions.size(),
+        sizeof(glm::vec3)
+    );
+
+    out_mesh.position_x.resize(unique);
+    out_mesh.position_y.resize(unique);
+    out_mesh.position_z.resize(unique);
+    out_mesh.resize_normals();
+
+    for (size_t i = 0; i < positions.size(); i++)
+    {
+        // Unreferenced vertices map to ~0u.
+        if (remap[i] < unique)
+        {
+            out_mesh.position_x[remap[i]] = positions[i].x;
+            out_mesh.position_y[remap[i]] = positions[i].y;
+            out_mesh.position_z[remap[i]] = positions[i].z;
+            out_mesh.normal_x  [remap[i]] = normals  [i].x;
+            out_mesh.normal_y  [remap[i]] = normals  [i].y;
+            out_mesh.normal_z  [remap[i]] = normals  [i].z;
+        }
+    }
+
+    out_mesh.indices.resize(indices.size());
+
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        out_mesh.indices[i] = remap[indices[i]];
+    }
+
+    SdfMeshStats stats;
+    stats.cells    = uint64_t(grid.cells.x) * grid.cells.y * grid.cells.z;
+    stats.samples  = samples;
+    stats.blocks   = block_count;
+    stats.remeshed = uint32_t(std::count(remeshed.begin(), remeshed.end(), 1));
+
+    return stats;
+}
+
+
+// -----------------------------------------------------------------------------
+// DUAL CONTOURING
+// -----------------------------------------------------------------------------
+
+// Regula falsi steps refining the linear estimates of the surface crossings
+// along cell edges; the vertices are only as sharp as the crossings.
+static const uint32_t SDF_CROSSING_STEPS = 2;
+
+// Eigenvalues of a QEF below this fraction of its largest are treated as zero,
+// so that nearly parallel planes don't fling the vertex along their crease.
+static const double SDF_QEF_EIGEN_RATIO = 0.1;
+
+// Quadratic error function: the sum of squared distances of a point to the
+// tangent planes at the surface crossings in a cell. In block-relative cell
+// units, and double precision, since simplification sums up many planes.
+struct SdfQef
+{
+    double   ata[6] = {}; // Of AᵀA, the upper triangle: xx, xy, xz, yy, yz, zz.
+    double   atb[3] = {};
+    double   btb    = 0.0;
+    double   sum[3] = {}; // Of the crossings, for the mass point.
+    uint32_t count  = 0;
+
+    void add(const glm::vec3& point, const glm::vec3& normal)
+    {
+        const double d = double(normal.x) * point.x + double(normal.y) * point.y + double(normal.z) * point.z;
+
+        ata[0] += double(normal.x) * normal.x;
+        ata[1] += double(normal.x) * normal.y;
+        ata[2] += double(normal.x) * normal.z;
+        ata[3] += double(normal.y) * normal.y;
+        ata[4] += double(normal.y) * normal.z;
+        ata[5] += double(normal.z) * normal.z;
+
+        for (int i = 0; i < 3; i++)
+        {
+            atb[i] += normal[i] * d;
+            sum[i] += point [i];
+        }
+
+        btb += d * d;
+        count++;
+    }
+
+    void add(const SdfQef& other)
+    {
+        for (int i = 0; i < 6; i++)
+        {
+            ata[i] += other.ata[i];
+        }
+
+        for (int i = 0; i < 3; i++)
+        {
+            atb[i] += other.atb[i];
+            sum[i] += other.sum[i];
+        }
+
+        btb   += other.btb;
+        count += other.count;
+    }
+
+    double error(const glm::vec3& point) const
+    {
+        const double x = point.x;
+        const double y = point.y;
+        const double z = point.z;
+
+        const double xax = ata[0] * x * x + ata[3] * y * y + ata[5] * z * z
+                         + 2.0 * (ata[1] * x * y + ata[2] * x * z + ata[4] * y * z);
+
+        return std::max(xax - 2.0 * (atb[0] * x + atb[1] * y + atb[2] * z) + btb, 0.0);
+    }
+
+    // Minimizer closest to the mass point, clamped to [min, max]. Solved by
+    // the truncated pseudo-inverse of AᵀA, whose eigenvectors come from Jacobi
+    // rotations, so that directions the planes don't constrain stay put.
+    glm::vec3 solve(const glm::vec3& min, const glm::vec3& max) const
+    {
+        double mass[3];
+
+        for (int i = 0; i < 3; i++)
+        {
+            mass[i] = sum[i] / count;
+        }
+
+        double a[3][3] =
+        {
+            { ata[0], ata[1], ata[2] },
+            { ata[1], ata[3], ata[4] },
+            { ata[2], ata[4], ata[5] },
+        };
+
+        double v[3][3] =
+        {
+            { 1.0, 0.0, 0.0 },
+            { 0.0, 1.0, 0.0 },
+            { 0.0, 0.0, 1.0 },
+        };
+
+        // Aᵀb - AᵀA m, so that the solution is an offset from the mass point.
+        double rhs[3];
+
+        for (int i = 0; i < 3; i++)
+        {
+            rhs[i] = atb[i] - (a[i][0] * mass[0] + a[i][1] * mass[1] + a[i][2] * mass[2]);
+        }
+
+        for (int sweep = 0; sweep < 8; sweep++)
+        {
+            for (int p = 0; p < 2; p++)
+            {
+                for (int q = p + 1; q < 3; q++)
+                {
+                    if (fabs(a[p][q]) < 1e-12)
+                    {
+                        continue;
+                    }
+
+                    const double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+                    const double t     = (theta < 0.0 ? -1.0 : 1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+                    const double c     = 1.0 / sqrt(t * t + 1.0);
+                    const double s     = t * c;
+
+                    a[p][p] -= t * a[p][q];
+                    a[q][q] += t * a[p][q];
+                    a[p][q]  = a[q][p] = 0.0;
+
+                    const int r = 3 - p - q;
+
+                    const double arp = a[r][p];
+                    const double arq = a[r][q];
+
+                    a[r][p] = a[p][r] = c * arp - s * arq;
+                    a[r][q] = a[q][r] = s * arp + c * arq;
+
+                    for (int k = 0; k < 3; k++)
+                    {
+                        const double vkp = v[k][p];
+                        const double vkq = v[k][q];
+
+                        v[k][p] = c * vkp - s * vkq;
+                        v[k][q] = s * vkp + c * vkq;
+                    }
+                }
+            }
+        }
+
+        const double largest = std::max({ a[0][0], a[1][1], a[2][2] });
+
+        glm::vec3 point;
+
+        for (int i = 0; i < 3; i++)
+        {
+            point[i] = float(mass[i]);
+        }
+
+        for (int i = 0; i < 3; i++)
+        {
+            if (a[i][i] <= largest * SDF_QEF_EIGEN_RATIO || a[i][i] <= 0.0)
+            {
+                continue;
+            }
+
+            const double along = (v[0][i] * rhs[0] + v[1][i] * rhs[1] + v[2][i] * rhs[2]) / a[i][i];
+
+            for (int k = 0; k < 3; k++)
+            {
+                point[k] += float(v[k][i] * along);
+            }
+        }
+
+        return glm::clamp(point, min, max);
+    }
+};
+
+// Bits of the corners, indexed by `x + 2y + 4z`, with samples inside.
+static uint32_t corner_signs(const SdfBlockSampler& sampler, const glm::uvec3& origin, uint32_t size)
+{
+    uint32_t corners = 0;
+
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        const glm::uvec3 corner = origin + glm::uvec3(i & 1, (i >> 1) & 1, (i >> 2) & 1) * size;
+
+        corners |= uint32_t(sampler.values[sampler.index(corner)] < 0.0f) << i;
+    }
+
+    return corners;
+}
+
+// Whether the corners inside, and those outside, are each connected along the
+// cube's edges, so that the surface crosses the cube as a single sheet.
+static bool is_single_sheet(uint32_t corners)
+{
+    // Corners whose index has the bit of the axis set.
+    static const uint32_t upper[3] = { 0xaa, 0xcc, 0xf0 };
+
+    for (uint32_t set : { corners, ~corners & 0xffu })
+    {
+        if (set == 0)
+        {
+            continue;
+        }
+
+        uint32_t reached = set & (0u - set);
+
+        for (;;)
+        {
+            uint32_t grown = reached;
+
+            for (uint32_t axis = 0; axis < 3; axis++)
+            {
+                grown |= ((reached & ~upper[axis]) << (1u << axis)) | ((reached & upper[axis]) >> (1u << axis));
+            }
+
+            grown &= set;
+
+            if (grown == reached)
+            {
+                break;
+            }
+
+            reached = grown;
+        }
+
+        if (reached != set)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// The topology test of Ju et al.: the sign at the middle of each edge and face
+// of a node, and at its center, agrees with at least one of the corners of that
+// edge, face or cube. Nodes merged only when it holds have at most one sign
+// change along every edge, so the contour between leaves of different sizes
+// stays closed.
+static bool is_topology_safe(const SdfBlockSampler& sampler, const glm::uvec3& origin, uint32_t size)
+{
+    const uint32_t half = size / 2;
+
+    for (uint32_t i = 0; i < 27; i++)
+    {
+        // Per axis, 0 at the low side, 1 in the middle and 2 at the high side.
+        const glm::uvec3 digits = { i % 3, (i / 3) % 3, i / 9 };
+
+        if (digits.x != 1 && digits.y != 1 && digits.z != 1)
+        {
+            continue;
+        }
+
+        bool any_inside  = false;
+        bool any_outside = false;
+
+        for (uint32_t corner = 0; corner < 8; corner++)
+        {
+            const glm::uvec3 bits = { corner & 1, (corner >> 1) & 1, (corner >> 2) & 1 };
+
+            if ((digits.x != 1 && digits.x != bits.x * 2) ||
+                (digits.y != 1 && digits.y != bits.y * 2) ||
+                (digits.z != 1 && digits.z != bits.z * 2))
+            {
+                continue;
+            }
+
+            const bool inside = sampler.values[sampler.index(origin + bits * size)] < 0.0f;
+
+            any_inside  |=  inside;
+            any_outside |= !inside;
+        }
+
+        const bool inside = sampler.values[sampler.index(origin + digits * half)] < 0.0f;
+
+        if (inside ? !any_inside : !any_outside)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+struct SdfContourNode
+{
+    SdfQef    qef;
+    glm::vec3 vertex  = glm::vec3(0.0f); // Block-relative, in cells; if crossed.
+    uint32_t  corners = 0;               // See `corner_signs`.
+    bool      leaf    = false;           // A cell, or a node simplified to one.
+};
+
+// A block's share of the mesh: the vertices of the leaves of its simplified
+// octree, and for each of its cells, the vertex of the leaf containing it.
+struct SdfContourBlock
+{
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<uint32_t>  cell_vertices; // Empty without surface.
+    std::vector<float>     values;        // At the cells' corners.
+    std::vector<uint32_t>  indices;
+    uint32_t               offset  = 0;   // Of the first vertex, in the mesh.
+    uint64_t               samples = 0;   // Evaluated.
+};
+
+// Samples the cells of the block at `first`, places a vertex in each cell with
+// surface from the hermite data of its edges, then merges the octree bottom up
+// wherever the merged vertex fits all the planes within `max_error`.
+static void contour_block
+(
+    const SdfTree&    tree,
+    uint32_t          root,
+    const SdfGrid&    grid,
+    const glm::uvec3& first,
+    float             max_error,
+    SdfContourBlock&  out_block
+)
+{
+    const uint32_t size = SDF_BLOCK_SIZE;
+
+    SdfBlockSampler sampler;
+    sampler.grid = &grid;
+    sampler.base = first;
+    sampler.size = glm::uvec3(size + 1);
+
+    const size_t point_count = size_t(size + 1) * (size + 1) * (size + 1);
+    const size_t cell_count  = size_t(size) * size * size;
+
+    sampler.values     .resize(point_count);
+    sampler.states     .resize(point_count, SdfSampleState::UNSET);
+    sampler.trees      .resize(8);
+    sampler.cell_leaves.resize(cell_count, UINT32_MAX);
+
+    sampler.sample(tree, root, glm::uvec3(0), glm::uvec3(size), 0);
+
+    out_block.samples = sampler.evaluated;
+
+    // All signs alike, so no surface.
+    if (sampler.evaluated == 0)
+    {
+        return;
+    }
+
+    // Hermite data: the crossings of the edges with sign changes, each refined
+    // with the tape of the leaf of a cell around it, where the gradient gives
+    // the normal. Leaves give the same results on the faces they share.
+    struct Crossing
+    {
+        glm::uvec3 point;       // Lower end of the edge.
+        uint32_t   axis;
+        float      lower;       // Bracket along the edge, in [0, 1].
+        float      upper;
+        float      lower_value;
+        float      upper_value;
+        float      t;
+    };
+
+    std::vector<Crossing>  crossings;
+    std::vector<uint32_t>  crossing_leaves;
+    std::vector<glm::vec3> points;
+    std::vector<float>     values;
+    std::vector<glm::vec3> gradients;
+
+    for (uint32_t z = 0; z <= size; z++)
+    {
+        for (uint32_t y = 0; y <= size; y++)
+        {
+            for (uint32_t x = 0; x <= size; x++)
+            {
+                const glm::uvec3 point = { x, y, z };
+                const float      value = sampler.values[sampler.index(point)];
+
+                for (uint32_t axis = 0; axis < 3; axis++)
+                {
+                    if (point[axis] == size)
+                    {
+                        continue;
+                    }
+
+                    glm::uvec3 next = point;
+                    next[axis]++;
+
+                    const float next_value = sampler.values[sampler.index(next)];
+
+                    if ((value < 0.0f) == (next_value < 0.0f))
+                    {
+                        continue;
+                    }
+
+                    const uint32_t leaf = sampler.cell_leaves[sampler.cell_index(glm::min(point, glm::uvec3(size - 1)))];
+
+                    if (leaf == UINT32_MAX)
+                    {
+                        continue;
+                    }
+
+                    crossings.push_back({ point, axis, 0.0f, 1.0f, value, next_value, value / (value - next_value) });
+                    crossing_leaves.push_back(leaf);
+                }
+            }
+        }
+    }
+
+    for (uint32_t step = 0; ; step++)
+    {
+        points.clear();
+
+        for (const Crossing& crossing : crossings)
+        {
+            glm::vec3 offset = glm::vec3(0.0f);
+            offset[crossing.axis] = crossing.t * grid.cell_size;
+
+            points.push_back(grid.point(first + crossing.point) + offset);
+        }
+
+        sampler.evaluate_gradients(points, crossing_leaves, values, gradients);
+
+        if (step == SDF_CROSSING_STEPS)
+        {
+            break;
+        }
+
+        for (size_t i = 0; i < crossings.size(); i++)
+        {
+            Crossing& crossing = crossings[i];
+
+            if ((values[i] < 0.0f) == (crossing.lower_value < 0.0f))
+            {
+                crossing.lower       = crossing.t;
+                crossing.lower_value = values[i];
+            }
+            else
+            {
+                crossing.upper       = crossing.t;
+                crossing.upper_value = values[i];
+            }
+
+            crossing.t = crossing.lower + (crossing.upper - crossing.lower) * crossing.lower_value / (crossing.lower_value - crossing.upper_value);
+        }
+    }
+
+    // The leaves of the octree, a level per power of two, from the cells up.
+    uint32_t level_count = 1;
+
+    while ((1u << (level_count - 1)) < size)
+    {
+        level_count++;
+    }
+
+    std::vector<std::vector<SdfContourNode>> levels(level_count);
+
+    levels[0].resize(cell_count);
+
+    for (size_t i = 0; i < crossings.size(); i++)
+    {
+        const Crossing& crossing = crossings[i];
+        const uint32_t  b        = (crossing.axis + 1) % 3;
+        const uint32_t  c        = (crossing.axis + 2) % 3;
+        const float     length   = glm::length(gradients[i]);
+
+        glm::vec3 point = glm::vec3(crossing.point);
+        point[crossing.axis] += crossing.t;
+
+        const glm::vec3 normal = length > 0.0f ? gradients[i] / length : glm::vec3(0.0f);
+
+        // Into the up to four cells around the edge.
+        for (uint32_t around = 0; around < 4; around++)
+        {
+            glm::uvec3 cell = crossing.point;
+
+            if (around & 1)
+            {
+                cell[b]--;
+            }
+
+            if (around & 2)
+            {
+                cell[c]--;
+            }
+
+            if (cell[b] < size && cell[c] < size)
+            {
+                levels[0][sampler.cell_index(cell)].qef.add(point, normal);
+            }
+        }
+    }
+
+    for (uint32_t z = 0; z < size; z++)
+    {
+        for (uint32_t y = 0; y < size; y++)
+        {
+            for (uint32_t x = 0; x < size; x++)
+            {
+                const glm::uvec3 cell = { x, y, z };
+                SdfContourNode&  node = levels[0][sampler.cell_index(cell)];
+
+                node.corners = corner_signs(sampler, cell, 1);
+                node.leaf    = true;
+
+                if (node.qef.count > 0)
+                {
+                    node.vertex = node.qef.solve(glm::vec3(cell), glm::vec3(cell + 1u));
+                }
+            }
+        }
+    }
+
+    for (uint32_t level = 1; level < level_count; level++)
+    {
+        const std::vector<SdfContourNode>& children  = levels[level - 1];
+        const uint32_t                     count     = size >> level;
+        const uint32_t                     node_size = 1u << level;
+
+        levels[level].resize(size_t(count) * count * count);
+
+        for (uint32_t z = 0; z < count; z++)
+        {
+            for (uint32_t y = 0; y < count; y++)
+            {
+                for (uint32_t x = 0; x < count; x++)
+                {
+                    const glm::uvec3 index  = { x, y, z };
+                    SdfContourNode&  node   = levels[level][(size_t(z) * count + y) * count + x];
+                    bool             merged = true;
+
+                    for (uint32_t i = 0; i < 8; i++)
+                    {
+                        const glm::uvec3      child_index = index * 2u + glm::uvec3(i & 1, (i >> 1) & 1, (i >> 2) & 1);
+                        const SdfContourNode& child       = children[(size_t(child_index.z) * count * 2 + child_index.y) * count * 2 + child_index.x];
+
+                        node.qef.add(child.qef);
+                        node.corners |= child.corners & (1u << i);
+
+                        merged = merged && child.leaf && is_single_sheet(child.corners);
+                    }
+
+                    const glm::uvec3 origin = index * node_size;
+
+                    merged = merged && is_single_sheet(node.corners) && is_topology_safe(sampler, origin, node_size);
+
+                    if (merged && node.qef.count > 0)
+                    {
+                        node.vertex = node.qef.solve(glm::vec3(origin), glm::vec3(origin + node_size));
+                        merged      = node.qef.error(node.vertex) <= max_error;
+                    }
+
+                    node.leaf = merged;
+                }
+            }
+        }
+    }
+
+    // Vertices of the leaves with surface, from the root down; each cell refers
+    // to the vertex of its leaf.
+    out_block.cell_vertices.resize(cell_count, UINT32_MAX);
+
+    const auto add_leaf = [&](const SdfContourNode& node, const glm::uvec3& origin, uint32_t node_size)
+    {
+        if (node.qef.count == 0)
+        {
+            return;
+        }
+
+        const uint32_t vertex = uint32_t(out_block.positions.size());
+
+        out_block.positions.push_back(grid.point(first, node.vertex));
+
+        for (uint32_t z = origin.z; z < origin.z + node_size; z++)
+        {
+            for (uint32_t y = origin.y; y < origin.y + node_size; y++)
+            {
+                for (uint32_t x = origin.x; x < origin.x + node_size; x++)
+                {
+                    out_block.cell_vertices[sampler.cell_index({ x, y, z })] = vertex;
+                }
+            }
+        }
+    };
+
+    std::vector<std::pair<uint32_t, glm::uvec3>> stack = { { level_count - 1, glm::uvec3(0) } };
+
+    while (!stack.empty())
+    {
+        const auto [level, index] = stack.back();
+        stack.pop_back();
+
+        const uint32_t        count = size >> level;
+        const SdfContourNode& node  = levels[level][(size_t(index.z) * count + index.y) * count + index.x];
+
+        if (node.leaf)
+        {
+            add_leaf(node, index << level, 1u << level);
+
+            continue;
+        }
+
+        for (uint32_t i = 0; i < 8; i++)
+        {
+            stack.push_back({ level - 1, index * 2u + glm::uvec3(i & 1, (i >> 1) & 1, (i >> 2) & 1) });
+        }
+    }
+
+    // Normals from the tape of the whole block, as merged vertices may sit in
+    // cells whose leaves were never evaluated.
+    const float pad = grid.cell_size * 0.5f;
+
+    Aabb region;
+    region.min = grid.point(first) - pad;
+    region.max = grid.point(first + size) + pad;
+
+    SdfTree& pruned = sampler.trees[0];
+    pruned.clear();
+
+    sampler.leaves.emplace_back().compile(pruned, tree.prune(root, region, pruned));
+
+    const std::vector<uint32_t> vertex_leaves(out_block.positions.size(), uint32_t(sampler.leaves.size() - 1));
+
+    sampler.compute_normals(out_block.positions, vertex_leaves, out_block.normals);
+
+    out_block.values = std::move(sampler.values);
+}
+
+// Triangles of the grid edges crossed by the surface that start at points of
+// the block at `block`, joining the vertices of the leaves of the four cells
+// around each, which may be in neighbor blocks. Where cells share a leaf, the
+// quad degenerates into a triangle, or nothing.
+static void contour_block_edges
+(
+    const glm::uvec3&                   blocks,
+    const std::vector<SdfContourBlock>& block_meshes,
+    const glm::uvec3&                   block,
+    std::vector<uint32_t>&              out_indices
+)
+{
+    const uint32_t         size  = SDF_BLOCK_SIZE;
+    const SdfContourBlock& own   = block_meshes[(size_t(block.z) * blocks.y + block.y) * blocks.x + block.x];
+    const glm::uvec3       first = block * size;
+
+    if (own.cell_vertices.empty())
+    {
+        return;
+    }
+
+    const auto sample = [&](const glm::uvec3& point)
+    {
+        return own.values[(size_t(point.z) * (size + 1) + point.y) * (size + 1) + point.x];
+    };
+
+    const auto cell_vertex = [&](const glm::uvec3& cell)
+    {
+        const glm::uvec3       local    = cell % size;
+        const glm::uvec3       in_block = cell / size;
+        const SdfContourBlock& mesh     = block_meshes[(size_t(in_block.z) * blocks.y + in_block.y) * blocks.x + in_block.x];
+
+        if (mesh.cell_vertices.empty())
+        {
+            return UINT32_MAX;
+        }
+
+        const uint32_t vertex = mesh.cell_vertices[(size_t(local.z) * size + local.y) * size + local.x];
+
+        return vertex == UINT32_MAX ? UINT32_MAX : mesh.offset + vertex;
+    };
+
+    const auto add_triangle = [&](uint32_t a, uint32_t b, uint32_t c)
+    {
+        if (a != b && b != c && c != a)
+        {
+            out_indices.insert(out_indices.end(), { a, b, c });
+        }
+    };
+
+    for (uint32_t z = 0; z < size; z++)
+    {
+        for (uint32_t y = 0; y < size; y++)
+        {
+            for (uint32_t x = 0; x < size; x++)
+            {
+                const glm::uvec3 local = { x, y, z };
+                const glm::uvec3 point = first + local;
+                const bool       below = sample(local) < 0.0f;
+
+                for (uint32_t a = 0; a < 3; a++)
+                {
+                    const uint32_t b = (a + 1) % 3;
+                    const uint32_t c = (a + 2) % 3;
+
+                    if (point[b] == 0 || point[c] == 0)
+                    {
+                        continue;
+                    }
+
+                    glm::uvec3 next = local;
+                    next[a]++;
+
+                    if (below == (sample(next) < 0.0f))
+                    {
+                        continue;
+                    }
+
+                    glm::uvec3 quad[4] = { point, point, point, point };
+
+                    quad[0][b]--;
+                    quad[0][c]--;
+                    quad[1][c]--;
+                    quad[3][b]--;
+
+                    uint32_t vertices[4];
+                    bool     complete = true;
+
+                    for (uint32_t i = 0; i < 4; i++)
+                    {
+                        vertices[i] = cell_vertex(quad[i]);
+                        complete    = complete && vertices[i] != UINT32_MAX;
+                    }
+
+                    // Only where blocks disagree on a shared sign by rounding.
+                    if (!complete)
+                    {
+                        continue;
+                    }
+
+                    // Same winding as `mesh_block`.
+                    if (below)
+                    {
+                        add_triangle(vertices[0], vertices[1], vertices[2]);
+                        add_triangle(vertices[0], vertices[2], vertices[3]);
+                    }
+                    else
+                    {
+                        add_triangle(vertices[0], vertices[2], vertices[1]);
+                        add_triangle(vertices[0], vertices[3], vertices[2]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+SdfMeshStats contour_sdf
+(
+    const SdfTree&    tree,
+    uint32_t          root,
+    const Aabb&       bounds,
+    float             cell_size,
+    float             tolerance,
+    Mesh&             out_mesh,
+    const TaskCancel* cancel
+)
+{
+    out_mesh.clear();
+
+    const glm::uvec3 cells  = glm::max(glm::uvec3(glm::ceil(bounds.extent() / cell_size)), glm::uvec3(1));
+    const glm::uvec3 blocks = (cells + SDF_BLOCK_SIZE - 1u) / SDF_BLOCK_SIZE;
+
+    // Rounded up to whole blocks, the roots of the octrees.
+    SdfGrid grid;
+    grid.origin    = bounds.min;
+    grid.cell_size = cell_size;
+    grid.cells     = blocks * SDF_BLOCK_SIZE;
+
+    const uint32_t block_count = blocks.x * blocks.y * blocks.z;
+    const auto     block_of    = [&](uint32_t i)
+    {
+        return glm::uvec3(i % blocks.x, (i / blocks.x) % blocks.y, i / (blocks.x * blocks.y));
+    };
+
+    // The error is a sum of squared distances, in cells.
+    const float max_error = (tolerance / cell_size) * (tolerance / cell_size);
+
+    std::vector<SdfContourBlock> block_meshes(block_count);
+
+    parallel_for(0, block_count, 1, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t i = begin; i < end && !task_cancelled(cancel); i++)
+        {
+            contour_block(tree, root, grid, block_of(i) * SDF_BLOCK_SIZE, max_error, block_meshes[i]);
+        }
+    });
+
+    // Some blocks may be missing.
+    if (task_cancelled(cancel))
+    {
+        return SdfMeshStats();
+    }
+
+    uint32_t vertex_count = 0;
+    uint64_t samples      = 0;
+
+    for (SdfContourBlock& block : block_meshes)
+    {
+        block.offset  = vertex_count;
+        vertex_count += uint32_t(block.positions.size());
+        samples      += block.samples;
+    }
+
+    parallel_for(0, block_count, 1, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t i = begin; i < end; i++)
+        {
+            contour_block_edges(blocks, block_meshes, block_of(i), block_meshes[i].indices);
+        }
+    });
+
+    // Leaves along the grid's outer faces may have no triangles; those are
+    // dropped, and the rest keep their order.
+    std::vector<bool> referenced(vertex_count, false);
+
+    for (const SdfContourBlock& block : block_meshes)
+    {
+        for (uint32_t index : block.indices)
+        {
+            referenced[index] = true;
+        }
+    }
+
+    std::vector<uint32_t> remap(vertex_count, UINT32_MAX);
+    uint32_t              unique = 0;
+
+    for (uint32_t i = 0; i < vertex_count; i++)
+    {
+        if (referenced[i])
+        {
+            remap[i] = unique++;
+        }
+    }
+
+    out_mesh.position_x.resize(unique);
+    out_mesh.position_y.resize(unique);
+    out_mesh.position_z.resize(unique);
+    out_mesh.resize_normals();
+
+    for (const SdfContourBlock& block : block_meshes)
+    {
+        for (size_t i = 0; i < block.positions.size(); i++)
+        {
+            const uint32_t index = remap[block.offset + i];
+
+            if (index < unique)
+            {
+                out_mesh.position_x[index] = block.positions[i].x;
+                out_mesh.position_y[index] = block.positions[i].y;
+                out_mesh.position_z[index] = block.positions[i].z;
+                out_mesh.normal_x  [index] = block.normals  [i].x;
+                out_mesh.normal_y  [index] = block.normals  [i].y;
+                out_mesh.normal_z  [index] = block.normals  [i].z;
+            }
+        }
+
+        for (uint32_t index : block.indices)
+        {
+            out_mesh.indices.push_back(remap[index]);
+        }
+    }
+
+    SdfMeshStats stats;
+    stats.cells    = uint64_t(grid.cells.x) * grid.cells.y * grid.cells.z;
+    stats.samples  = samples;
+    stats.blocks   = block_count;
+    stats.remeshed = block_count;
+
+    return stats;
+}
+
+
+// -----------------------------------------------------------------------------
+// BRICK MAPS
+// -----------------------------------------------------------------------------
+
+// Quantization step: samples are in units of `band / SDF_BRICK_SCALE`.
+static const float SDF_BRICK_SCALE = 32767.0f;
+
+// Bricks of one page, sampled by octree subdivision over them: regions whose
+// interval is beyond the band are filled with their side, and single bricks
+// are evaluated with the tape of the tree pruned to them, which gives the same
+// results there as the whole tree's, so the points shared with neighbor bricks
+// come out identical.
+struct SdfBrickPage
+{
+    const SdfBrickMap*    map  = nullptr;
+    glm::uvec3            base = glm::uvec3(0); // First brick of the page.
+    std::vector<uint32_t> slots;                // Index into `samples`, or `INSIDE` / `OUTSIDE`.
+    std::vector<int16_t>  samples;
+    std::vector<SdfTree>  trees;                // Pruned, per octree level.
+
+    SdfTape               tape;
+    std::vector<float>    batch_x;
+    std::vector<float>    batch_y;
+    std::vector<float>    batch_z;
+    std::vector<float>    batch_values;
+    std::vector<float>    registers;
+
+    glm::vec3 point(const glm::uvec3& index) const
+    {
+        return map->origin + glm::vec3(index) * map->cell_size;
+    }
+
+    uint32_t& slot(const glm::uvec3& brick)
+    {
+        return slots[(brick.z * SdfBrickMap::PAGE_SIZE + brick.y) * SdfBrickMap::PAGE_SIZE + brick.x];
+    }
+
+    // Of the bricks in [first, last), relative to `base`.
+    void sample(const SdfTree& tree, uint32_t root, const glm::uvec3& first, const glm::uvec3& last, uint32_t level)
+    {
+        const float pad = map->cell_size * 0.5f;
+
+        Aabb region;
+        region.min = point((base + first) * SdfBrickMap::BRICK_CELLS) - pad;
+        region.max = point((base + last ) * SdfBrickMap::BRICK_CELLS) + pad;
+
+        const SdfInterval interval = tree.evaluate_interval(root, region);
+
+        if (interval.min > map->band || interval.max < -map->band)
+        {
+            for (uint32_t z = first.z; z < last.z; z++)
+            {
+                for (uint32_t y = first.y; y < last.y; y++)
+                {
+                    for (uint32_t x = first.x; x < last.x; x++)
+                    {
+                        slot({ x, y, z }) = interval.min > map->band ? SdfBrickMap::OUTSIDE : SdfBrickMap::INSIDE;
+                    }
+                }
+            }
+
+            return;
+        }
+
+        SdfTree& pruned = trees[level];
+        pruned.clear();
+
+        const uint32_t   pruned_root = tree.prune(root, region, pruned);
+        const glm::uvec3 bricks      = last - first;
+
+        if (bricks.x == 1 && bricks.y == 1 && bricks.z == 1)
+        {
+            sample_brick(pruned, pruned_root, first);
+
+            return;
+        }
+
+        const glm::uvec3 middle = first + (bricks + 1u) / 2u;
+
+        for (uint32_t child = 0; child < 8; child++)
+        {
+            glm::uvec3 child_first = first;
+            glm::uvec3 child_last  = last;
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                (child & (1 << axis) ? child_first : child_last)[axis] = middle[axis];
+            }
+
+            if (glm::all(glm::lessThan(child_first, child_last)))
+            {
+                sample(pruned, pruned_root, child_first, child_last, level + 1);
+            }
+        }
+    }
+
+    void sample_brick(const SdfTree& tree, uint32_t root, const glm::uvec3& brick)
+    {
+        const glm::uvec3 first = (base + brick) * SdfBrickMap::BRICK_CELLS;
+
+        batch_x.clear();
+        batch_y.clear();
+        batch_z.clear();
+
+        for (uint32_t z = 0; z < SdfBrickMap::BRICK_SIZE; z++)
+        {
+            for (uint32_t y = 0; y < SdfBrickMap::BRICK_SIZE; y++)
+            {
+                for (uint32_t x = 0; x < SdfBrickMap::BRICK_SIZE; x++)
+                {
+                    const glm::vec3 position = point(first + glm::uvec3(x, y, z));
+
+                    batch_x.push_back(position.x);
+                    batch_y.push_back(position.y);
+                    batch_z.push_back(position.z);
+                }
+            }
+        }
+
+        batch_values.resize(SdfBrickMap::BRICK_AREA);
+
+        tape.compile(tree, root);
+        tape.evaluate({ batch_x.data(), batch_y.data(), batch_z.data() }, SdfBrickMap::BRICK_AREA, batch_values.data(), registers);
+
+        // The interval may well have been too wide.
+        const auto [min, max] = std::minmax_element(batch_values.begin(), batch_values.end());
+
+        if (*min > map->band || *max < -map->band)
+        {
+            slot(brick) = *min > map->band ? SdfBrickMap::OUTSIDE : SdfBrickMap::INSIDE;
+
+            return;
+        }
+
+        slot(brick) = uint32_t(samples.size() / SdfBrickMap::BRICK_AREA);
+
+        const float scale = SDF_BRICK_SCALE / map->band;
+
+        // Keeping the signs, which decide the surface's topology.
+        for (const float value : batch_values)
+        {
+            const long quantized = lrintf(std::clamp(value * scale, -SDF_BRICK_SCALE, SDF_BRICK_SCALE));
+
+            samples.push_back(int16_t(value < 0.0f ? std::min(quantized, -1l) : quantized));
+        }
+    }
+};
+
+void SdfBrickMap::build(const SdfTree& tree, uint32_t root, const Aabb& bounds, float grid_cell_size, float requested_band, const TaskCancel* cancel)
+{
+    const glm::uvec3 cells = glm::max(glm::uvec3(glm::ceil(bounds.extent() / grid_cell_size)), glm::uvec3(1));
+
+    origin    = bounds.min;
+    cell_size = grid_cell_size;
+    band      = std::max(requested_band, grid_cell_size * 2.0f);
+    bricks    = (cells + BRICK_CELLS - 1u) / BRICK_CELLS;
+    pages     = (bricks + PAGE_SIZE - 1u) / PAGE_SIZE;
+
+    const uint32_t page_count = pages.x * pages.y * pages.z;
+
+    std::vector<SdfBrickPage> sampled(page_count);
+
+    parallel_for(0, page_count, 1, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t i = begin; i < end && !task_cancelled(cancel); i++)
+        {
+            const glm::uvec3 page = { i % pages.x, (i / pages.x) % pages.y, i / (pages.x * pages.y) };
+
+            SdfBrickPage& sampler = sampled[i];
+            sampler.map  = this;
+            sampler.base = page * PAGE_SIZE;
+            sampler.slots.resize(PAGE_AREA, OUTSIDE);
+            sampler.trees.resize(4);
+
+            sampler.sample(tree, root, glm::uvec3(0), glm::min(bricks - sampler.base, glm::uvec3(PAGE_SIZE)), 0);
+
+            // Done with them; only the slots and samples are gathered.
+            sampler.trees.clear();
+            sampler.trees.shrink_to_fit();
+        }
+    });
+
+    if (task_cancelled(cancel))
+    {
+        clear();
+
+        return;
+    }
+
+    // Pages without stored bricks that are all on one side take no slots.
+    page_table.assign(page_count, OUTSIDE);
+    slots     .clear();
+    samples   .clear();
+
+    for (uint32_t i = 0; i < page_count; i++)
+    {
+        SdfBrickPage&    page = sampled[i];
+        const glm::uvec3 last = glm::min(bricks - page.base, glm::uvec3(PAGE_SIZE));
+
+        bool inside  = true;
+        bool outside = true;
+
+        for (uint32_t z = 0; z < last.z; z++)
+        {
+            for (uint32_t y = 0; y < last.y; y++)
+            {
+                for (uint32_t x = 0; x < last.x; x++)
+                {
+                    inside  &= page.slot({ x, y, z }) == INSIDE;
+                    outside &= page.slot({ x, y, z }) == OUTSIDE;
+                }
+            }
+        }
+
+        if (inside || outside)
+        {
+            page_table[i] = inside ? INSIDE : OUTSIDE;
+
+            continue;
+        }
+
+        const uint32_t first_brick = brick_count();
+
+        page_table[i] = uint32_t(slots.size());
+
+        for (const uint32_t slot : page.slots)
+        {
+            slots.push_back(slot < INSIDE ? first_brick + slot : slot);
+        }
+
+        samples.insert(samples.end(), page.samples.begin(), page.samples.end());
+    }
+}
+
+uint32_t SdfBrickMap::find(const glm::uvec3& brick) const
+{
+    const glm::uvec3 page  = brick / PAGE_SIZE;
+    const uint32_t   entry = page_table[(page.z * pages.y + page.y) * pages.x + page.x];
+
+    if (entry >= INSIDE)
+    {
+        return entry;
+    }
+
+    const glm::uvec3 local = brick % PAGE_SIZE;
+
+    return slots[entry + (local.z * PAGE_SIZE + local.y) * PAGE_SIZE + local.x];
+}
+
+float SdfBrickMap::distance(const glm::vec3& point) const
+{
+    const glm::vec3  grid  = glm::clamp((point - origin) / cell_size, glm::vec3(0.0f), glm::vec3(bricks * BRICK_CELLS));
+    const glm::uvec3 brick = glm::min(glm::uvec3(grid / float(BRICK_CELLS)), bricks - 1u);
+    const uint32_t   index = find(brick);
+
+    if (index >= INSIDE)
+    {
+        return index == INSIDE ? -band : band;
+    }
+
+    const glm::vec3  local = grid - glm::vec3(brick * BRICK_CELLS);
+    const glm::uvec3 cell  = glm::min(glm::uvec3(local), glm::uvec3(BRICK_CELLS - 1));
+    const glm::vec3  t     = local - glm::vec3(cell);
+
+    constexpr uint32_t dy = BRICK_SIZE;
+    constexpr uint32_t dz = BRICK_SIZE * BRICK_SIZE;
+
+    const int16_t* s = &samples[size_t(index) * BRICK_AREA + cell.z * dz + cell.y * dy + cell.x];
+
+    const float c00 = glm::mix(float(s[0      ]), float(s[1          ]), t.x);
+    const float c10 = glm::mix(float(s[dy     ]), float(s[dy + 1     ]), t.x);
+    const float c01 = glm::mix(float(s[dz     ]), float(s[dz + 1     ]), t.x);
+    const float c11 = glm::mix(float(s[dz + dy]), float(s[dz + dy + 1]), t.x);
+
+    return glm::mix(glm::mix(c00, c10, t.y), glm::mix(c01, c11, t.y), t.z) * (band / SDF_BRICK_SCALE);
+}
+
+size_t SdfBrickMap::memory_usage() const
+{
+    return page_table.capacity() * sizeof(uint32_t) + slots.capacity() * sizeof(uint32_t) + samples.capacity() * sizeof(int16_t);
+}
+
+void SdfBrickMap::clear()
+{
+    origin    = glm::vec3(0.0f);
+    cell_size = 0.0f;
+    band      = 0.0f;
+    bricks    = glm::uvec3(0);
+    pages     = glm::uvec3(0);
+
+    page_table.clear();
+    slots     .clear();
+    samples   .clear();
+}
+
+SdfMeshStats mesh_brick_map(const SdfBrickMap& map, Mesh& out_mesh)
+{
+    using Map = SdfBrickMap;
+
+    constexpr uint32_t CELL_AREA = Map::BRICK_CELLS * Map::BRICK_CELLS * Map::BRICK_CELLS;
+
+    out_mesh.clear();
+
+    // Coordinates of the stored bricks, by index.
+    std::vector<glm::uvec3> stored(map.brick_count());
+
+    for (uint32_t z = 0; z < map.bricks.z; z++)
+    {
+        for (uint32_t y = 0; y < map.bricks.y; y++)
+        {
+            for (uint32_t x = 0; x < map.bricks.x; x++)
+            {
+                const uint32_t index = map.find({ x, y, z });
+
+                if (index < Map::INSIDE)
+                {
+                    stored[index] = { x, y, z };
+                }
+            }
+        }
+    }
+
+    const uint32_t brick_count = uint32_t(stored.size());
+
+    const auto sample = [&](uint32_t brick, const glm::uvec3& point)
+    {
+        return float(map.samples[size_t(brick) * Map::BRICK_AREA + (point.z * Map::BRICK_SIZE + point.y) * Map::BRICK_SIZE + point.x]);
+    };
+
+    const auto local_cell_index = [](const glm::uvec3& cell)
+    {
+        return (cell.z * Map::BRICK_CELLS + cell.y) * Map::BRICK_CELLS + cell.x;
+    };
+
+    // One vertex per cell crossed by the surface, as in `mesh_block`. Every
+    // such cell is in a stored brick, the band being wider than its diagonal.
+    std::vector<SdfBlockMesh> meshes(brick_count);
+    std::vector<uint32_t>     cell_vertices(size_t(brick_count) * CELL_AREA, UINT32_MAX);
+
+    parallel_for(0, brick_count, 1, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t i = begin; i < end; i++)
+        {
+            SdfBlockMesh& mesh = meshes[i];
+
+            for (uint32_t z = 0; z < Map::BRICK_CELLS; z++)
+            {
+                for (uint32_t y = 0; y < Map::BRICK_CELLS; y++)
+                {
+                    for (uint32_t x = 0; x < Map::BRICK_CELLS; x++)
+                    {
+                        float    corners[8];
+                        uint32_t inside = 0;
+
+                        for (uint32_t j = 0; j < 8; j++)
+                        {
+                            corners[j] = sample(i, { x + (j & 1), y + ((j >> 1) & 1), z + ((j >> 2) & 1) });
+                            inside    |= uint32_t(corners[j] < 0.0f) << j;
+                        }
+
+                        if (inside == 0 || inside == 0xff)
+                        {
+                            continue;
+                        }
+
+                        glm::vec3 sum   = glm::vec3(0.0f);
+                        uint32_t  count = 0;
+
+                        for (uint32_t j = 0; j < 8; j++)
+                        {
+                            for (uint32_t bit = 1; bit < 8; bit <<= 1)
+                            {
+                                const uint32_t k = j | bit;
+
+                                if (j & bit || ((inside >> j) & 1) == ((inside >> k) & 1))
+                                {
+                                    continue;
+                                }
+
+                                const float     t    = corners[j] / (corners[j] - corners[k]);
+                                const glm::vec3 from = { float(j & 1), float((j >> 1) & 1), float((j >> 2) & 1) };
+                                const glm::vec3 to   = { float(k & 1), float((k >> 1) & 1), float((k >> 2) & 1) };
+
+                                sum += from + (to - from) * t;
+                                count++;
+                            }
+                        }
+
+                        const glm::uvec3 cell     = stored[i] * Map::BRICK_CELLS + glm::uvec3(x, y, z);
+                        const glm::vec3  position = map.origin + (glm::vec3(cell) + sum / float(count)) * map.cell_size;
+                        const float      h        = map.cell_size * 0.5f;
+
+                        const glm::vec3 gradient =
+                        {
+                            map.distance(position + glm::vec3(h, 0.0f, 0.0f)) - map.distance(position - glm::vec3(h, 0.0f, 0.0f)),
+                            map.distance(position + glm::vec3(0.0f, h, 0.0f)) - map.distance(position - glm::vec3(0.0f, h, 0.0f)),
+                            map.distance(position + glm::vec3(0.0f, 0.0f, h)) - map.distance(position - glm::vec3(0.0f, 0.0f, h)),
+                        };
+
+                        const float length = glm::length(gradient);
+
+                        cell_vertices[size_t(i) * CELL_AREA + local_cell_index({ x, y, z })] = uint32_t(mesh.positions.size());
+
+                        mesh.positions.push_back(position);
+                        mesh.normals  .push_back(length > 0.0f ? gradient / length : glm::vec3(0.0f));
+                    }
+                }
+            }
+        }
+    });
+
+    std::vector<uint32_t> offsets(brick_count + 1, 0);
+
+    for (uint32_t i = 0; i < brick_count; i++)
+    {
+        offsets[i + 1] = offsets[i] + uint32_t(meshes[i].positions.size());
+    }
+
+    // Global index of the vertex of `cell`, or `UINT32_MAX`.
+    const auto cell_vertex = [&](const glm::uvec3& cell)
+    {
+        const uint32_t brick = map.find(cell / Map::BRICK_CELLS);
+
+        if (brick >= Map::INSIDE)
+        {
+            return UINT32_MAX;
+        }
+
+        const uint32_t vertex = cell_vertices[size_t(brick) * CELL_AREA + local_cell_index(cell % Map::BRICK_CELLS)];
+
+        return vertex == UINT32_MAX ? UINT32_MAX : offsets[brick] + vertex;
+    };
+
+    // One quad per crossed grid edge, as in `mesh_block`. Bricks own the edges
+    // starting at their points below their upper faces.
+    parallel_for(0, brick_count, 1, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t i = begin; i < end; i++)
+        {
+            std::vector<uint32_t>& indices = meshes[i].indices;
+
+            for (uint32_t z = 0; z < Map::BRICK_CELLS; z++)
+            {
+                for (uint32_t y = 0; y < Map::BRICK_CELLS; y++)
+                {
+                    for (uint32_t x = 0; x < Map::BRICK_CELLS; x++)
+                    {
+                        const glm::uvec3 local = { x, y, z };
+                        const glm::uvec3 point = stored[i] * Map::BRICK_CELLS + local;
+                        const bool       below = sample(i, local) < 0.0f;
+
+                        for (uint32_t a = 0; a < 3; a++)
+                        {
+                            const uint32_t b = (a + 1) % 3;
+                            const uint32_t c = (a + 2) % 3;
+
+                            if (point[b] == 0 || point[c] == 0)
+                            {
+                                continue;
+                            }
+
+                            glm::uvec3 next = local;
+                            next[a]++;
+
+                            if (below == (sample(i, next) < 0.0f))
+                            {
+                                continue;
+                            }
+
+                            glm::uvec3 quad[4] = { point, point, point, point };
+
+                            quad[0][b]--;
+                            quad[0][c]--;
+                            quad[1][c]--;
+                            quad[3][b]--;
+
+                            uint32_t vertices[4];
+                            bool     complete = true;
+
+                            for (uint32_t j = 0; j < 4; j++)
+                            {
+                                vertices[j] = cell_vertex(quad[j]);
+                                complete   &= vertices[j] != UINT32_MAX;
+                            }
+
+                            if (!complete)
+                            {
+                                continue;
+                            }
+
+                            if (below)
+                            {
+                                indices.insert(indices.end(), { vertices[0], vertices[1], vertices[2], vertices[0], vertices[2], vertices[3] });
+                            }
+                            else
+                            {
+                                indices.insert(indices.end(), { vertices[0], vertices[2], vertices[1], vertices[0], vertices[3], vertices[2] });
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    });
+
+    out_mesh.position_x.resize(offsets[brick_count]);
+    out_mesh.position_y.resize(offsets[brick_count]);
+    out_mesh.position_z.resize(offsets[brick_count]);
+    out_mesh.resize_normals();
+
+    for (uint32_t i = 0; i < brick_count; i++)
+    {
+        const SdfBlockMesh& mesh = meshes[i];
+
+        for (size_t j = 0; j < mesh.positions.size(); j++)
+        {
+            out_mesh.position_x[offsets[i] + j] = mesh.positions[j].x;
+            out_mesh.position_y[offsets[i] + j] = mesh.positions[j].y;
+            out_mesh.position_z[offsets[i] + j] = mesh.positions[j].z;
+            out_mesh.normal_x  [offsets[i] + j] = mesh.normals  [j].x;
+            out_mesh.normal_y  [offsets[i] + j] = mesh.normals  [j].y;
+            out_mesh.normal_z  [offsets[i] + j] = mesh.normals  [j].z;
+        }
+
+        out_mesh.indices.insert(out_mesh.indices.end(), mesh.indices.begin(), mesh.indices.end());
+    }
+
+    SdfMeshStats stats;
+    stats.cells    = uint64_t(map.bricks.x) * map.bricks.y * map.bricks.z * CELL_AREA;
+    stats.blocks   = brick_count;
+    stats.remeshed = brick_count;
+
+    return stats;
+}
+
+
+// -----------------------------------------------------------------------------
+// SHADER GENERATION
+// -----------------------------------------------------------------------------
+
+static const char* SDF_SHADER_PRELUDE =
+    "float sdf_smooth_min(float a, float b, float k)\n"
+    "{\n"
+    "    float h = max(k - abs(a - b), 0.0) / k;\n"
+    "    return min(a, b) - h * h * k * 0.25;\n"
+    "}\n"
+    "\n"
+    "float sdf_field(vec3 v0)\n"
+    "{\n";
+
+// Writes one statement per operation into single-assignment variables `vN`,
+// the way `SdfTree::evaluate` recurses; `v0` is the function's point.
+struct SdfShaderWriter
+{
+    const SdfTree&          tree;
+    std::string&            source;
+    std::vector<glm::vec4>& params;
+    uint32_t                variables = 1;
+
+    // Appends an indented line, and returns the index of the variable it
+    // declares.
+    uint32_t line(const char* format, ...)
+    {
+        char text[256];
+
+        va_list args;
+        va_start(args, format);
+        vsnprintf(text, sizeof(text), format, args);
+        va_end(args);
+
+        source += "    ";
+        source += text;
+        source += '\n';
+
+        return variables++;
+    }
+
+    uint32_t param(const glm::vec4& value)
+    {
+        params.push_back(value);
+
+        return uint32_t(params.size() - 1);
+    }
+
+    // Returns the variable holding the distance of `index` at `p`.
+    uint32_t write(uint32_t index, uint32_t p)
+    {
+        const SdfNode& node = tree.nodes[index];
+        const uint32_t v    = variables;
+
+        switch (node.op)
+        {
+        case SdfOp::SPHERE:
+        {
+            const uint32_t k = param(node.params);
+
+            return line("float v%u = length(v%u) - u_sdf_params[%u].x;", v, p, k);
+        }
+
+        case SdfOp::BOX:
+        {
+            const uint32_t k = param(node.params);
+
+            line("vec3 v%u = abs(v%u) - (u_sdf_params[%u].xyz - u_sdf_params[%u].w);", v, p, k, k);
+
+            return line("float v%u = length(max(v%u, 0.0)) + min(max(v%u.x, max(v%u.y, v%u.z)), 0.0) - u_sdf_params[%u].w;", v + 1, v, v, v, v, k);
+        }
+
+        case SdfOp::CYLINDER:
+        {
+            const uint32_t k = param(node.params);
+
+            line("vec2 v%u = abs(vec2(length(v%u.xz), v%u.y)) - u_sdf_params[%u].xy;", v, p, p, k);
+
+            return line("float v%u = min(max(v%u.x, v%u.y), 0.0) + length(max(v%u, 0.0));", v + 1, v, v, v);
+        }
+
+        case SdfOp::TORUS:
+        {
+            const uint32_t k = param(node.params);
+
+            return line("float v%u = length(vec2(length(v%u.xz) - u_sdf_params[%u].x, v%u.y)) - u_sdf_params[%u].y;", v, p, k, p, k);
+        }
+
+        case SdfOp::CAPSULE:
+        {
+            const uint32_t k = param(node.params);
+
+            return line("float v%u = length(vec3(v%u.x, v%u.y - clamp(v%u.y, -u_sdf_params[%u].y, u_sdf_params[%u].y), v%u.z)) - u_sdf_params[%u].x;", v, p, p, p, k, k, p, k);
+        }
+
+        case SdfOp::PLANE:
+        {
+            const uint32_t k = param(node.params);
+
+            return line("float v%u = dot(v%u, u_sdf_params[%u].xyz) - u_sdf_params[%u].w;", v, p, k, k);
+        }
+
+        case SdfOp::UNION:
+        case SdfOp::INTERSECT:
+        case SdfOp::SUBTRACT:
+        {
+            const uint32_t a = write(node.a, p);
+            const uint32_t b = write(node.b, p);
+
+            switch (node.op)
+            {
+            case SdfOp::UNION    : return line("float v%u = min(v%u, v%u);", variables, a, b);
+            case SdfOp::INTERSECT: return line("float v%u = max(v%u, v%u);", variables, a, b);
+            default              : return line("float v%u = max(v%u, -v%u);", variables, a, b);
+            }
+        }
+
+        case SdfOp::SMOOTH_UNION:
+        case SdfOp::SMOOTH_INTERSECT:
+        case SdfOp::SMOOTH_SUBTRACT:
+        {
+            const uint32_t k = param(node.params);
+            const uint32_t a = write(node.a, p);
+            const uint32_t b = write(node.b, p);
+
+            switch (node.op)
+            {
+            case SdfOp::SMOOTH_UNION    : return line("float v%u = sdf_smooth_min(v%u, v%u, u_sdf_params[%u].x);", variables, a, b, k);
+            case SdfOp::SMOOTH_INTERSECT: return line("float v%u = -sdf_smooth_min(-v%u, -v%u, u_sdf_params[%u].x);", variables, a, b, k);
+            default                     : return line("float v%u = -sdf_smooth_min(-v%u, v%u, u_sdf_params[%u].x);", variables, a, b, k);
+            }
+        }
+
+        case SdfOp::TRANSFORM:
+        {
+            // Rows of the affine part, then the scale factor.
+            const glm::mat4 rows = glm::transpose(node.matrix);
+            const uint32_t  k    = param(rows[0]);
+
+            param(rows[1]);
+            param(rows[2]);
+            param(node.params);
+
+            line("vec3 v%u = vec3(dot(u_sdf_params[%u], vec4(v%u, 1.0)), dot(u_sdf_params[%u], vec4(v%u, 1.0)), dot(u_sdf_params[%u], vec4(v%u, 1.0)));", v, k, p, k + 1, p, k + 2, p);
+
+            const uint32_t a = write(node.a, v);
+
+            return line("float v%u = v%u * u_sdf_params[%u].x;", variables, a, k + 3);
+        }
+
+        case SdfOp::REPEAT:
+        {
+            // Axes with a zero period come out unchanged.
+            const uint32_t k = param(node.params);
+
+            line("vec3 v%u = v%u - max(u_sdf_params[%u].xyz, 0.0) * floor(v%u / max(u_sdf_params[%u].xyz, 1e-6) + 0.5);", v, p, k, p, k);
+
+            return write(node.a, v);
+        }
+
+        case SdfOp::MIRROR:
+        {
+            const glm::vec4& flags = node.params;
+            const uint32_t   k     = param({
+                flags.x != 0.0f ? 1.0f : 0.0f,
+                flags.y != 0.0f ? 1.0f : 0.0f,
+                flags.z != 0.0f ? 1.0f : 0.0f,
+                0.0f,
+            });
+
+            line("vec3 v%u = mix(v%u, abs(v%u), u_sdf_params[%u].xyz);", v, p, p, k);
+
+            return write(node.a, v);
+        }
+
+        case SdfOp::TWIST:
+        {
+            const uint32_t k = param(node.params);
+
+            line("vec2 v%u = vec2(cos(u_sdf_params[%u].x * v%u.y), sin(u_sdf_params[%u].x * v%u.y));", v, k, p, k, p);
+            line("vec3 v%u = vec3(v%u.x * v%u.x - v%u.y * v%u.z, v%u.y, v%u.y * v%u.x + v%u.x * v%u.z);", v + 1, v, p, v, p, p, v, p, v, p);
+
+            return write(node.a, v + 1);
+        }
+
+        case SdfOp::ROUND:
+        case SdfOp::SHELL:
+        {
+            const uint32_t k = param(node.params);
+            const uint32_t a = write(node.a, p);
+
+            return node.op == SdfOp::ROUND
+                ? line("float v%u = v%u - u_sdf_params[%u].x;", variables, a, k)
+                : line("float v%u = abs(v%u) - u_sdf_params[%u].x;", variables, a, k);
+        }
+        }
+
+        return line("float v%u = 1e30;", v);
+    }
+};
+
+bool generate_sdf_shader(const SdfTree& tree, uint32_t root, SdfShader& out_shader)
+{
+    out_shader.source = SDF_SHADER_PRELUDE;
+    out_shader.params.clear();
+
+    SdfShaderWriter writer = { tree, out_shader.source, out_shader.params };
+
+    const uint32_t result = writer.write(root, 0);
+
+    writer.line("return v%u;", result);
+    out_shader.source += "}\n";
+
+    out_shader.hash = fnv1a(out_shader.source.data(), out_shader.source.size(), FNV_OFFSET_BASIS);
+
+    return out_shader.params.size() <= SDF_SHADER_MAX_PARAMS;
+}
@@ -0,0 +1,397 @@
+#pragma once
+
+#include <stddef.h>    // size_t
+#include <stdint.h>    // uint*_t
+
+#include <mutex>         // mutex
+#include <string>        // string
+#include <unordered_map> // unordered_map
+#include <vector>        // vector
+
+#include <glm/glm.hpp>   // mat4, uvec3, vec3, vec4
+
+#include "mesh.h"        // Aabb, ConstFloat3Span, Float3Span, Mesh
+#include "sdf_tape.h"    // SdfInstruction
+
+struct TaskCancel;
+
+
+// -----------------------------------------------------------------------------
+// SIGNED DISTANCE FIELDS
+// -----------------------------------------------------------------------------
+
+// Negative inside. Parameters go in `SdfNode::params`, in the listed order.
+enum struct SdfOp : uint8_t
+{
+    // Primitives, centered at the origin.
+    SPHERE,           // Radius.
+    BOX,              // Half extents, edge rounding.
+    CYLINDER,         // Radius, half height; along Y.
+    TORUS,            // Major radius, minor radius; around Y.
+    CAPSULE,          // Radius, half length of the segment; along Y.
+    PLANE,            // Unit normal, offset along it; solid below.
+
+    // Of the children `a` and `b`. The smooth ones blend over a radius.
+    UNION,
+    INTERSECT,
+    SUBTRACT,         // `a` minus `b`.
+    SMOOTH_UNION,     // Radius.
+    SMOOTH_INTERSECT, // Radius.
+    SMOOTH_SUBTRACT,  // Radius.
+
+    // Of the child `a`.
+    TRANSFORM,        // Smallest scale factor; `matrix` maps world to local.
+    REPEAT,           // Period per axis, zero to not repeat along it.
+    MIRROR,           // Nonzero per axis to mirror across its zero plane.
+    TWIST,            // Radians per unit along Y.
+    ROUND,            // Radius added around the surface.
+    SHELL,            // Thickness.
+};
+
+// Range of field values.
+struct SdfInterval
+{
+    float min = 0.0f;
+    float max = 0.0f;
+
+    bool contains_zero() const
+    {
+        return min <= 0.0f && max >= 0.0f;
+    }
+};
+
+struct SdfNode
+{
+    SdfOp     op     = SdfOp::SPHERE;
+    uint32_t  a      = 0;
+    uint32_t  b      = 0;
+    uint32_t  depth  = 1;               // Nodes on the longest path down.
+    glm::vec4 params = glm::vec4(0.0f);
+    glm::mat4 matrix = glm::mat4(1.0f); // `TRANSFORM` only.
+    uint64_t  hash   = 0;               // Of the whole subtree.
+};
+
+// Flat solid modeling tree. Nodes only refer to earlier ones, so every node is
+// the root of a valid subtree, and trees only ever grow. The builders return
+// the index of the new node. Subtree hashes cover the operations, parameters
+// and children, so equal hashes mean (practically) equal fields.
+//
+// Domain operations (repetition, twisting) and non-uniform scaling don't keep
+// the field an exact distance; it stays a bound good enough for meshing.
+struct SdfTree
+{
+    // The traversals recurse along the tree, so deeper trees could overflow
+    // the stack; the script bindings reject them.
+    static constexpr uint32_t MAX_DEPTH = 512;
+
+    std::vector<SdfNode> nodes;
+
+    uint32_t sphere  (float radius);
+    uint32_t box     (const glm::vec3& half_extents, float rounding = 0.0f);
+    uint32_t cylinder(float radius, float half_height);
+    uint32_t torus   (float major_radius, float minor_radius);
+    uint32_t capsule (float radius, float half_length);
+    uint32_t plane   (const glm::vec3& normal, float offset);
+
+    // With a zero `radius`, the sharp variants.
+    uint32_t unite    (uint32_t a, uint32_t b, float radius = 0.0f);
+    uint32_t intersect(uint32_t a, uint32_t b, float radius = 0.0f);
+    uint32_t subtract (uint32_t a, uint32_t b, float radius = 0.0f);
+
+    // `matrix` maps the child's space to the parent's.
+    uint32_t transform(uint32_t a, const glm::mat4& matrix);
+    uint32_t repeat   (uint32_t a, const glm::vec3& period);
+    uint32_t mirror   (uint32_t a, bool x, bool y, bool z);
+    uint32_t twist    (uint32_t a, float radians_per_unit);
+    uint32_t round    (uint32_t a, float radius);
+    uint32_t shell    (uint32_t a, float thickness);
+
+    float evaluate(uint32_t node, const glm::vec3& point) const;
+
+    // Unit-length, by central differences over `epsilon`; zero where the
+    // field is flat.
+    glm::vec3 normal(uint32_t node, const glm::vec3& point, float epsilon = 1e-3f) const;
+
+    // Conservative. Infinite (±1e30) along unbounded directions, like those
+    // of planes and repetitions.
+    Aabb bounds(uint32_t node) const;
+
+    // Conservative range of `evaluate` over `box`, by interval arithmetic on
+    // the operations. Primitives, which are exact distances in their own
+    // space, contribute their value at the center of their local box plus or
+    // minus its half diagonal.
+    SdfInterval evaluate_interval(uint32_t node, const Aabb& box) const;
+
+    // Copies the subtree of `node` into `out_tree` without the branches that
+    // can't affect the field inside `region`, like the side of a union that
+    // is larger everywhere there, and returns the new root. Inside `region`,
+    // the copy evaluates bitwise identically to the original.
+    uint32_t prune(uint32_t node, const Aabb& region, SdfTree& out_tree) const;
+
+    void clear();
+
+    // Appends a node and hashes its subtree; what the builders use.
+    uint32_t add(SdfOp op, uint32_t a, uint32_t b, const glm::vec4& params, const glm::mat4& matrix = glm::mat4(1.0f));
+};
+
+
+// -----------------------------------------------------------------------------
+// TAPES
+// -----------------------------------------------------------------------------
+
+// Subtree lowered to a flat list of register instructions, run over batches of
+// points with the dispatched SIMD level (see `mesh_kernels.h`). Registers are
+// assigned once; the point's coordinates are in registers 0 to 2.
+//
+// Compilation folds the constant parts of the tree: nested transforms become a
+// single affine map (planes absorb theirs), and operations that do nothing,
+// like zero rounding or repetition, disappear. Instructions identical to an
+// earlier one, e.g. of subtrees built twice, reuse its result instead. The
+// accumulated map passes through binary operations to both operands, so every
+// leaf gets the same composed chain of transforms whether or not its siblings
+// are there. Pruning (see `SdfTree::prune`) only drops operations that return
+// one operand exactly in the region, so it doesn't change the results of the
+// tape of a subtree; they may differ from `SdfTree::evaluate` by rounding,
+// though.
+struct SdfTape
+{
+    std::vector<SdfInstruction> code;
+    std::vector<float>          constants;
+    uint32_t                    register_count = 3;
+    uint32_t                    result         = 0; // Register of the distance.
+
+    // Replaces the tape with that of the subtree of `node`.
+    void compile(const SdfTree& tree, uint32_t node);
+
+    // Distances at `count` points. `registers` is scratch space, resized as
+    // needed, which can be reused across calls and tapes.
+    void evaluate(ConstFloat3Span points, uint32_t count, float* out, std::vector<float>& registers) const;
+
+    // Also their gradients, exact up to rounding, by running the tape on dual
+    // numbers; several times as costly as a plain evaluation. Where a sharp
+    // operation switches between children, the gradient is that of the child
+    // chosen.
+    void evaluate_gradient(ConstFloat3Span points, uint32_t count, float* out, Float3Span out_gradients, std::vector<float>& registers) const;
+};
+
+
+// -----------------------------------------------------------------------------
+// MESHING
+// -----------------------------------------------------------------------------
+
+// Cells per axis of the blocks meshed in parallel.
+static constexpr uint32_t SDF_BLOCK_SIZE = 16;
+
+// Cells per axis of the octree leaves within blocks, below which regions are
+// sampled point by point.
+static constexpr uint32_t SDF_LEAF_SIZE  = 4;
+
+struct SdfMeshStats
+{
+    uint64_t cells    = 0; // Voxels of the grid.
+    uint64_t samples  = 0; // Points where the field was evaluated.
+    uint32_t blocks   = 0; // Meshed in parallel.
+    uint32_t remeshed = 0; // Blocks meshed, rather than reused from a cache.
+};
+
+struct SdfBlockMesh
+{
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<uint32_t>  indices;
+    uint64_t               samples   = 0; // Evaluated.
+    uint32_t               last_used = 0; // See `SdfMeshCache`.
+};
+
+// How `mesh_sdf` lays its grid over the bounds.
+enum struct SdfGridSnap : uint8_t
+{
+    NONE,   // Starting exactly at the bounds' minimum.
+    BLOCKS, // In whole blocks of a lattice through the world origin.
+};
+
+// Block meshes of earlier `mesh_sdf` calls, for later calls over grids that
+// share blocks with theirs. Each block is keyed by the hash of the tree pruned
+// to the region it samples, which the pruning guarantees to evaluate bitwise
+// identically there, and by where the block lies on its grid's lattice, so a
+// block whose key didn't change would come out the same and is reused.
+// Changing a node changes the keys of just the blocks that the node can reach
+// by interval arithmetic, i.e. of its bounds plus whatever a blend, rounding
+// or domain operation above it spreads them to, and the remeshed blocks weld
+// to the reused ones as if all had been meshed anew.
+//
+// Grids snapped to the block lattice share their blocks with those of other
+// bounds, so moving the outer parts of a field only remeshes the blocks that
+// it reaches. Different fields keep their own blocks, since their keys differ.
+// Thread-safe; blocks stay until `evict_unused` or `clear`.
+struct SdfMeshCache
+{
+    // Keys of the blocks of a mesh, for `retain`.
+    struct MeshBlocks
+    {
+        std::vector<uint64_t> keys;
+        uint32_t              last_used = 0;
+    };
+
+    std::unordered_map<uint64_t, SdfBlockMesh> blocks;
+    std::unordered_map<uint64_t, MeshBlocks>   meshes; // By the caller's mesh key.
+    uint32_t                                   pass = 0;
+    std::mutex                                 mutex;
+
+    // Starts the next pass, after which `evict_unused` drops the blocks that
+    // no call used.
+    void begin();
+
+    // Keeps the blocks of the mesh made with `mesh_key` through this pass, for
+    // callers that cache whole meshes too and didn't need to mesh it again.
+    void retain(uint64_t mesh_key);
+
+    void evict_unused();
+
+    void clear();
+};
+
+// The bounds of the grid of `mesh_sdf` with `SdfGridSnap::BLOCKS`.
+Aabb snap_sdf_bounds(const Aabb& bounds, float cell_size);
+
+// Surface nets over a grid of `cell_size` cells covering `bounds`, which must
+// be finite, laid out as `snap` says. The grid is split into blocks of
+// `SDF_BLOCK_SIZE` cells per axis, meshed in parallel on the task pool; each
+// block samples one layer of its neighbors' cells, so the vertices along block
+// faces come out identical on both sides and are welded. Normals are the
+// field's gradients, by automatic differentiation.
+//
+// Blocks are subdivided as octrees: regions whose field interval excludes zero
+// can't contain the surface and aren't sampled, and leaves are sampled with the
+// tape of a tree pruned to their region, so the cost grows with the surface
+// area rather than the volume.
+//
+// With a `cache`, only the blocks where the field changed since the calls that
+// filled it are meshed (see `SdfMeshCache`); a nonzero `mesh_key` remembers
+// which blocks the mesh is made of.
+//
+// Stops between blocks once `cancel` is requested, leaving the mesh empty.
+SdfMeshStats mesh_sdf
+(
+    const SdfTree&    tree,
+    uint32_t          root,
+    const Aabb&       bounds,
+    float             cell_size,
+    Mesh&             out_mesh,
+    SdfMeshCache*     cache    = nullptr,
+    SdfGridSnap       snap     = SdfGridSnap::NONE,
+    uint64_t          mesh_key = 0,
+    const TaskCancel* cancel   = nullptr
+);
+
+// Adaptive dual contouring over the same grid, rounded up to whole blocks,
+// which are the roots of octrees contoured in parallel. Each cell crossed by
+// the surface gets the vertex minimizing the squared distances to the tangent
+// planes at the crossings of its edges, from the tapes' gradients, so sharp
+// edges and corners are kept rather than rounded off. Octree nodes are then
+// merged bottom up while the merged vertex stays within `tolerance` of all
+// their planes (in the sum of squares) and the merge can't change the topology,
+// so flat and gently curved regions end up with few, large triangles. Stops
+// between blocks once `cancel` is requested, leaving the mesh empty.
+SdfMeshStats contour_sdf
+(
+    const SdfTree&    tree,
+    uint32_t          root,
+    const Aabb&       bounds,
+    float             cell_size,
+    float             tolerance,
+    Mesh&             out_mesh,
+    const TaskCancel* cancel = nullptr
+);
+
+
+// -----------------------------------------------------------------------------
+// BRICK MAPS
+// -----------------------------------------------------------------------------
+
+// Sparse sampling of a field over a grid, for meshing it again or querying
+// distances without evaluating the tree. The grid's points are grouped into
+// bricks of `BRICK_SIZE` points per axis, neighbors sharing their faces, and
+// only the bricks where the field comes within `band` of zero are stored, as
+// 16-bit fractions of `band`; the others only keep whether they're inside or
+// outside. Bricks are found through a two-level table: pages of `PAGE_SIZE`
+// bricks per axis that are all inside or all outside take a single entry, and
+// the others point to a slot per brick.
+//
+// Memory grows with the surface area rather than the volume: about 1 KiB per
+// stored brick, against 4 bytes per grid point for dense floats.
+struct SdfBrickMap
+{
+    static constexpr uint32_t BRICK_SIZE  = 8;                // Points per axis.
+    static constexpr uint32_t BRICK_CELLS = BRICK_SIZE - 1;
+    static constexpr uint32_t BRICK_AREA  = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+    static constexpr uint32_t PAGE_SIZE   = 8;                // Bricks per axis.
+    static constexpr uint32_t PAGE_AREA   = PAGE_SIZE * PAGE_SIZE * PAGE_SIZE;
+
+    // Table entries of bricks and pages that aren't stored.
+    static constexpr uint32_t INSIDE      = UINT32_MAX - 1;
+    static constexpr uint32_t OUTSIDE     = UINT32_MAX;
+
+    glm::vec3             origin    = glm::vec3(0.0f);
+    float                 cell_size = 0.0f;
+    float                 band      = 0.0f;
+    glm::uvec3            bricks    = glm::uvec3(0);  // Per axis.
+    glm::uvec3            pages     = glm::uvec3(0);  // Per axis.
+    std::vector<uint32_t> page_table;                 // First slot of the page, or `INSIDE` / `OUTSIDE`.
+    std::vector<uint32_t> slots;                      // `PAGE_AREA` per page with a table: brick index, or `INSIDE` / `OUTSIDE`.
+    std::vector<int16_t>  samples;                    // `BRICK_AREA` per stored brick, X fastest.
+
+    // Samples the field over a grid of `grid_cell_size` cells covering
+    // `bounds`, rounded up to whole bricks, keeping the distances within the
+    // band, which is at least two cells wide so that every cell crossed by the
+    // surface is in a stored brick. Pages are sampled in parallel, skipping the
+    // regions that interval arithmetic puts beyond the band. Stops between
+    // pages once `cancel` is requested, leaving the map empty.
+    void build(const SdfTree& tree, uint32_t root, const Aabb& bounds, float grid_cell_size, float requested_band, const TaskCancel* cancel = nullptr);
+
+    // Trilinear interpolation of the samples, at the point clamped to the grid;
+    // `±band` away from the stored bricks.
+    float distance(const glm::vec3& point) const;
+
+    // Index of the brick in `samples`, or `INSIDE` / `OUTSIDE`.
+    uint32_t find(const glm::uvec3& brick) const;
+
+    uint32_t brick_count() const
+    {
+        return uint32_t(samples.size() / BRICK_AREA);
+    }
+
+    // Bytes allocated for the tables and samples.
+    size_t memory_usage() const;
+
+    void clear();
+};
+
+// Surface nets straight from the samples of the stored bricks, like `mesh_sdf`
+// over the same grid but without evaluating the field; normals are gradients
+// of the interpolated samples. Bricks are meshed in parallel.
+SdfMeshStats mesh_brick_map(const SdfBrickMap& map, Mesh& out_mesh);
+
+
+// -----------------------------------------------------------------------------
+// SHADERS
+// -----------------------------------------------------------------------------
+
+// Parameter slots of the generated shaders.
+static constexpr uint32_t SDF_SHADER_MAX_PARAMS = 256;
+
+// Subtree translated to bgfx shader source defining `float sdf_field(vec3 p)`,
+// which evaluates like `SdfTree::evaluate`. Every parameter is read from the
+// uniform array `u_sdf_params` (of `SDF_SHADER_MAX_PARAMS` elements), which the
+// including shader declares and fills with `params`, so the source depends on
+// the tree's structure only, and so does `hash`: editing values doesn't change
+// the shader.
+struct SdfShader
+{
+    std::string            source;
+    std::vector<glm::vec4> params;
+    uint64_t               hash = 0; // Of `source`.
+};
+
+// Returns false if the parameters don't fit `SDF_SHADER_MAX_PARAMS`.
+bool generate_sdf_shader(const SdfTree& tree, uint32_t root, SdfShader& out_shader);
@@ -0,0 +1,56 @@
+#pragma once
+
+// Instruction encoding of SDF tapes, shared by `sdf.cpp`, which compiles them,
+// and the batch kernels, which run them. Like `mesh_kernels_impl.h`, it must
+// only include C headers and declare plain data.
+
+#include <stdint.h> // uint*_t
+
+
+// -----------------------------------------------------------------------------
+// SDF TAPES
+// -----------------------------------------------------------------------------
+
+// Points per batch of a tape evaluation; every register holds one value per
+// point of the batch, so that each instruction runs over all of them at once.
+static constexpr uint32_t SDF_TAPE_BATCH = 64;
+
+// Constants are read from `SdfInstruction::constants` on, in the listed order.
+enum struct SdfCode : uint8_t
+{
+    // Of the point in registers `a` to `a + 2`, into `out` to `out + 2`.
+    AFFINE,           // Rows of the 3x4 matrix.
+    REPEAT,           // Period per axis, zero to not repeat along it.
+    MIRROR,           // Nonzero per axis to mirror across its zero plane.
+    TWIST,            // Radians per unit along Y.
+
+    // Distance from the point in registers `a` to `a + 2`, into `out`.
+    SPHERE,           // Radius.
+    BOX,              // Half extents less the rounding, rounding.
+    CYLINDER,         // Radius, half height.
+    TORUS,            // Major radius, minor radius.
+    CAPSULE,          // Radius, half length.
+    PLANE,            // Normal, offset along it.
+
+    // Of the distances in registers `a` and `b`, into `out`.
+    MIN,
+    MAX,
+    SUBTRACT,         // `max(a, -b)`.
+    SMOOTH_UNION,     // Radius.
+    SMOOTH_INTERSECT, // Radius.
+    SMOOTH_SUBTRACT,  // Radius.
+
+    // Of the distance in register `a`, into `out`.
+    MUL,              // Factor.
+    ADD,              // Term.
+    SHELL,            // Term added to the absolute value.
+};
+
+struct SdfInstruction
+{
+    SdfCode  code      = SdfCode::MIN;
+    uint32_t out       = 0;
+    uint32_t a         = 0;
+    uint32_t b         = 0;
+    uint32_t constants = 0; // Index of the first.
+};
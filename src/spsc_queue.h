@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h> // uint32_t
+
+#include <atomic>   // atomic
+#include <utility>  // move
+
+
+// -----------------------------------------------------------------------------
+// SINGLE-PRODUCER SINGLE-CONSUMER QUEUE
+// -----------------------------------------------------------------------------
+
+// Bounded lock-free ring buffer handing items from exactly one producer thread
+// to exactly one consumer thread. Each side only writes its own index, so
+// neither ever waits for the other; `push` fails when the ring is full instead.
+template <typename T, uint32_t CAPACITY>
+struct SpscQueue
+{
+    static_assert(CAPACITY != 0 && (CAPACITY & (CAPACITY - 1)) == 0, "The capacity must be a power of two.");
+
+    // On separate cache lines, so the two sides don't keep stealing them.
+    alignas(64) std::atomic<uint32_t> head = 0; // Next to pop; consumer side.
+    alignas(64) std::atomic<uint32_t> tail = 0; // Next to push; producer side.
+    alignas(64) T                     items[CAPACITY];
+
+    // Producer only. Leaves `item` alone when the queue is full.
+    bool push(T&& item)
+    {
+        const uint32_t index = tail.load(std::memory_order_relaxed);
+
+        if (index - head.load(std::memory_order_acquire) == CAPACITY)
+        {
+            return false;
+        }
+
+        items[index & (CAPACITY - 1)] = std::move(item);
+        tail.store(index + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // Consumer only.
+    bool pop(T& out_item)
+    {
+        const uint32_t index = head.load(std::memory_order_relaxed);
+
+        if (index == tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        out_item = std::move(items[index & (CAPACITY - 1)]);
+        head.store(index + 1, std::memory_order_release);
+
+        return true;
+    }
+};
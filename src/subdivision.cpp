@@ -0,0 +1,706 @@
+#include "subdivision.h"
+
+#include <algorithm> // min, sort
+#include <utility>   // pair, swap
+
+#include "tasks.h"   // parallel_for, task_cancelled, TaskCancel
+
+
+// -----------------------------------------------------------------------------
+// HALF-EDGE MESH
+// -----------------------------------------------------------------------------
+
+void HalfEdgeMesh::build(const uint32_t* indices, const uint32_t* face_sizes, uint32_t face_count, uint32_t mesh_vertex_count)
+{
+    clear();
+
+    vertex_count = mesh_vertex_count;
+
+    face_offsets.resize(face_count + 1);
+    face_offsets[0] = 0;
+
+    for (uint32_t i = 0; i < face_count; i++)
+    {
+        face_offsets[i + 1] = face_offsets[i] + face_sizes[i];
+    }
+
+    const uint32_t count = face_offsets[face_count];
+
+    vertices.assign(indices, indices + count);
+    faces   .resize(count);
+
+    for (uint32_t i = 0; i < face_count; i++)
+    {
+        std::fill(faces.begin() + face_offsets[i], faces.begin() + face_offsets[i + 1], i);
+    }
+
+    // Outgoing half-edges by vertex, in order.
+    std::vector<uint32_t> outgoing_offsets(vertex_count + 1, 0);
+    std::vector<uint32_t> outgoing(count);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        outgoing_offsets[vertices[i] + 1]++;
+    }
+
+    for (uint32_t i = 0; i < vertex_count; i++)
+    {
+        outgoing_offsets[i + 1] += outgoing_offsets[i];
+    }
+
+    {
+        std::vector<uint32_t> cursors(outgoing_offsets.begin(), outgoing_offsets.end() - 1);
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            outgoing[cursors[vertices[i]]++] = i;
+        }
+    }
+
+    // An edge is matched from both ends, in parallel. Each half-edge also
+    // finds the first of those on its edge, in either direction, which owns
+    // the edge.
+    std::vector<uint32_t> owners(count);
+
+    twins.resize(count);
+
+    parallel_for(0, count, 4096, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t i = begin; i < end; i++)
+        {
+            const uint32_t a = vertices[i];
+            const uint32_t b = target(i);
+
+            uint32_t same     = 0;
+            uint32_t opposite = 0;
+            uint32_t twin     = NO_HALF_EDGE;
+            uint32_t owner    = i;
+
+            for (uint32_t k = outgoing_offsets[a]; k < outgoing_offsets[a + 1]; k++)
+            {
+                if (target(outgoing[k]) == b)
+                {
+                    same++;
+                    owner = std::min(owner, outgoing[k]);
+                }
+            }
+
+            for (uint32_t k = outgoing_offsets[b]; k < outgoing_offsets[b + 1]; k++)
+            {
+                if (target(outgoing[k]) == a && outgoing[k] != i)
+                {
+                    opposite++;
+                    twin  = outgoing[k];
+                    owner = std::min(owner, outgoing[k]);
+                }
+            }
+
+            twins [i] = same == 1 && opposite == 1 ? twin : NO_HALF_EDGE;
+            owners[i] = owner;
+        }
+    });
+
+    // Owners come first, so their edges are numbered by the time the other
+    // half-edges look them up.
+    edges.resize(count);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        edges[i] = owners[i] == i ? edge_count++ : edges[owners[i]];
+    }
+
+    vertex_half_edges.assign(vertex_count, NO_HALF_EDGE);
+
+    for (uint32_t i = 0; i < vertex_count; i++)
+    {
+        for (uint32_t k = outgoing_offsets[i]; k < outgoing_offsets[i + 1]; k++)
+        {
+            if (vertex_half_edges[i] == NO_HALF_EDGE || twins[outgoing[k]] == NO_HALF_EDGE)
+            {
+                vertex_half_edges[i] = outgoing[k];
+            }
+
+            if (twins[outgoing[k]] == NO_HALF_EDGE)
+            {
+                break;
+            }
+        }
+    }
+}
+
+void HalfEdgeMesh::clear()
+{
+    vertices         .clear();
+    twins            .clear();
+    faces            .clear();
+    edges            .clear();
+    face_offsets     .clear();
+    vertex_half_edges.clear();
+
+    vertex_count = 0;
+    edge_count   = 0;
+}
+
+
+// -----------------------------------------------------------------------------
+// STENCILS
+// -----------------------------------------------------------------------------
+
+// Weights of one row, gathered with repeats, then merged by source.
+struct StencilRow
+{
+    std::vector<std::pair<uint32_t, float>> entries;
+
+    void add(uint32_t source, float weight)
+    {
+        entries.push_back({ source, weight });
+    }
+
+    // Centroid of the face, weighted.
+    void add_face(const HalfEdgeMesh& mesh, uint32_t face, float weight)
+    {
+        const float share = weight / float(mesh.face_size(face));
+
+        for (uint32_t i = mesh.face_offsets[face]; i < mesh.face_offsets[face + 1]; i++)
+        {
+            add(mesh.vertices[i], share);
+        }
+    }
+
+    void emit(std::vector<uint32_t>& sources, std::vector<float>& weights)
+    {
+        std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b)
+        {
+            return a.first < b.first;
+        });
+
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            if (i > 0 && entries[i].first == entries[i - 1].first)
+            {
+                weights.back() += entries[i].second;
+            }
+            else
+            {
+                sources.push_back(entries[i].first);
+                weights.push_back(entries[i].second);
+            }
+        }
+
+        entries.clear();
+    }
+};
+
+// Faces around a vertex, from its outgoing half-edges. Open when the walk hits
+// a half-edge without twin; incomplete when the vertex has more than one fan.
+struct VertexFan
+{
+    std::vector<uint32_t> half_edges; // Outgoing, counter-clockwise.
+    bool                  open       = false;
+    bool                  complete   = false;
+};
+
+static void walk_fan(const HalfEdgeMesh& mesh, uint32_t vertex, uint32_t outgoing_count, VertexFan& fan)
+{
+    fan.half_edges.clear();
+    fan.open     = false;
+    fan.complete = false;
+
+    const uint32_t start = mesh.vertex_half_edges[vertex];
+
+    if (start == NO_HALF_EDGE)
+    {
+        return;
+    }
+
+    uint32_t half_edge = start;
+
+    do
+    {
+        fan.half_edges.push_back(half_edge);
+
+        const uint32_t incoming = mesh.prev(half_edge);
+
+        if (mesh.twins[incoming] == NO_HALF_EDGE)
+        {
+            fan.open = true;
+            break;
+        }
+
+        half_edge = mesh.twins[incoming];
+    }
+    while (half_edge != start && fan.half_edges.size() < outgoing_count);
+
+    fan.complete = fan.half_edges.size() == outgoing_count && (fan.open ? mesh.twins[start] == NO_HALF_EDGE : half_edge == start);
+}
+
+// Vertex rules of the smooth interior, the B-spline boundary, and the fixed
+// corners: boundary vertices of a single face, and those with several fans.
+static void add_vertex_rule(const HalfEdgeMesh& mesh, SubdivisionScheme scheme, uint32_t vertex, const VertexFan& fan, StencilRow& row)
+{
+    const uint32_t n = uint32_t(fan.half_edges.size());
+
+    if (!fan.complete || (fan.open && n < 2))
+    {
+        row.add(vertex, 1.0f);
+        return;
+    }
+
+    if (fan.open)
+    {
+        row.add(vertex, 0.75f);
+        row.add(mesh.target(fan.half_edges.front()), 0.125f);
+        row.add(mesh.vertices[mesh.prev(fan.half_edges.back())], 0.125f);
+        return;
+    }
+
+    if (scheme == SubdivisionScheme::CATMULL_CLARK)
+    {
+        // (n - 2) / n of the vertex, then the average of the edge neighbors
+        // and of the face points, over n each.
+        const float share = 1.0f / float(n * n);
+
+        row.add(vertex, float(n - 2) / float(n));
+
+        for (const uint32_t half_edge : fan.half_edges)
+        {
+            row.add(mesh.target(half_edge), share);
+            row.add_face(mesh, mesh.faces[half_edge], share);
+        }
+    }
+    else
+    {
+        const float beta = n == 3 ? 3.0f / 16.0f : 3.0f / (8.0f * float(n));
+
+        row.add(vertex, 1.0f - float(n) * beta);
+
+        for (const uint32_t half_edge : fan.half_edges)
+        {
+            row.add(mesh.target(half_edge), beta);
+        }
+    }
+}
+
+static void add_edge_rule(const HalfEdgeMesh& mesh, SubdivisionScheme scheme, uint32_t half_edge, StencilRow& row)
+{
+    const uint32_t a    = mesh.vertices[half_edge];
+    const uint32_t b    = mesh.target(half_edge);
+    const uint32_t twin = mesh.twins[half_edge];
+
+    if (twin == NO_HALF_EDGE)
+    {
+        row.add(a, 0.5f);
+        row.add(b, 0.5f);
+    }
+    else if (scheme == SubdivisionScheme::CATMULL_CLARK)
+    {
+        row.add(a, 0.25f);
+        row.add(b, 0.25f);
+        row.add_face(mesh, mesh.faces[half_edge], 0.25f);
+        row.add_face(mesh, mesh.faces[twin], 0.25f);
+    }
+    else
+    {
+        row.add(a, 0.375f);
+        row.add(b, 0.375f);
+        row.add(mesh.vertices[mesh.prev(half_edge)], 0.125f);
+        row.add(mesh.vertices[mesh.prev(twin)], 0.125f);
+    }
+}
+
+static const uint32_t STENCIL_GRAIN = 1024;
+
+// Stencils of the next level, whose vertices are the vertex points, then the
+// edge points, then for Catmull-Clark the face points, and its faces, quads or
+// triangles, by vertex of the next level.
+static void subdivide_level
+(
+    const HalfEdgeMesh&    mesh,
+    SubdivisionScheme      scheme,
+    SubdivisionStencils&   out_stencils,
+    std::vector<uint32_t>& out_indices,
+    std::vector<uint32_t>& out_face_sizes,
+    const TaskCancel*      cancel
+)
+{
+    const bool     catmull_clark = scheme == SubdivisionScheme::CATMULL_CLARK;
+    const uint32_t vertex_count  = mesh.vertex_count;
+    const uint32_t edge_base     = vertex_count;
+    const uint32_t face_base     = vertex_count + mesh.edge_count;
+    const uint32_t row_count     = face_base + (catmull_clark ? mesh.face_count() : 0);
+
+    std::vector<uint32_t> outgoing_counts(vertex_count, 0);
+    std::vector<uint32_t> edge_half_edges(mesh.edge_count, NO_HALF_EDGE);
+
+    for (uint32_t i = 0; i < mesh.half_edge_count(); i++)
+    {
+        outgoing_counts[mesh.vertices[i]]++;
+
+        if (edge_half_edges[mesh.edges[i]] == NO_HALF_EDGE)
+        {
+            edge_half_edges[mesh.edges[i]] = i;
+        }
+    }
+
+    // Rows in parallel, compacted by chunk.
+    const uint32_t chunk_count = (row_count + STENCIL_GRAIN - 1) / STENCIL_GRAIN;
+
+    std::vector<std::vector<uint32_t>> chunk_sizes  (chunk_count);
+    std::vector<std::vector<uint32_t>> chunk_sources(chunk_count);
+    std::vector<std::vector<float>>    chunk_weights(chunk_count);
+
+    parallel_for(0, row_count, STENCIL_GRAIN, [&](uint32_t begin, uint32_t end)
+    {
+        const uint32_t chunk = begin / STENCIL_GRAIN;
+
+        if (task_cancelled(cancel))
+        {
+            return;
+        }
+
+        StencilRow row;
+        VertexFan  fan;
+
+        for (uint32_t i = begin; i < end; i++)
+        {
+            if (i < edge_base)
+            {
+                walk_fan(mesh, i, outgoing_counts[i], fan);
+                add_vertex_rule(mesh, scheme, i, fan, row);
+            }
+            else if (i < face_base)
+            {
+                add_edge_rule(mesh, scheme, edge_half_edges[i - edge_base], row);
+            }
+            else
+            {
+                row.add_face(mesh, i - face_base, 1.0f);
+            }
+
+            const size_t size = chunk_sources[chunk].size();
+
+            row.emit(chunk_sources[chunk], chunk_weights[chunk]);
+            chunk_sizes[chunk].push_back(uint32_t(chunk_sources[chunk].size() - size));
+        }
+    });
+
+    // Some chunks may be missing; the caller drops the level.
+    if (task_cancelled(cancel))
+    {
+        return;
+    }
+
+    out_stencils.offsets.assign(1, 0);
+    out_stencils.sources.clear();
+    out_stencils.weights.clear();
+
+    for (uint32_t i = 0; i < chunk_count; i++)
+    {
+        for (const uint32_t size : chunk_sizes[i])
+        {
+            out_stencils.offsets.push_back(out_stencils.offsets.back() + size);
+        }
+
+        out_stencils.sources.insert(out_stencils.sources.end(), chunk_sources[i].begin(), chunk_sources[i].end());
+        out_stencils.weights.insert(out_stencils.weights.end(), chunk_weights[i].begin(), chunk_weights[i].end());
+    }
+
+    // Catmull-Clark makes a quad per corner of each face; Loop splits each
+    // triangle into four, with the edge points as the middle one.
+    out_indices   .clear();
+    out_face_sizes.clear();
+
+    for (uint32_t face = 0; face < mesh.face_count(); face++)
+    {
+        const uint32_t first = mesh.face_offsets[face];
+        const uint32_t last  = mesh.face_offsets[face + 1];
+
+        for (uint32_t i = first; i < last; i++)
+        {
+            const uint32_t prev = mesh.prev(i);
+
+            out_indices.push_back(mesh.vertices[i]);
+            out_indices.push_back(edge_base + mesh.edges[i]);
+
+            if (catmull_clark)
+            {
+                out_indices.push_back(face_base + face);
+            }
+
+            out_indices.push_back(edge_base + mesh.edges[prev]);
+            out_face_sizes.push_back(catmull_clark ? 4 : 3);
+        }
+
+        if (!catmull_clark)
+        {
+            for (uint32_t i = first; i < last; i++)
+            {
+                out_indices.push_back(edge_base + mesh.edges[i]);
+            }
+
+            out_face_sizes.push_back(last - first);
+        }
+    }
+}
+
+
+// -----------------------------------------------------------------------------
+// SUBDIVISION SURFACES
+// -----------------------------------------------------------------------------
+
+// Quad of two triangles sharing an edge in opposite directions, if they do.
+static bool pair_quad(const uint32_t* t0, const uint32_t* t1, uint32_t* out_quad)
+{
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        const uint32_t p = t0[i];
+        const uint32_t q = t0[(i + 1) % 3];
+        const uint32_t r = t0[(i + 2) % 3];
+
+        for (uint32_t k = 0; k < 3; k++)
+        {
+            const uint32_t s = t1[(k + 2) % 3];
+
+            if (t1[k] == q && t1[(k + 1) % 3] == p && s != r && s != p && s != q)
+            {
+                out_quad[0] = p;
+                out_quad[1] = s;
+                out_quad[2] = q;
+                out_quad[3] = r;
+
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+// Whether cage triangle `triangle` and the next one make a quad, `out_quad`.
+static bool pair_next(const Mesh& cage, uint32_t triangle, uint32_t* out_quad)
+{
+    return triangle + 1 < cage.triangle_count() && pair_quad(&cage.indices[triangle * 3], &cage.indices[triangle * 3 + 3], out_quad);
+}
+
+uint64_t SubdivisionSurface::count_triangles(const Mesh& cage, SubdivisionScheme subdivision_scheme, uint32_t level_count, bool pair_triangles)
+{
+    const uint32_t triangle_count = cage.triangle_count();
+
+    level_count = std::min(level_count, 8u);
+
+    if (level_count == 0)
+    {
+        return triangle_count;
+    }
+
+    if (subdivision_scheme == SubdivisionScheme::LOOP)
+    {
+        return uint64_t(triangle_count) << (level_count * 2);
+    }
+
+    // Quads of the first level, split in four by each later one and in two
+    // triangles at the end.
+    uint64_t corners = 0;
+
+    for (uint32_t i = 0; i < triangle_count; i++)
+    {
+        uint32_t quad[4];
+
+        if (pair_triangles && pair_next(cage, i, quad))
+        {
+            corners += 4;
+            i++;
+        }
+        else
+        {
+            corners += 3;
+        }
+    }
+
+    return (corners << ((level_count - 1) * 2)) * 2;
+}
+
+void SubdivisionSurface::build(const Mesh& cage, SubdivisionScheme subdivision_scheme, uint32_t level_count, bool pair_triangles, const TaskCancel* cancel)
+{
+    clear();
+
+    scheme            = subdivision_scheme;
+    cage_vertex_count = cage.vertex_count();
+    level_count       = std::min(level_count, 8u);
+
+    std::vector<uint32_t> face_indices;
+    std::vector<uint32_t> face_sizes;
+
+    const uint32_t triangle_count = cage.triangle_count();
+
+    for (uint32_t i = 0; i < triangle_count; i++)
+    {
+        const uint32_t* tri = &cage.indices[i * 3];
+        uint32_t        quad[4];
+
+        if (pair_triangles && scheme == SubdivisionScheme::CATMULL_CLARK && pair_next(cage, i, quad))
+        {
+            face_indices.insert(face_indices.end(), quad, quad + 4);
+            face_sizes.push_back(4);
+            i++;
+        }
+        else
+        {
+            face_indices.insert(face_indices.end(), tri, tri + 3);
+            face_sizes.push_back(3);
+        }
+    }
+
+    HalfEdgeMesh          mesh;
+    std::vector<uint32_t> next_indices;
+    std::vector<uint32_t> next_sizes;
+    uint32_t              vertex_count = cage_vertex_count;
+
+    for (uint32_t level = 0; level < level_count; level++)
+    {
+        mesh.build(face_indices.data(), face_sizes.data(), uint32_t(face_sizes.size()), vertex_count);
+
+        levels.emplace_back();
+        subdivide_level(mesh, scheme, levels.back(), next_indices, next_sizes, cancel);
+
+        if (task_cancelled(cancel))
+        {
+            clear();
+
+            return;
+        }
+
+        vertex_count = levels.back().row_count();
+
+        std::swap(face_indices, next_indices);
+        std::swap(face_sizes,   next_sizes);
+    }
+
+    // Faces as triangle fans.
+    const uint32_t* face = face_indices.data();
+
+    for (const uint32_t size : face_sizes)
+    {
+        for (uint32_t i = 2; i < size; i++)
+        {
+            indices.push_back(face[0]);
+            indices.push_back(face[i - 1]);
+            indices.push_back(face[i]);
+        }
+
+        face += size;
+    }
+}
+
+static const uint32_t EVALUATE_GRAIN = 4096;
+
+// One level: each row's weighted sum of the coarser positions.
+static void apply_stencils(const SubdivisionStencils& stencils, ConstFloat3Span source, Float3Span destination, const TaskCancel* cancel)
+{
+    parallel_for(0, stencils.row_count(), EVALUATE_GRAIN, [&](uint32_t begin, uint32_t end)
+    {
+        if (task_cancelled(cancel))
+        {
+            return;
+        }
+
+        for (uint32_t i = begin; i < end; i++)
+        {
+            float x = 0.0f;
+            float y = 0.0f;
+            float z = 0.0f;
+
+            for (uint32_t k = stencils.offsets[i]; k < stencils.offsets[i + 1]; k++)
+            {
+                const uint32_t s = stencils.sources[k];
+                const float    w = stencils.weights[k];
+
+                x += source.x[s] * w;
+                y += source.y[s] * w;
+                z += source.z[s] * w;
+            }
+
+            destination.x[i] = x;
+            destination.y[i] = y;
+            destination.z[i] = z;
+        }
+    });
+}
+
+void SubdivisionSurface::evaluate(ConstFloat3Span cage_positions, Mesh& out_mesh, const TaskCancel* cancel) const
+{
+    const uint32_t count = vertex_count();
+
+    out_mesh.position_x.resize(count);
+    out_mesh.position_y.resize(count);
+    out_mesh.position_z.resize(count);
+    out_mesh.normal_x  .clear();
+    out_mesh.normal_y  .clear();
+    out_mesh.normal_z  .clear();
+    out_mesh.colors    .clear();
+    out_mesh.indices   = indices;
+
+    if (levels.empty())
+    {
+        std::copy(cage_positions.x, cage_positions.x + count, out_mesh.position_x.begin());
+        std::copy(cage_positions.y, cage_positions.y + count, out_mesh.position_y.begin());
+        std::copy(cage_positions.z, cage_positions.z + count, out_mesh.position_z.begin());
+        return;
+    }
+
+    // Intermediate levels alternate between two buffers, the last one goes
+    // straight to the mesh.
+    std::vector<float> buffers[2][3];
+    ConstFloat3Span    source = cage_positions;
+
+    for (size_t level = 0; level < levels.size(); level++)
+    {
+        Float3Span destination = out_mesh.positions();
+
+        if (level + 1 < levels.size())
+        {
+            std::vector<float>* buffer = buffers[level % 2];
+            const uint32_t      rows   = levels[level].row_count();
+
+            buffer[0].resize(rows);
+            buffer[1].resize(rows);
+            buffer[2].resize(rows);
+
+            destination = { buffer[0].data(), buffer[1].data(), buffer[2].data() };
+        }
+
+        apply_stencils(levels[level], source, destination, cancel);
+
+        if (task_cancelled(cancel))
+        {
+            out_mesh.clear();
+
+            return;
+        }
+
+        source = destination;
+    }
+}
+
+size_t SubdivisionSurface::memory_usage() const
+{
+    size_t bytes = indices.capacity() * sizeof(uint32_t);
+
+    for (const SubdivisionStencils& stencils : levels)
+    {
+        bytes += stencils.offsets.capacity() * sizeof(uint32_t);
+        bytes += stencils.sources.capacity() * sizeof(uint32_t);
+        bytes += stencils.weights.capacity() * sizeof(float);
+    }
+
+    return bytes;
+}
+
+void SubdivisionSurface::clear()
+{
+    scheme            = SubdivisionScheme::CATMULL_CLARK;
+    cage_vertex_count = 0;
+
+    levels .clear();
+    indices.clear();
+}
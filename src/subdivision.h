@@ -0,0 +1,142 @@
+#pragma once
+
+#include <stddef.h> // size_t
+#include <stdint.h> // uint32_t, uint64_t
+
+#include <vector>   // vector
+
+#include "mesh.h"   // ConstFloat3Span, Float3Span, Mesh
+
+struct TaskCancel;
+
+
+// -----------------------------------------------------------------------------
+// HALF-EDGE MESH
+// -----------------------------------------------------------------------------
+
+static constexpr uint32_t NO_HALF_EDGE = UINT32_MAX;
+
+// Polygon mesh with the half-edges of each face stored consecutively, so that
+// the next and previous half-edges are implicit. Half-edges of non-manifold
+// edges, shared by more than two faces or twice in the same direction, have no
+// twin, like those of boundaries.
+struct HalfEdgeMesh
+{
+    std::vector<uint32_t> vertices;          // Origin of each half-edge.
+    std::vector<uint32_t> twins;             // Opposite half-edge, or `NO_HALF_EDGE`.
+    std::vector<uint32_t> faces;             // Face of each half-edge.
+    std::vector<uint32_t> edges;             // Edge of each half-edge, shared with its twin.
+    std::vector<uint32_t> face_offsets;      // First half-edge of each face, and the total.
+    std::vector<uint32_t> vertex_half_edges; // One outgoing per vertex, without twin if any, or `NO_HALF_EDGE`.
+    uint32_t              vertex_count = 0;
+    uint32_t              edge_count   = 0;
+
+    // Faces given by `face_sizes` consecutive `indices` each, counter-clockwise.
+    void build(const uint32_t* indices, const uint32_t* face_sizes, uint32_t face_count, uint32_t mesh_vertex_count);
+
+    uint32_t face_count() const
+    {
+        return uint32_t(face_offsets.size() - 1);
+    }
+
+    uint32_t half_edge_count() const
+    {
+        return uint32_t(vertices.size());
+    }
+
+    uint32_t face_size(uint32_t face) const
+    {
+        return face_offsets[face + 1] - face_offsets[face];
+    }
+
+    uint32_t next(uint32_t half_edge) const
+    {
+        const uint32_t face = faces[half_edge];
+
+        return half_edge + 1 < face_offsets[face + 1] ? half_edge + 1 : face_offsets[face];
+    }
+
+    uint32_t prev(uint32_t half_edge) const
+    {
+        const uint32_t face = faces[half_edge];
+
+        return half_edge > face_offsets[face] ? half_edge - 1 : face_offsets[face + 1] - 1;
+    }
+
+    // Where the half-edge points to.
+    uint32_t target(uint32_t half_edge) const
+    {
+        return vertices[next(half_edge)];
+    }
+
+    void clear();
+};
+
+
+// -----------------------------------------------------------------------------
+// SUBDIVISION SURFACES
+// -----------------------------------------------------------------------------
+
+enum struct SubdivisionScheme
+{
+    CATMULL_CLARK, // Any polygons, quads after the first level.
+    LOOP,          // Triangles only.
+};
+
+// Sparse matrix from the vertices of one level to those of the next, a row of
+// weights per vertex.
+struct SubdivisionStencils
+{
+    std::vector<uint32_t> offsets; // First entry of each row, and the total.
+    std::vector<uint32_t> sources; // Vertex of the coarser level.
+    std::vector<float>    weights;
+
+    uint32_t row_count() const
+    {
+        return offsets.empty() ? 0 : uint32_t(offsets.size() - 1);
+    }
+};
+
+// Subdivision of a cage to a fixed number of levels, split into its topology,
+// built once, and the positions, evaluated from the cage's with the stencils
+// of each level in turn. As long as only the cage's positions change, like
+// when dragging a vertex, re-evaluating is a sparse matrix-vector product per
+// level, in parallel over the rows.
+//
+// Boundaries follow the cubic B-spline of their vertices; vertices where
+// several fans of faces meet, and those of no face, stay in place.
+struct SubdivisionSurface
+{
+    SubdivisionScheme                scheme            = SubdivisionScheme::CATMULL_CLARK;
+    uint32_t                         cage_vertex_count = 0;
+    std::vector<SubdivisionStencils> levels;
+    std::vector<uint32_t>            indices; // Triangles of the finest level.
+
+    // With `pair_triangles`, consecutive triangles sharing an edge are taken
+    // as the halves of a quad, as the mesh primitives emit them; this is what
+    // Catmull-Clark is meant for. Loop ignores it. Level count is clamped to 8.
+    // Stops between chunks of stencil rows once `cancel` is requested, leaving
+    // the surface empty.
+    void build(const Mesh& cage, SubdivisionScheme subdivision_scheme, uint32_t level_count, bool pair_triangles, const TaskCancel* cancel = nullptr);
+
+    // Positions of the finest level from those of the cage, in `out_mesh`,
+    // which gets the indices as well. Reuses the mesh's arrays when it held
+    // the previous evaluation. Stops between chunks of rows once `cancel` is
+    // requested, leaving the mesh empty.
+    void evaluate(ConstFloat3Span cage_positions, Mesh& out_mesh, const TaskCancel* cancel = nullptr) const;
+
+    // Triangles of the finest level that `build` makes of the cage, without
+    // building it. Catmull-Clark's first level makes a quad per face corner,
+    // so unpaired triangles grow sixfold rather than fourfold.
+    static uint64_t count_triangles(const Mesh& cage, SubdivisionScheme subdivision_scheme, uint32_t level_count, bool pair_triangles);
+
+    uint32_t vertex_count() const
+    {
+        return levels.empty() ? cage_vertex_count : levels.back().row_count();
+    }
+
+    // Bytes allocated for the stencils and indices.
+    size_t memory_usage() const;
+
+    void clear();
+};
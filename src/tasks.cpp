@@ -0,0 +1,239 @@
+#include "tasks.h"
+
+#include <condition_variable> // condition_variable
+#include <deque>              // deque
+#include <mutex>              // mutex, unique_lock
+#include <thread>             // thread, yield
+#include <utility>            // move
+#include <vector>             // vector
+
+#include <bx/timer.h>         // getHPCounter
+
+
+// -----------------------------------------------------------------------------
+// TASK POOL
+// -----------------------------------------------------------------------------
+
+struct Task
+{
+    std::function<void()> func;
+    TaskCounter*          counter = nullptr;
+};
+
+struct TaskPool
+{
+    std::vector<std::thread> threads;
+    std::deque<Task>         queue;
+    std::mutex               mutex;
+    std::condition_variable  wake;
+    TaskQueue                kind = TaskQueue::FRAME;
+    bool                     quit = false;
+
+    // Only takes tasks of `counter`, newest first, since those are the ones
+    // the nested waits are most likely to be blocked on.
+    bool try_pop(const TaskCounter& counter, Task& task)
+    {
+        std::unique_lock lock(mutex);
+
+        for (auto it = queue.rbegin(); it != queue.rend(); ++it)
+        {
+            if (it->counter == &counter)
+            {
+                task = std::move(*it);
+                queue.erase(std::next(it).base());
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void worker_loop();
+
+    void execute(Task& task);
+};
+
+static TaskPool* g_task_pools[2] = {};
+
+static thread_local TaskQueue t_task_queue = TaskQueue::FRAME;
+
+void TaskPool::worker_loop()
+{
+    t_task_queue = kind;
+
+    for (;;)
+    {
+        Task task;
+        {
+            std::unique_lock lock(mutex);
+            wake.wait(lock, [&]() { return quit || !queue.empty(); });
+
+            if (quit && queue.empty())
+            {
+                return;
+            }
+
+            task = std::move(queue.front());
+            queue.pop_front();
+        }
+
+        execute(task);
+    }
+}
+
+// Nested tasks go to the same queue, also when helping out from another one.
+void TaskPool::execute(Task& task)
+{
+    const TaskQueue previous = t_task_queue;
+
+    t_task_queue = kind;
+    task.func();
+    t_task_queue = previous;
+
+    task.counter->pending.fetch_sub(1, std::memory_order_release);
+}
+
+void task_pool_init(uint32_t thread_count)
+{
+    task_pool_shutdown();
+
+    if (thread_count == 0)
+    {
+        thread_count = std::thread::hardware_concurrency();
+    }
+
+    if (thread_count <= 1)
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < 2; i++)
+    {
+        TaskPool* pool = new TaskPool();
+        pool->kind     = TaskQueue(i);
+
+        g_task_pools[i] = pool;
+    }
+
+    for (TaskPool* pool : g_task_pools)
+    {
+        for (uint32_t i = 1; i < thread_count; i++)
+        {
+            pool->threads.emplace_back([pool]() { pool->worker_loop(); });
+        }
+    }
+}
+
+void task_pool_shutdown()
+{
+    if (g_task_pools[0] == nullptr)
+    {
+        return;
+    }
+
+    for (TaskPool* pool : g_task_pools)
+    {
+        {
+            std::unique_lock lock(pool->mutex);
+            pool->quit = true;
+        }
+        pool->wake.notify_all();
+    }
+
+    for (TaskPool*& pool : g_task_pools)
+    {
+        for (std::thread& thread : pool->threads)
+        {
+            thread.join();
+        }
+
+        delete pool;
+        pool = nullptr;
+    }
+}
+
+uint32_t task_pool_thread_count()
+{
+    const TaskPool* pool = g_task_pools[0];
+
+    return pool ? uint32_t(pool->threads.size()) + 1 : 1;
+}
+
+void task_set_thread_queue(TaskQueue queue)
+{
+    t_task_queue = queue;
+}
+
+void task_run(TaskCounter& counter, std::function<void()> func)
+{
+    task_run(counter, t_task_queue, std::move(func));
+}
+
+void task_run(TaskCounter& counter, TaskQueue queue, std::function<void()> func)
+{
+    TaskPool* pool = g_task_pools[uint32_t(queue)];
+
+    if (pool == nullptr)
+    {
+        func();
+        return;
+    }
+
+    counter.pending.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::unique_lock lock(pool->mutex);
+        pool->queue.push_back({ std::move(func), &counter });
+    }
+    pool->wake.notify_one();
+}
+
+void task_wait(TaskCounter& counter)
+{
+    // The counter's tasks are usually in the calling thread's queue.
+    const uint32_t first = uint32_t(t_task_queue);
+
+    while (counter.pending.load(std::memory_order_acquire) != 0)
+    {
+        Task      task;
+        TaskPool* pool = nullptr;
+
+        for (uint32_t i = 0; i < 2 && g_task_pools[0]; i++)
+        {
+            TaskPool* candidate = g_task_pools[(first + i) % 2];
+
+            if (candidate->try_pop(counter, task))
+            {
+                pool = candidate;
+                break;
+            }
+        }
+
+        if (pool)
+        {
+            pool->execute(task);
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+
+// -----------------------------------------------------------------------------
+// CANCELLATION
+// -----------------------------------------------------------------------------
+
+bool TaskCancel::requested() const
+{
+    for (const std::atomic<bool>* flag : flags)
+    {
+        if (flag && flag->load(std::memory_order_relaxed))
+        {
+            return true;
+        }
+    }
+
+    return deadline != INT64_MAX && bx::getHPCounter() > deadline;
+}
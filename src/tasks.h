@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stdint.h>   // int64_t, INT64_MAX, uint32_t, uint8_t
+
+#include <atomic>     // atomic
+#include <functional> // function
+
+// Minimal fork-join task pool shared by the geometry code. Before
+// `task_pool_init` is called (or after `task_pool_shutdown`), tasks simply run
+// inline on the calling thread, so library code can use it unconditionally.
+//
+// There are two sets of worker threads, so that frame-critical work of the UI
+// thread never queues behind long-running evaluator work (script tasks,
+// meshing, booleans). Waiting threads only help with the tasks they wait for.
+
+// Which worker threads a task runs on.
+enum struct TaskQueue : uint8_t
+{
+    FRAME,      // Short, latency-sensitive work of the UI thread.
+    BACKGROUND, // Evaluator work that may take seconds.
+};
+
+// Tracks completion of a group of tasks.
+struct TaskCounter
+{
+    std::atomic<uint32_t> pending = 0;
+};
+
+// Stop request that long-running kernels poll between their units of work
+// (blocks, pages, chunks), returning early with incomplete output once it's
+// set, which callers must then drop.
+struct TaskCancel
+{
+    const std::atomic<bool>* flags[2] = {};        // Either one set stops.
+    int64_t                  deadline = INT64_MAX; // `bx::getHPCounter` time.
+
+    bool requested() const;
+};
+
+inline bool task_cancelled(const TaskCancel* cancel)
+{
+    return cancel && cancel->requested();
+}
+
+// Zero `thread_count` uses all hardware threads. The calling thread counts as
+// one of them (it executes tasks while waiting). Each queue gets its own
+// `thread_count - 1` workers.
+void task_pool_init(uint32_t thread_count = 0);
+
+void task_pool_shutdown();
+
+// Number of threads executing tasks of a queue, including the caller (at
+// least one).
+uint32_t task_pool_thread_count();
+
+// Sets the queue that tasks run from the calling thread go to, `FRAME` by
+// default. Tasks themselves submit to the queue they were taken from.
+void task_set_thread_queue(TaskQueue queue);
+
+void task_run(TaskCounter& counter, std::function<void()> func);
+
+void task_run(TaskCounter& counter, TaskQueue queue, std::function<void()> func);
+
+// Executes queued tasks of the counter until it drops to zero. Safe to call
+// from within a task.
+void task_wait(TaskCounter& counter);
+
+// Calls `func(range_begin, range_end)` for chunks of at most `grain` elements
+// and returns once all of them finished.
+template <typename Func>
+void parallel_for(uint32_t begin, uint32_t end, uint32_t grain, Func&& func)
+{
+    grain = grain ? grain : 1;
+
+    if (end - begin <= grain || task_pool_thread_count() == 1)
+    {
+        if (begin < end)
+        {
+            func(begin, end);
+        }
+        return;
+    }
+
+    TaskCounter counter;
+
+    for (uint32_t chunk = begin + grain; chunk < end; chunk += grain)
+    {
+        const uint32_t chunk_end = end - chunk > grain ? chunk + grain : end;
+
+        task_run(counter, [&func, chunk, chunk_end]()
+        {
+            func(chunk, chunk_end);
+        });
+    }
+
+    func(begin, begin + grain);
+
+    task_wait(counter);
+}
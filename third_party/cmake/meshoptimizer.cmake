@@ -1,6 +1,7 @@
 set(MESHOPT_DIR ${meshoptimizer_SOURCE_DIR}/src)
 
 set(MESHOPT_SOURCE_FILES
+    ${MESHOPT_DIR}/clusterizer.cpp
     ${MESHOPT_DIR}/indexgenerator.cpp
     ${MESHOPT_DIR}/meshoptimizer.h
     ${MESHOPT_DIR}/overdrawoptimizer.cpp
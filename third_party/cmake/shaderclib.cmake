@@ -807,6 +807,8 @@ function(create_shaderc_target AS_EXECUTABLE)
         set(SHADERC_PLATFORM osx)
     elseif(WIN32)
         set(SHADERC_PLATFORM windows)
+    elseif(UNIX)
+        set(SHADERC_PLATFORM linux)
     else()
         message(FATAL_ERROR "Unsupported platform.")
     endif()
@@ -1,6 +1,7 @@
 #include "shaderclib.h"
 
 #include <string>
+#include <utility>           // move
 #include <vector>            // vector
 
 #include <bgfx/bgfx.h>       // copy, createShader
@@ -33,7 +34,7 @@ public:
 	}
 };
 
-bgfx::ShaderHandle compile_from_memory
+std::vector<uint8_t> compile_to_memory
 (
     ShaderType  type,
     const char* source,
@@ -50,6 +51,9 @@ bgfx::ShaderHandle compile_from_memory
 #elif BX_PLATFORM_WINDOWS
     options.platform = "windows";
     options.profile  = "cpv"[int(type)] + std::string("s_5_0");
+#elif BX_PLATFORM_LINUX
+    options.platform = "linux";
+    options.profile  = "spirv13-11";
 #else
 #   error Unsupported platform.
 #endif
@@ -65,24 +69,40 @@ bgfx::ShaderHandle compile_from_memory
     }
 
     constexpr size_t pad = 16384;
-    char* data = new char[patched.length() + pad];
-    bx::memCopy(data, patched.c_str(), patched.length());
-    bx::memSet(&data[patched.length()], 0, pad);
+    std::vector<char> data(patched.length() + pad, 0);
+    bx::memCopy(data.data(), patched.c_str(), patched.length());
 
     BufferWriter writer;
     if (!bgfx::compileShader(
         varying,
         "",
-        data,
+        data.data(),
         patched.length() - 1,
         options,
         &writer
     ))
+    {
+        return {};
+    }
+
+    return std::move(static_cast<std::vector<uint8_t>&>(writer));
+}
+
+bgfx::ShaderHandle compile_from_memory
+(
+    ShaderType  type,
+    const char* source,
+    const char* varying
+)
+{
+    const std::vector<uint8_t> binary = compile_to_memory(type, source, varying);
+
+    if (binary.empty())
     {
         return BGFX_INVALID_HANDLE;
     }
 
-    return bgfx::createShader(bgfx::copy(writer.data(), writer.size()));
+    return bgfx::createShader(bgfx::copy(binary.data(), uint32_t(binary.size())));
 }
 
 } // namespace shaderc
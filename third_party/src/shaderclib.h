@@ -1,5 +1,9 @@
 #pragma once
 
+#include <stdint.h> // uint8_t
+
+#include <vector>   // vector
+
 namespace bgfx { struct ShaderHandle; }
 
 namespace shaderc
@@ -12,6 +16,16 @@ enum struct ShaderType
     VERTEX,
 };
 
+// Shader binary for `bgfx::createShader`, or empty on failure. Doesn't call
+// into bgfx, so it can run off the rendering thread, though not concurrently
+// with another compilation.
+std::vector<uint8_t> compile_to_memory
+(
+    ShaderType  type,
+    const char* source,
+    const char* varying
+);
+
 bgfx::ShaderHandle compile_from_memory
 (
     ShaderType  type,